@@ -0,0 +1,38 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+
+// Number of times each benchmark runs over the whole corpus
+#define SR_BENCH_ROUNDS 200000
+
+// Gets a monotonic timestamp, in seconds
+double SR_BenchNow();
+
+// Prints how long a benchmark took, in total and per operation
+void SR_BenchReport(const char* name, double seconds, size_t operations);
+
+// Prints a failed correctness check. Always returns false.
+bool SR_BenchFail(const char* format, ...);
+
+// Compares the rule trie against the chain of comparisons it replaced, with few and many rules,
+// and rejecting paths with the file name filter against finding their file name first
+bool SR_BenchRuleTrie();
+
+// Checks the single-pass file name scan with every instruction set the processor supports, and compares them with wcsrchr
+bool SR_BenchPathScan();
+
+// Checks the case folding table against known characters and the whole Basic Multilingual Plane, and compares
+// folding ASCII blocks at once with folding one character at a time
+bool SR_BenchCaseFold();
+
+// Checks the user-mode canonicizer against recorded Windows paths and compares it with GetFullPathNameW
+bool SR_BenchCanonicizer();
+
+// Checks the in-memory INI against the documented GetPrivateProfile* behaviour and compares it with reading the file
+bool SR_BenchIniFile();
+
+// Checks the settings read from a hand-edited config and that saving them only changes it when needed, and times both
+bool SR_BenchConfig();
+
+// Checks that messages stored in the binary log decode to the same text, and compares storing them with formatting them
+bool SR_BenchTrace();
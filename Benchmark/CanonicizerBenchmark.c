@@ -0,0 +1,167 @@
+#include "Benchmark.h"
+#include "Corpus.h"
+#include "../SkyrimRedirector/Canonicizer.h"
+
+#include <string.h>
+#include <wchar.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <locale.h>
+#define wcscasecmp _wcsicmp
+#endif
+
+// The current directory the recorded paths were resolved against
+#define RECORDED_CURRENT_DIR L"C:\\Games\\Skyrim Special Edition"
+
+// Paths recorded on Windows, along with what GetFullPathNameW followed by an invariant uppercase returned
+// for them when the current directory was RECORDED_CURRENT_DIR.
+// Paths with an expected value of NULL aren't supported by the canonicizer.
+static const struct
+{
+	const wchar_t* Path;
+	const wchar_t* Expected;
+
+} Recorded[] =
+{
+	{ L"C:\\Users\\Player\\Documents\\My Games\\Skyrim Special Edition\\Skyrim.ini", L"C:\\USERS\\PLAYER\\DOCUMENTS\\MY GAMES\\SKYRIM SPECIAL EDITION\\SKYRIM.INI" },
+	{ L"c:/users/player/documents/my games/skyrim special edition/skyrimprefs.ini", L"C:\\USERS\\PLAYER\\DOCUMENTS\\MY GAMES\\SKYRIM SPECIAL EDITION\\SKYRIMPREFS.INI" },
+	{ L"C:\\Users\\Player\\Documents\\\\My Games\\.\\Skyrim Special Edition\\..\\Skyrim Special Edition\\SkyrimCustom.ini", L"C:\\USERS\\PLAYER\\DOCUMENTS\\MY GAMES\\SKYRIM SPECIAL EDITION\\SKYRIMCUSTOM.INI" },
+	{ L"C:\\Games\\Skyrim Special Edition\\Data\\Skyrim - Meshes0.bsa", L"C:\\GAMES\\SKYRIM SPECIAL EDITION\\DATA\\SKYRIM - MESHES0.BSA" },
+	{ L"Data\\meshes\\..\\textures\\sky\\skyrimcloudsupper04.dds", L"C:\\GAMES\\SKYRIM SPECIAL EDITION\\DATA\\TEXTURES\\SKY\\SKYRIMCLOUDSUPPER04.DDS" },
+	{ L"Data//meshes///effects/fxfirewithembers01.nif", L"C:\\GAMES\\SKYRIM SPECIAL EDITION\\DATA\\MESHES\\EFFECTS\\FXFIREWITHEMBERS01.NIF" },
+	{ L".\\Skyrim.ini", L"C:\\GAMES\\SKYRIM SPECIAL EDITION\\SKYRIM.INI" },
+	{ L"..", L"C:\\GAMES" },
+	{ L"..\\..\\Users\\Player\\AppData\\Local\\Skyrim Special Edition\\plugins.txt", L"C:\\USERS\\PLAYER\\APPDATA\\LOCAL\\SKYRIM SPECIAL EDITION\\PLUGINS.TXT" },
+	{ L"\\Windows\\win.ini", L"C:\\WINDOWS\\WIN.INI" },
+	{ L"C:Data\\Skyrim.esm", L"C:\\GAMES\\SKYRIM SPECIAL EDITION\\DATA\\SKYRIM.ESM" },
+	{ L"D:Saves\\quicksave.ess", NULL },
+	{ L"C:", L"C:\\GAMES\\SKYRIM SPECIAL EDITION" },
+	{ L"C:\\", L"C:\\" },
+	{ L"C:\\Games\\..\\..\\..\\Skyrim.ini", L"C:\\SKYRIM.INI" },
+	{ L"C:\\Games\\Skyrim Special Edition\\Data\\", L"C:\\GAMES\\SKYRIM SPECIAL EDITION\\DATA\\" },
+	{ L"C:\\Games\\Skyrim Special Edition\\Skyrim.ini. .", L"C:\\GAMES\\SKYRIM SPECIAL EDITION\\SKYRIM.INI" },
+	{ L"\\\\NAS\\Games\\Skyrim\\..\\..\\Skyrim.ini", L"\\\\NAS\\GAMES\\SKYRIM.INI" },
+	{ L"//nas/games/skyrim/skyrim.ini", L"\\\\NAS\\GAMES\\SKYRIM\\SKYRIM.INI" },
+	{ L"\\\\?\\C:\\Users\\Player\\Documents\\My Games\\Skyrim Special Edition\\Skyrim.ini", L"C:\\USERS\\PLAYER\\DOCUMENTS\\MY GAMES\\SKYRIM SPECIAL EDITION\\SKYRIM.INI" },
+	{ L"\\\\?\\UNC\\NAS\\Games\\Skyrim.ini", L"\\\\NAS\\GAMES\\SKYRIM.INI" },
+	{ L"\\\\.\\PhysicalDrive0", NULL },
+	{ L"", NULL },
+};
+
+// Checks the canonicizer against the recorded paths
+static bool CheckRecorded()
+{
+	wchar_t buffer[1024];
+
+	for (size_t i = 0; i < sizeof(Recorded) / sizeof(Recorded[0]); i++)
+	{
+		size_t len = SR_CanonicizeIntoW(Recorded[i].Path, RECORDED_CURRENT_DIR, buffer, 1024);
+
+		if (Recorded[i].Expected == NULL)
+		{
+			if (len != 0)
+				return SR_BenchFail("'%ls' canonicized to '%ls', expected it to be unsupported", Recorded[i].Path, buffer);
+
+			continue;
+		}
+
+		if (len == 0)
+			return SR_BenchFail("'%ls' couldn't be canonicized, expected '%ls'", Recorded[i].Path, Recorded[i].Expected);
+
+		if (wcscmp(buffer, Recorded[i].Expected) != 0 || len != wcslen(buffer))
+			return SR_BenchFail("'%ls' canonicized to '%ls', expected '%ls'", Recorded[i].Path, buffer, Recorded[i].Expected);
+
+		// Resolving keeps the case, but must otherwise be identical so that directory prefixes line up
+		wchar_t resolved[1024];
+		size_t resolvedLen = SR_ResolveIntoW(Recorded[i].Path, RECORDED_CURRENT_DIR, resolved, 1024);
+		if (resolvedLen != len || wcscasecmp(resolved, buffer) != 0)
+			return SR_BenchFail("'%ls' resolved to '%ls', expected a case-insensitive match of '%ls'", Recorded[i].Path, resolved, buffer);
+	}
+
+	// The canonicizer must never write past the buffer it was given
+	if (SR_CanonicizeIntoW(Recorded[0].Path, NULL, buffer, wcslen(Recorded[0].Expected)) != 0)
+		return SR_BenchFail("A path was canonicized into a buffer too small to hold it");
+
+	return true;
+}
+
+#ifdef _WIN32
+
+static _locale_t InvariantLocale = NULL;
+
+// How the redirector canonicized paths before the user-mode canonicizer
+static size_t LegacyCanonicizeW(const wchar_t* path, wchar_t* buffer, size_t bufferSize)
+{
+	DWORD len = GetFullPathNameW(path, (DWORD)bufferSize, buffer, NULL);
+	if (len == 0 || len >= bufferSize) return 0;
+
+	_wcsupr_s_l(buffer, bufferSize, InvariantLocale);
+	return len;
+}
+
+// Checks the canonicizer against GetFullPathNameW on the whole corpus, using the actual current directory
+static bool CheckAgainstWindows(const wchar_t* currentDir)
+{
+	wchar_t expected[1024];
+	wchar_t actual[1024];
+
+	for (size_t i = 0; i < SR_CorpusLen; i++)
+	{
+		if (LegacyCanonicizeW(SR_Corpus[i], expected, 1024) == 0) continue;
+		if (SR_CanonicizeIntoW(SR_Corpus[i], currentDir, actual, 1024) == 0)
+			return SR_BenchFail("'%ls' couldn't be canonicized, expected '%ls'", SR_Corpus[i], expected);
+
+		if (wcscmp(expected, actual) != 0)
+			return SR_BenchFail("'%ls' canonicized to '%ls', expected '%ls'", SR_Corpus[i], actual, expected);
+	}
+
+	return true;
+}
+
+#endif
+
+bool SR_BenchCanonicizer()
+{
+	if (!CheckRecorded()) return false;
+
+	const wchar_t* currentDir = RECORDED_CURRENT_DIR;
+
+#ifdef _WIN32
+	InvariantLocale = _create_locale(LC_ALL, "C");
+
+	wchar_t actualCurrentDir[1024];
+	if (GetCurrentDirectoryW(1024, actualCurrentDir) == 0)
+		return SR_BenchFail("Unable to get the current directory");
+
+	currentDir = actualCurrentDir;
+	if (!CheckAgainstWindows(currentDir)) return false;
+#endif
+
+	const size_t operations = SR_BENCH_ROUNDS * SR_CorpusLen;
+	volatile size_t totalLen = 0;
+	wchar_t buffer[1024];
+	double start;
+
+#ifdef _WIN32
+	start = SR_BenchNow();
+	for (size_t round = 0; round < SR_BENCH_ROUNDS; round++)
+	{
+		for (size_t i = 0; i < SR_CorpusLen; i++)
+			totalLen += LegacyCanonicizeW(SR_Corpus[i], buffer, 1024);
+	}
+	SR_BenchReport("GetFullPathNameW + _wcsupr_s_l", SR_BenchNow() - start, operations);
+
+	_free_locale(InvariantLocale);
+#endif
+
+	start = SR_BenchNow();
+	for (size_t round = 0; round < SR_BENCH_ROUNDS; round++)
+	{
+		for (size_t i = 0; i < SR_CorpusLen; i++)
+			totalLen += SR_CanonicizeIntoW(SR_Corpus[i], currentDir, buffer, 1024);
+	}
+	SR_BenchReport("User-mode canonicizer", SR_BenchNow() - start, operations);
+
+	return true;
+}
@@ -0,0 +1,170 @@
+#include "Benchmark.h"
+#include "Corpus.h"
+#include "../SkyrimRedirector/CaseFold.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+
+// Size, in characters, of the buffers the paths are folded in
+#define BUFFER_SIZE 1024
+
+// Characters whose uppercase form is known, along with it
+static const wchar_t KnownFolds[][2] =
+{
+	{ L'a', L'A' },
+	{ L'z', L'Z' },
+	{ L'A', L'A' },
+	{ L'\\', L'\\' },
+	{ 0x00E9, 0x00C9 }, // e with acute accent
+	{ 0x00FF, 0x0178 }, // y with diaeresis, whose uppercase form is outside of Latin-1
+	{ 0x00DF, 0x00DF }, // sharp s, whose uppercase form is two characters
+	{ 0x0131, 0x0131 }, // dotless i, which NTFS doesn't uppercase to an ASCII 'I'
+	{ 0x017F, 0x017F }, // long s, which NTFS doesn't uppercase to an ASCII 'S'
+	{ 0x03C9, 0x03A9 }, // omega
+	{ 0x044F, 0x042F }, // ya
+	{ 0xFF41, 0xFF21 }, // fullwidth a
+	{ 0xFFFF, 0xFFFF },
+};
+
+#define KNOWN_FOLD_COUNT (sizeof(KnownFolds) / sizeof(KnownFolds[0]))
+
+// Paths with letters outside of ASCII in different places around the blocks folded at once
+static const wchar_t* EdgeCases[] =
+{
+	L"",
+	L"c:\\users\\jos\x00E9\\documents\\my games\\skyrim special edition\\skyrim.ini",
+	L"\x00E9\\abcdefghijklmnopqrstuvwxyz\\",
+	L"c:\\\x0434\x043E\x043A\x0443\x043C\x0435\x043D\x0442\x044B\\skyrim.ini",
+	L"abcdefghijklmno\x00FF",
+	L"`abcxyz{@ABCXYZ[",
+};
+
+#define EDGE_CASE_COUNT (sizeof(EdgeCases) / sizeof(EdgeCases[0]))
+
+// Folds every character of a wide string one at a time
+static void FoldEachW(wchar_t* str, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+		str[i] = SR_FoldCharW(str[i]);
+}
+
+// Checks that folding a path all at once gives the same result as folding each character, at every offset
+static bool CheckPath(const wchar_t* path)
+{
+	static wchar_t expected[BUFFER_SIZE];
+	static wchar_t actual[BUFFER_SIZE];
+	static char narrowExpected[BUFFER_SIZE];
+	static char narrowActual[BUFFER_SIZE];
+
+	size_t len = wcslen(path);
+
+	for (size_t start = 0; start <= len; start++)
+	{
+		wmemcpy(expected, path, len + 1);
+		wmemcpy(actual, path, len + 1);
+		FoldEachW(expected + start, len - start);
+		SR_FoldW(actual + start, len - start);
+
+		if (wmemcmp(expected, actual, len + 1) != 0)
+			return SR_BenchFail("'%ls' folded from %zu was '%ls', expected '%ls'", path, start, actual, expected);
+
+		// Anything that isn't ASCII is narrowed to a byte above 0x7F, which must never be folded
+		for (size_t i = 0; i <= len; i++)
+			narrowExpected[i] = narrowActual[i] = path[i] < 0x80 ? (char)path[i] : (char)0xE9;
+
+		for (size_t i = start; i < len; i++)
+			narrowExpected[i] = SR_FoldCharA(narrowExpected[i]);
+		SR_FoldA(narrowActual + start, len - start);
+
+		if (memcmp(narrowExpected, narrowActual, len + 1) != 0)
+			return SR_BenchFail("narrow '%ls' folded from %zu was '%s', expected '%s'", path, start, narrowActual, narrowExpected);
+	}
+
+	return true;
+}
+
+// Checks every character of the Basic Multilingual Plane against the rules the table was generated with
+static bool CheckPlane()
+{
+	for (unsigned int c = 0; c <= 0xFFFF; c++)
+	{
+		unsigned int folded = (unsigned int)SR_FoldCharW((wchar_t)c);
+
+		// Uppercase forms never go back to ASCII, and folding them again doesn't change them
+		if (c >= 0x80 && folded < 0x80)
+			return SR_BenchFail("U+%04X was folded to ASCII U+%04X", c, folded);
+		if ((unsigned int)SR_FoldCharW((wchar_t)folded) != folded)
+			return SR_BenchFail("U+%04X was folded to U+%04X, which folds again", c, folded);
+
+		wchar_t str[2] = { (wchar_t)c, L'\0' };
+		SR_FoldW(str, 1);
+		if ((unsigned int)str[0] != folded)
+			return SR_BenchFail("U+%04X was folded to U+%04X one character at a time, but to U+%04X in a string", c, folded, (unsigned int)str[0]);
+	}
+
+	return true;
+}
+
+bool SR_BenchCaseFold()
+{
+	bool passed = true;
+
+	for (size_t i = 0; i < KNOWN_FOLD_COUNT && passed; i++)
+	{
+		wchar_t folded = SR_FoldCharW(KnownFolds[i][0]);
+		if (folded != KnownFolds[i][1])
+			passed = SR_BenchFail("U+%04X was folded to U+%04X, expected U+%04X",
+				(unsigned int)KnownFolds[i][0], (unsigned int)folded, (unsigned int)KnownFolds[i][1]);
+	}
+
+	if (passed) passed = CheckPlane();
+
+	for (size_t i = 0; i < SR_CorpusLen && passed; i++)
+		passed = CheckPath(SR_Corpus[i]);
+
+	for (size_t i = 0; i < EDGE_CASE_COUNT && passed; i++)
+		passed = CheckPath(EdgeCases[i]);
+
+	if (passed && !SR_FoldedEqualsW(L"C:\\Users\\Jos\x00E9\\Skyrim.ini", L"c:\\USERS\\JOS\x00C9\\skyrim.INI"))
+		passed = SR_BenchFail("Paths that only differ in case weren't equal");
+
+	if (passed && SR_FoldedEqualsW(L"Skyrim.ini", L"Skyrim.in"))
+		passed = SR_BenchFail("Paths of different lengths were equal");
+
+	if (passed)
+	{
+		static wchar_t buffer[BUFFER_SIZE];
+		const size_t operations = SR_BENCH_ROUNDS * SR_CorpusLen;
+		volatile size_t folded = 0;
+		double start;
+
+		start = SR_BenchNow();
+		for (size_t round = 0; round < SR_BENCH_ROUNDS; round++)
+		{
+			for (size_t i = 0; i < SR_CorpusLen; i++)
+			{
+				size_t len = wcslen(SR_Corpus[i]);
+				wmemcpy(buffer, SR_Corpus[i], len);
+				FoldEachW(buffer, len);
+				folded += buffer[len / 2];
+			}
+		}
+		SR_BenchReport("Wide: one character at a time", SR_BenchNow() - start, operations);
+
+		start = SR_BenchNow();
+		for (size_t round = 0; round < SR_BENCH_ROUNDS; round++)
+		{
+			for (size_t i = 0; i < SR_CorpusLen; i++)
+			{
+				size_t len = wcslen(SR_Corpus[i]);
+				wmemcpy(buffer, SR_Corpus[i], len);
+				SR_FoldW(buffer, len);
+				folded += buffer[len / 2];
+			}
+		}
+		SR_BenchReport("Wide: ASCII blocks at once", SR_BenchNow() - start, operations);
+	}
+
+	return passed;
+}
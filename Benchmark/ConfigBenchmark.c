@@ -0,0 +1,218 @@
+#include "Benchmark.h"
+#include "../SkyrimRedirector/ConfigParser.h"
+#include "../SkyrimRedirector/Logging.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+// A config as written by the plugin, edited by hand
+static const wchar_t ConfigText[] =
+	L"[Logging]\r\n"
+	L"File=C:\\Games\\Skyrim Special Edition\\Data\\SKSE\\Plugins\\SkyrimRedirector.log\r\n"
+	L"level = debug\r\n"
+	L"Append=FALSE\r\n"
+	L"HookStatistics=true\r\n"
+	L"\r\n"
+	L"[Redirection]\r\n"
+	L"Ini=C:\\Users\\Player\\Documents\\My Games\\Enderal Special Edition\\Enderal.ini\r\n"
+	L"prefsini=\"C:\\Users\\Player\\Documents\\My Games\\Enderal Special Edition\\EnderalPrefs.ini\"\r\n"
+	L"CustomIni=\r\n"
+	L"; Extra redirections\r\n"
+	L"Data\\Interface\\fontconfig.txt = C:\\Mods\\fontconfig.txt\r\n"
+	L"#Data\\Commented.txt=C:\\Commented.txt\r\n"
+	L"NoValue=\r\n"
+	L"NotAPair\r\n"
+	L"C:\\Saves\\quicksave.ess=D:\\Saves\\quicksave.ess\r\n"
+	L"\r\n"
+	L"[DirectoryRedirection]\r\n"
+	L"My Games\\Skyrim Special Edition\\Saves=D:\\Saves\r\n"
+	L"\r\n"
+	L"[Hooks]\r\n"
+	L"default = import\r\n"
+	L"CreateFileW=Inline\r\n"
+	L"GetPrivateProfileStringA=Unknown\r\n";
+
+// Checks that a string read from the config is the expected one, or both are NULL
+static bool StringEquals(const wchar_t* actual, const wchar_t* expected)
+{
+	if (actual == NULL || expected == NULL) return actual == expected;
+	return wcscmp(actual, expected) == 0;
+}
+
+// Frees every string and array read into a config
+static void FreeParsed(SR_UserConfig* config)
+{
+	free(config->Logging.File);
+	free(config->Redirection.Ini);
+	free(config->Redirection.PrefsIni);
+	free(config->Redirection.CustomIni);
+	free(config->Redirection.Plugins);
+
+	for (size_t i = 0; i < config->Redirection.RuleCount; i++)
+	{
+		free(config->Redirection.Rules[i].Source);
+		free(config->Redirection.Rules[i].Target);
+	}
+	free(config->Redirection.Rules);
+
+	for (size_t i = 0; i < config->Redirection.DirectoryRuleCount; i++)
+	{
+		free(config->Redirection.DirectoryRules[i].Source);
+		free(config->Redirection.DirectoryRules[i].Target);
+	}
+	free(config->Redirection.DirectoryRules);
+
+	for (size_t i = 0; i < config->Hooks.RuleCount; i++)
+		free(config->Hooks.Rules[i].Name);
+	free(config->Hooks.Rules);
+}
+
+// Checks the settings read from the hand-edited config
+static bool CheckConfig(const SR_UserConfig* config)
+{
+	if (!StringEquals(config->Logging.File, L"C:\\Games\\Skyrim Special Edition\\Data\\SKSE\\Plugins\\SkyrimRedirector.log"))
+		return SR_BenchFail("Read the log file as '%ls'", config->Logging.File);
+
+	if (config->Logging.Level != SR_LOG_LEVEL_DEBUG || config->Logging.Append || !config->Logging.HookStatistics || !config->Logging.Binary)
+		return SR_BenchFail("Read the wrong logging options, or didn't keep the default of a missing one");
+
+	if (!StringEquals(config->Redirection.Ini, L"C:\\Users\\Player\\Documents\\My Games\\Enderal Special Edition\\Enderal.ini"))
+		return SR_BenchFail("Read the Ini redirection as '%ls'", config->Redirection.Ini);
+
+	if (!StringEquals(config->Redirection.PrefsIni, L"C:\\Users\\Player\\Documents\\My Games\\Enderal Special Edition\\EnderalPrefs.ini"))
+		return SR_BenchFail("Read the PrefsIni redirection as '%ls'", config->Redirection.PrefsIni);
+
+	// Empty and missing paths are both left for the defaults
+	if (config->Redirection.CustomIni != NULL || config->Redirection.Plugins != NULL)
+		return SR_BenchFail("Read an empty or missing redirection as a path");
+
+	if (config->Redirection.RuleCount != 2
+		|| !StringEquals(config->Redirection.Rules[0].Source, L"Data\\Interface\\fontconfig.txt")
+		|| !StringEquals(config->Redirection.Rules[0].Target, L"C:\\Mods\\fontconfig.txt")
+		|| !StringEquals(config->Redirection.Rules[1].Source, L"C:\\Saves\\quicksave.ess")
+		|| !StringEquals(config->Redirection.Rules[1].Target, L"D:\\Saves\\quicksave.ess"))
+		return SR_BenchFail("Read %zu redirection rules, expected the 2 valid ones", config->Redirection.RuleCount);
+
+	if (config->Redirection.DirectoryRuleCount != 1
+		|| !StringEquals(config->Redirection.DirectoryRules[0].Source, L"My Games\\Skyrim Special Edition\\Saves")
+		|| !StringEquals(config->Redirection.DirectoryRules[0].Target, L"D:\\Saves"))
+		return SR_BenchFail("Read %zu directory redirection rules, expected 1", config->Redirection.DirectoryRuleCount);
+
+	// Unknown modes fall back to inline hooks, which work for every function
+	if (config->Hooks.RuleCount != 2
+		|| SR_GetHookMode(config, L"GetFileAttributesW") != SR_HOOK_IMPORT
+		|| SR_GetHookMode(config, L"createfilew") != SR_HOOK_INLINE
+		|| SR_GetHookMode(config, L"GetPrivateProfileStringA") != SR_HOOK_INLINE)
+		return SR_BenchFail("Read %zu hook modes, or read the wrong default or mode", config->Hooks.RuleCount);
+
+	return true;
+}
+
+// Checks that an empty config keeps every default and reads no paths or rules
+static bool CheckEmptyConfig()
+{
+	SR_IniFile* ini = SR_ParseIni(L"", 0);
+	SR_UserConfig config = { 0 };
+	config.Logging.Level = SR_LOG_LEVEL_INFO;
+	config.Logging.Append = true;
+
+	SR_ParseUserConfig(ini, &config);
+	SR_FreeIni(ini);
+
+	bool passed = config.Logging.Level == SR_LOG_LEVEL_INFO && config.Logging.Append
+		&& config.Logging.File == NULL && config.Redirection.Ini == NULL
+		&& config.Redirection.RuleCount == 0 && config.Redirection.DirectoryRuleCount == 0
+		&& config.Hooks.Default == SR_HOOK_INLINE && config.Hooks.RuleCount == 0;
+
+	FreeParsed(&config);
+	return passed ? true : SR_BenchFail("An empty config didn't keep the defaults");
+}
+
+// Checks that storing a config that was just read and stored doesn't change the file, so that it isn't written
+static bool CheckStore(SR_IniFile* ini, SR_UserConfig* config)
+{
+	// The file doesn't have Binary yet and spells the level in lowercase, so it's changed the first time
+	if (!SR_StoreUserConfig(ini, config))
+		return SR_BenchFail("Storing a config with a new setting didn't change the file");
+
+	size_t len;
+	wchar_t* stored = SR_FormatIni(ini, &len);
+	bool changed = SR_StoreUserConfig(ini, config);
+
+	size_t unchangedLen;
+	wchar_t* unchanged = SR_FormatIni(ini, &unchangedLen);
+	bool identical = len == unchangedLen && wmemcmp(stored, unchanged, len) == 0;
+	free(stored);
+	free(unchanged);
+
+	if (changed || !identical)
+		return SR_BenchFail("Storing the same config twice changed the file");
+
+	// Lines that weren't changed are kept as they were, quotes and all
+	SR_IniFile* reparsed = SR_ParseIni(ConfigText, wcslen(ConfigText));
+	config->Logging.Binary = false;
+	config->Logging.Level = SR_LOG_LEVEL_OFF;
+	SR_SetIniString(reparsed, L"Logging", L"Level", L"OFF");
+
+	changed = SR_StoreUserConfig(reparsed, config);
+	stored = SR_FormatIni(reparsed, &len);
+	SR_FreeIni(reparsed);
+
+	bool kept = wcsstr(stored, L"prefsini=\"C:\\Users") != NULL && wcsstr(stored, L"Binary=FALSE") != NULL;
+	free(stored);
+
+	if (!changed || !kept)
+		return SR_BenchFail("Storing a config didn't add the missing setting or didn't keep the unchanged lines");
+
+	return true;
+}
+
+bool SR_BenchConfig()
+{
+	if (!CheckEmptyConfig()) return false;
+
+	SR_IniFile* ini = SR_ParseIni(ConfigText, wcslen(ConfigText));
+	SR_UserConfig config = { 0 };
+	config.Logging.Binary = true;
+
+	SR_ParseUserConfig(ini, &config);
+	bool passed = CheckConfig(&config) && CheckStore(ini, &config);
+	FreeParsed(&config);
+	SR_FreeIni(ini);
+
+	if (!passed) return false;
+
+	// Loading the config is much slower than the other benchmarks, so it runs fewer times
+	const size_t rounds = SR_BENCH_ROUNDS / 100;
+	double start;
+
+	start = SR_BenchNow();
+	for (size_t round = 0; round < rounds; round++)
+	{
+		SR_IniFile* parsed = SR_ParseIni(ConfigText, wcslen(ConfigText));
+		SR_UserConfig loaded = { 0 };
+
+		SR_ParseUserConfig(parsed, &loaded);
+
+		FreeParsed(&loaded);
+		SR_FreeIni(parsed);
+	}
+	SR_BenchReport("Parse the config from memory", SR_BenchNow() - start, rounds);
+
+	SR_IniFile* stored = SR_ParseIni(ConfigText, wcslen(ConfigText));
+	SR_UserConfig loaded = { 0 };
+	SR_ParseUserConfig(stored, &loaded);
+	SR_StoreUserConfig(stored, &loaded);
+
+	volatile size_t changes = 0;
+	start = SR_BenchNow();
+	for (size_t round = 0; round < rounds; round++)
+		changes += SR_StoreUserConfig(stored, &loaded);
+	SR_BenchReport("Store an unchanged config", SR_BenchNow() - start, rounds);
+
+	FreeParsed(&loaded);
+	SR_FreeIni(stored);
+
+	return true;
+}
@@ -0,0 +1,72 @@
+#include "Corpus.h"
+
+const wchar_t* const SR_Corpus[] =
+{
+	L"C:\\Games\\Skyrim Special Edition\\Data\\Skyrim - Meshes0.bsa",
+	L"C:\\Games\\Skyrim Special Edition\\Data\\Skyrim - Meshes1.bsa",
+	L"C:\\Games\\Skyrim Special Edition\\Data\\Skyrim - Textures0.bsa",
+	L"C:\\Games\\Skyrim Special Edition\\Data\\Skyrim - Textures3.bsa",
+	L"C:\\Games\\Skyrim Special Edition\\Data\\Skyrim - Sounds.bsa",
+	L"C:\\Games\\Skyrim Special Edition\\Data\\Skyrim - Voices_en0.bsa",
+	L"C:\\Games\\Skyrim Special Edition\\Data\\Skyrim - Interface.bsa",
+	L"C:\\Games\\Skyrim Special Edition\\Data\\Skyrim - Animations.bsa",
+	L"C:\\Games\\Skyrim Special Edition\\Data\\E - Meshes.bsa",
+	L"C:\\Games\\Skyrim Special Edition\\Data\\E - Textures1.bsa",
+	L"C:\\Games\\Skyrim Special Edition\\Data\\Enderal - Forgotten Stories.esm",
+	L"C:\\Games\\Skyrim Special Edition\\Data\\Skyrim.esm",
+	L"C:\\Games\\Skyrim Special Edition\\Data\\Update.esm",
+	L"Data\\meshes\\actors\\character\\character assets\\malehead.nif",
+	L"Data\\meshes\\actors\\character\\character assets\\femalebody_1.nif",
+	L"Data\\meshes\\armor\\iron\\m\\cuirass_1.nif",
+	L"Data\\meshes\\weapons\\iron\\ironsword.nif",
+	L"Data\\meshes\\architecture\\whiterun\\wrbuildings\\wrhouse01.nif",
+	L"Data\\meshes\\landscape\\trees\\treepineforest01.nif",
+	L"Data\\meshes\\clutter\\common\\basket01.nif",
+	L"Data\\textures\\actors\\character\\male\\malehead.dds",
+	L"Data\\textures\\actors\\character\\male\\malehead_msn.dds",
+	L"Data\\textures\\armor\\iron\\cuirass.dds",
+	L"Data\\textures\\armor\\iron\\cuirass_n.dds",
+	L"Data\\textures\\landscape\\dirt01.dds",
+	L"Data\\textures\\landscape\\grass\\grass01.dds",
+	L"Data\\textures\\sky\\skyrimcloudsupper04.dds",
+	L"Data\\textures\\terrain\\tamriel\\tamriel.4.-12.4.dds",
+	L"Data\\sound\\fx\\ui\\ui_menu_ok.wav",
+	L"Data\\sound\\fx\\npc\\wolf\\attack\\npc_wolf_attack_01.wav",
+	L"Data\\sound\\voice\\skyrim.esm\\maleeventoned\\00012345_1.fuz",
+	L"Data\\music\\explore\\mus_explore_day_01.xwm",
+	L"Data\\interface\\fontconfig.txt",
+	L"Data\\interface\\translate_english.txt",
+	L"Data\\interface\\hudmenu.swf",
+	L"Data\\scripts\\actor.pex",
+	L"Data\\scripts\\quest.pex",
+	L"Data\\seq\\skyrim.seq",
+	L"Data\\grass\\grass.ini",
+	L"Data/meshes/effects/fxfirewithembers01.nif",
+	L"Data/textures/effects/gradients/gradfire01.dds",
+	L"C:\\Games\\Skyrim Special Edition\\SkyrimSE.exe",
+	L"C:\\Games\\Skyrim Special Edition\\Skyrim_Default.ini",
+	L"C:\\Games\\Skyrim Special Edition\\Data\\SKSE\\Plugins\\SkyrimRedirector.ini",
+	L"C:\\Users\\Player\\Documents\\My Games\\Skyrim Special Edition\\Skyrim.ini",
+	L"C:\\Users\\Player\\Documents\\My Games\\Skyrim Special Edition\\SkyrimPrefs.ini",
+	L"C:\\Users\\Player\\Documents\\My Games\\Skyrim Special Edition\\SkyrimCustom.ini",
+	L"C:\\Users\\Player\\AppData\\Local\\Skyrim Special Edition\\plugins.txt",
+	L"C:\\Users\\Player\\Documents\\My Games\\Skyrim Special Edition\\Saves\\Save1_0000_Player_Tamriel.ess",
+	L"C:\\Users\\Player\\Documents\\My Games\\Skyrim Special Edition\\Saves\\Save1_0000_Player_Tamriel.skse",
+	L"C:\\Users\\Player\\Documents\\My Games\\Skyrim Special Edition\\SKSE\\skse64.log",
+	L"c:\\users\\player\\documents\\my games\\skyrim special edition\\skyrimprefs.ini",
+};
+
+const size_t SR_CorpusLen = sizeof(SR_Corpus) / sizeof(SR_Corpus[0]);
+
+const wchar_t* SR_CorpusFileName(const wchar_t* path)
+{
+	const wchar_t* fileName = path;
+
+	for (const wchar_t* current = path; *current != L'\0'; current++)
+	{
+		if (*current == L'\\' || *current == L'/')
+			fileName = current + 1;
+	}
+
+	return fileName;
+}
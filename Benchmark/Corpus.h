@@ -0,0 +1,16 @@
+#pragma once
+#include <stddef.h>
+#include <wchar.h>
+
+// A mix of paths recorded from the file accesses the game makes during startup and gameplay:
+// mostly archives, meshes, textures and sounds, with the occasional .ini or plugins.txt
+extern const wchar_t* const SR_Corpus[];
+
+// Maximum number of paths in SR_Corpus, for benchmarks that need to precompute something for every path
+#define SR_CORPUS_MAX_LEN 256
+
+// Number of paths in SR_Corpus
+extern const size_t SR_CorpusLen;
+
+// Gets the file name from a wide path in the corpus, without depending on the Windows CRT
+const wchar_t* SR_CorpusFileName(const wchar_t* path);
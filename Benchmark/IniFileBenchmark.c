@@ -0,0 +1,488 @@
+#include "Benchmark.h"
+#include "../SkyrimRedirector/IniFile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+// A small INI with only behaviour that is documented for GetPrivateProfileString
+static const wchar_t IniText[] =
+	L"; Skyrim.ini\r\n"
+	L"[General]\r\n"
+	L"sLanguage=ENGLISH\r\n"
+	L"  sTest  =  spaced value  \r\n"
+	L"sQuoted=\"quoted value\"\r\n"
+	L"fFloat=1.5000\r\n"
+	L"iHex=0x1F\r\n"
+	L"iNeg=-42\r\n"
+	L"\r\n"
+	L"[Display]\r\n"
+	L"iSize W=1920\r\n"
+	L"iSize H=1080\r\n"
+	L"[Empty]\r\n"
+	L"[Struct]\r\n"
+	L"Data=01020306\r\n"
+	L"Bad=01020307\r\n";
+
+// An INI full of malformed lines, only compared against Windows
+static const wchar_t QuirksText[] =
+	L"TopKey=before any section\n"
+	L"[General]   trailing\n"
+	L"NoEquals\n"
+	L"=NoName\n"
+	L"; comment=inside\n"
+	L"\n"
+	L"\n"
+	L"sHalf=\"open\n"
+	L"sSingle='x'\n"
+	L"sEmptyQuotes=\"\"\n"
+	L"sQuoted=\"quoted value\"\n"
+	L"[general]\n"
+	L"sLanguage=GERMAN\r"
+	L"[Un]closed\n"
+	L"[Missing\n"
+	L"[]\n"
+	L"iSpaces=   12abc\n"
+	L"iPlus=+0b101\n"
+	L"iOctal=0o17\n"
+	L"iUpperHex=0X1F\n";
+
+// Number of sections and keys per section in the generated INI used for timing, about as many as SkyrimPrefs.ini
+#define TIMING_SECTIONS 24
+#define TIMING_KEYS 16
+
+// A query made against both the in-memory INI and Windows
+typedef struct
+{
+	const wchar_t* Section;
+	const wchar_t* Key;
+	const wchar_t* Default;
+	size_t Size;
+
+} Query;
+
+// A string query and the list or value it must return
+typedef struct
+{
+	Query Query;
+
+	const wchar_t* Expected;
+	// Length of Expected, including every null terminator in it
+	size_t ExpectedLen;
+	size_t ExpectedResult;
+
+} StringCheck;
+
+#define EXPECT(text, result) text, sizeof(text) / sizeof(wchar_t) - 1, result
+
+static const StringCheck StringChecks[] =
+{
+	{ { L"General", L"sLanguage", NULL, 64 }, EXPECT(L"ENGLISH", 7) },
+	{ { L"  general ", L" SLANGUAGE ", NULL, 64 }, EXPECT(L"ENGLISH", 7) },
+	{ { L"General", L"sTest", NULL, 64 }, EXPECT(L"spaced value", 12) },
+	{ { L"General", L"sQuoted", NULL, 64 }, EXPECT(L"quoted value", 12) },
+	{ { L"General", L"Missing", L"default  ", 64 }, EXPECT(L"default", 7) },
+	{ { L"Missing", L"sLanguage", NULL, 64 }, EXPECT(L"", 0) },
+	{ { L"General", L"sLanguage", NULL, 4 }, EXPECT(L"ENG", 3) },
+	{ { L"Display", NULL, NULL, 64 }, EXPECT(L"iSize W\0iSize H\0", 16) },
+	{ { L"Display", NULL, NULL, 10 }, EXPECT(L"iSize W\0", 8) },
+	{ { L"Empty", NULL, L"default", 64 }, EXPECT(L"default", 7) },
+	{ { NULL, NULL, NULL, 64 }, EXPECT(L"General\0Display\0Empty\0Struct\0", 29) },
+	{ { NULL, NULL, NULL, 10 }, EXPECT(L"General\0\0", 8) },
+};
+
+// Checks if a buffer holds the expected string or list, followed by a null terminator
+static bool BufferEquals(const wchar_t* buffer, const wchar_t* expected, size_t expectedLen)
+{
+	return wmemcmp(buffer, expected, expectedLen) == 0 && buffer[expectedLen] == L'\0';
+}
+
+// Checks the in-memory INI against the documented behaviour of the GetPrivateProfile* functions
+static bool CheckDocumented(const SR_IniFile* ini)
+{
+	wchar_t buffer[64];
+
+	for (size_t i = 0; i < sizeof(StringChecks) / sizeof(StringChecks[0]); i++)
+	{
+		const StringCheck* check = &StringChecks[i];
+		wmemset(buffer, L'#', 64);
+
+		size_t result = SR_GetIniString(ini, check->Query.Section, check->Query.Key, check->Query.Default, buffer, check->Query.Size);
+		if (result != check->ExpectedResult || !BufferEquals(buffer, check->Expected, check->ExpectedLen))
+		{
+			return SR_BenchFail(
+				"[%ls] %ls returned %zu '%ls', expected %zu '%ls'",
+				check->Query.Section != NULL ? check->Query.Section : L"(null)",
+				check->Query.Key != NULL ? check->Query.Key : L"(null)",
+				result, buffer, check->ExpectedResult, check->Expected
+			);
+		}
+	}
+
+	static const wchar_t ExpectedSection[] = L"iSize W=1920\0iSize H=1080\0";
+	size_t sectionLen = SR_GetIniSection(ini, L"Display", buffer, 64);
+	if (sectionLen != 26 || !BufferEquals(buffer, ExpectedSection, 26))
+		return SR_BenchFail("[Display] was listed as %zu '%ls'", sectionLen, buffer);
+
+	if (SR_GetIniInt(ini, L"General", L"fFloat", 7) != 1) return SR_BenchFail("fFloat wasn't read as 1");
+	if (SR_GetIniInt(ini, L"General", L"iHex", 7) != 31) return SR_BenchFail("iHex wasn't read as 31");
+	if (SR_GetIniInt(ini, L"General", L"iNeg", 7) != (unsigned int)-42) return SR_BenchFail("iNeg wasn't read as -42");
+	if (SR_GetIniInt(ini, L"General", L"sLanguage", 7) != 0) return SR_BenchFail("sLanguage wasn't read as 0");
+	if (SR_GetIniInt(ini, L"General", L"Missing", 7) != 7) return SR_BenchFail("A missing integer didn't return its default");
+
+	unsigned char data[4] = { 0 };
+	if (!SR_GetIniStruct(ini, L"Struct", L"Data", data, 3) || data[0] != 1 || data[1] != 2 || data[2] != 3)
+		return SR_BenchFail("The struct in [Struct] Data wasn't read");
+	if (SR_GetIniStruct(ini, L"Struct", L"Data", data, 4))
+		return SR_BenchFail("A struct was read with the wrong size");
+	if (SR_GetIniStruct(ini, L"Struct", L"Bad", data, 3))
+		return SR_BenchFail("A struct was read with the wrong checksum");
+
+	return true;
+}
+
+// A change made to both the in-memory INI and, on Windows, a file with WritePrivateProfileStringW
+typedef struct
+{
+	const wchar_t* Section;
+	const wchar_t* Key;
+	const wchar_t* Value;
+
+} Write;
+
+static const Write Writes[] =
+{
+	{ L"General", L"sLanguage", L"GERMAN" },
+	{ L" general ", L" sNew ", L"  new value  " },
+	{ L"General", L"iNeg", NULL },
+	{ L"Empty", NULL, NULL },
+	{ L"Added", L"Key", L"1" },
+};
+
+// IniText after every write, SR_SetIniSection and SR_SetIniStruct in CheckWrites
+static const wchar_t WrittenText[] =
+	L"; Skyrim.ini\r\n"
+	L"[General]\r\n"
+	L"sLanguage=GERMAN\r\n"
+	L"  sTest  =  spaced value  \r\n"
+	L"sQuoted=\"quoted value\"\r\n"
+	L"fFloat=1.5000\r\n"
+	L"iHex=0x1F\r\n"
+	L"sNew=new value\r\n"
+	L"\r\n"
+	L"[Display]\r\n"
+	L"iSize W=800\r\n"
+	L"iSize H=600\r\n"
+	L"[Struct]\r\n"
+	L"Data=0405060F\r\n"
+	L"Bad=01020307\r\n"
+	L"[Added]\r\n"
+	L"Key=1\r\n";
+
+// Checks that changes are made like the WritePrivateProfile* functions, and that unchanged lines are written back as-is
+static bool CheckWrites()
+{
+	SR_IniFile* ini = SR_ParseIni(IniText, wcslen(IniText));
+	bool passed = true;
+
+	size_t len;
+	wchar_t* text = SR_FormatIni(ini, &len);
+	if (len != wcslen(IniText) || wcscmp(text, IniText) != 0)
+		passed = SR_BenchFail("An unchanged INI was written back as '%ls'", text);
+	free(text);
+
+	for (size_t i = 0; passed && i < sizeof(Writes) / sizeof(Writes[0]); i++)
+	{
+		if (!SR_SetIniString(ini, Writes[i].Section, Writes[i].Key, Writes[i].Value))
+			passed = SR_BenchFail("Write %zu didn't change the INI", i);
+	}
+
+	static const unsigned char Data[3] = { 4, 5, 6 };
+	if (passed && SR_SetIniString(ini, L"General", L"sLanguage", L"GERMAN"))
+		passed = SR_BenchFail("Writing the same value changed the INI");
+	if (passed && SR_SetIniString(ini, L"Missing", L"Key", NULL))
+		passed = SR_BenchFail("Removing a missing key changed the INI");
+	if (passed && !SR_SetIniSection(ini, L"Display", L"iSize W = 800\0iSize H=600\0NoEquals\0"))
+		passed = SR_BenchFail("[Display] wasn't replaced");
+	if (passed && !SR_SetIniStruct(ini, L"Struct", L"Data", Data, 3))
+		passed = SR_BenchFail("[Struct] Data wasn't written");
+
+	wchar_t buffer[64];
+	if (passed && (SR_GetIniString(ini, L"General", L"sNew", NULL, buffer, 64) != 9 || wcscmp(buffer, L"new value") != 0))
+		passed = SR_BenchFail("A pending write was read as '%ls'", buffer);
+
+	unsigned char data[3] = { 0 };
+	if (passed && (!SR_GetIniStruct(ini, L"Struct", L"Data", data, 3) || memcmp(data, Data, 3) != 0))
+		passed = SR_BenchFail("A written struct wasn't read back");
+
+	text = SR_FormatIni(ini, &len);
+	if (passed && (len != wcslen(WrittenText) || wcscmp(text, WrittenText) != 0))
+		passed = SR_BenchFail("The changed INI was written as '%ls'", text);
+	free(text);
+
+	SR_FreeIni(ini);
+	return passed;
+}
+
+#ifdef _WIN32
+
+// Every query compared against Windows, for both the documented and the malformed INI
+static const Query WindowsQueries[] =
+{
+	{ L"General", L"sLanguage", NULL, 64 },
+	{ L"general", L"SLANGUAGE", L"default", 64 },
+	{ L" General ", L" sTest ", NULL, 64 },
+	{ L"General", L"sTest", NULL, 6 },
+	{ L"General", L"sQuoted", NULL, 64 },
+	{ L"General", L"sQuoted", NULL, 14 },
+	{ L"General", L"sQuoted", NULL, 13 },
+	{ L"General", L"sQuoted", NULL, 5 },
+	{ L"General", L"sHalf", NULL, 64 },
+	{ L"General", L"sSingle", NULL, 64 },
+	{ L"General", L"sEmptyQuotes", NULL, 64 },
+	{ L"General", L"NoEquals", L"default", 64 },
+	{ L"General", L"", L"default", 64 },
+	{ L"General", L"TopKey", L"default", 64 },
+	{ L"General", L"Missing", L"   ", 64 },
+	{ L"General", L"Missing", L"\"quoted default\"  ", 64 },
+	{ L"General", L"Missing", L"default", 4 },
+	{ L"General", NULL, NULL, 64 },
+	{ L"General", NULL, NULL, 12 },
+	{ L"General", NULL, NULL, 3 },
+	{ L"General", NULL, NULL, 2 },
+	{ L"Display", NULL, NULL, 64 },
+	{ L"Display", NULL, NULL, 10 },
+	{ L"Display", NULL, NULL, 9 },
+	{ L" Display", NULL, L"default", 64 },
+	{ L"Empty", NULL, L"default", 64 },
+	{ L"Missing", NULL, L"default", 64 },
+	{ L"Un", L"iSpaces", NULL, 64 },
+	{ NULL, NULL, NULL, 64 },
+	{ NULL, NULL, NULL, 10 },
+	{ NULL, NULL, NULL, 9 },
+	{ NULL, NULL, NULL, 3 },
+	{ NULL, NULL, NULL, 2 },
+};
+
+// Every integer key compared against Windows
+static const wchar_t* const WindowsIntKeys[] =
+{
+	L"fFloat", L"iHex", L"iNeg", L"sLanguage", L"Missing", L"iSpaces", L"iPlus", L"iOctal", L"iUpperHex", L"NoEquals",
+};
+
+// Every section listed and compared against Windows
+static const wchar_t* const WindowsSections[] = { L"General", L"general", L" General", L"Display", L"Un", L"Missing", L"Empty", L"Added" };
+
+// Writes an INI to a temporary UTF-16 file, returning if it succeeded
+static bool WriteTemporaryIni(const wchar_t* path, const wchar_t* text, size_t len)
+{
+	HANDLE file = CreateFileW(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY, NULL);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	static const wchar_t ByteOrderMark = 0xFEFF;
+	DWORD written;
+	BOOL succeeded = WriteFile(file, &ByteOrderMark, sizeof(wchar_t), &written, NULL)
+		&& WriteFile(file, text, (DWORD)(len * sizeof(wchar_t)), &written, NULL);
+
+	CloseHandle(file);
+	return succeeded;
+}
+
+// Compares two results of the same list or string query
+static bool ResultsEqual(const wchar_t* expected, size_t expectedResult, const wchar_t* actual, size_t actualResult, size_t size)
+{
+	if (expectedResult != actualResult) return false;
+
+	// Compare the result and up to two null terminators after it
+	size_t compared = min(expectedResult + 2, size);
+	return wmemcmp(expected, actual, compared) == 0;
+}
+
+// Runs every query against the in-memory INI and the actual Windows functions reading the same file
+static bool CheckAgainstWindows(const wchar_t* text, size_t len)
+{
+	wchar_t path[MAX_PATH];
+	wchar_t directory[MAX_PATH];
+	if (GetTempPathW(MAX_PATH, directory) == 0 || GetTempFileNameW(directory, L"SRI", 0, path) == 0)
+		return SR_BenchFail("Unable to create a temporary file");
+
+	if (!WriteTemporaryIni(path, text, len))
+		return SR_BenchFail("Unable to write '%ls'", path);
+
+	SR_IniFile* ini = SR_ParseIni(text, len);
+	bool passed = true;
+
+	wchar_t expected[64];
+	wchar_t actual[64];
+
+	for (size_t i = 0; passed && i < sizeof(WindowsQueries) / sizeof(WindowsQueries[0]); i++)
+	{
+		const Query* query = &WindowsQueries[i];
+		wmemset(expected, L'#', 64);
+		wmemset(actual, L'#', 64);
+
+		DWORD expectedResult = GetPrivateProfileStringW(query->Section, query->Key, query->Default, expected, (DWORD)query->Size, path);
+		size_t actualResult = SR_GetIniString(ini, query->Section, query->Key, query->Default, actual, query->Size);
+
+		if (!ResultsEqual(expected, expectedResult, actual, actualResult, query->Size))
+		{
+			passed = SR_BenchFail(
+				"[%ls] %ls with size %zu returned %zu '%ls', Windows returned %lu '%ls'",
+				query->Section != NULL ? query->Section : L"(null)",
+				query->Key != NULL ? query->Key : L"(null)",
+				query->Size, actualResult, actual, expectedResult, expected
+			);
+		}
+	}
+
+	for (size_t i = 0; passed && i < sizeof(WindowsIntKeys) / sizeof(WindowsIntKeys[0]); i++)
+	{
+		UINT expectedResult = GetPrivateProfileIntW(L"General", WindowsIntKeys[i], 7, path);
+		unsigned int actualResult = SR_GetIniInt(ini, L"General", WindowsIntKeys[i], 7);
+		if (expectedResult != actualResult)
+			passed = SR_BenchFail("%ls was read as %u, Windows read %u", WindowsIntKeys[i], actualResult, expectedResult);
+	}
+
+	for (size_t i = 0; passed && i < sizeof(WindowsSections) / sizeof(WindowsSections[0]); i++)
+	{
+		for (size_t size = 2; passed && size <= 64; size += 7)
+		{
+			wmemset(expected, L'#', 64);
+			wmemset(actual, L'#', 64);
+
+			DWORD expectedResult = GetPrivateProfileSectionW(WindowsSections[i], expected, (DWORD)size, path);
+			size_t actualResult = SR_GetIniSection(ini, WindowsSections[i], actual, size);
+
+			if (!ResultsEqual(expected, expectedResult, actual, actualResult, size))
+				passed = SR_BenchFail("[%ls] with size %zu was listed as %zu characters, Windows listed %lu", WindowsSections[i], size, actualResult, expectedResult);
+		}
+	}
+
+	unsigned char expectedData[3] = { 0 };
+	unsigned char actualData[3] = { 0 };
+	BOOL expectedStruct = GetPrivateProfileStructW(L"Struct", L"Data", expectedData, 3, path);
+	bool actualStruct = SR_GetIniStruct(ini, L"Struct", L"Data", actualData, 3);
+	if (passed && (!expectedStruct != !actualStruct || memcmp(expectedData, actualData, 3) != 0))
+		passed = SR_BenchFail("[Struct] Data wasn't read the same way as Windows");
+
+	// Make the same changes on both sides, and compare every section again
+	for (size_t i = 0; passed && i < sizeof(Writes) / sizeof(Writes[0]); i++)
+	{
+		WritePrivateProfileStringW(Writes[i].Section, Writes[i].Key, Writes[i].Value, path);
+		SR_SetIniString(ini, Writes[i].Section, Writes[i].Key, Writes[i].Value);
+	}
+
+	for (size_t i = 0; passed && i < sizeof(WindowsSections) / sizeof(WindowsSections[0]); i++)
+	{
+		wmemset(expected, L'#', 64);
+		wmemset(actual, L'#', 64);
+
+		DWORD expectedResult = GetPrivateProfileSectionW(WindowsSections[i], expected, 64, path);
+		size_t actualResult = SR_GetIniSection(ini, WindowsSections[i], actual, 64);
+
+		if (!ResultsEqual(expected, expectedResult, actual, actualResult, 64))
+			passed = SR_BenchFail("[%ls] was listed as '%ls' after writing, Windows listed '%ls'", WindowsSections[i], actual, expected);
+	}
+
+	SR_FreeIni(ini);
+	DeleteFileW(path);
+
+	return passed;
+}
+
+#endif
+
+// Generates an INI with TIMING_SECTIONS sections of TIMING_KEYS keys each, returning its length
+static size_t GenerateIni(wchar_t* text, size_t size)
+{
+	size_t len = 0;
+
+	for (int section = 0; section < TIMING_SECTIONS; section++)
+	{
+		len += swprintf(text + len, size - len, L"[Section%d]\r\n", section);
+
+		for (int key = 0; key < TIMING_KEYS; key++)
+			len += swprintf(text + len, size - len, L"fSetting%d=%d.0000\r\n", key, section * key);
+
+		len += swprintf(text + len, size - len, L"\r\n");
+	}
+
+	return len;
+}
+
+bool SR_BenchIniFile()
+{
+	SR_IniFile* documented = SR_ParseIni(IniText, wcslen(IniText));
+	bool passed = CheckDocumented(documented);
+	SR_FreeIni(documented);
+
+	if (!passed || !CheckWrites()) return false;
+
+#ifdef _WIN32
+	if (!CheckAgainstWindows(IniText, wcslen(IniText))) return false;
+	if (!CheckAgainstWindows(QuirksText, wcslen(QuirksText))) return false;
+#else
+	(void)QuirksText;
+#endif
+
+	static wchar_t text[TIMING_SECTIONS * (TIMING_KEYS + 2) * 32];
+	size_t textLen = GenerateIni(text, sizeof(text) / sizeof(wchar_t));
+
+	wchar_t sections[TIMING_SECTIONS][16];
+	wchar_t keys[TIMING_KEYS][16];
+	for (int i = 0; i < TIMING_SECTIONS; i++) swprintf(sections[i], 16, L"Section%d", i);
+	for (int i = 0; i < TIMING_KEYS; i++) swprintf(keys[i], 16, L"fSetting%d", i);
+
+	// Parsing is much slower than a lookup, so it runs fewer times
+	const size_t parseRounds = SR_BENCH_ROUNDS / 1000;
+	const size_t lookupRounds = SR_BENCH_ROUNDS / 100;
+	const size_t lookups = lookupRounds * TIMING_SECTIONS * TIMING_KEYS;
+
+	volatile size_t totalLen = 0;
+	wchar_t buffer[64];
+	double start;
+
+	start = SR_BenchNow();
+	for (size_t round = 0; round < parseRounds; round++)
+		SR_FreeIni(SR_ParseIni(text, textLen));
+	SR_BenchReport("Parse 24 sections of 16 keys", SR_BenchNow() - start, parseRounds);
+
+	SR_IniFile* ini = SR_ParseIni(text, textLen);
+
+#ifdef _WIN32
+	wchar_t path[MAX_PATH];
+	wchar_t directory[MAX_PATH];
+	if (GetTempPathW(MAX_PATH, directory) != 0 && GetTempFileNameW(directory, L"SRI", 0, path) != 0 && WriteTemporaryIni(path, text, textLen))
+	{
+		// The Windows functions read the whole file at every call, so only a single round is timed
+		start = SR_BenchNow();
+		for (int section = 0; section < TIMING_SECTIONS; section++)
+		{
+			for (int key = 0; key < TIMING_KEYS; key++)
+				totalLen += GetPrivateProfileStringW(sections[section], keys[key], NULL, buffer, 64, path);
+		}
+		SR_BenchReport("GetPrivateProfileStringW", SR_BenchNow() - start, TIMING_SECTIONS * TIMING_KEYS);
+
+		DeleteFileW(path);
+	}
+#endif
+
+	start = SR_BenchNow();
+	for (size_t round = 0; round < lookupRounds; round++)
+	{
+		for (int section = 0; section < TIMING_SECTIONS; section++)
+		{
+			for (int key = 0; key < TIMING_KEYS; key++)
+				totalLen += SR_GetIniString(ini, sections[section], keys[key], NULL, buffer, 64);
+		}
+	}
+	SR_BenchReport("In-memory INI", SR_BenchNow() - start, lookups);
+
+	SR_FreeIni(ini);
+	return true;
+}
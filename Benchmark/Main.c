@@ -0,0 +1,83 @@
+#include "Benchmark.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+// Benchmarks for the hot paths of the redirector.
+//
+// Only the parts of the redirector that don't depend on Windows are benchmarked, so this program can be
+// built and run on any platform, e.g. from the repository root:
+//
+//   cc -O2 -o benchmark Benchmark/*.c SkyrimRedirector/CaseFold.c SkyrimRedirector/CaseFoldTable.c SkyrimRedirector/Canonicizer.c SkyrimRedirector/ConfigParser.c SkyrimRedirector/IniFile.c SkyrimRedirector/PathScan.c SkyrimRedirector/RuleTrie.c SkyrimRedirector/TraceFormat.c
+//
+// Every benchmark checks that the new implementation agrees with the old one over the whole corpus before
+// timing it, and the program exits with a non-zero code if any check fails.
+
+double SR_BenchNow()
+{
+#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+
+	return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+
+	return (double)time.tv_sec + (double)time.tv_nsec / 1e9;
+#endif
+}
+
+void SR_BenchReport(const char* name, double seconds, size_t operations)
+{
+	printf("    %-40s %10.3f ms %10.2f ns/op\n", name, seconds * 1e3, seconds * 1e9 / (double)operations);
+}
+
+bool SR_BenchFail(const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+
+	printf("    X Failed: ");
+	vprintf(format, args);
+	printf("\n");
+
+	va_end(args);
+	return false;
+}
+
+int main()
+{
+	bool passed = true;
+
+	printf("\nRule matching\n");
+	passed &= SR_BenchRuleTrie();
+
+	printf("\nFile names\n");
+	passed &= SR_BenchPathScan();
+
+	printf("\nCase folding\n");
+	passed &= SR_BenchCaseFold();
+
+	printf("\nPath canonicization\n");
+	passed &= SR_BenchCanonicizer();
+
+	printf("\nINI files\n");
+	passed &= SR_BenchIniFile();
+
+	printf("\nConfig\n");
+	passed &= SR_BenchConfig();
+
+	printf("\nTrace log\n");
+	passed &= SR_BenchTrace();
+
+	printf("\n%s\n", passed ? "All checks passed" : "Some checks failed");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,150 @@
+#include "Benchmark.h"
+#include "Corpus.h"
+#include "../SkyrimRedirector/PathScan.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+
+// Size, in characters, of the buffers the paths are copied into to check them at every alignment
+#define BUFFER_SIZE 1024
+
+// Number of characters every path is shifted by, which covers every position inside a 32-byte block
+#define MAX_SHIFT 32
+
+// Paths that stress the edges of the blocks: empty paths, paths without separators, paths that end with one and a
+// path long enough to span several blocks with separators on both sides of every block boundary
+static const wchar_t* EdgeCases[] =
+{
+	L"",
+	L"\\",
+	L"/",
+	L"Skyrim.ini",
+	L"C:\\Saves\\",
+	L"C:/Users/Player/Documents/My Games/Skyrim Special Edition/Skyrim.ini",
+	L"C:\\Users/Player\\Documents/My Games\\Skyrim Special Edition/Saves\\",
+	L"a\\b/c\\d/e\\f/g\\h/i\\j/k\\l/m\\n/o\\p/q\\r/s\\t/u\\v/w\\x/y\\z/0\\1/2\\3/4\\5/6\\7/8\\9/a\\b/c\\d/e\\f/g\\h",
+	L"C:\\Games\\Skyrim Special Edition\\Data\\meshes\\architecture\\whiterun\\wrbuildings\\wrinteriors\\wrhouse01\\clutter\\basket01.nif",
+};
+
+#define EDGE_CASE_COUNT (sizeof(EdgeCases) / sizeof(EdgeCases[0]))
+
+// Names of the instructions, as printed in the report
+static const char* LevelNames[] = { "scalar", "SSE2", "AVX2" };
+
+// Finds the file name and the length of a wide path as the redirector did before the single-pass scan
+static size_t LegacyFindFileNameW(const wchar_t* path, size_t* len)
+{
+	const wchar_t* lastBack = wcsrchr(path, L'\\');
+	const wchar_t* lastForward = wcsrchr(path, L'/');
+	*len = wcslen(path);
+
+	const wchar_t* last = lastBack > lastForward ? lastBack : lastForward;
+	return last == NULL ? 0 : (size_t)(last - path) + 1;
+}
+
+// Finds the file name and the length of a narrow path as the redirector did before the single-pass scan
+static size_t LegacyFindFileNameA(const char* path, size_t* len)
+{
+	const char* lastBack = strrchr(path, '\\');
+	const char* lastForward = strrchr(path, '/');
+	*len = strlen(path);
+
+	const char* last = lastBack > lastForward ? lastBack : lastForward;
+	return last == NULL ? 0 : (size_t)(last - path) + 1;
+}
+
+// Checks a path shifted by every number of characters up to MAX_SHIFT, with separators right after its end
+static bool CheckPath(const wchar_t* path, SR_PathScanLevel level)
+{
+	static wchar_t wide[BUFFER_SIZE];
+	static char narrow[BUFFER_SIZE];
+
+	size_t pathLen = wcslen(path);
+
+	for (size_t shift = 0; shift < MAX_SHIFT; shift++)
+	{
+		// A separator after the end of the path must never be taken as its last one
+		for (size_t i = 0; i < BUFFER_SIZE; i++)
+		{
+			wide[i] = L'\\';
+			narrow[i] = '/';
+		}
+
+		// Every path checked is ASCII, so it can be narrowed one character at a time
+		for (size_t i = 0; i <= pathLen; i++)
+		{
+			wide[shift + i] = path[i];
+			narrow[shift + i] = (char)path[i];
+		}
+
+		size_t expectedLen, actualLen;
+		size_t expected = LegacyFindFileNameW(wide + shift, &expectedLen);
+		size_t actual = SR_FindFileNameW(wide + shift, &actualLen);
+
+		if (expected != actual || expectedLen != actualLen)
+			return SR_BenchFail("%s: '%ls' shifted by %zu found the file name at %zu of %zu, expected %zu of %zu",
+				LevelNames[level], path, shift, actual, actualLen, expected, expectedLen);
+
+		expected = LegacyFindFileNameA(narrow + shift, &expectedLen);
+		actual = SR_FindFileNameA(narrow + shift, &actualLen);
+
+		if (expected != actual || expectedLen != actualLen)
+			return SR_BenchFail("%s: narrow '%ls' shifted by %zu found the file name at %zu of %zu, expected %zu of %zu",
+				LevelNames[level], path, shift, actual, actualLen, expected, expectedLen);
+	}
+
+	return true;
+}
+
+bool SR_BenchPathScan()
+{
+	SR_PathScanLevel fastest = SR_GetPathScanLevel();
+	bool passed = true;
+
+	for (int level = SR_PATH_SCAN_SCALAR; level <= (int)fastest && passed; level++)
+	{
+		SR_SetPathScanLevel((SR_PathScanLevel)level);
+
+		for (size_t i = 0; i < SR_CorpusLen && passed; i++)
+			passed = CheckPath(SR_Corpus[i], (SR_PathScanLevel)level);
+
+		for (size_t i = 0; i < EDGE_CASE_COUNT && passed; i++)
+			passed = CheckPath(EdgeCases[i], (SR_PathScanLevel)level);
+	}
+
+	if (passed)
+	{
+		const size_t operations = SR_BENCH_ROUNDS * SR_CorpusLen;
+		volatile size_t found = 0;
+		size_t len;
+		double start;
+
+		start = SR_BenchNow();
+		for (size_t round = 0; round < SR_BENCH_ROUNDS; round++)
+		{
+			for (size_t i = 0; i < SR_CorpusLen; i++)
+				found += LegacyFindFileNameW(SR_Corpus[i], &len) + len;
+		}
+		SR_BenchReport("Wide: wcsrchr twice + wcslen", SR_BenchNow() - start, operations);
+
+		for (int level = SR_PATH_SCAN_SCALAR; level <= (int)fastest; level++)
+		{
+			SR_SetPathScanLevel((SR_PathScanLevel)level);
+
+			start = SR_BenchNow();
+			for (size_t round = 0; round < SR_BENCH_ROUNDS; round++)
+			{
+				for (size_t i = 0; i < SR_CorpusLen; i++)
+					found += SR_FindFileNameW(SR_Corpus[i], &len) + len;
+			}
+
+			char name[64];
+			snprintf(name, sizeof(name), "Wide: single pass, %s", LevelNames[level]);
+			SR_BenchReport(name, SR_BenchNow() - start, operations);
+		}
+	}
+
+	SR_SetPathScanLevel(fastest);
+	return passed;
+}
@@ -0,0 +1,362 @@
+#include "Benchmark.h"
+#include "Corpus.h"
+#include "../SkyrimRedirector/RuleTrie.h"
+#include "../SkyrimRedirector/Canonicizer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+
+#ifdef _WIN32
+#include <locale.h>
+static _locale_t InvariantLocale = NULL;
+#define CASE_INSENSITIVE_COMPARE(first, second) _wcsicmp_l(first, second, InvariantLocale)
+#else
+#define CASE_INSENSITIVE_COMPARE(first, second) wcscasecmp(first, second)
+#endif
+
+#define CURRENT_DIR L"C:\\Games\\Skyrim Special Edition"
+
+#define PATH_SKYRIM_INI        L"MY GAMES\\SKYRIM SPECIAL EDITION\\SKYRIM.INI"
+#define PATH_SKYRIM_PREFS_INI  L"MY GAMES\\SKYRIM SPECIAL EDITION\\SKYRIMPREFS.INI"
+#define PATH_SKYRIM_CUSTOM_INI L"MY GAMES\\SKYRIM SPECIAL EDITION\\SKYRIMCUSTOM.INI"
+#define PATH_PLUGINS_TXT       L"C:\\USERS\\PLAYER\\APPDATA\\LOCAL\\SKYRIM SPECIAL EDITION\\PLUGINS.TXT"
+
+// Number of extra rules added to show that the cost of a lookup doesn't depend on the number of rules
+#define EXTRA_RULES 60
+
+// Checks if a string ends with another one, as the redirector did before the rule trie
+static bool LegacyEndsWith(const wchar_t* full, size_t fullLen, const wchar_t* component)
+{
+	size_t componentLen = wcslen(component);
+	return fullLen >= componentLen && wcscmp(full + fullLen - componentLen, component) == 0;
+}
+
+// Checks which built-in rule a file name could match, as the redirector did before the rule trie.
+// Returns the rule that could match, or SR_NO_RULE.
+static size_t LegacyMatchFileName(const wchar_t* fileName)
+{
+	if (CASE_INSENSITIVE_COMPARE(fileName, L"SKYRIM.INI") == 0) return 0;
+	if (CASE_INSENSITIVE_COMPARE(fileName, L"SKYRIMPREFS.INI") == 0) return 1;
+	if (CASE_INSENSITIVE_COMPARE(fileName, L"SKYRIMCUSTOM.INI") == 0) return 2;
+	if (CASE_INSENSITIVE_COMPARE(fileName, L"PLUGINS.TXT") == 0) return 3;
+	return SR_NO_RULE;
+}
+
+// Matches a canonical path against the built-in rules, as the redirector did before the rule trie
+static size_t LegacyMatch(const wchar_t* fileName, const wchar_t* canonical, size_t canonicalLen)
+{
+	switch (LegacyMatchFileName(fileName))
+	{
+	case 0: return LegacyEndsWith(canonical, canonicalLen, PATH_SKYRIM_INI) ? 0 : SR_NO_RULE;
+	case 1: return LegacyEndsWith(canonical, canonicalLen, PATH_SKYRIM_PREFS_INI) ? 1 : SR_NO_RULE;
+	case 2: return LegacyEndsWith(canonical, canonicalLen, PATH_SKYRIM_CUSTOM_INI) ? 2 : SR_NO_RULE;
+	case 3: return wcscmp(canonical, PATH_PLUGINS_TXT) == 0 ? 3 : SR_NO_RULE;
+	default: return SR_NO_RULE;
+	}
+}
+
+// Creates a trie with the built-in rules, and optionally a lot of extra rules that never match the corpus
+static SR_RuleTrie* CreateTrie(bool withExtraRules)
+{
+	SR_RuleTrie* trie = SR_CreateRuleTrie();
+
+	SR_AddRuleW(trie, PATH_SKYRIM_INI, SR_RULE_SUFFIX, 0);
+	SR_AddRuleW(trie, PATH_SKYRIM_PREFS_INI, SR_RULE_SUFFIX, 1);
+	SR_AddRuleW(trie, PATH_SKYRIM_CUSTOM_INI, SR_RULE_SUFFIX, 2);
+	SR_AddRuleW(trie, PATH_PLUGINS_TXT, SR_RULE_EXACT, 3);
+
+	if (!withExtraRules) return trie;
+
+	for (size_t i = 0; i < EXTRA_RULES; i++)
+	{
+		wchar_t pattern[256];
+		swprintf(pattern, 256, L"My Games\\Skyrim Special Edition\\Profiles\\Profile%zu\\Skyrim%zu.ini", i, i);
+		SR_AddRuleW(trie, pattern, SR_RULE_SUFFIX, 4 + i);
+	}
+
+	return trie;
+}
+
+// Paths whose file names only differ from a rule's in the checks the filter makes, or in case and separators
+static const wchar_t* FilterEdgeCases[] =
+{
+	L"C:\\Users\\Player\\Documents\\My Games\\Skyrim Special Edition\\skyrim.INI",
+	L"C:/Users/Player/Documents/My Games/Skyrim Special Edition/SkyrimPrefs.ini",
+	L"C:\\Users\\Player\\Documents\\My Games\\Skyrim Special Edition\\Skyrim.ini\\",
+	L"C:\\Users\\Player\\Documents\\My Games\\Skyrim Special Edition\\Skyrim.inf",
+	L"C:\\Users\\Player\\Documents\\My Games\\Skyrim Special Edition\\Skyrim.ini.bak",
+	L"C:\\Users\\Player\\Documents\\My Games\\Skyrim Special Edition\\Skyrom.ini",
+	L"C:\\Users\\Player\\AppData\\Local\\Skyrim Special Edition\\Plugins.txt",
+	L"Plugins.txt",
+	L"",
+};
+
+#define FILTER_EDGE_CASE_COUNT (sizeof(FilterEdgeCases) / sizeof(FilterEdgeCases[0]))
+
+// Checks that the filter never rejects a path whose file name the trie accepts, for wide and narrow paths
+static bool CheckFilter(const SR_RuleTrie* trie, const wchar_t* path)
+{
+	bool expected = SR_RuleTrieHasFileNameW(trie, SR_CorpusFileName(path));
+
+	if (SR_RuleTrieCouldMatchW(trie, path) != expected)
+		return SR_BenchFail("'%ls' passed the wide filter: %d, expected %d", path, !expected, expected);
+
+	// Every path checked is ASCII, so it can be narrowed one character at a time
+	char narrow[1024];
+	size_t len = wcslen(path);
+	for (size_t i = 0; i <= len; i++)
+		narrow[i] = (char)path[i];
+
+	if (SR_RuleTrieCouldMatchA(trie, narrow) != expected)
+		return SR_BenchFail("'%ls' passed the narrow filter: %d, expected %d", path, !expected, expected);
+
+	return true;
+}
+
+// Checks the filter against the trie and times rejecting paths that can't match any rule, before and after it
+static bool BenchMisses(const SR_RuleTrie* builtIn, const SR_RuleTrie* extra)
+{
+	const wchar_t* misses[SR_CORPUS_MAX_LEN];
+	size_t missCount = 0;
+
+	for (size_t i = 0; i < SR_CorpusLen; i++)
+	{
+		if (!CheckFilter(builtIn, SR_Corpus[i]) || !CheckFilter(extra, SR_Corpus[i])) return false;
+		if (!SR_RuleTrieHasFileNameW(builtIn, SR_CorpusFileName(SR_Corpus[i]))) misses[missCount++] = SR_Corpus[i];
+	}
+
+	for (size_t i = 0; i < FILTER_EDGE_CASE_COUNT; i++)
+	{
+		if (!CheckFilter(builtIn, FilterEdgeCases[i]) || !CheckFilter(extra, FilterEdgeCases[i])) return false;
+	}
+
+	if (missCount == 0) return SR_BenchFail("Every path in the corpus could match a rule");
+
+	const size_t operations = SR_BENCH_ROUNDS * missCount;
+	volatile size_t matches = 0;
+	double start;
+
+	// Before the filter, the file name was found by scanning the whole path, and then walked in the trie
+	start = SR_BenchNow();
+	for (size_t round = 0; round < SR_BENCH_ROUNDS; round++)
+	{
+		for (size_t i = 0; i < missCount; i++)
+			matches += SR_RuleTrieHasFileNameW(builtIn, SR_CorpusFileName(misses[i]));
+	}
+	SR_BenchReport("Miss: file name scan, 4 rules", SR_BenchNow() - start, operations);
+
+	start = SR_BenchNow();
+	for (size_t round = 0; round < SR_BENCH_ROUNDS; round++)
+	{
+		for (size_t i = 0; i < missCount; i++)
+			matches += SR_RuleTrieCouldMatchW(builtIn, misses[i]);
+	}
+	SR_BenchReport("Miss: tail filter, 4 rules", SR_BenchNow() - start, operations);
+
+	start = SR_BenchNow();
+	for (size_t round = 0; round < SR_BENCH_ROUNDS; round++)
+	{
+		for (size_t i = 0; i < missCount; i++)
+			matches += SR_RuleTrieHasFileNameW(extra, SR_CorpusFileName(misses[i]));
+	}
+	SR_BenchReport("Miss: file name scan, 64 rules", SR_BenchNow() - start, operations);
+
+	start = SR_BenchNow();
+	for (size_t round = 0; round < SR_BENCH_ROUNDS; round++)
+	{
+		for (size_t i = 0; i < missCount; i++)
+			matches += SR_RuleTrieCouldMatchW(extra, misses[i]);
+	}
+	SR_BenchReport("Miss: tail filter, 64 rules", SR_BenchNow() - start, operations);
+
+	return true;
+}
+
+// Directories redirected by the directory benchmark, already canonical.
+// Only the first two contain paths from the corpus.
+static const wchar_t* Directories[] =
+{
+	L"C:\\USERS\\PLAYER\\DOCUMENTS\\MY GAMES\\SKYRIM SPECIAL EDITION\\SAVES",
+	L"C:\\GAMES\\SKYRIM SPECIAL EDITION\\DATA\\MESHES",
+	L"C:\\GAMES\\SKYRIM SPECIAL EDITION\\DATA\\MESH",
+	L"C:\\GAMES\\SKYRIM SPECIAL EDITION\\DATA\\SKSE\\PLUGINS\\LOGS",
+	L"C:\\USERS\\PLAYER\\DOCUMENTS\\MY GAMES\\SKYRIM SPECIAL EDITION\\SCREENSHOTS",
+	L"C:\\USERS\\PLAYER\\DOCUMENTS\\MY GAMES\\SKYRIM SPECIAL EDITION\\LOGS",
+	L"C:\\USERS\\PLAYER\\APPDATA\\LOCAL\\ENDERAL SPECIAL EDITION",
+	L"D:\\SAVES",
+};
+
+#define DIRECTORY_COUNT (sizeof(Directories) / sizeof(Directories[0]))
+
+// Finds the longest directory that contains a canonical path by comparing it against every directory
+static size_t LinearMatchDirectory(const wchar_t* path, size_t len, size_t* prefixLen)
+{
+	size_t result = SR_NO_RULE;
+	size_t resultLen = 0;
+
+	for (size_t i = 0; i < DIRECTORY_COUNT; i++)
+	{
+		size_t directoryLen = wcslen(Directories[i]);
+		if (directoryLen <= resultLen || directoryLen > len) continue;
+		if (wcsncmp(path, Directories[i], directoryLen) != 0) continue;
+		if (directoryLen != len && path[directoryLen] != L'\\') continue;
+
+		result = i;
+		resultLen = directoryLen;
+	}
+
+	*prefixLen = resultLen;
+	return result;
+}
+
+// Checks and times directory matching against a linear scan of every directory
+static bool BenchDirectories(wchar_t canonical[][1024], const size_t* canonicalLen)
+{
+	SR_RuleTrie* trie = SR_CreateRuleTrie();
+	for (size_t i = 0; i < DIRECTORY_COUNT; i++)
+		SR_AddRuleW(trie, Directories[i], SR_RULE_PREFIX, i);
+
+	bool passed = true;
+	size_t hits = 0;
+
+	for (size_t i = 0; i < SR_CorpusLen && passed; i++)
+	{
+		size_t expectedLen = 0;
+		size_t actualLen = 0;
+		size_t expected = LinearMatchDirectory(canonical[i], canonicalLen[i], &expectedLen);
+		size_t actual = SR_MatchRuleTriePrefixW(trie, canonical[i], canonicalLen[i], &actualLen);
+
+		if (expected != actual || (expected != SR_NO_RULE && expectedLen != actualLen))
+			passed = SR_BenchFail("'%ls' matched directory %d, expected %d", canonical[i], (int)actual, (int)expected);
+
+		hits += actual != SR_NO_RULE;
+	}
+
+	// Directories must only match whole segments
+	const wchar_t* outside = L"C:\\GAMES\\SKYRIM SPECIAL EDITION\\DATA\\MESHES2\\A.NIF";
+	size_t ignored;
+	if (passed && SR_MatchRuleTriePrefixW(trie, outside, wcslen(outside), &ignored) != SR_NO_RULE)
+		passed = SR_BenchFail("'%ls' matched a directory it isn't in", outside);
+
+	if (passed && hits == 0)
+		passed = SR_BenchFail("No path matched a directory");
+
+	if (passed)
+	{
+		const size_t operations = SR_BENCH_ROUNDS * SR_CorpusLen;
+		volatile size_t matches = 0;
+		size_t prefixLen;
+		double start;
+
+		start = SR_BenchNow();
+		for (size_t round = 0; round < SR_BENCH_ROUNDS; round++)
+		{
+			for (size_t i = 0; i < SR_CorpusLen; i++)
+				matches += LinearMatchDirectory(canonical[i], canonicalLen[i], &prefixLen) != SR_NO_RULE;
+		}
+		SR_BenchReport("Directory: linear scan", SR_BenchNow() - start, operations);
+
+		start = SR_BenchNow();
+		for (size_t round = 0; round < SR_BENCH_ROUNDS; round++)
+		{
+			for (size_t i = 0; i < SR_CorpusLen; i++)
+				matches += SR_MatchRuleTriePrefixW(trie, canonical[i], canonicalLen[i], &prefixLen) != SR_NO_RULE;
+		}
+		SR_BenchReport("Directory: prefix trie", SR_BenchNow() - start, operations);
+	}
+
+	SR_FreeRuleTrie(trie);
+	return passed;
+}
+
+bool SR_BenchRuleTrie()
+{
+#ifdef _WIN32
+	InvariantLocale = _create_locale(LC_ALL, "C");
+#endif
+
+	static wchar_t canonical[SR_CORPUS_MAX_LEN][1024];
+	size_t canonicalLen[SR_CORPUS_MAX_LEN];
+	const wchar_t* fileNames[SR_CORPUS_MAX_LEN];
+
+	for (size_t i = 0; i < SR_CorpusLen; i++)
+	{
+		fileNames[i] = SR_CorpusFileName(SR_Corpus[i]);
+		canonicalLen[i] = SR_CanonicizeIntoW(SR_Corpus[i], CURRENT_DIR, canonical[i], 1024);
+	}
+
+	SR_RuleTrie* builtIn = CreateTrie(false);
+	SR_RuleTrie* extra = CreateTrie(true);
+	bool passed = true;
+
+	for (size_t i = 0; i < SR_CorpusLen && passed; i++)
+	{
+		size_t expected = LegacyMatch(fileNames[i], canonical[i], canonicalLen[i]);
+		size_t actual = SR_RuleTrieHasFileNameW(builtIn, fileNames[i]) ? SR_MatchRuleTrieW(builtIn, canonical[i], canonicalLen[i]) : SR_NO_RULE;
+		size_t actualExtra = SR_RuleTrieHasFileNameW(extra, fileNames[i]) ? SR_MatchRuleTrieW(extra, canonical[i], canonicalLen[i]) : SR_NO_RULE;
+
+		if (expected != actual || expected != actualExtra)
+			passed = SR_BenchFail("'%ls' matched rules %d and %d, expected %d", SR_Corpus[i], (int)actual, (int)actualExtra, (int)expected);
+	}
+
+	if (passed)
+	{
+		const size_t operations = SR_BENCH_ROUNDS * SR_CorpusLen;
+		volatile size_t matches = 0;
+		double start;
+
+		start = SR_BenchNow();
+		for (size_t round = 0; round < SR_BENCH_ROUNDS; round++)
+		{
+			for (size_t i = 0; i < SR_CorpusLen; i++)
+				matches += LegacyMatchFileName(fileNames[i]) != SR_NO_RULE;
+		}
+		SR_BenchReport("File name: comparison chain", SR_BenchNow() - start, operations);
+
+		start = SR_BenchNow();
+		for (size_t round = 0; round < SR_BENCH_ROUNDS; round++)
+		{
+			for (size_t i = 0; i < SR_CorpusLen; i++)
+				matches += SR_RuleTrieHasFileNameW(builtIn, fileNames[i]);
+		}
+		SR_BenchReport("File name: trie, 4 rules", SR_BenchNow() - start, operations);
+
+		start = SR_BenchNow();
+		for (size_t round = 0; round < SR_BENCH_ROUNDS; round++)
+		{
+			for (size_t i = 0; i < SR_CorpusLen; i++)
+				matches += LegacyMatch(fileNames[i], canonical[i], canonicalLen[i]) != SR_NO_RULE;
+		}
+		SR_BenchReport("Full match: comparison chain", SR_BenchNow() - start, operations);
+
+		start = SR_BenchNow();
+		for (size_t round = 0; round < SR_BENCH_ROUNDS; round++)
+		{
+			for (size_t i = 0; i < SR_CorpusLen; i++)
+				matches += SR_MatchRuleTrieW(builtIn, canonical[i], canonicalLen[i]) != SR_NO_RULE;
+		}
+		SR_BenchReport("Full match: trie, 4 rules", SR_BenchNow() - start, operations);
+
+		start = SR_BenchNow();
+		for (size_t round = 0; round < SR_BENCH_ROUNDS; round++)
+		{
+			for (size_t i = 0; i < SR_CorpusLen; i++)
+				matches += SR_MatchRuleTrieW(extra, canonical[i], canonicalLen[i]) != SR_NO_RULE;
+		}
+		SR_BenchReport("Full match: trie, 64 rules", SR_BenchNow() - start, operations);
+	}
+
+	if (passed) passed = BenchMisses(builtIn, extra);
+
+	SR_FreeRuleTrie(builtIn);
+	SR_FreeRuleTrie(extra);
+
+	if (passed) passed = BenchDirectories(canonical, canonicalLen);
+
+#ifdef _WIN32
+	_free_locale(InvariantLocale);
+#endif
+
+	return passed;
+}
@@ -0,0 +1,173 @@
+#include "Benchmark.h"
+#include "Corpus.h"
+#include "../SkyrimRedirector/TraceFormat.h"
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <wchar.h>
+
+// Size of the buffer messages are formatted or stored into, the same as a slot of the log
+#define MESSAGE_SIZE 1024
+
+// Converts wide text to UTF-8, the encoding of the log
+static size_t ToUtf8(const wchar_t* text, char* buffer)
+{
+	size_t len = 0;
+	for (; *text != L'\0'; text++)
+	{
+		uint32_t c = (uint32_t)*text;
+		if (c < 0x80)
+		{
+			buffer[len++] = (char)c;
+		}
+		else if (c < 0x800)
+		{
+			buffer[len++] = (char)(0xC0 | (c >> 6));
+			buffer[len++] = (char)(0x80 | (c & 0x3F));
+		}
+		else
+		{
+			buffer[len++] = (char)(0xE0 | (c >> 12));
+			buffer[len++] = (char)(0x80 | ((c >> 6) & 0x3F));
+			buffer[len++] = (char)(0x80 | (c & 0x3F));
+		}
+	}
+
+	buffer[len] = '\0';
+	return len;
+}
+
+// Stores the arguments of a message whose format was already parsed, the way the binary log does
+static size_t EncodeWith(const uint8_t* kinds, size_t count, unsigned char* buffer, ...)
+{
+	va_list args;
+	va_start(args, buffer);
+	size_t len = SR_EncodeTraceArguments(kinds, count, args, buffer, MESSAGE_SIZE);
+	va_end(args);
+
+	return len;
+}
+
+// Parses a format and stores the arguments of a message. Returns the number of bytes stored.
+static size_t Encode(const wchar_t* format, unsigned char* buffer, ...)
+{
+	uint8_t kinds[SR_TRACE_MAX_ARGUMENTS];
+	size_t count = SR_GetTraceArguments(format, kinds);
+	if (count == SIZE_MAX) return SIZE_MAX;
+
+	va_list args;
+	va_start(args, buffer);
+	size_t len = SR_EncodeTraceArguments(kinds, count, args, buffer, MESSAGE_SIZE);
+	va_end(args);
+
+	return len;
+}
+
+// Formats a message the way the text log does
+static void Format(wchar_t* buffer, const wchar_t* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	vswprintf(buffer, MESSAGE_SIZE, format, args);
+	va_end(args);
+}
+
+// Checks that a message stored in a trace decodes to the same text it would have been formatted into
+#define CHECK(format, ...) \
+	do \
+	{ \
+		size_t len = Encode(L##format, data, __VA_ARGS__); \
+		if (len == SIZE_MAX) return SR_BenchFail("'%s' couldn't be stored in a trace", format); \
+		\
+		Format(wide, L##format, __VA_ARGS__); \
+		ToUtf8(wide, expected); \
+		SR_FormatTrace(L##format, data, len, actual, MESSAGE_SIZE * 3); \
+		\
+		if (strcmp(expected, actual) != 0) \
+			return SR_BenchFail("'%s' decoded to '%s', expected '%s'", format, actual, expected); \
+	} \
+	while (0)
+
+// Checks that messages logged by the redirector decode to the text they would have been formatted into
+static bool CheckMessages()
+{
+	unsigned char data[MESSAGE_SIZE];
+	wchar_t wide[MESSAGE_SIZE];
+	char expected[MESSAGE_SIZE * 3];
+	char actual[MESSAGE_SIZE * 3];
+
+	CHECK("Platform: %ls", L"Skyrim Special Edition (x64)");
+	CHECK("%-32ls %12llu calls %12llu redirected %12.0f ns", L"CreateFileW", 123456789ULL, 42ULL, 1234.56);
+	CHECK("Redirecting '%ls' to '%ls'", SR_Corpus[0], L"C:\\Users\\Jos\u00e9\\Documents\\Skyrim.ini");
+	CHECK("%ld messages were dropped because the log buffer was full", 17L);
+	CHECK("Error %lu while reading '%hs'", 0x80070005UL, "plugins.txt");
+	CHECK("[%*d] %.3ls|%-6hs|%5ls", 4, 12, L"Truncated", "left", L"r");
+	CHECK("%d%% %u %x %X %08x %hd %hu %zu", -5, 5u, 0xBEEFu, 0xBEEFu, 0x1Fu, 70000, 70000u, (size_t)123);
+	CHECK("%c%c %+d %5.2f %e", L'O', L'K', 3, 3.14159, 0.000125);
+	CHECK("100%% done, with an unused argument", 0);
+	CHECK("Null: %ls", (const wchar_t*)NULL);
+
+	// Formats that write to their arguments can never be stored
+	uint8_t kinds[SR_TRACE_MAX_ARGUMENTS];
+	if (SR_GetTraceArguments(L"Written %n", kinds) != SIZE_MAX)
+		return SR_BenchFail("A format with %%n was stored in a trace");
+
+	// Long strings are truncated instead of overflowing the slot
+	wchar_t longText[MESSAGE_SIZE * 2];
+	wmemset(longText, L'x', MESSAGE_SIZE * 2 - 1);
+	longText[MESSAGE_SIZE * 2 - 1] = L'\0';
+
+	size_t len = Encode(L"%ls", data, longText);
+	if (len > MESSAGE_SIZE)
+		return SR_BenchFail("A long string took %zu bytes, more than the %d available", len, MESSAGE_SIZE);
+
+	return true;
+}
+
+bool SR_BenchTrace()
+{
+	if (!CheckMessages()) return false;
+
+	const size_t operations = SR_BENCH_ROUNDS * SR_CorpusLen;
+	volatile size_t totalLen = 0;
+	unsigned char data[MESSAGE_SIZE];
+	wchar_t text[MESSAGE_SIZE];
+	double start;
+
+	// The message logged for every redirected path at the TRACE level
+	const wchar_t* format = L"Redirecting '%ls' to '%ls' (%lu)";
+
+	start = SR_BenchNow();
+	for (size_t round = 0; round < SR_BENCH_ROUNDS; round++)
+	{
+		for (size_t i = 0; i < SR_CorpusLen; i++)
+		{
+			Format(text, format, SR_Corpus[i], SR_Corpus[SR_CorpusLen - i - 1], (unsigned long)i);
+			totalLen += text[0];
+		}
+	}
+	SR_BenchReport("vswprintf", SR_BenchNow() - start, operations);
+
+	start = SR_BenchNow();
+	for (size_t round = 0; round < SR_BENCH_ROUNDS; round++)
+	{
+		for (size_t i = 0; i < SR_CorpusLen; i++)
+			totalLen += Encode(format, data, SR_Corpus[i], SR_Corpus[SR_CorpusLen - i - 1], (unsigned long)i);
+	}
+	SR_BenchReport("Parse format + store arguments", SR_BenchNow() - start, operations);
+
+	// The log parses each format once, so only the arguments are stored when logging
+	uint8_t kinds[SR_TRACE_MAX_ARGUMENTS];
+	size_t count = SR_GetTraceArguments(format, kinds);
+
+	start = SR_BenchNow();
+	for (size_t round = 0; round < SR_BENCH_ROUNDS; round++)
+	{
+		for (size_t i = 0; i < SR_CorpusLen; i++)
+			totalLen += EncodeWith(kinds, count, data, SR_Corpus[i], SR_Corpus[SR_CorpusLen - i - 1], (unsigned long)i);
+	}
+	SR_BenchReport("Store arguments", SR_BenchNow() - start, operations);
+
+	return true;
+}
@@ -1155,27 +1155,40 @@ inline ULONG detour_is_code_filler(PBYTE pbCode)
 
 //////////////////////////////////////////////// Trampoline Memory Management.
 //
+// The first trampolines of a region hold its header, with a bitmap of the trampolines in use.
+const ULONG DETOUR_REGION_SIGNATURE = 'Rrtd';
+const ULONG DETOUR_REGION_SIZE = 0x10000;
+const ULONG DETOUR_REGION_SLOTS = DETOUR_REGION_SIZE / sizeof(DETOUR_TRAMPOLINE);
+
 struct DETOUR_REGION
 {
     ULONG               dwSignature;
-    DETOUR_REGION *     pNext;  // Next region in list of regions.
-    DETOUR_TRAMPOLINE * pFree;  // List of free trampolines in this region.
+    ULONG               cUsed;      // Number of trampolines in use in this region.
+    ULONG               rdwUsed[(DETOUR_REGION_SLOTS + 31) / 32];   // Bit n is set if trampoline n is in use.
 };
 typedef DETOUR_REGION * PDETOUR_REGION;
 
-const ULONG DETOUR_REGION_SIGNATURE = 'Rrtd';
-const ULONG DETOUR_REGION_SIZE = 0x10000;
-const ULONG DETOUR_TRAMPOLINES_PER_REGION = (DETOUR_REGION_SIZE
-                                             / sizeof(DETOUR_TRAMPOLINE)) - 1;
-static PDETOUR_REGION s_pRegions = NULL;            // List of all regions.
-static PDETOUR_REGION s_pRegion = NULL;             // Default region.
+const ULONG DETOUR_REGION_HEADER_SLOTS = (sizeof(DETOUR_REGION) + sizeof(DETOUR_TRAMPOLINE) - 1)
+                                         / sizeof(DETOUR_TRAMPOLINE);
+const ULONG DETOUR_TRAMPOLINES_PER_REGION = DETOUR_REGION_SLOTS - DETOUR_REGION_HEADER_SLOTS;
+
+// Regions sorted by address, so that the ones within jump bounds of a target are found with a binary search.
+struct DETOUR_REGION_INDEX
+{
+    PDETOUR_REGION *    ppRegions;
+    ULONG               cRegions;
+    ULONG               cMaxRegions;
+};
+
+static DETOUR_REGION_INDEX s_Regions = { NULL, 0, 0 };      // All regions.
+static DETOUR_REGION_INDEX s_OpenRegions = { NULL, 0, 0 };  // Regions with a free trampoline.
 
 static DWORD detour_writable_trampoline_regions()
 {
     // Mark all of the regions as writable.
-    for (PDETOUR_REGION pRegion = s_pRegions; pRegion != NULL; pRegion = pRegion->pNext) {
+    for (ULONG n = 0; n < s_Regions.cRegions; n++) {
         DWORD dwOld;
-        if (!VirtualProtect(pRegion, DETOUR_REGION_SIZE, PAGE_EXECUTE_READWRITE, &dwOld)) {
+        if (!VirtualProtect(s_Regions.ppRegions[n], DETOUR_REGION_SIZE, PAGE_EXECUTE_READWRITE, &dwOld)) {
             return GetLastError();
         }
     }
@@ -1187,11 +1200,74 @@ static void detour_runnable_trampoline_regions()
     HANDLE hProcess = GetCurrentProcess();
 
     // Mark all of the regions as executable.
-    for (PDETOUR_REGION pRegion = s_pRegions; pRegion != NULL; pRegion = pRegion->pNext) {
+    for (ULONG n = 0; n < s_Regions.cRegions; n++) {
         DWORD dwOld;
-        VirtualProtect(pRegion, DETOUR_REGION_SIZE, PAGE_EXECUTE_READ, &dwOld);
-        FlushInstructionCache(hProcess, pRegion, DETOUR_REGION_SIZE);
+        VirtualProtect(s_Regions.ppRegions[n], DETOUR_REGION_SIZE, PAGE_EXECUTE_READ, &dwOld);
+        FlushInstructionCache(hProcess, s_Regions.ppRegions[n], DETOUR_REGION_SIZE);
+    }
+}
+
+// Finds the position of the first region at or above an address.
+static ULONG detour_region_index_find(const DETOUR_REGION_INDEX *pIndex, PBYTE pbAddress)
+{
+    ULONG nLo = 0;
+    ULONG nHi = pIndex->cRegions;
+    while (nLo < nHi) {
+        ULONG nMid = nLo + (nHi - nLo) / 2;
+        if ((PBYTE)pIndex->ppRegions[nMid] < pbAddress) {
+            nLo = nMid + 1;
+        }
+        else {
+            nHi = nMid;
+        }
+    }
+    return nLo;
+}
+
+// Makes room in an index for a number of regions, so that adding them can't fail.
+static BOOL detour_region_index_reserve(DETOUR_REGION_INDEX *pIndex, ULONG cMaxRegions)
+{
+    if (cMaxRegions <= pIndex->cMaxRegions) {
+        return TRUE;
+    }
+
+    ULONG cNewMax = pIndex->cMaxRegions < 8 ? 8 : pIndex->cMaxRegions * 2;
+    if (cNewMax < cMaxRegions) {
+        cNewMax = cMaxRegions;
+    }
+
+    PDETOUR_REGION *ppRegions = new NOTHROW PDETOUR_REGION[cNewMax];
+    if (ppRegions == NULL) {
+        return FALSE;
+    }
+    if (pIndex->ppRegions != NULL) {
+        CopyMemory(ppRegions, pIndex->ppRegions, pIndex->cRegions * sizeof(PDETOUR_REGION));
+        delete[] pIndex->ppRegions;
+    }
+    pIndex->ppRegions = ppRegions;
+    pIndex->cMaxRegions = cNewMax;
+    return TRUE;
+}
+
+// Adds a region to an index, which must already have room for it.
+static void detour_region_index_insert(DETOUR_REGION_INDEX *pIndex, PDETOUR_REGION pRegion)
+{
+    ULONG n = detour_region_index_find(pIndex, (PBYTE)pRegion);
+    MoveMemory(&pIndex->ppRegions[n + 1], &pIndex->ppRegions[n],
+               (pIndex->cRegions - n) * sizeof(PDETOUR_REGION));
+    pIndex->ppRegions[n] = pRegion;
+    pIndex->cRegions++;
+}
+
+static void detour_region_index_remove(DETOUR_REGION_INDEX *pIndex, PDETOUR_REGION pRegion)
+{
+    ULONG n = detour_region_index_find(pIndex, (PBYTE)pRegion);
+    if (n == pIndex->cRegions || pIndex->ppRegions[n] != pRegion) {
+        return;
     }
+    MoveMemory(&pIndex->ppRegions[n], &pIndex->ppRegions[n + 1],
+               (pIndex->cRegions - n - 1) * sizeof(PDETOUR_REGION));
+    pIndex->cRegions--;
 }
 
 static PBYTE detour_alloc_round_down_to_region(PBYTE pbTry)
@@ -1374,6 +1450,32 @@ PVOID WINAPI DetourAllocateRegionWithinJumpBounds(_In_ LPCVOID pbTarget,
     return pbNewlyAllocated;
 }
 
+// Takes the lowest free trampoline of a region, so that trampolines stay packed at the start of the regions.
+static PDETOUR_TRAMPOLINE detour_alloc_trampoline_in_region(PDETOUR_REGION pRegion)
+{
+    for (ULONG w = 0; w < ARRAYSIZE(pRegion->rdwUsed); w++) {
+        DWORD nBit;
+        if (!BitScanForward(&nBit, ~pRegion->rdwUsed[w])) {
+            continue;
+        }
+
+        ULONG nSlot = w * 32 + nBit;
+        if (nSlot >= DETOUR_TRAMPOLINES_PER_REGION) {
+            break;
+        }
+
+        pRegion->rdwUsed[w] |= 1UL << nBit;
+        if (++pRegion->cUsed == DETOUR_TRAMPOLINES_PER_REGION) {
+            detour_region_index_remove(&s_OpenRegions, pRegion);
+        }
+
+        PDETOUR_TRAMPOLINE pTrampoline = ((PDETOUR_TRAMPOLINE)pRegion) + DETOUR_REGION_HEADER_SLOTS + nSlot;
+        memset(pTrampoline, 0xcc, sizeof(*pTrampoline));
+        return pTrampoline;
+    }
+    return NULL;
+}
+
 static PDETOUR_TRAMPOLINE detour_alloc_trampoline(PBYTE pbTarget)
 {
     // We have to place trampolines within +/- 2GB of target.
@@ -1383,37 +1485,21 @@ static PDETOUR_TRAMPOLINE detour_alloc_trampoline(PBYTE pbTarget)
 
     detour_find_jmp_bounds(pbTarget, &pLo, &pHi);
 
-    PDETOUR_TRAMPOLINE pTrampoline = NULL;
-
-    // Insure that there is a default region.
-    if (s_pRegion == NULL && s_pRegions != NULL) {
-        s_pRegion = s_pRegions;
-    }
-
-    // First check the default region for an valid free block.
-    if (s_pRegion != NULL && s_pRegion->pFree != NULL &&
-        s_pRegion->pFree >= pLo && s_pRegion->pFree <= pHi) {
+    // Use the lowest region with a free trampoline that lies entirely within bounds,
+    // so that every region is filled before the next one is used.
+    ULONG n = detour_region_index_find(&s_OpenRegions, (PBYTE)pLo);
+    if (n < s_OpenRegions.cRegions &&
+        (PBYTE)s_OpenRegions.ppRegions[n] + DETOUR_REGION_SIZE <= (PBYTE)pHi) {
 
-      found_region:
-        pTrampoline = s_pRegion->pFree;
-        // do a last sanity check on region.
-        if (pTrampoline < pLo || pTrampoline > pHi) {
-            return NULL;
-        }
-        s_pRegion->pFree = (PDETOUR_TRAMPOLINE)pTrampoline->pbRemain;
-        memset(pTrampoline, 0xcc, sizeof(*pTrampoline));
-        return pTrampoline;
-    }
-
-    // Then check the existing regions for a valid free block.
-    for (s_pRegion = s_pRegions; s_pRegion != NULL; s_pRegion = s_pRegion->pNext) {
-        if (s_pRegion != NULL && s_pRegion->pFree != NULL &&
-            s_pRegion->pFree >= pLo && s_pRegion->pFree <= pHi) {
-            goto found_region;
-        }
+        return detour_alloc_trampoline_in_region(s_OpenRegions.ppRegions[n]);
     }
 
     // We need to allocate a new region.
+    if (!detour_region_index_reserve(&s_Regions, s_Regions.cRegions + 1) ||
+        !detour_region_index_reserve(&s_OpenRegions, s_Regions.cRegions + 1)) {
+        DETOUR_TRACE(("Couldn't grow the region index!\n"));
+        return NULL;
+    }
 
     // Round pbTarget down to 64KB block.
     pbTarget = pbTarget - (PtrToUlong(pbTarget) & 0xffff);
@@ -1421,23 +1507,15 @@ static PDETOUR_TRAMPOLINE detour_alloc_trampoline(PBYTE pbTarget)
     PVOID pbNewlyAllocated =
         detour_alloc_trampoline_allocate_new(pbTarget, pLo, pHi);
     if (pbNewlyAllocated != NULL) {
-        s_pRegion = (DETOUR_REGION*)pbNewlyAllocated;
-        s_pRegion->dwSignature = DETOUR_REGION_SIGNATURE;
-        s_pRegion->pFree = NULL;
-        s_pRegion->pNext = s_pRegions;
-        s_pRegions = s_pRegion;
+        PDETOUR_REGION pRegion = (DETOUR_REGION*)pbNewlyAllocated;
+        ZeroMemory(pRegion, sizeof(*pRegion));
+        pRegion->dwSignature = DETOUR_REGION_SIGNATURE;
+        detour_region_index_insert(&s_Regions, pRegion);
+        detour_region_index_insert(&s_OpenRegions, pRegion);
         DETOUR_TRACE(("  Allocated region %p..%p\n\n",
-                      s_pRegion, ((PBYTE)s_pRegion) + DETOUR_REGION_SIZE - 1));
+                      pRegion, ((PBYTE)pRegion) + DETOUR_REGION_SIZE - 1));
 
-        // Put everything but the first trampoline on the free list.
-        PBYTE pFree = NULL;
-        pTrampoline = ((PDETOUR_TRAMPOLINE)s_pRegion) + 1;
-        for (int i = DETOUR_TRAMPOLINES_PER_REGION - 1; i > 1; i--) {
-            pTrampoline[i].pbRemain = pFree;
-            pFree = (PBYTE)&pTrampoline[i];
-        }
-        s_pRegion->pFree = (PDETOUR_TRAMPOLINE)pFree;
-        goto found_region;
+        return detour_alloc_trampoline_in_region(pRegion);
     }
 
     DETOUR_TRACE(("Couldn't find available memory region!\n"));
@@ -1448,10 +1526,15 @@ static void detour_free_trampoline(PDETOUR_TRAMPOLINE pTrampoline)
 {
     PDETOUR_REGION pRegion = (PDETOUR_REGION)
         ((ULONG_PTR)pTrampoline & ~(ULONG_PTR)0xffff);
+    ULONG nSlot = (ULONG)(pTrampoline - ((PDETOUR_TRAMPOLINE)pRegion + DETOUR_REGION_HEADER_SLOTS));
 
     memset(pTrampoline, 0, sizeof(*pTrampoline));
-    pTrampoline->pbRemain = (PBYTE)pRegion->pFree;
-    pRegion->pFree = pTrampoline;
+    pRegion->rdwUsed[nSlot / 32] &= ~(1UL << (nSlot % 32));
+
+    // A full region can be used again.
+    if (pRegion->cUsed-- == DETOUR_TRAMPOLINES_PER_REGION) {
+        detour_region_index_insert(&s_OpenRegions, pRegion);
+    }
 }
 
 static BOOL detour_is_region_empty(PDETOUR_REGION pRegion)
@@ -1461,40 +1544,24 @@ static BOOL detour_is_region_empty(PDETOUR_REGION pRegion)
         return FALSE;
     }
 
-    PBYTE pbRegionBeg = (PBYTE)pRegion;
-    PBYTE pbRegionLim  = pbRegionBeg + DETOUR_REGION_SIZE;
-
-    // Stop if any of the trampolines aren't free.
-    PDETOUR_TRAMPOLINE pTrampoline = ((PDETOUR_TRAMPOLINE)pRegion) + 1;
-    for (int i = 0; i < DETOUR_TRAMPOLINES_PER_REGION; i++) {
-        if (pTrampoline[i].pbRemain != NULL &&
-            (pTrampoline[i].pbRemain < pbRegionBeg ||
-             pTrampoline[i].pbRemain >= pbRegionLim)) {
-            return FALSE;
-        }
-    }
-
-    // OK, the region is empty.
-    return TRUE;
+    return pRegion->cUsed == 0;
 }
 
 static void detour_free_unused_trampoline_regions()
 {
-    PDETOUR_REGION *ppRegionBase = &s_pRegions;
-    PDETOUR_REGION pRegion = s_pRegions;
+    ULONG cKept = 0;
 
-    while (pRegion != NULL) {
+    for (ULONG n = 0; n < s_Regions.cRegions; n++) {
+        PDETOUR_REGION pRegion = s_Regions.ppRegions[n];
         if (detour_is_region_empty(pRegion)) {
-            *ppRegionBase = pRegion->pNext;
-
+            detour_region_index_remove(&s_OpenRegions, pRegion);
             VirtualFree(pRegion, 0, MEM_RELEASE);
-            s_pRegion = NULL;
         }
         else {
-            ppRegionBase = &pRegion->pNext;
+            s_Regions.ppRegions[cKept++] = pRegion;
         }
-        pRegion = *ppRegionBase;
     }
+    s_Regions.cRegions = cKept;
 }
 
 ///////////////////////////////////////////////////////// Transaction Structs.
@@ -1512,6 +1579,12 @@ struct DetourOperation
     PBYTE *             ppbPointer;
     PBYTE               pbTarget;
     PDETOUR_TRAMPOLINE  pTrampoline;
+};
+
+// A code page written by a transaction, which is only made writable while it commits.
+struct DetourPage
+{
+    PBYTE               pbPage;
     ULONG               dwPerm;
 };
 
@@ -1523,6 +1596,7 @@ static LONG                 s_nPendingError         = NO_ERROR;
 static PVOID *              s_ppPendingError        = NULL;
 static DetourThread *       s_pPendingThreads       = NULL;
 static DetourOperation *    s_pPendingOperations    = NULL;
+static DETOUR_COMMIT_STATISTICS s_CommitStatistics  = { 0, 0, 0, 0 };
 
 //////////////////////////////////////////////////////////////////////////////
 //
@@ -1592,13 +1666,8 @@ LONG WINAPI DetourTransactionAbort()
         return ERROR_INVALID_OPERATION;
     }
 
-    // Restore all of the page permissions.
+    // The target pages are only made writable by the commit, so they don't need restoring.
     for (DetourOperation *o = s_pPendingOperations; o != NULL;) {
-        // We don't care if this fails, because the code is still accessible.
-        DWORD dwOld;
-        VirtualProtect(o->pbTarget, o->pTrampoline->cbRestore,
-                       o->dwPerm, &dwOld);
-
         if (!o->fIsRemove) {
             if (o->pTrampoline) {
                 detour_free_trampoline(o->pTrampoline);
@@ -1655,6 +1724,90 @@ static LONG detour_align_from_target(PDETOUR_TRAMPOLINE pTrampoline, LONG obTarg
     return 0;
 }
 
+BOOL WINAPI DetourGetCommitStatistics(_Out_ PDETOUR_COMMIT_STATISTICS pStatistics)
+{
+    if (pStatistics == NULL) {
+        return FALSE;
+    }
+    *pStatistics = s_CommitStatistics;
+    return TRUE;
+}
+
+// Makes every code page written by the pending operations writable, each of them once,
+// however many of the operations write to it.
+static LONG detour_writable_target_pages(DetourPage **ppPages, ULONG *pcPages, ULONG cbPage)
+{
+    *ppPages = NULL;
+    *pcPages = 0;
+
+    ULONG cMaxPages = 0;
+    for (DetourOperation *o = s_pPendingOperations; o != NULL; o = o->pNext) {
+        ULONG_PTR nFirst = (ULONG_PTR)o->pbTarget / cbPage;
+        ULONG_PTR nLast = ((ULONG_PTR)o->pbTarget + o->pTrampoline->cbRestore - 1) / cbPage;
+        cMaxPages += (ULONG)(nLast - nFirst + 1);
+    }
+    if (cMaxPages == 0) {
+        return NO_ERROR;
+    }
+
+    DetourPage *pPages = new NOTHROW DetourPage[cMaxPages];
+    if (pPages == NULL) {
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    // Insert each page in address order, skipping the ones already found.
+    // Transactions only touch a few dozen pages, so this is faster than anything fancier.
+    ULONG cPages = 0;
+    for (DetourOperation *o = s_pPendingOperations; o != NULL; o = o->pNext) {
+        PBYTE pbFirst = (PBYTE)((ULONG_PTR)o->pbTarget & ~(ULONG_PTR)(cbPage - 1));
+        PBYTE pbEnd = o->pbTarget + o->pTrampoline->cbRestore;
+
+        for (PBYTE pbPage = pbFirst; pbPage < pbEnd; pbPage += cbPage) {
+            ULONG n = cPages;
+            while (n > 0 && pPages[n - 1].pbPage > pbPage) {
+                n--;
+            }
+            if (n > 0 && pPages[n - 1].pbPage == pbPage) {
+                continue;
+            }
+            for (ULONG m = cPages; m > n; m--) {
+                pPages[m] = pPages[m - 1];
+            }
+            pPages[n].pbPage = pbPage;
+            pPages[n].dwPerm = 0;
+            cPages++;
+        }
+    }
+
+    for (ULONG n = 0; n < cPages; n++) {
+        DWORD dwOld = 0;
+        if (!VirtualProtect(pPages[n].pbPage, cbPage, PAGE_EXECUTE_READWRITE, &dwOld)) {
+            LONG error = GetLastError();
+
+            // Report the first operation that needed the page.
+            for (DetourOperation *o = s_pPendingOperations; o != NULL; o = o->pNext) {
+                if (o->pbTarget < pPages[n].pbPage + cbPage &&
+                    o->pbTarget + o->pTrampoline->cbRestore > pPages[n].pbPage) {
+                    s_ppPendingError = (PVOID*)o->ppbPointer;
+                    break;
+                }
+            }
+
+            // We don't care if this fails, because the code is still accessible.
+            while (n-- > 0) {
+                VirtualProtect(pPages[n].pbPage, cbPage, pPages[n].dwPerm, &dwOld);
+            }
+            delete[] pPages;
+            return error;
+        }
+        pPages[n].dwPerm = dwOld;
+    }
+
+    *ppPages = pPages;
+    *pcPages = cPages;
+    return NO_ERROR;
+}
+
 LONG WINAPI DetourTransactionCommitEx(_Out_opt_ PVOID **pppFailedPointer)
 {
     if (pppFailedPointer != NULL) {
@@ -1677,6 +1830,24 @@ LONG WINAPI DetourTransactionCommitEx(_Out_opt_ PVOID **pppFailedPointer)
     DetourThread *t;
     BOOL freed = FALSE;
 
+    // Make the target pages writable, once per page rather than once per operation.
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    ULONG cbPage = si.dwPageSize;
+
+    DetourPage *pPages = NULL;
+    ULONG cPages = 0;
+    LONG error = detour_writable_target_pages(&pPages, &cPages, cbPage);
+    if (error != NO_ERROR) {
+        s_nPendingError = error;
+        if (pppFailedPointer != NULL) {
+            *pppFailedPointer = s_ppPendingError;
+        }
+        DETOUR_BREAK();
+        DetourTransactionAbort();
+        return s_nPendingError;
+    }
+
     // Insert or remove each of the detours.
     for (o = s_pPendingOperations; o != NULL; o = o->pNext) {
         if (o->fIsRemove) {
@@ -1877,13 +2048,31 @@ typedef ULONG_PTR DETOURS_EIP_TYPE;
 #undef DETOURS_EIP
     }
 
-    // Restore all of the page permissions and flush the icache.
-    HANDLE hProcess = GetCurrentProcess();
-    for (o = s_pPendingOperations; o != NULL;) {
+    // Restore all of the page permissions, once per page.
+    for (ULONG n = 0; n < cPages; n++) {
         // We don't care if this fails, because the code is still accessible.
         DWORD dwOld;
-        VirtualProtect(o->pbTarget, o->pTrampoline->cbRestore, o->dwPerm, &dwOld);
-        FlushInstructionCache(hProcess, o->pbTarget, o->pTrampoline->cbRestore);
+        VirtualProtect(pPages[n].pbPage, cbPage, pPages[n].dwPerm, &dwOld);
+    }
+
+    // Flush the icache once for each run of adjacent pages, without flushing the memory between runs,
+    // which may lie in another module or not be mapped at all.
+    HANDLE hProcess = GetCurrentProcess();
+    ULONG cFlushes = 0;
+    for (ULONG n = 0; n < cPages;) {
+        ULONG m = n + 1;
+        while (m < cPages && pPages[m].pbPage == pPages[m - 1].pbPage + cbPage) {
+            m++;
+        }
+        FlushInstructionCache(hProcess, pPages[n].pbPage, (SIZE_T)(m - n) * cbPage);
+        cFlushes++;
+        n = m;
+    }
+    delete[] pPages;
+
+    ULONG cOperations = 0;
+    for (o = s_pPendingOperations; o != NULL;) {
+        cOperations++;
 
         if (o->fIsRemove && o->pTrampoline) {
             detour_free_trampoline(o->pTrampoline);
@@ -1897,6 +2086,11 @@ typedef ULONG_PTR DETOURS_EIP_TYPE;
     }
     s_pPendingOperations = NULL;
 
+    s_CommitStatistics.cOperations = cOperations;
+    s_CommitStatistics.cPages = cPages;
+    s_CommitStatistics.cProtectCalls = cPages * 2;
+    s_CommitStatistics.cFlushCalls = cFlushes;
+
     // Free any trampoline regions that are now unused.
     if (freed && !s_fRetainRegions) {
         detour_free_unused_trampoline_regions();
@@ -2289,12 +2483,7 @@ LONG WINAPI DetourAttachEx(_Inout_ PVOID *ppPointer,
 
     (void)pbTrampoline;
 
-    DWORD dwOld = 0;
-    if (!VirtualProtect(pbTarget, cbTarget, PAGE_EXECUTE_READWRITE, &dwOld)) {
-        error = GetLastError();
-        DETOUR_BREAK();
-        goto fail;
-    }
+    // The target is only made writable by the commit, along with every other target on its page.
 
     DETOUR_TRACE(("detours: pbTarget=%p: "
                   "%02x %02x %02x %02x "
@@ -2320,7 +2509,6 @@ LONG WINAPI DetourAttachEx(_Inout_ PVOID *ppPointer,
     o->ppbPointer = (PBYTE*)ppPointer;
     o->pTrampoline = pTrampoline;
     o->pbTarget = pbTarget;
-    o->dwPerm = dwOld;
     o->pNext = s_pPendingOperations;
     s_pPendingOperations = o;
 
@@ -2447,19 +2635,11 @@ LONG WINAPI DetourDetach(_Inout_ PVOID *ppPointer,
         }
     }
 
-    DWORD dwOld = 0;
-    if (!VirtualProtect(pbTarget, cbTarget,
-                        PAGE_EXECUTE_READWRITE, &dwOld)) {
-        error = GetLastError();
-        DETOUR_BREAK();
-        goto fail;
-    }
-
+    // The target is only made writable by the commit, along with every other target on its page.
     o->fIsRemove = TRUE;
     o->ppbPointer = (PBYTE*)ppPointer;
     o->pTrampoline = pTrampoline;
     o->pbTarget = pbTarget;
-    o->dwPerm = dwOld;
     o->pNext = s_pPendingOperations;
     s_pPendingOperations = o;
 
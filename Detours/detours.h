@@ -548,12 +548,22 @@ typedef BOOL (CALLBACK *PF_DETOUR_IMPORT_FUNC_CALLBACK_EX)(_In_opt_ PVOID pConte
 typedef VOID * PDETOUR_BINARY;
 typedef VOID * PDETOUR_LOADED_BINARY;
 
+// What the last committed transaction did to the code it patched.
+typedef struct _DETOUR_COMMIT_STATISTICS
+{
+    ULONG   cOperations;    // Detours attached or detached.
+    ULONG   cPages;         // Distinct code pages the detours were written to.
+    ULONG   cProtectCalls;  // VirtualProtect calls made to make those pages writable and restore them.
+    ULONG   cFlushCalls;    // FlushInstructionCache calls made for those pages, one per run of adjacent pages.
+} DETOUR_COMMIT_STATISTICS, *PDETOUR_COMMIT_STATISTICS;
+
 //////////////////////////////////////////////////////////// Transaction APIs.
 //
 LONG WINAPI DetourTransactionBegin(VOID);
 LONG WINAPI DetourTransactionAbort(VOID);
 LONG WINAPI DetourTransactionCommit(VOID);
 LONG WINAPI DetourTransactionCommitEx(_Out_opt_ PVOID **pppFailedPointer);
+BOOL WINAPI DetourGetCommitStatistics(_Out_ PDETOUR_COMMIT_STATISTICS pStatistics);
 
 LONG WINAPI DetourUpdateThread(_In_ HANDLE hThread);
 
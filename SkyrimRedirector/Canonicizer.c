@@ -0,0 +1,495 @@
+#include "SR_Base.h"
+#include "Canonicizer.h"
+#include "CaseFold.h"
+
+#include <stddef.h>
+
+#define IS_SEPARATOR(c) ((c) == '\\' || (c) == '/')
+#define IS_LETTER(c) (((c) >= 'A' && (c) <= 'Z') || ((c) >= 'a' && (c) <= 'z'))
+
+#define IS_DRIVE_W(path) (IS_LETTER((path)[0]) && (path)[1] == L':')
+#define IS_DRIVE_A(path) (IS_LETTER((path)[0]) && (path)[1] == ':')
+
+// Ways a path can be resolved
+typedef enum
+{
+	PATH_UNSUPPORTED,
+	PATH_ABSOLUTE,       // C:\Games
+	PATH_UNC,            // \\Server\Share
+	PATH_DRIVE_RELATIVE, // C:Games
+	PATH_ROOTED,         // \Games
+	PATH_RELATIVE,       // Games
+
+} PathType;
+
+// Output of the canonicizer
+typedef struct
+{
+	wchar_t* Buffer;
+	size_t Size;
+
+	// Number of characters written to Buffer
+	size_t Len;
+	// Length of the root of the path, that '..' segments can never remove
+	size_t RootLen;
+
+} OutputW;
+
+// Finds the type of a wide path.
+// `rest` is set to the part of the path that comes after any \\?\ prefix.
+static PathType GetPathTypeW(const wchar_t* path, const wchar_t** rest)
+{
+	// Win32 file namespace, which skips normalization in Windows but is normalized here
+	// so that the same file always has the same canonical path
+	if (path[0] == L'\\' && path[1] == L'\\' && path[2] == L'?' && path[3] == L'\\')
+	{
+		path += 4;
+
+		if (SR_FoldCharW(path[0]) == L'U' && SR_FoldCharW(path[1]) == L'N' && SR_FoldCharW(path[2]) == L'C' && path[3] == L'\\')
+		{
+			*rest = path + 4;
+			return PATH_UNC;
+		}
+
+		*rest = path;
+		return IS_DRIVE_W(path) && IS_SEPARATOR(path[2]) ? PATH_ABSOLUTE : PATH_UNSUPPORTED;
+	}
+
+	*rest = path;
+
+	if (IS_SEPARATOR(path[0]) && IS_SEPARATOR(path[1]))
+	{
+		// Device paths (\\.\ and \\?\ with forward slashes) point to devices, not files
+		if ((path[2] == L'.' || path[2] == L'?') && (path[3] == L'\0' || IS_SEPARATOR(path[3])))
+			return PATH_UNSUPPORTED;
+
+		*rest = path + 2;
+		return PATH_UNC;
+	}
+
+	if (IS_DRIVE_W(path))
+		return IS_SEPARATOR(path[2]) ? PATH_ABSOLUTE : PATH_DRIVE_RELATIVE;
+
+	if (IS_SEPARATOR(path[0])) return PATH_ROOTED;
+	if (path[0] == L'\0') return PATH_UNSUPPORTED;
+	return PATH_RELATIVE;
+}
+
+// Appends a character to the output.
+// Returns false if the output buffer is full.
+static bool PushW(OutputW* out, wchar_t c)
+{
+	// Always leave space for the null terminator
+	if (out->Len + 1 >= out->Size) return false;
+
+	out->Buffer[out->Len++] = c;
+	return true;
+}
+
+// Removes the last segment from the output, unless only the root is left
+static void PopW(OutputW* out)
+{
+	while (out->Len > out->RootLen && out->Buffer[out->Len - 1] != L'\\')
+		out->Len--;
+
+	// Remove the separator before the segment too
+	if (out->Len > out->RootLen)
+		out->Len--;
+}
+
+// Writes the root of an absolute or UNC path to the output.
+//  type: The type of the path, either PATH_ABSOLUTE or PATH_UNC
+//  path: The path, after any \\?\ prefix
+// Returns the part of the path after the root, or NULL if the root couldn't be written.
+static const wchar_t* PushRootW(OutputW* out, PathType type, const wchar_t* path)
+{
+	if (type == PATH_ABSOLUTE)
+	{
+		if (!PushW(out, path[0]) || !PushW(out, L':')) return NULL;
+
+		out->RootLen = out->Len;
+		return path + 2;
+	}
+
+	// UNC: \\Server\Share
+	if (IS_SEPARATOR(path[0]) || path[0] == L'\0') return NULL;
+	if (!PushW(out, L'\\') || !PushW(out, L'\\')) return NULL;
+
+	for (; *path != L'\0' && !IS_SEPARATOR(*path); path++)
+		if (!PushW(out, *path)) return NULL;
+
+	if (*path != L'\0')
+	{
+		path++;
+		if (!PushW(out, L'\\')) return NULL;
+
+		for (; *path != L'\0' && !IS_SEPARATOR(*path); path++)
+			if (!PushW(out, *path)) return NULL;
+	}
+
+	out->RootLen = out->Len;
+	return path;
+}
+
+// Appends all segments of a path to the output, resolving any '.' and '..' segments.
+//  path: The segments to append, which may start with a separator
+//  final: If this is the path being canonicized, and not a directory it is being resolved against.
+//         Trailing separators, dots and spaces are only handled for the final path.
+// Returns false if the output buffer is full.
+static bool PushSegmentsW(OutputW* out, const wchar_t* path, bool final)
+{
+	bool endsWithSeparator = false;
+	bool endsWithName = false;
+	size_t lastNameStart = 0;
+
+	while (*path != L'\0')
+	{
+		if (IS_SEPARATOR(*path))
+		{
+			endsWithSeparator = true;
+			path++;
+			continue;
+		}
+
+		const wchar_t* end = path;
+		while (*end != L'\0' && !IS_SEPARATOR(*end))
+			end++;
+
+		size_t len = end - path;
+		endsWithSeparator = false;
+		endsWithName = false;
+
+		if (len == 2 && path[0] == L'.' && path[1] == L'.')
+		{
+			PopW(out);
+		}
+		else if (len != 1 || path[0] != L'.')
+		{
+			endsWithName = true;
+			lastNameStart = out->Len;
+
+			if (!PushW(out, L'\\')) return false;
+			for (; path != end; path++)
+				if (!PushW(out, *path)) return false;
+		}
+
+		path = end;
+	}
+
+	if (!final) return true;
+
+	// Windows removes trailing dots and spaces from the last segment, which may remove it completely
+	if (endsWithName && !endsWithSeparator)
+	{
+		while (out->Len > lastNameStart + 1 && (out->Buffer[out->Len - 1] == L'.' || out->Buffer[out->Len - 1] == L' '))
+			out->Len--;
+
+		if (out->Len == lastNameStart + 1)
+			out->Len = lastNameStart;
+	}
+
+	// Trailing separators are kept, and drive roots always end with a separator
+	bool needsSeparator = endsWithSeparator || out->Len == out->RootLen;
+	if (needsSeparator && out->Buffer[out->Len - 1] != L'\\')
+		return PushW(out, L'\\');
+
+	return true;
+}
+
+bool SR_NeedsCurrentDirW(const wchar_t* path)
+{
+	const wchar_t* rest;
+	PathType type = GetPathTypeW(path, &rest);
+
+	return type == PATH_DRIVE_RELATIVE || type == PATH_ROOTED || type == PATH_RELATIVE;
+}
+
+// Resolves a path into a caller-supplied buffer, optionally uppercasing it.
+// Returns the length of the resolved path, or 0 if the path isn't supported or doesn't fit in the buffer.
+static size_t ResolveW(const wchar_t* path, const wchar_t* currentDir, wchar_t* buffer, size_t bufferSize, bool fold)
+{
+	OutputW out = { buffer, bufferSize, 0, 0 };
+
+	const wchar_t* rest;
+	PathType type = GetPathTypeW(path, &rest);
+	if (type == PATH_UNSUPPORTED) return 0;
+
+	if (type == PATH_ABSOLUTE || type == PATH_UNC)
+	{
+		rest = PushRootW(&out, type, rest);
+		if (rest == NULL) return 0;
+	}
+	else
+	{
+		if (currentDir == NULL) return 0;
+
+		const wchar_t* currentRest;
+		PathType currentType = GetPathTypeW(currentDir, &currentRest);
+		if (currentType != PATH_ABSOLUTE && currentType != PATH_UNC) return 0;
+
+		// Drive-relative paths on another drive use the current directory of that drive, which only Windows knows
+		if (type == PATH_DRIVE_RELATIVE && (currentType != PATH_ABSOLUTE || SR_FoldCharW(currentRest[0]) != SR_FoldCharW(rest[0]))) return 0;
+
+		currentRest = PushRootW(&out, currentType, currentRest);
+		if (currentRest == NULL) return 0;
+
+		// Rooted paths only use the root of the current directory
+		if (type != PATH_ROOTED && !PushSegmentsW(&out, currentRest, false)) return 0;
+
+		// Skip the drive of drive-relative paths
+		if (type == PATH_DRIVE_RELATIVE) rest += 2;
+	}
+
+	if (!PushSegmentsW(&out, rest, true)) return 0;
+
+	// Nothing reads the case of the output while it's being written, so it can be uppercased all at once
+	if (fold) SR_FoldW(out.Buffer, out.Len);
+
+	out.Buffer[out.Len] = L'\0';
+	return out.Len;
+}
+
+size_t SR_CanonicizeIntoW(const wchar_t* path, const wchar_t* currentDir, wchar_t* buffer, size_t bufferSize)
+{
+	return ResolveW(path, currentDir, buffer, bufferSize, true);
+}
+
+size_t SR_ResolveIntoW(const wchar_t* path, const wchar_t* currentDir, wchar_t* buffer, size_t bufferSize)
+{
+	return ResolveW(path, currentDir, buffer, bufferSize, false);
+}
+
+typedef struct
+{
+	char* Buffer;
+	size_t Size;
+
+	// Number of characters written to Buffer
+	size_t Len;
+	// Length of the root of the path, that '..' segments can never remove
+	size_t RootLen;
+
+} OutputA;
+
+// Finds the type of a wide path.
+// `rest` is set to the part of the path that comes after any \\?\ prefix.
+static PathType GetPathTypeA(const char* path, const char** rest)
+{
+	// Win32 file namespace, which skips normalization in Windows but is normalized here
+	// so that the same file always has the same canonical path
+	if (path[0] == '\\' && path[1] == '\\' && path[2] == '?' && path[3] == '\\')
+	{
+		path += 4;
+
+		if (SR_FoldCharA(path[0]) == 'U' && SR_FoldCharA(path[1]) == 'N' && SR_FoldCharA(path[2]) == 'C' && path[3] == '\\')
+		{
+			*rest = path + 4;
+			return PATH_UNC;
+		}
+
+		*rest = path;
+		return IS_DRIVE_A(path) && IS_SEPARATOR(path[2]) ? PATH_ABSOLUTE : PATH_UNSUPPORTED;
+	}
+
+	*rest = path;
+
+	if (IS_SEPARATOR(path[0]) && IS_SEPARATOR(path[1]))
+	{
+		// Device paths (\\.\ and \\?\ with forward slashes) point to devices, not files
+		if ((path[2] == '.' || path[2] == '?') && (path[3] == '\0' || IS_SEPARATOR(path[3])))
+			return PATH_UNSUPPORTED;
+
+		*rest = path + 2;
+		return PATH_UNC;
+	}
+
+	if (IS_DRIVE_A(path))
+		return IS_SEPARATOR(path[2]) ? PATH_ABSOLUTE : PATH_DRIVE_RELATIVE;
+
+	if (IS_SEPARATOR(path[0])) return PATH_ROOTED;
+	if (path[0] == '\0') return PATH_UNSUPPORTED;
+	return PATH_RELATIVE;
+}
+
+// Appends a character to the output.
+// Returns false if the output buffer is full.
+static bool PushA(OutputA* out, char c)
+{
+	// Always leave space for the null terminator
+	if (out->Len + 1 >= out->Size) return false;
+
+	out->Buffer[out->Len++] = c;
+	return true;
+}
+
+// Removes the last segment from the output, unless only the root is left
+static void PopA(OutputA* out)
+{
+	while (out->Len > out->RootLen && out->Buffer[out->Len - 1] != '\\')
+		out->Len--;
+
+	// Remove the separator before the segment too
+	if (out->Len > out->RootLen)
+		out->Len--;
+}
+
+// Writes the root of an absolute or UNC path to the output.
+//  type: The type of the path, either PATH_ABSOLUTE or PATH_UNC
+//  path: The path, after any \\?\ prefix
+// Returns the part of the path after the root, or NULL if the root couldn't be written.
+static const char* PushRootA(OutputA* out, PathType type, const char* path)
+{
+	if (type == PATH_ABSOLUTE)
+	{
+		if (!PushA(out, path[0]) || !PushA(out, ':')) return NULL;
+
+		out->RootLen = out->Len;
+		return path + 2;
+	}
+
+	// UNC: \\Server\Share
+	if (IS_SEPARATOR(path[0]) || path[0] == '\0') return NULL;
+	if (!PushA(out, '\\') || !PushA(out, '\\')) return NULL;
+
+	for (; *path != '\0' && !IS_SEPARATOR(*path); path++)
+		if (!PushA(out, *path)) return NULL;
+
+	if (*path != '\0')
+	{
+		path++;
+		if (!PushA(out, '\\')) return NULL;
+
+		for (; *path != '\0' && !IS_SEPARATOR(*path); path++)
+			if (!PushA(out, *path)) return NULL;
+	}
+
+	out->RootLen = out->Len;
+	return path;
+}
+
+// Appends all segments of a path to the output, resolving any '.' and '..' segments.
+//  path: The segments to append, which may start with a separator
+//  final: If this is the path being canonicized, and not a directory it is being resolved against.
+//         Trailing separators, dots and spaces are only handled for the final path.
+// Returns false if the output buffer is full.
+static bool PushSegmentsA(OutputA* out, const char* path, bool final)
+{
+	bool endsWithSeparator = false;
+	bool endsWithName = false;
+	size_t lastNameStart = 0;
+
+	while (*path != '\0')
+	{
+		if (IS_SEPARATOR(*path))
+		{
+			endsWithSeparator = true;
+			path++;
+			continue;
+		}
+
+		const char* end = path;
+		while (*end != '\0' && !IS_SEPARATOR(*end))
+			end++;
+
+		size_t len = end - path;
+		endsWithSeparator = false;
+		endsWithName = false;
+
+		if (len == 2 && path[0] == '.' && path[1] == '.')
+		{
+			PopA(out);
+		}
+		else if (len != 1 || path[0] != '.')
+		{
+			endsWithName = true;
+			lastNameStart = out->Len;
+
+			if (!PushA(out, '\\')) return false;
+			for (; path != end; path++)
+				if (!PushA(out, *path)) return false;
+		}
+
+		path = end;
+	}
+
+	if (!final) return true;
+
+	// Windows removes trailing dots and spaces from the last segment, which may remove it completely
+	if (endsWithName && !endsWithSeparator)
+	{
+		while (out->Len > lastNameStart + 1 && (out->Buffer[out->Len - 1] == '.' || out->Buffer[out->Len - 1] == ' '))
+			out->Len--;
+
+		if (out->Len == lastNameStart + 1)
+			out->Len = lastNameStart;
+	}
+
+	// Trailing separators are kept, and drive roots always end with a separator
+	bool needsSeparator = endsWithSeparator || out->Len == out->RootLen;
+	if (needsSeparator && out->Buffer[out->Len - 1] != '\\')
+		return PushA(out, '\\');
+
+	return true;
+}
+
+bool SR_NeedsCurrentDirA(const char* path)
+{
+	const char* rest;
+	PathType type = GetPathTypeA(path, &rest);
+
+	return type == PATH_DRIVE_RELATIVE || type == PATH_ROOTED || type == PATH_RELATIVE;
+}
+
+// Resolves a path into a caller-supplied buffer, optionally uppercasing it.
+// Returns the length of the resolved path, or 0 if the path isn't supported or doesn't fit in the buffer.
+static size_t ResolveA(const char* path, const char* currentDir, char* buffer, size_t bufferSize, bool fold)
+{
+	OutputA out = { buffer, bufferSize, 0, 0 };
+
+	const char* rest;
+	PathType type = GetPathTypeA(path, &rest);
+	if (type == PATH_UNSUPPORTED) return 0;
+
+	if (type == PATH_ABSOLUTE || type == PATH_UNC)
+	{
+		rest = PushRootA(&out, type, rest);
+		if (rest == NULL) return 0;
+	}
+	else
+	{
+		if (currentDir == NULL) return 0;
+
+		const char* currentRest;
+		PathType currentType = GetPathTypeA(currentDir, &currentRest);
+		if (currentType != PATH_ABSOLUTE && currentType != PATH_UNC) return 0;
+
+		// Drive-relative paths on another drive use the current directory of that drive, which only Windows knows
+		if (type == PATH_DRIVE_RELATIVE && (currentType != PATH_ABSOLUTE || SR_FoldCharA(currentRest[0]) != SR_FoldCharA(rest[0]))) return 0;
+
+		currentRest = PushRootA(&out, currentType, currentRest);
+		if (currentRest == NULL) return 0;
+
+		// Rooted paths only use the root of the current directory
+		if (type != PATH_ROOTED && !PushSegmentsA(&out, currentRest, false)) return 0;
+
+		// Skip the drive of drive-relative paths
+		if (type == PATH_DRIVE_RELATIVE) rest += 2;
+	}
+
+	if (!PushSegmentsA(&out, rest, true)) return 0;
+
+	if (fold) SR_FoldA(out.Buffer, out.Len);
+
+	out.Buffer[out.Len] = '\0';
+	return out.Len;
+}
+
+size_t SR_CanonicizeIntoA(const char* path, const char* currentDir, char* buffer, size_t bufferSize)
+{
+	return ResolveA(path, currentDir, buffer, bufferSize, true);
+}
+
+size_t SR_ResolveIntoA(const char* path, const char* currentDir, char* buffer, size_t bufferSize)
+{
+	return ResolveA(path, currentDir, buffer, bufferSize, false);
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <wchar.h>
+#include <stdbool.h>
+
+/*
+User-mode path canonicizer
+
+Produces the same result as GetFullPathName followed by SR_FoldW or SR_FoldA, but works entirely in a
+caller-supplied buffer without calling into Windows. The path is resolved in a single pass, and then uppercased
+all at once. This file doesn't depend on Windows, so it can be tested and benchmarked on any platform.
+
+Supported paths:
+  * Absolute paths:        C:\Games\Skyrim
+  * Drive-relative paths:  C:Skyrim.ini
+  * Rooted paths:          \Games\Skyrim
+  * Relative paths:        Data\..\Skyrim.ini
+  * UNC paths:             \\Server\Share\Skyrim
+  * Win32 file namespace:  \\?\C:\Games\Skyrim and \\?\UNC\Server\Share\Skyrim (the prefix is removed)
+
+Both '\' and '/' are accepted as separators, repeated separators are collapsed, '.' and '..' segments are
+resolved and trailing dots and spaces are removed from the last segment.
+
+Device paths (\\.\) aren't supported, and neither are drive-relative paths on a drive other than the current
+directory's, as they're resolved against the current directory of that drive, which only Windows keeps.
+*/
+
+// Checks if a wide path must be resolved against the current directory to be canonicized
+bool SR_NeedsCurrentDirW(const wchar_t* path);
+
+// Checks if a narrow path must be resolved against the current directory to be canonicized
+bool SR_NeedsCurrentDirA(const char* path);
+
+// Canonicizes a wide path into a caller-supplied buffer.
+//  path: The path to canonicize
+//  currentDir: The absolute directory relative paths are resolved against.
+//              May be NULL if SR_NeedsCurrentDirW(path) is false.
+//  buffer: Where the canonical path will be stored
+//  bufferSize: The size of `buffer`, in characters
+// Returns the length of the canonical path, or 0 if the path isn't supported or doesn't fit in the buffer.
+size_t SR_CanonicizeIntoW(const wchar_t* path, const wchar_t* currentDir, wchar_t* buffer, size_t bufferSize);
+
+// Resolves a wide path into a caller-supplied buffer, the same way as SR_CanonicizeIntoW but keeping its case.
+// The result always has the same length and separators as the canonical path, so a prefix of one can be
+// swapped for the matching prefix of the other.
+size_t SR_ResolveIntoW(const wchar_t* path, const wchar_t* currentDir, wchar_t* buffer, size_t bufferSize);
+
+// Canonicizes a narrow path into a caller-supplied buffer.
+// The path must be in a code page where '\' and '/' can't be part of a multi-byte character,
+// such as any single-byte code page or UTF-8.
+//  path: The path to canonicize
+//  currentDir: The absolute directory relative paths are resolved against.
+//              May be NULL if SR_NeedsCurrentDirA(path) is false.
+//  buffer: Where the canonical path will be stored
+//  bufferSize: The size of `buffer`, in characters
+// Returns the length of the canonical path, or 0 if the path isn't supported or doesn't fit in the buffer.
+size_t SR_CanonicizeIntoA(const char* path, const char* currentDir, char* buffer, size_t bufferSize);
+
+// Resolves a narrow path into a caller-supplied buffer, the same way as SR_CanonicizeIntoA but keeping its case.
+// The result always has the same length and separators as the canonical path, so a prefix of one can be
+// swapped for the matching prefix of the other.
+size_t SR_ResolveIntoA(const char* path, const char* currentDir, char* buffer, size_t bufferSize);
@@ -0,0 +1,108 @@
+#include "SR_Base.h"
+#include "CaseFold.h"
+
+// SSE2 is part of every x64 processor, and 32-bit builds use it when they target it
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || (defined(__i386__) && defined(__SSE2__))
+#define CASE_FOLD_SIMD
+#include <emmintrin.h>
+#endif
+
+#ifdef CASE_FOLD_SIMD
+
+// Size of the blocks folded at once, in bytes
+#define BLOCK_SIZE 16
+
+// wchar_t is 16 bits on Windows, but 32 bits on most other platforms
+#if WCHAR_MAX > 0xFFFF
+#define SET1_W _mm_set1_epi32
+#define CMPEQ_W _mm_cmpeq_epi32
+#define CMPGT_W _mm_cmpgt_epi32
+#define CMPLT_W _mm_cmplt_epi32
+#else
+#define SET1_W _mm_set1_epi16
+#define CMPEQ_W _mm_cmpeq_epi16
+#define CMPGT_W _mm_cmpgt_epi16
+#define CMPLT_W _mm_cmplt_epi16
+#endif
+
+// Every byte of a block, as returned by _mm_movemask_epi8
+#define FULL_MASK 0xFFFF
+
+#endif
+
+void SR_FoldW(wchar_t* str, size_t len)
+{
+	size_t i = 0;
+
+#ifdef CASE_FOLD_SIMD
+	const size_t blockChars = BLOCK_SIZE / sizeof(wchar_t);
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i nonAscii = SET1_W(~0x7F);
+	const __m128i beforeA = SET1_W('a' - 1);
+	const __m128i afterZ = SET1_W('z' + 1);
+	const __m128i caseBit = SET1_W(0x20);
+
+	for (; i + blockChars <= len; i += blockChars)
+	{
+		__m128i chars = _mm_loadu_si128((const __m128i*)(str + i));
+
+		// Characters that aren't ASCII may be folded to anything, so they have to be looked up in the table
+		if (_mm_movemask_epi8(CMPEQ_W(_mm_and_si128(chars, nonAscii), zero)) != FULL_MASK)
+		{
+			for (size_t j = i; j < i + blockChars; j++)
+				str[j] = SR_FoldCharW(str[j]);
+
+			continue;
+		}
+
+		// Lowercase ASCII letters only differ from uppercase ones in the case bit
+		__m128i lower = _mm_and_si128(CMPGT_W(chars, beforeA), CMPLT_W(chars, afterZ));
+		_mm_storeu_si128((__m128i*)(str + i), _mm_xor_si128(chars, _mm_and_si128(lower, caseBit)));
+	}
+#endif
+
+	for (; i < len; i++)
+		str[i] = SR_FoldCharW(str[i]);
+}
+
+void SR_FoldA(char* str, size_t len)
+{
+	size_t i = 0;
+
+#ifdef CASE_FOLD_SIMD
+	const __m128i beforeA = _mm_set1_epi8('a' - 1);
+	const __m128i afterZ = _mm_set1_epi8('z' + 1);
+	const __m128i caseBit = _mm_set1_epi8(0x20);
+
+	// Bytes that aren't ASCII are negative, so they're never taken as lowercase letters
+	for (; i + BLOCK_SIZE <= len; i += BLOCK_SIZE)
+	{
+		__m128i chars = _mm_loadu_si128((const __m128i*)(str + i));
+		__m128i lower = _mm_and_si128(_mm_cmpgt_epi8(chars, beforeA), _mm_cmplt_epi8(chars, afterZ));
+		_mm_storeu_si128((__m128i*)(str + i), _mm_xor_si128(chars, _mm_and_si128(lower, caseBit)));
+	}
+#endif
+
+	for (; i < len; i++)
+		str[i] = SR_FoldCharA(str[i]);
+}
+
+bool SR_FoldedEqualsW(const wchar_t* first, const wchar_t* second)
+{
+	for (size_t i = 0; ; i++)
+	{
+		// Only the null character is folded to a null character, so both strings end at the same time
+		if (first[i] != second[i] && SR_FoldCharW(first[i]) != SR_FoldCharW(second[i])) return false;
+		if (first[i] == L'\0') return true;
+	}
+}
+
+bool SR_FoldedEqualsA(const char* first, const char* second)
+{
+	for (size_t i = 0; ; i++)
+	{
+		if (first[i] != second[i] && SR_FoldCharA(first[i]) != SR_FoldCharA(second[i])) return false;
+		if (first[i] == '\0') return true;
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <wchar.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+Case folding
+
+Uppercases characters the same way NTFS does when it compares file names, without going through the CRT and its
+locales, so that paths are folded the same way on every machine.
+
+Wide characters are folded with a table generated by Tools/GenerateCaseFoldTable.py. The Basic Multilingual Plane is
+split into blocks of SR_CASE_FOLD_BLOCK_SIZE characters, and every block points to the difference between each of its
+characters and their uppercase form. Most blocks have no letters, so they all share the same block of zeros, and the
+whole table is about 7 KB. Characters outside of the plane are never folded, like in NTFS.
+
+Narrow characters can be in any codepage, so only their ASCII letters are folded.
+
+Folding whole strings uses SSE2 to uppercase runs of ASCII characters 16 bytes at a time, and only looks characters up
+in the table when a block has any that aren't ASCII.
+
+This file doesn't depend on Windows, so it can be tested and benchmarked on any platform.
+*/
+
+#ifdef _MSC_VER
+#define SR_CASE_FOLD_INLINE static __forceinline
+#else
+#define SR_CASE_FOLD_INLINE static inline
+#endif
+
+// Number of characters in each block of the table
+#define SR_CASE_FOLD_BLOCK_SIZE 64
+// Number of blocks in the Basic Multilingual Plane
+#define SR_CASE_FOLD_BLOCK_COUNT (0x10000 / SR_CASE_FOLD_BLOCK_SIZE)
+
+// The block of differences used by each block of characters
+extern const uint8_t SR_CaseFoldIndex[SR_CASE_FOLD_BLOCK_COUNT];
+// Differences between every character and its uppercase form, modulo 2^16
+extern const uint16_t SR_CaseFoldDeltas[][SR_CASE_FOLD_BLOCK_SIZE];
+
+// Uppercases a wide character
+SR_CASE_FOLD_INLINE wchar_t SR_FoldCharW(wchar_t c)
+{
+	unsigned int code = (unsigned int)c;
+	if (code < 0x80) return (code >= 'a' && code <= 'z') ? (wchar_t)(code - ('a' - 'A')) : c;
+	if (code > 0xFFFF) return c;
+
+	uint16_t delta = SR_CaseFoldDeltas[SR_CaseFoldIndex[code / SR_CASE_FOLD_BLOCK_SIZE]][code % SR_CASE_FOLD_BLOCK_SIZE];
+	return (wchar_t)(uint16_t)(code + delta);
+}
+
+// Uppercases a narrow character, if it's an ASCII letter
+SR_CASE_FOLD_INLINE char SR_FoldCharA(char c)
+{
+	return (c >= 'a' && c <= 'z') ? (char)(c - ('a' - 'A')) : c;
+}
+
+// Uppercases the first `len` characters of a wide string in place
+void SR_FoldW(wchar_t* str, size_t len);
+
+// Uppercases the ASCII letters among the first `len` characters of a narrow string in place
+void SR_FoldA(char* str, size_t len);
+
+// Checks if two null-terminated wide strings are equal once uppercased
+bool SR_FoldedEqualsW(const wchar_t* first, const wchar_t* second);
+
+// Checks if two null-terminated narrow strings are equal once their ASCII letters are uppercased
+bool SR_FoldedEqualsA(const char* first, const char* second);
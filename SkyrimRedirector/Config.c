@@ -1,13 +1,16 @@
 #include "SR_Base.h"
 #include "Config.h"
+#include "ConfigParser.h"
+#include "IniCache.h"
 #include "StringUtils.h"
 #include "Logging.h"
-#include "WindowsUtils.h"
+#include "Paths.h"
+#include "Redirections.h"
+#include "Once.h"
 #include "PlatformDefinitions.h"
 
 #include <stdlib.h>
 #include <stdbool.h>
-#include <ShlObj.h>
 #include <Windows.h>
 
 // The base directory, relative to the current module path, where all logs and configs from this plugin are stored
@@ -38,178 +41,54 @@
 // The default file path to where plugins.txt will be redirected, relative to the Local AppData folder.
 #define SR_DEFAULT_REDIRECTION_PLUGINS L"\\Enderal" SR_FOLDER_SUFFIX_W L"\\plugins.txt"
 
-// Reads a string stored in a .ini fully
-// If the specified key doesn't exist, this returns null.
-// Otherwise, the returned string is allocated dynamically and must be freed.
-static wchar_t* SR_ReadIniString(const wchar_t* section, const wchar_t* key, const wchar_t* file)
+wchar_t* SR_GetConfigFile()
 {
-	// Exponentially increase the buffer size until it fits the full module file name
-	DWORD resultSize = 16;
-	wchar_t* result = NULL;
-	DWORD actualLen;
-	do
-	{
-		resultSize *= 2;
-		result = realloc(result, resultSize * sizeof(wchar_t));
-		actualLen = GetPrivateProfileStringW(section, key, NULL, result, resultSize, file);
-
-	} while (actualLen >= resultSize - 1);
-
-	if (actualLen == 0) // Key doesn't exist, defaults to empty string
-	{
-		free(result);
-		return NULL;
-	}
-
-	// Trim buffer to fit string exactly
-	result = realloc(result, (actualLen + 1) * sizeof(wchar_t));
-
-	return result;
-}
-
-
-// Gets the full module file path of the currently running executable.
-// The returned string is allocated dynamically and must be freed.
-static wchar_t* SR_GetModuleFilePath()
-{
-	// Exponentially increase the buffer size until it fits the full module file name
-	DWORD moduleFilePathSize = 16;
-	wchar_t* moduleFilePath = NULL;
-	do
-	{
-		moduleFilePathSize *= 2;
-		moduleFilePath = realloc(moduleFilePath, moduleFilePathSize * sizeof(wchar_t));
-		GetModuleFileNameW(NULL, moduleFilePath, moduleFilePathSize);
-
-	} while (GetLastError() == ERROR_INSUFFICIENT_BUFFER);
-
-	// Trim buffer to fit string exactly
-	size_t actualSize = wcslen(moduleFilePath) + 1;
-	moduleFilePath = realloc(moduleFilePath, actualSize * sizeof(wchar_t));
-
-	return moduleFilePath;
-}
-
-// Gets the base directory where the config and default log file will be stored.
-// The returned string is allocated dynamically and must be freed.
-static wchar_t* SR_GetBaseDir()
-{
-	wchar_t* moduleFilePath = SR_GetModuleFilePath();
-
-	// Start Dir is the folder of the module file -- the module file path until its last path separator
-	ptrdiff_t startDirLen = wcsrchr(moduleFilePath, L'\\') - &moduleFilePath[0];
-
-	// Base Dir = Start Dir \ Relative Base Dir '\0'
-	rsize_t baseDirSize = startDirLen + 1 + wcslen(SR_BASE_DIR) + 1;
-	wchar_t* baseDir = calloc(baseDirSize, sizeof(wchar_t));
-
-	wcsncpy_s(baseDir, baseDirSize, moduleFilePath, startDirLen);
-	free(moduleFilePath);
-
-	wcscat_s(baseDir, baseDirSize, L"\\");
-	wcscat_s(baseDir, baseDirSize, SR_BASE_DIR);
-
-	return baseDir;
-}
-
-// Gets the file path of the configuration file.
-// The returned string is allocated dynamically and must be freed.
-static wchar_t* SR_GetConfigFile()
-{
-	wchar_t* baseDir = SR_GetBaseDir();
-	wchar_t* result = SR_Concat(2, baseDir, SR_CONFIG_FILE);
-	free(baseDir);
-
-	return result;
+	return SR_Concat(4, SR_GetModuleDir(), L"\\", SR_BASE_DIR, SR_CONFIG_FILE);
 }
 
 // Gets the default file path of the log file.
 // The returned string is allocated dynamically and must be freed.
 static wchar_t* SR_GetDefaultLogFile()
 {
-	wchar_t* baseDir = SR_GetBaseDir();
-	wchar_t* result = SR_Concat(2, baseDir, SR_DEFAULT_LOG_FILE);
-	free(baseDir);
-
-	return result;
+	return SR_Concat(4, SR_GetModuleDir(), L"\\", SR_BASE_DIR, SR_DEFAULT_LOG_FILE);
 }
 
 // Gets the default file path of the redirected .ini file.
 // The returned string is allocated dynamically and must be freed.
 static wchar_t* SR_GetDefaultRedirectionIni()
 {
-	wchar_t* documentsPath = SR_GetKnownFolder(&FOLDERID_Documents);
-
-	wchar_t* result = SR_Concat(2, documentsPath, SR_DEFAULT_REDIRECTION_INI);
-	free(documentsPath);
-
-	return result;
+	return SR_Concat(2, SR_GetDocumentsDir(), SR_DEFAULT_REDIRECTION_INI);
 }
 
 // Gets the default file path of the redirected prefs .ini file.
 // The returned string is allocated dynamically and must be freed.
 static wchar_t* SR_GetDefaultRedirectionPrefsIni()
 {
-	wchar_t* documentsPath = SR_GetKnownFolder(&FOLDERID_Documents);
-
-	wchar_t* result = SR_Concat(2, documentsPath, SR_DEFAULT_REDIRECTION_PREFS_INI);
-	free(documentsPath);
-
-	return result;
+	return SR_Concat(2, SR_GetDocumentsDir(), SR_DEFAULT_REDIRECTION_PREFS_INI);
 }
 
 // Gets the default file path of the redirected custom .ini file.
 // The returned string is allocated dynamically and must be freed.
 static wchar_t* SR_GetDefaultRedirectionCustomIni()
 {
-	wchar_t* documentsPath = SR_GetKnownFolder(&FOLDERID_Documents);
-
-	wchar_t* result = SR_Concat(2, documentsPath, SR_DEFAULT_REDIRECTION_CUSTOM_INI);
-	free(documentsPath);
-
-	return result;
+	return SR_Concat(2, SR_GetDocumentsDir(), SR_DEFAULT_REDIRECTION_CUSTOM_INI);
 }
 
 // Gets the default file path of the redirected plugins file.
 // The returned string is allocated dynamically and must be freed.
 static wchar_t* SR_GetDefaultRedirectionPlugins()
 {
-	wchar_t* documentsPath = SR_GetKnownFolder(&FOLDERID_LocalAppData);
-
-	wchar_t* result = SR_Concat(2, documentsPath, SR_DEFAULT_REDIRECTION_PLUGINS);
-	free(documentsPath);
-
-	return result;
+	return SR_Concat(2, SR_GetLocalAppDataDir(), SR_DEFAULT_REDIRECTION_PLUGINS);
 }
 
 
-// Transforms a textual log level info an integer log level
-static uint8_t SR_LogStringToLogLevel(const wchar_t* level)
-{
-	if (SR_AreCaseInsensitiveEqualW(level, L"TRACE")) return SR_LOG_LEVEL_TRACE;
-	if (SR_AreCaseInsensitiveEqualW(level, L"DEBUG")) return SR_LOG_LEVEL_DEBUG;
-	if (SR_AreCaseInsensitiveEqualW(level, L"INFO")) return SR_LOG_LEVEL_INFO;
-	if (SR_AreCaseInsensitiveEqualW(level, L"WARN")) return SR_LOG_LEVEL_WARN;
-	if (SR_AreCaseInsensitiveEqualW(level, L"ERROR")) return SR_LOG_LEVEL_ERROR;
-	return SR_LOG_LEVEL_OFF;
-}
-
-// Transforms an integer log level into a textual log level
-// The returned string is static and doesn't need to be freed.
-static const wchar_t* SR_LogLevelToLogString(uint8_t level)
-{
-	if (level == SR_LOG_LEVEL_TRACE) return L"TRACE";
-	if (level == SR_LOG_LEVEL_DEBUG) return L"DEBUG";
-	if (level == SR_LOG_LEVEL_INFO) return L"INFO";
-	if (level == SR_LOG_LEVEL_WARN) return L"WARN";
-	if (level == SR_LOG_LEVEL_ERROR) return L"ERROR";
-	return L"OFF";
-}
-
 // Checks if a file is valid, that is, it exists  and is not a directory
 static bool SR_IsFileValid(const wchar_t* name)
 {
+	SR_EnterRedirector();
 	DWORD attr = GetFileAttributesW(name);
+	SR_LeaveRedirector();
+
 	if (attr == INVALID_FILE_ATTRIBUTES) return false;
 
 	return (attr & FILE_ATTRIBUTE_DIRECTORY) == 0;
@@ -235,118 +114,169 @@ static void SR_ValidateFile(const wchar_t* name, wchar_t** storage, wchar_t* (*g
 		SR_ERROR("%ls path '%ls' is still invalid even after regeneration, redirections will fail", name, *storage);
 }
 
-static SR_UserConfig* UserConfig = NULL;
+// The config, read the first time it's needed
+static SR_Once UserConfig = SR_ONCE_INIT;
 
-// Saves the values currently stored in UserConfig to the .ini file
-static void SR_SaveUserConfig()
-{
-	if (UserConfig == NULL) return;
-	wchar_t* configFile = SR_GetConfigFile();
+// The config file as it was read, along with every change saved since, or NULL if it couldn't be read
+static SR_IniFile* ConfigIni = NULL;
+// The encoding ConfigIni was read in
+static SR_IniEncoding ConfigEncoding = SR_INI_ENCODING_ANSI;
 
-	WritePrivateProfileStringW(L"Logging", L"File", UserConfig->Logging.File, configFile);
-	WritePrivateProfileStringW(L"Logging", L"Level", SR_LogLevelToLogString(UserConfig->Logging.Level), configFile);
+// Saves the values of a config to the .ini file.
+// The file is only written if one of the values changed, and then it's written once, in a single step.
+static void SR_SaveUserConfig(const SR_UserConfig* config)
+{
+	// A file that couldn't be read is never overwritten, since everything else in it would be lost
+	if (ConfigIni == NULL) return;
+	if (!SR_StoreUserConfig(ConfigIni, config)) return;
 
-	if (UserConfig->Logging.Append)
-		WritePrivateProfileStringW(L"Logging", L"Append", L"TRUE", configFile);
-	else
-		WritePrivateProfileStringW(L"Logging", L"Append", L"FALSE", configFile);
+	wchar_t* configFile = SR_GetConfigFile();
 
-	WritePrivateProfileStringW(L"Redirection", L"Ini", UserConfig->Redirection.Ini, configFile);
-	WritePrivateProfileStringW(L"Redirection", L"PrefsIni", UserConfig->Redirection.PrefsIni, configFile);
-	WritePrivateProfileStringW(L"Redirection", L"CustomIni", UserConfig->Redirection.CustomIni, configFile);
-	WritePrivateProfileStringW(L"Redirection", L"Plugins", UserConfig->Redirection.Plugins, configFile);
+	if (!SR_WriteIniFile(configFile, ConfigIni, ConfigEncoding))
+		SR_ERROR("Unable to save the config to '%ls' (error %lu)", configFile, GetLastError());
 
 	free(configFile);
 }
 
-/*
-
-This macro is to be used as follows:
+static double LoadMilliseconds = 0;
 
-  READOR("Section", "Key", GetDefaultValue());
-  someVar = read;
+// Creates a config with the values of a config file, using the defaults for every value that isn't in it.
+//  ini: The config file, or NULL to use every default
+static SR_UserConfig* SR_CreateUserConfig(const SR_IniFile* ini)
+{
+	SR_UserConfig* config = calloc(1, sizeof(SR_UserConfig));
+	if (config == NULL) return NULL;
 
-It does the following:
+	config->Logging.Level = SR_ParseLogLevel(SR_DEFAULT_LOG_LEVEL);
+	config->Logging.Append = true;
 
-  1. Call SR_ReadIniString with the variable `configFile` as the config file parameter
-	 and assign its return value to the variable `read`
+	if (ini != NULL) SR_ParseUserConfig(ini, config);
 
-  2. If `read` is null, call the specified default value generator and assign it to read.
+	if (config->Logging.File == NULL) config->Logging.File = SR_GetDefaultLogFile();
+	if (config->Redirection.Ini == NULL) config->Redirection.Ini = SR_GetDefaultRedirectionIni();
+	if (config->Redirection.PrefsIni == NULL) config->Redirection.PrefsIni = SR_GetDefaultRedirectionPrefsIni();
+	if (config->Redirection.CustomIni == NULL) config->Redirection.CustomIni = SR_GetDefaultRedirectionCustomIni();
+	if (config->Redirection.Plugins == NULL) config->Redirection.Plugins = SR_GetDefaultRedirectionPlugins();
 
-*/
-#define READOR(section, key, default) \
-	read = SR_ReadIniString(L##section, L##key, configFile); \
-	if (read == NULL) \
-		read = default;
+	return config;
+}
 
-static void SR_LoadConfig()
+// Reads the config. Called once, through UserConfig.
+static void* SR_LoadConfig()
 {
-	SR_FreeUserConfig();
-
-	UserConfig = calloc(1, sizeof(SR_UserConfig));
+	LARGE_INTEGER start, end, frequency;
+	QueryPerformanceCounter(&start);
 
+	// The whole file is read and parsed once, instead of once for every key, and kept to tell if saving changes it
 	wchar_t* configFile = SR_GetConfigFile();
-	wchar_t* read;
-
-	READOR("Logging", "File", SR_GetDefaultLogFile());
-	UserConfig->Logging.File = read;
+	ConfigIni = SR_ReadIniFile(configFile, &ConfigEncoding);
+	free(configFile);
 
-	READOR("Logging", "Level", _wcsdup(SR_DEFAULT_LOG_LEVEL));
-	UserConfig->Logging.Level = SR_LogStringToLogLevel(read);
-	free(read);
+	SR_UserConfig* config = SR_CreateUserConfig(ConfigIni);
+	if (config == NULL) return NULL;
 
-	READOR("Logging", "Append", _wcsdup(L"TRUE"));
-	UserConfig->Logging.Append = SR_AreCaseInsensitiveEqualW(read, L"TRUE");
-	free(read);
+	SR_SaveUserConfig(config);
 
-	READOR("Redirection", "Ini", SR_GetDefaultRedirectionIni());
-	UserConfig->Redirection.Ini = read;
+	QueryPerformanceCounter(&end);
+	QueryPerformanceFrequency(&frequency);
+	LoadMilliseconds = (double)(end.QuadPart - start.QuadPart) * 1000.0 / (double)frequency.QuadPart;
 
-	READOR("Redirection", "PrefsIni", SR_GetDefaultRedirectionPrefsIni());
-	UserConfig->Redirection.PrefsIni = read;
+	return config;
+}
 
-	READOR("Redirection", "CustomIni", SR_GetDefaultRedirectionCustomIni());
-	UserConfig->Redirection.CustomIni = read;
+SR_UserConfig* SR_GetUserConfig()
+{
+	return SR_GetOnce(&UserConfig, SR_LoadConfig);
+}
 
-	READOR("Redirection", "Plugins", SR_GetDefaultRedirectionPlugins());
-	UserConfig->Redirection.Plugins = read;
+void SR_ValidateUserConfig()
+{
+	SR_UserConfig* config = SR_GetUserConfig();
 
-	free(configFile);
+	// The config is loaded before the log is opened, so how long it took can only be logged now
+	SR_INFO("Loaded the config in %.3f ms", LoadMilliseconds);
 
-	SR_SaveUserConfig();
+	SR_ValidateFile(L"Log File",   &config->Logging.File,          &SR_GetDefaultLogFile             );
+	SR_ValidateFile(L"Ini",        &config->Redirection.Ini,       &SR_GetDefaultRedirectionIni      );
+	SR_ValidateFile(L"Prefs Ini",  &config->Redirection.PrefsIni,  &SR_GetDefaultRedirectionPrefsIni );
+	SR_ValidateFile(L"Custom Ini", &config->Redirection.CustomIni, &SR_GetDefaultRedirectionCustomIni);
+	SR_ValidateFile(L"Plugins",    &config->Redirection.Plugins,   &SR_GetDefaultRedirectionPlugins  );
+	SR_SaveUserConfig(config);
 }
 
-#undef READOR
-
-SR_UserConfig* SR_GetUserConfig()
+// Checks if two config files have the same contents
+static bool SR_IniEquals(const SR_IniFile* first, const SR_IniFile* second)
 {
-	if (UserConfig == NULL) SR_LoadConfig();
-	return UserConfig;
+	size_t firstLen, secondLen;
+	wchar_t* firstText = SR_FormatIni(first, &firstLen);
+	wchar_t* secondText = SR_FormatIni(second, &secondLen);
+
+	bool equal = firstLen == secondLen && wmemcmp(firstText, secondText, firstLen) == 0;
+	free(firstText);
+	free(secondText);
+
+	return equal;
 }
 
-void SR_ValidateUserConfig()
+SR_UserConfig* SR_ReadChangedUserConfig()
 {
-	if (UserConfig == NULL) SR_LoadConfig();
-
-	SR_ValidateFile(L"Log File",   &UserConfig->Logging.File,          &SR_GetDefaultLogFile             );
-	SR_ValidateFile(L"Ini",        &UserConfig->Redirection.Ini,       &SR_GetDefaultRedirectionIni      );
-	SR_ValidateFile(L"Prefs Ini",  &UserConfig->Redirection.PrefsIni,  &SR_GetDefaultRedirectionPrefsIni );
-	SR_ValidateFile(L"Custom Ini", &UserConfig->Redirection.CustomIni, &SR_GetDefaultRedirectionCustomIni);
-	SR_ValidateFile(L"Plugins",    &UserConfig->Redirection.Plugins,   &SR_GetDefaultRedirectionPlugins  );
-	SR_SaveUserConfig();
+	wchar_t* configFile = SR_GetConfigFile();
+	SR_IniEncoding encoding;
+	SR_IniFile* ini = SR_ReadIniFile(configFile, &encoding);
+	free(configFile);
+
+	// Saving the config also changes the file, which mustn't reload it again
+	if (ini == NULL || (ConfigIni != NULL && SR_IniEquals(ini, ConfigIni)))
+	{
+		if (ini != NULL) SR_FreeIni(ini);
+		return NULL;
+	}
+
+	SR_UserConfig* config = SR_CreateUserConfig(ini);
+
+	if (ConfigIni != NULL) SR_FreeIni(ConfigIni);
+	ConfigIni = ini;
+	ConfigEncoding = encoding;
+
+	return config;
 }
 
-void SR_FreeUserConfig()
+void SR_FreeConfig(SR_UserConfig* config)
 {
-	if (UserConfig == NULL) return;
+	if (config == NULL) return;
+
+	free(config->Logging.File);
 
-	free(UserConfig->Logging.File);
+	free(config->Redirection.Ini);
+	free(config->Redirection.PrefsIni);
+	free(config->Redirection.CustomIni);
+	free(config->Redirection.Plugins);
 
-	free(UserConfig->Redirection.Ini);
-	free(UserConfig->Redirection.PrefsIni);
-	free(UserConfig->Redirection.CustomIni);
-	free(UserConfig->Redirection.Plugins);
+	for (size_t i = 0; i < config->Redirection.RuleCount; i++)
+	{
+		free(config->Redirection.Rules[i].Source);
+		free(config->Redirection.Rules[i].Target);
+	}
+	free(config->Redirection.Rules);
+
+	for (size_t i = 0; i < config->Redirection.DirectoryRuleCount; i++)
+	{
+		free(config->Redirection.DirectoryRules[i].Source);
+		free(config->Redirection.DirectoryRules[i].Target);
+	}
+	free(config->Redirection.DirectoryRules);
+
+	for (size_t i = 0; i < config->Hooks.RuleCount; i++)
+		free(config->Hooks.Rules[i].Name);
+	free(config->Hooks.Rules);
+
+	free(config);
+}
+
+void SR_FreeUserConfig()
+{
+	SR_FreeConfig(SR_ResetOnce(&UserConfig));
 
-	free(UserConfig);
-	UserConfig = NULL;
+	if (ConfigIni != NULL) SR_FreeIni(ConfigIni);
+	ConfigIni = NULL;
 }
@@ -1,7 +1,42 @@
 #pragma once
+#include <wchar.h>
 #include <stdint.h>
 #include <stdbool.h>
 
+// A redirection configured by the user, in addition to the built-in ones
+typedef struct
+{
+	// The file being redirected.
+	// Absolute paths only match that exact file, relative paths match any file whose path ends with them.
+	wchar_t* Source;
+
+	// The file the source is redirected to
+	wchar_t* Target;
+
+} SR_RedirectionRule;
+
+// How a hook is installed
+typedef enum
+{
+	// The first instructions of the function are replaced with a jump to the hook, with Detours.
+	// Every call to the function goes through the hook, wherever it comes from.
+	SR_HOOK_INLINE,
+
+	// The game executable's import of the function is pointed at the hook.
+	// Only the game's own calls go through the hook, but they reach it without any jump or trampoline.
+	SR_HOOK_IMPORT,
+
+} SR_HookMode;
+
+// The mode of a single hook, overriding the default one
+typedef struct
+{
+	// The name of the hooked function, such as CreateFileW
+	wchar_t* Name;
+	SR_HookMode Mode;
+
+} SR_HookModeRule;
+
 typedef struct
 {
 	struct
@@ -10,6 +45,13 @@ typedef struct
 		uint8_t Level;
 		bool Append;
 
+		// If every hook should count its calls, redirections and matching time, and log them when unloaded
+		bool HookStatistics;
+
+		// If messages should be written to "<File>.bin" as a binary trace, to be decoded by TraceDecoder, instead of
+		// being formatted when they're logged
+		bool Binary;
+
 	} Logging;
 
 	struct
@@ -19,17 +61,54 @@ typedef struct
 		wchar_t* CustomIni;
 		wchar_t* Plugins;
 
+		// Every other key in the [Redirection] section, as Source=Target
+		SR_RedirectionRule* Rules;
+		size_t RuleCount;
+
+		// Every key in the [DirectoryRedirection] section, as Source=Target.
+		// Every path inside a source directory is redirected to the same path inside the target directory.
+		// Relative sources are relative to the Documents folder.
+		SR_RedirectionRule* DirectoryRules;
+		size_t DirectoryRuleCount;
+
 	} Redirection;
 
+	// How the hooks are installed. Only read when they're attached, so changes need a restart.
+	struct
+	{
+		// The mode of every hook that isn't in Rules
+		SR_HookMode Default;
+
+		// Every other key in the [Hooks] section, as Function=Mode
+		SR_HookModeRule* Rules;
+		size_t RuleCount;
+
+	} Hooks;
+
 } SR_UserConfig;
 
-// Gets the current UserConfig
+// Gets the current UserConfig, reading it the first time it's needed.
+// Safe to call from any thread. The config is only read once, even if several threads need it at the same time.
 SR_UserConfig* SR_GetUserConfig();
 
 // Validates the current UserConfig, checking if its files and values
-// are correct, and automatically correcting them if they aren't
+// are correct, and automatically correcting them if they aren't.
+// The config is never changed after this, so it must be called before the redirections are attached.
 void SR_ValidateUserConfig();
 
+// Gets the file path of the configuration file.
+// The returned string is allocated dynamically and must be freed.
+wchar_t* SR_GetConfigFile();
+
+// Reads the configuration file again, to reload the redirections while the game runs.
+// Returns NULL if it couldn't be read or didn't change since it was last read or saved. Otherwise, returns a new
+// config that is independent from the current UserConfig and must be freed with SR_FreeConfig.
+// Only one thread can call this at a time.
+SR_UserConfig* SR_ReadChangedUserConfig();
+
+// Frees a config returned by SR_ReadChangedUserConfig
+void SR_FreeConfig(SR_UserConfig* config);
+
 // Frees all resources allocated to the user config
 // Any pointers returned by SR_GetUserConfig() must be considered invalid 
 // after this function is called.
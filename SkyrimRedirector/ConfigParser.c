@@ -0,0 +1,287 @@
+#include "SR_Base.h"
+#include "ConfigParser.h"
+#include "Logging.h"
+
+#include <stdlib.h>
+#include <wctype.h>
+
+// Compares two strings, ignoring the case of ASCII letters
+static bool EqualsIgnoringCase(const wchar_t* a, const wchar_t* b)
+{
+	for (; *a != L'\0' && *b != L'\0'; a++, b++)
+	{
+		wchar_t foldedA = *a >= L'a' && *a <= L'z' ? *a - (L'a' - L'A') : *a;
+		wchar_t foldedB = *b >= L'a' && *b <= L'z' ? *b - (L'a' - L'A') : *b;
+		if (foldedA != foldedB) return false;
+	}
+
+	return *a == *b;
+}
+
+// Reads a value fully.
+// If the key doesn't exist or is empty, this returns null.
+// Otherwise, the returned string is allocated dynamically and must be freed.
+static wchar_t* ReadString(const SR_IniFile* ini, const wchar_t* section, const wchar_t* key)
+{
+	// Exponentially increase the buffer size until it fits the whole value
+	size_t size = 32;
+	wchar_t* result = NULL;
+	size_t len;
+	do
+	{
+		size *= 2;
+		result = realloc(result, size * sizeof(wchar_t));
+		len = SR_GetIniString(ini, section, key, NULL, result, size);
+
+	} while (len >= size - 1);
+
+	if (len == 0) // Key doesn't exist, defaults to empty string
+	{
+		free(result);
+		return NULL;
+	}
+
+	// Trim buffer to fit string exactly
+	return realloc(result, (len + 1) * sizeof(wchar_t));
+}
+
+// Reads a TRUE or FALSE value, keeping the current value if the key doesn't exist
+static void ReadBool(const SR_IniFile* ini, const wchar_t* section, const wchar_t* key, bool* value)
+{
+	wchar_t* read = ReadString(ini, section, key);
+	if (read == NULL) return;
+
+	*value = EqualsIgnoringCase(read, L"TRUE");
+	free(read);
+}
+
+// Duplicates part of a string, without any leading or trailing whitespace.
+//  start: The first character to duplicate
+//  end: The character after the last character to duplicate
+// The returned string is allocated dynamically and must be freed.
+static wchar_t* DuplicateTrimmed(const wchar_t* start, const wchar_t* end)
+{
+	while (start < end && iswspace(*start)) start++;
+	while (end > start && iswspace(end[-1])) end--;
+
+	size_t len = end - start;
+	wchar_t* result = calloc(len + 1, sizeof(wchar_t));
+	wmemcpy(result, start, len);
+
+	return result;
+}
+
+// Checks if a key in the [Redirection] section configures one of the built-in redirections
+static bool IsBuiltInRedirectionKey(const wchar_t* key)
+{
+	return EqualsIgnoringCase(key, L"Ini")
+		|| EqualsIgnoringCase(key, L"PrefsIni")
+		|| EqualsIgnoringCase(key, L"CustomIni")
+		|| EqualsIgnoringCase(key, L"Plugins");
+}
+
+// Reads every line of a section, as a list of null-terminated strings ending with an empty string.
+// The returned list is allocated dynamically and must be freed.
+static wchar_t* ReadSection(const SR_IniFile* ini, const wchar_t* sectionName)
+{
+	// Exponentially increase the buffer size until it fits the full section
+	size_t size = 256;
+	wchar_t* section = NULL;
+	size_t len;
+	do
+	{
+		size *= 2;
+		section = realloc(section, size * sizeof(wchar_t));
+		len = SR_GetIniSection(ini, sectionName, section, size);
+
+	} while (len >= size - 2);
+
+	return section;
+}
+
+// Splits a line of a section into its trimmed key and value.
+// Returns false, without allocating anything, if the line is a comment or isn't a key=value pair.
+// Otherwise, both strings are allocated dynamically and must be freed.
+static bool SplitEntry(const wchar_t* entry, wchar_t** key, wchar_t** value)
+{
+	if (*entry == L';' || *entry == L'#') return false;
+
+	const wchar_t* separator = wcschr(entry, L'=');
+	if (separator == NULL) return false;
+
+	*key = DuplicateTrimmed(entry, separator);
+	*value = DuplicateTrimmed(separator + 1, separator + 1 + wcslen(separator + 1));
+	return true;
+}
+
+// Reads every user-defined redirection rule from a section.
+// Every key that isn't a built-in redirection is a rule, with the key as the source and the value as the target.
+//  count: Where the number of rules read will be stored
+// The returned array and all of its strings are allocated dynamically and must be freed.
+static SR_RedirectionRule* ReadRedirectionRules(const SR_IniFile* ini, const wchar_t* sectionName, size_t* count)
+{
+	*count = 0;
+
+	wchar_t* section = ReadSection(ini, sectionName);
+
+	size_t capacity = 0;
+	SR_RedirectionRule* rules = NULL;
+
+	for (const wchar_t* entry = section; *entry != L'\0'; entry += wcslen(entry) + 1)
+	{
+		wchar_t* key;
+		wchar_t* value;
+		if (!SplitEntry(entry, &key, &value)) continue;
+
+		if (*key == L'\0' || *value == L'\0' || IsBuiltInRedirectionKey(key))
+		{
+			free(key);
+			free(value);
+			continue;
+		}
+
+		if (*count == capacity)
+		{
+			capacity = capacity == 0 ? 8 : capacity * 2;
+			rules = realloc(rules, capacity * sizeof(SR_RedirectionRule));
+		}
+
+		rules[*count].Source = key;
+		rules[*count].Target = value;
+		(*count)++;
+	}
+
+	free(section);
+	return rules;
+}
+
+// Reads the mode of every hook listed in the [Hooks] section, along with the default mode for every other hook
+static void ReadHookModes(const SR_IniFile* ini, SR_UserConfig* config)
+{
+	config->Hooks.Rules = NULL;
+	config->Hooks.RuleCount = 0;
+
+	wchar_t* section = ReadSection(ini, L"Hooks");
+	size_t capacity = 0;
+
+	for (const wchar_t* entry = section; *entry != L'\0'; entry += wcslen(entry) + 1)
+	{
+		wchar_t* key;
+		wchar_t* value;
+		if (!SplitEntry(entry, &key, &value)) continue;
+
+		if (*key == L'\0' || *value == L'\0')
+		{
+			free(key);
+			free(value);
+			continue;
+		}
+
+		if (EqualsIgnoringCase(key, L"Default"))
+		{
+			config->Hooks.Default = SR_ParseHookMode(value);
+			free(key);
+			free(value);
+			continue;
+		}
+
+		if (config->Hooks.RuleCount == capacity)
+		{
+			capacity = capacity == 0 ? 8 : capacity * 2;
+			config->Hooks.Rules = realloc(config->Hooks.Rules, capacity * sizeof(SR_HookModeRule));
+		}
+
+		config->Hooks.Rules[config->Hooks.RuleCount].Name = key;
+		config->Hooks.Rules[config->Hooks.RuleCount].Mode = SR_ParseHookMode(value);
+		config->Hooks.RuleCount++;
+
+		free(value);
+	}
+
+	free(section);
+}
+
+uint8_t SR_ParseLogLevel(const wchar_t* level)
+{
+	if (EqualsIgnoringCase(level, L"TRACE")) return SR_LOG_LEVEL_TRACE;
+	if (EqualsIgnoringCase(level, L"DEBUG")) return SR_LOG_LEVEL_DEBUG;
+	if (EqualsIgnoringCase(level, L"INFO")) return SR_LOG_LEVEL_INFO;
+	if (EqualsIgnoringCase(level, L"WARN")) return SR_LOG_LEVEL_WARN;
+	if (EqualsIgnoringCase(level, L"ERROR")) return SR_LOG_LEVEL_ERROR;
+	return SR_LOG_LEVEL_OFF;
+}
+
+const wchar_t* SR_FormatLogLevel(uint8_t level)
+{
+	if (level == SR_LOG_LEVEL_TRACE) return L"TRACE";
+	if (level == SR_LOG_LEVEL_DEBUG) return L"DEBUG";
+	if (level == SR_LOG_LEVEL_INFO) return L"INFO";
+	if (level == SR_LOG_LEVEL_WARN) return L"WARN";
+	if (level == SR_LOG_LEVEL_ERROR) return L"ERROR";
+	return L"OFF";
+}
+
+SR_HookMode SR_ParseHookMode(const wchar_t* mode)
+{
+	if (EqualsIgnoringCase(mode, L"Import")) return SR_HOOK_IMPORT;
+	return SR_HOOK_INLINE;
+}
+
+const wchar_t* SR_FormatHookMode(SR_HookMode mode)
+{
+	if (mode == SR_HOOK_IMPORT) return L"Import";
+	return L"Inline";
+}
+
+SR_HookMode SR_GetHookMode(const SR_UserConfig* config, const wchar_t* name)
+{
+	for (size_t i = 0; i < config->Hooks.RuleCount; i++)
+	{
+		if (EqualsIgnoringCase(config->Hooks.Rules[i].Name, name)) return config->Hooks.Rules[i].Mode;
+	}
+
+	return config->Hooks.Default;
+}
+
+void SR_ParseUserConfig(const SR_IniFile* ini, SR_UserConfig* config)
+{
+	config->Logging.File = ReadString(ini, L"Logging", L"File");
+
+	wchar_t* level = ReadString(ini, L"Logging", L"Level");
+	if (level != NULL) config->Logging.Level = SR_ParseLogLevel(level);
+	free(level);
+
+	ReadBool(ini, L"Logging", L"Append", &config->Logging.Append);
+	ReadBool(ini, L"Logging", L"HookStatistics", &config->Logging.HookStatistics);
+	ReadBool(ini, L"Logging", L"Binary", &config->Logging.Binary);
+
+	config->Redirection.Ini = ReadString(ini, L"Redirection", L"Ini");
+	config->Redirection.PrefsIni = ReadString(ini, L"Redirection", L"PrefsIni");
+	config->Redirection.CustomIni = ReadString(ini, L"Redirection", L"CustomIni");
+	config->Redirection.Plugins = ReadString(ini, L"Redirection", L"Plugins");
+
+	config->Redirection.Rules = ReadRedirectionRules(ini, L"Redirection", &config->Redirection.RuleCount);
+	config->Redirection.DirectoryRules = ReadRedirectionRules(ini, L"DirectoryRedirection", &config->Redirection.DirectoryRuleCount);
+
+	ReadHookModes(ini, config);
+}
+
+bool SR_StoreUserConfig(SR_IniFile* ini, const SR_UserConfig* config)
+{
+	bool changed = false;
+
+	changed |= SR_SetIniString(ini, L"Logging", L"File", config->Logging.File);
+	changed |= SR_SetIniString(ini, L"Logging", L"Level", SR_FormatLogLevel(config->Logging.Level));
+	changed |= SR_SetIniString(ini, L"Logging", L"Append", config->Logging.Append ? L"TRUE" : L"FALSE");
+	changed |= SR_SetIniString(ini, L"Logging", L"HookStatistics", config->Logging.HookStatistics ? L"TRUE" : L"FALSE");
+	changed |= SR_SetIniString(ini, L"Logging", L"Binary", config->Logging.Binary ? L"TRUE" : L"FALSE");
+
+	changed |= SR_SetIniString(ini, L"Redirection", L"Ini", config->Redirection.Ini);
+	changed |= SR_SetIniString(ini, L"Redirection", L"PrefsIni", config->Redirection.PrefsIni);
+	changed |= SR_SetIniString(ini, L"Redirection", L"CustomIni", config->Redirection.CustomIni);
+	changed |= SR_SetIniString(ini, L"Redirection", L"Plugins", config->Redirection.Plugins);
+
+	changed |= SR_SetIniString(ini, L"Hooks", L"Default", SR_FormatHookMode(config->Hooks.Default));
+
+	return changed;
+}
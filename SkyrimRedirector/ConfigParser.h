@@ -0,0 +1,42 @@
+#pragma once
+#include "Config.h"
+#include "IniFile.h"
+
+/*
+Config parser
+
+Reads every setting of SkyrimRedirector.ini out of the file parsed once in memory, instead of asking Windows for each
+key, which opens, reads and parses the whole file again every time. Settings are stored back into the same in-memory
+file, which tells if anything changed, so that the file is only written when it has to be.
+
+This file doesn't depend on Windows, so it can be tested on any platform. The defaults that do, like the paths of
+known folders, are filled in by Config.c.
+*/
+
+// Reads every setting stored in a config file.
+//  config: Must already hold the default Level, Append, HookStatistics, Binary and hook mode, which are kept for keys
+//          that aren't in the file. Paths that aren't in the file are set to NULL.
+// Every string stored in the config is allocated dynamically and must be freed.
+void SR_ParseUserConfig(const SR_IniFile* ini, SR_UserConfig* config);
+
+// Stores every setting of a config in a config file, keeping every other line of the file as it is.
+// Returns true if the file was changed, in which case it needs to be written.
+bool SR_StoreUserConfig(SR_IniFile* ini, const SR_UserConfig* config);
+
+// Transforms a textual log level into an integer log level. Unknown levels turn logging off.
+uint8_t SR_ParseLogLevel(const wchar_t* level);
+
+// Transforms an integer log level into a textual log level.
+// The returned string is static and doesn't need to be freed.
+const wchar_t* SR_FormatLogLevel(uint8_t level);
+
+// Transforms a textual hook mode into a hook mode. Unknown modes are SR_HOOK_INLINE, which works for every hook.
+SR_HookMode SR_ParseHookMode(const wchar_t* mode);
+
+// Transforms a hook mode into a textual hook mode.
+// The returned string is static and doesn't need to be freed.
+const wchar_t* SR_FormatHookMode(SR_HookMode mode);
+
+// Gets the mode a hook must be installed with.
+//  name: The name of the hooked function, such as CreateFileW
+SR_HookMode SR_GetHookMode(const SR_UserConfig* config, const wchar_t* name);
@@ -0,0 +1,222 @@
+#include "SR_Base.h"
+#include "ConfigWatcher.h"
+#include "Config.h"
+#include "Redirections.h"
+#include "Logging.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <Windows.h>
+
+// Time the config file must stay unchanged before the redirections are reloaded, in milliseconds
+#define RELOAD_DELAY 500
+
+// Size of the buffer that receives the changes made inside the folder, in bytes
+#define CHANGES_BUFFER_SIZE 4096
+
+// The folder of the config file, followed by the name of the file. Split in two by a null character.
+static wchar_t* ConfigPath = NULL;
+// Points to the name of the config file, inside ConfigPath
+static const wchar_t* ConfigName = NULL;
+
+// The folder of the config file, opened to be watched
+static HANDLE Folder = INVALID_HANDLE_VALUE;
+// Calls FolderCallback whenever changes made inside Folder are read
+static PTP_IO FolderIo = NULL;
+static OVERLAPPED FolderOverlapped;
+// Receives the changes made inside Folder. ReadDirectoryChangesW needs it to be DWORD-aligned.
+static DWORD Changes[CHANGES_BUFFER_SIZE / sizeof(DWORD)];
+
+// Reloads the redirections once RELOAD_DELAY passes without any other change
+static PTP_TIMER ReloadTimer = NULL;
+// Held while reloading, as the timer can fire again before the previous reload is done
+static SRWLOCK ReloadLock = SRWLOCK_INIT;
+
+// Set once the watcher is stopped, so that no other read or reload is started
+static volatile bool WatchStopped = false;
+// Held while checking WatchStopped and starting the next read, so that no read can start once the watcher is stopped
+static SRWLOCK WatchLock = SRWLOCK_INIT;
+
+// Starts reading the next changes made inside the folder. FolderCallback is called once they're read.
+// Returns false if they can't be read.
+static bool ReadChanges()
+{
+	StartThreadpoolIo(FolderIo);
+
+	ZeroMemory(&FolderOverlapped, sizeof(FolderOverlapped));
+	if (ReadDirectoryChangesW(Folder, Changes, sizeof(Changes), FALSE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE, NULL, &FolderOverlapped, NULL))
+		return true;
+
+	CancelThreadpoolIo(FolderIo);
+	return false;
+}
+
+// Checks if any of the changes read into Changes was made to the config file
+//  bytes: The number of bytes read into Changes
+static bool IsConfigChanged(ULONG_PTR bytes)
+{
+	// When too many changes are made at once, they don't fit in the buffer and none of them is read
+	if (bytes == 0) return true;
+
+	const BYTE* current = (const BYTE*)Changes;
+	while (true)
+	{
+		const FILE_NOTIFY_INFORMATION* change = (const FILE_NOTIFY_INFORMATION*)current;
+
+		// The file name isn't null-terminated
+		int nameLen = (int)(change->FileNameLength / sizeof(wchar_t));
+		if (CompareStringOrdinal(change->FileName, nameLen, ConfigName, -1, TRUE) == CSTR_EQUAL) return true;
+
+		if (change->NextEntryOffset == 0) return false;
+		current += change->NextEntryOffset;
+	}
+}
+
+// Schedules a reload whenever the config file changes, called by FolderIo
+static VOID CALLBACK FolderCallback(PTP_CALLBACK_INSTANCE instance, PVOID context, PVOID overlapped, ULONG result, ULONG_PTR bytes, PTP_IO io)
+{
+	(void)instance;
+	(void)context;
+	(void)overlapped;
+	(void)io;
+
+	// Stopping the watcher cancels the pending read, which still calls this
+	if (WatchStopped) return;
+
+	if (result != NO_ERROR)
+	{
+		SR_ERROR("Unable to read the changes to the config (error %lu), they will only be applied when the game restarts", result);
+		return;
+	}
+
+	if (IsConfigChanged(bytes))
+	{
+		// A negative due time is relative, in 100 nanosecond units. Setting it again pushes back the pending reload.
+		ULARGE_INTEGER due;
+		due.QuadPart = (ULONGLONG)(-(LONGLONG)RELOAD_DELAY * 10000);
+
+		FILETIME dueTime;
+		dueTime.dwLowDateTime = due.LowPart;
+		dueTime.dwHighDateTime = due.HighPart;
+
+		SetThreadpoolTimer(ReloadTimer, &dueTime, 0, 0);
+	}
+
+	// A read started after the watcher is stopped would never be cancelled, and stopping would wait for it forever
+	AcquireSRWLockExclusive(&WatchLock);
+	bool reading = WatchStopped || ReadChanges();
+	DWORD error = GetLastError();
+	ReleaseSRWLockExclusive(&WatchLock);
+
+	if (!reading)
+		SR_ERROR("Unable to keep watching the config (error %lu), changes will only be applied when the game restarts", error);
+}
+
+// Reloads the redirections, called by ReloadTimer
+static VOID CALLBACK ReloadTimerCallback(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_TIMER timer)
+{
+	(void)instance;
+	(void)context;
+	(void)timer;
+
+	AcquireSRWLockExclusive(&ReloadLock);
+
+	if (!WatchStopped)
+	{
+		SR_DEBUG("'%ls' changed, reloading the redirections", ConfigName);
+		SR_ReloadRedirections();
+	}
+
+	ReleaseSRWLockExclusive(&ReloadLock);
+}
+
+// Closes everything the watcher opened. No callback can be running anymore.
+static void CloseWatcher()
+{
+	if (ReloadTimer != NULL) CloseThreadpoolTimer(ReloadTimer);
+	ReloadTimer = NULL;
+
+	if (FolderIo != NULL) CloseThreadpoolIo(FolderIo);
+	FolderIo = NULL;
+
+	if (Folder != INVALID_HANDLE_VALUE) CloseHandle(Folder);
+	Folder = INVALID_HANDLE_VALUE;
+
+	free(ConfigPath);
+	ConfigPath = NULL;
+	ConfigName = NULL;
+}
+
+void SR_StartConfigWatcher()
+{
+	if (FolderIo != NULL) return;
+
+	WatchStopped = false;
+
+	ConfigPath = SR_GetConfigFile();
+	wchar_t* separator = wcsrchr(ConfigPath, L'\\');
+	if (separator == NULL)
+	{
+		CloseWatcher();
+		return;
+	}
+
+	*separator = L'\0';
+	ConfigName = separator + 1;
+
+	SR_EnterRedirector();
+	Folder = CreateFileW(ConfigPath, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+		OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+	SR_LeaveRedirector();
+
+	if (Folder == INVALID_HANDLE_VALUE)
+	{
+		SR_ERROR("Unable to open '%ls' to watch the config (error %lu), changes will only be applied when the game restarts", ConfigPath, GetLastError());
+		CloseWatcher();
+		return;
+	}
+
+	// The callbacks keep the plugin loaded while they run. The watcher is stopped from DllMain, under the loader lock,
+	// and this keeps a callback from waiting for the loader lock while DllMain waits for the callback.
+	HMODULE plugin = NULL;
+	GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, (LPCWSTR)FolderCallback, &plugin);
+
+	TP_CALLBACK_ENVIRON environment;
+	InitializeThreadpoolEnvironment(&environment);
+	if (plugin != NULL) SetThreadpoolCallbackLibrary(&environment, plugin);
+
+	FolderIo = CreateThreadpoolIo(Folder, FolderCallback, NULL, &environment);
+	ReloadTimer = CreateThreadpoolTimer(ReloadTimerCallback, NULL, &environment);
+	DestroyThreadpoolEnvironment(&environment);
+
+	if (FolderIo == NULL || ReloadTimer == NULL || !ReadChanges())
+	{
+		SR_ERROR("Unable to watch '%ls' for changes (error %lu), they will only be applied when the game restarts", ConfigPath, GetLastError());
+		CloseWatcher();
+		return;
+	}
+
+	SR_INFO("Watching '%ls\\%ls', changes to the redirections will be applied while the game runs", ConfigPath, ConfigName);
+}
+
+void SR_StopConfigWatcher(bool processExiting)
+{
+	if (FolderIo == NULL) return;
+
+	AcquireSRWLockExclusive(&WatchLock);
+	WatchStopped = true;
+	ReleaseSRWLockExclusive(&WatchLock);
+
+	// When the process is exiting, the threadpool threads were already terminated, so there's nothing to wait for
+	if (processExiting) return;
+
+	// The read has to be stopped first, as it can schedule a reload until it's done.
+	// No other read can start once WatchStopped is set, so this is the last one.
+	CancelIoEx(Folder, &FolderOverlapped);
+	WaitForThreadpoolIoCallbacks(FolderIo, FALSE);
+
+	SetThreadpoolTimer(ReloadTimer, NULL, 0, 0);
+	WaitForThreadpoolTimerCallbacks(ReloadTimer, TRUE);
+
+	CloseWatcher();
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <stdbool.h>
+
+/*
+Config watcher
+
+Watches the folder of SkyrimRedirector.ini while the game runs, so that changes to the redirections are applied
+without restarting the game.
+
+The folder is watched with ReadDirectoryChangesW on the threadpool. Editors usually write a file several times when
+saving it, so the redirections are only reloaded once the file stays unchanged for RELOAD_DELAY, also on the
+threadpool, and never on a thread the game uses. Only the redirections are reloaded: the logging options and hook
+modes only take effect the next time the game starts.
+
+The watcher is stopped from DllMain, under the loader lock, so its callbacks must never need the loader: the paths
+they use were all resolved when the plugin loaded. The callbacks also keep the plugin loaded while they run, with
+SetThreadpoolCallbackLibrary, so that a callback that ends up waiting for the loader lock can't deadlock DllMain.
+*/
+
+// Starts watching the config file. Does nothing if it's already being watched.
+void SR_StartConfigWatcher();
+
+// Stops watching the config file, waiting for a reload in progress to finish.
+// No callback of the watcher runs or is pending once this returns, unless the process is exiting.
+//  processExiting: If the whole process is exiting, in which case every other thread was already terminated
+void SR_StopConfigWatcher(bool processExiting);
@@ -0,0 +1,131 @@
+#include "SR_Base.h"
+#include "Epoch.h"
+
+#include <Windows.h>
+#include <malloc.h>
+#include <string.h>
+
+#define CACHE_LINE_SIZE 64
+
+// The epoch stored in a slot while its thread isn't reading the shared data
+#define IDLE 0
+
+// The slot of a single thread.
+// Aligned to a cache line so that threads entering and leaving epochs never write to the same line.
+typedef __declspec(align(CACHE_LINE_SIZE)) struct Slot
+{
+	// The epoch the thread entered, or IDLE
+	volatile LONG Epoch;
+
+	// If a thread owns this slot. Slots of threads that exited are taken by new threads.
+	volatile LONG Owned;
+
+	struct Slot* Next;
+
+} Slot;
+
+// Every slot, as a lock-free stack that is only pushed to until the slots are freed
+static Slot* volatile AllSlots = NULL;
+
+// The current epoch. Starts after IDLE and only moves forward.
+static volatile LONG GlobalEpoch = IDLE + 1;
+
+// Incremented every time the slots are freed, so that threads know their slot is gone
+static volatile LONG Generation = 0;
+
+// The slot of the current thread, only valid if CurrentGeneration is Generation
+static __declspec(thread) Slot* CurrentSlot = NULL;
+static __declspec(thread) LONG CurrentGeneration = -1;
+
+// Gets the slot of the current thread, taking a free one or creating a new one if needed.
+// Returns NULL if a new slot couldn't be allocated.
+static Slot* GetThreadSlot()
+{
+	if (CurrentSlot != NULL && CurrentGeneration == Generation) return CurrentSlot;
+
+	Slot* slot = NULL;
+	for (Slot* current = AllSlots; current != NULL && slot == NULL; current = current->Next)
+	{
+		if (current->Owned == 0 && InterlockedCompareExchange(&current->Owned, 1, 0) == 0)
+			slot = current;
+	}
+
+	if (slot == NULL)
+	{
+		slot = _aligned_malloc(sizeof(Slot), CACHE_LINE_SIZE);
+		if (slot == NULL) return NULL;
+
+		memset(slot, 0, sizeof(Slot));
+		slot->Owned = 1;
+
+		Slot* head;
+		do
+		{
+			head = AllSlots;
+			slot->Next = head;
+		} while (InterlockedCompareExchangePointer((PVOID volatile*)&AllSlots, slot, head) != head);
+	}
+
+	CurrentSlot = slot;
+	CurrentGeneration = Generation;
+
+	return slot;
+}
+
+bool SR_EnterEpoch()
+{
+	Slot* slot = GetThreadSlot();
+	if (slot == NULL) return false;
+
+	slot->Epoch = GlobalEpoch;
+
+	// Only keeps the compiler from reading the shared data before the epoch is announced.
+	// The processor may still do so, which SR_SynchronizeEpoch accounts for.
+	_ReadWriteBarrier();
+
+	return true;
+}
+
+void SR_LeaveEpoch()
+{
+	// Volatile writes have release semantics, so every read of the shared data happens before this
+	CurrentSlot->Epoch = IDLE;
+}
+
+void SR_SynchronizeEpoch()
+{
+	LONG epoch = InterlockedIncrement(&GlobalEpoch);
+
+	// Makes every thread's announcement visible. A thread that read the old data announced its epoch before that,
+	// so it's seen below, and a thread that didn't announce anything yet will read the new data.
+	FlushProcessWriteBuffers();
+
+	for (Slot* slot = AllSlots; slot != NULL; slot = slot->Next)
+	{
+		// Threads are only inside an epoch for as long as it takes to match a path
+		while (slot->Epoch != IDLE && slot->Epoch < epoch)
+			SwitchToThread();
+	}
+}
+
+void SR_FreeThreadEpoch()
+{
+	if (CurrentSlot == NULL || CurrentGeneration != Generation) return;
+
+	CurrentSlot->Epoch = IDLE;
+	InterlockedExchange(&CurrentSlot->Owned, 0);
+	CurrentSlot = NULL;
+}
+
+void SR_FreeEpochs()
+{
+	Slot* slot = InterlockedExchangePointer((PVOID volatile*)&AllSlots, NULL);
+	InterlockedIncrement(&Generation);
+
+	while (slot != NULL)
+	{
+		Slot* next = slot->Next;
+		_aligned_free(slot);
+		slot = next;
+	}
+}
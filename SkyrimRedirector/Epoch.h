@@ -0,0 +1,34 @@
+#pragma once
+#include <stdbool.h>
+
+/*
+Epoch-based reclamation
+
+Lets data shared with the hooks be replaced while the game runs, without the hooks ever taking a lock.
+
+A hook calls SR_EnterEpoch before reading the shared data and SR_LeaveEpoch once it doesn't use it anymore, which
+announces the current epoch in a slot owned by its thread. To replace the data, its new version is published first,
+and then SR_SynchronizeEpoch moves to the next epoch and waits until no thread is still inside an older one. After
+that, no thread can be using the old version, so it can be freed.
+
+Readers only ever write to their own cache-line-aligned slot, with no interlocked operations or memory barriers:
+SR_SynchronizeEpoch calls FlushProcessWriteBuffers to make their writes visible instead, since replacing the data is
+rare and can afford to be slow.
+*/
+
+// Marks the current thread as reading the shared data. Calls can't be nested.
+// Returns false if the thread's slot couldn't be allocated, in which case the shared data can't be read.
+bool SR_EnterEpoch();
+
+// Marks the current thread as done reading the shared data. Must only be called if SR_EnterEpoch returned true.
+void SR_LeaveEpoch();
+
+// Waits until every thread that could have read a version of the shared data replaced before this call is done.
+// Only one thread can call this at a time, and never from inside SR_EnterEpoch/SR_LeaveEpoch.
+void SR_SynchronizeEpoch();
+
+// Gives the current thread's slot to the next thread that needs one. Must be called when a thread exits.
+void SR_FreeThreadEpoch();
+
+// Frees the slots of every thread. No thread can be inside an epoch when this is called.
+void SR_FreeEpochs();
@@ -0,0 +1,257 @@
+#include "SR_Base.h"
+#include "ExportResolver.h"
+#include "CaseFold.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Number of forwarders followed from one export before leaving the rest to GetProcAddress, and of import stubs followed
+// from one function. Windows never chains more than a couple, so this only stops a malformed module from looping forever.
+#define MAX_FORWARD_DEPTH 4
+
+// Finds one of the data directories of a module, such as its exports or its import address table.
+//  entry: The IMAGE_DIRECTORY_ENTRY_* of the directory
+//  size: Receives the size of the directory
+// Returns NULL if the module doesn't have that directory.
+static const BYTE* GetDataDirectory(HMODULE module, int entry, DWORD* size)
+{
+	const BYTE* base = (const BYTE*)module;
+
+	const IMAGE_DOS_HEADER* dosHeader = (const IMAGE_DOS_HEADER*)base;
+	if (dosHeader->e_magic != IMAGE_DOS_SIGNATURE) return NULL;
+
+	const IMAGE_NT_HEADERS* ntHeader = (const IMAGE_NT_HEADERS*)(base + dosHeader->e_lfanew);
+	if (ntHeader->Signature != IMAGE_NT_SIGNATURE) return NULL;
+
+	const IMAGE_DATA_DIRECTORY* directory = &ntHeader->OptionalHeader.DataDirectory[entry];
+	if (directory->VirtualAddress == 0 || directory->Size == 0) return NULL;
+
+	*size = directory->Size;
+	return base + directory->VirtualAddress;
+}
+
+// Finds the export directory of a module.
+//  size: Receives the size of the directory. Exports whose address is inside it are forwarders.
+// Returns NULL if the module has no exports.
+static const IMAGE_EXPORT_DIRECTORY* GetExportDirectory(HMODULE module, DWORD* size)
+{
+	return (const IMAGE_EXPORT_DIRECTORY*)GetDataDirectory(module, IMAGE_DIRECTORY_ENTRY_EXPORT, size);
+}
+
+// Gets the module an address is in, or NULL if it isn't in any
+static HMODULE GetContainingModule(PVOID address)
+{
+	HMODULE module;
+	if (!GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, (LPCWSTR)address, &module))
+		return NULL;
+
+	return module;
+}
+
+// Finds where a function jumps to, if all it does is jump through an import of its module.
+// This is how most kernel32 functions call their kernelbase implementation, in a stub that is never forwarded.
+// Returns NULL if the function is anything else.
+static PVOID SkipImportStub(PVOID function)
+{
+	const BYTE* code = function;
+
+	// The stubs have a REX.W prefix, so that they're long enough to be hot-patched
+	if (code[0] == 0x48) code++;
+
+	// jmp [address]
+	if (code[0] != 0xFF || code[1] != 0x25) return NULL;
+
+	INT32 operand = *(const INT32 UNALIGNED*)(code + 2);
+#ifdef _WIN64
+	// x64 addresses are relative to the next instruction
+	PVOID* slot = (PVOID*)(code + 6 + operand);
+#else
+	PVOID* slot = (PVOID*)(ULONG_PTR)(UINT32)operand;
+#endif
+
+	// Jumps through anything other than the imports could go anywhere, at any time
+	HMODULE module = GetContainingModule(function);
+	DWORD importsSize;
+	const BYTE* imports = module == NULL ? NULL : GetDataDirectory(module, IMAGE_DIRECTORY_ENTRY_IAT, &importsSize);
+	if (imports == NULL || (const BYTE*)slot < imports || (const BYTE*)slot + sizeof(PVOID) > imports + importsSize)
+		return NULL;
+
+	return *slot;
+}
+
+// Orders two exports by name, the same way the export names of a module are ordered
+static int CompareExports(const void* first, const void* second)
+{
+	const SR_Export* firstExport = *(const SR_Export* const*)first;
+	const SR_Export* secondExport = *(const SR_Export* const*)second;
+
+	return strcmp(firstExport->Name, secondExport->Name);
+}
+
+// Finds every export in a list in the export table of a module, walking the table once.
+// Forwarded exports only have their Forwarder set. Exports that can't be found this way are left unresolved, for
+// GetProcAddress to find.
+static void WalkExports(HMODULE module, SR_Export* exports, size_t count)
+{
+	DWORD directorySize;
+	const IMAGE_EXPORT_DIRECTORY* directory = GetExportDirectory(module, &directorySize);
+	if (directory == NULL) return;
+
+	const BYTE* base = (const BYTE*)module;
+	const DWORD* functions = (const DWORD*)(base + directory->AddressOfFunctions);
+	const DWORD* names = (const DWORD*)(base + directory->AddressOfNames);
+	const WORD* ordinals = (const WORD*)(base + directory->AddressOfNameOrdinals);
+
+	SR_Export** sorted = malloc(count * sizeof(SR_Export*));
+	if (sorted == NULL) return;
+
+	for (size_t i = 0; i < count; i++)
+		sorted[i] = &exports[i];
+
+	qsort(sorted, count, sizeof(SR_Export*), CompareExports);
+
+	size_t next = 0;
+	for (DWORD i = 0; i < directory->NumberOfNames && next < count; i++)
+	{
+		const char* name = (const char*)(base + names[i]);
+
+		// Requested names that sort before this one aren't exported at all
+		while (next < count && strcmp(sorted[next]->Name, name) < 0)
+			next++;
+
+		if (next == count || strcmp(sorted[next]->Name, name) != 0) continue;
+
+		SR_Export* current = sorted[next++];
+		const BYTE* code = base + functions[ordinals[i]];
+
+		if (code >= (const BYTE*)directory && code < (const BYTE*)directory + directorySize)
+		{
+			current->Forwarder = (const char*)code;
+		}
+		else
+		{
+			current->Address = (PVOID)code;
+			current->Module = module;
+		}
+	}
+
+	free(sorted);
+}
+
+// Gets the length of the module part of a forwarder string, or 0 if it isn't a forwarder to a named function
+static size_t GetForwardedModuleLength(const char* forwarder)
+{
+	const char* separator = strrchr(forwarder, '.');
+	if (separator == NULL || separator == forwarder || separator[1] == '#') return 0;
+
+	return (size_t)(separator - forwarder);
+}
+
+// Checks if a forwarder string points to a named function in a module
+//  forwarder: The forwarder string, or NULL if the export isn't forwarded
+//  moduleName: The name of the module, as found in the forwarder strings
+static bool IsForwardedTo(const char* forwarder, const char* moduleName, size_t moduleLen)
+{
+	if (forwarder == NULL || GetForwardedModuleLength(forwarder) != moduleLen) return false;
+
+	for (size_t i = 0; i < moduleLen; i++)
+	{
+		if (SR_FoldCharA(forwarder[i]) != SR_FoldCharA(moduleName[i])) return false;
+	}
+
+	return true;
+}
+
+// Resolves every export in a list in a module, following forwarders until `depth` reaches MAX_FORWARD_DEPTH
+static void ResolveExports(HMODULE module, SR_Export* exports, size_t count, int depth)
+{
+	WalkExports(module, exports, count);
+
+	// Every module exports are forwarded to is walked once, for all of the exports forwarded to it
+	SR_Export* forwarded = calloc(count, sizeof(SR_Export));
+
+	for (size_t i = 0; i < count && forwarded != NULL; i++)
+	{
+		size_t moduleLen = exports[i].Forwarder == NULL ? 0 : GetForwardedModuleLength(exports[i].Forwarder);
+		if (moduleLen == 0 || moduleLen >= MAX_PATH || depth >= MAX_FORWARD_DEPTH) continue;
+
+		char moduleName[MAX_PATH];
+		memcpy(moduleName, exports[i].Forwarder, moduleLen);
+		moduleName[moduleLen] = '\0';
+
+		// Forwarders can only point to modules the loader already loaded, along with the one forwarding to them
+		HMODULE target = GetModuleHandleA(moduleName);
+		if (target == NULL) continue;
+
+		size_t forwardedCount = 0;
+		for (size_t j = i; j < count; j++)
+		{
+			if (!IsForwardedTo(exports[j].Forwarder, moduleName, moduleLen)) continue;
+
+			SR_Export* current = &forwarded[forwardedCount++];
+			ZeroMemory(current, sizeof(SR_Export));
+			current->Name = exports[j].Forwarder + moduleLen + 1;
+		}
+
+		ResolveExports(target, forwarded, forwardedCount, depth + 1);
+
+		// The exports are matched back in the same order they were copied in
+		size_t k = 0;
+		for (size_t j = i; j < count && k < forwardedCount; j++)
+		{
+			if (!IsForwardedTo(exports[j].Forwarder, moduleName, moduleLen)) continue;
+
+			exports[j].Address = forwarded[k].Address;
+			exports[j].Module = forwarded[k].Module;
+			exports[j].Forwarded = true;
+			exports[j].Forwarder = NULL;
+			k++;
+		}
+	}
+
+	free(forwarded);
+
+	// Anything that couldn't be found or followed, like forwarders to an ordinal, is left to the loader
+	for (size_t i = 0; i < count; i++)
+	{
+		if (exports[i].Address != NULL && exports[i].Forwarder == NULL) continue;
+
+		exports[i].Address = (PVOID)GetProcAddress(module, exports[i].Name);
+		exports[i].Module = exports[i].Address == NULL ? NULL : GetContainingModule(exports[i].Address);
+		exports[i].Forwarded = exports[i].Module != NULL && exports[i].Module != module;
+		exports[i].Forwarder = NULL;
+	}
+}
+
+size_t SR_ResolveExports(HMODULE module, SR_Export* exports, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		exports[i].Address = NULL;
+		exports[i].Module = NULL;
+		exports[i].Forwarded = false;
+		exports[i].Stub = false;
+		exports[i].Forwarder = NULL;
+	}
+
+	ResolveExports(module, exports, count, 0);
+
+	size_t resolved = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (exports[i].Address == NULL) continue;
+		resolved++;
+
+		for (int depth = 0; depth < MAX_FORWARD_DEPTH; depth++)
+		{
+			PVOID target = SkipImportStub(exports[i].Address);
+			if (target == NULL) break;
+
+			exports[i].Address = target;
+			exports[i].Module = GetContainingModule(target);
+			exports[i].Stub = true;
+		}
+	}
+
+	return resolved;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <stdbool.h>
+#include <Windows.h>
+
+/*
+Export resolver
+
+Finds the addresses of many functions exported by a module in a single walk over its export table, instead of one
+GetProcAddress call, and one binary search over the export names, for each of them.
+
+The names the loader searches are sorted, so the requested names are sorted too, and both lists are walked together.
+Exports that are forwarded to another module, like most of kernel32's to kernelbase, are followed to the module that
+actually implements them, walking the export table of each of those modules once for all the functions forwarded to
+it. Forwarders the resolver can't follow, like the ones that point to an ordinal, are left to GetProcAddress.
+
+Functions that aren't forwarded may still be stubs that only jump through an import of their module, which is how
+kernel32 calls most of the kernelbase functions it doesn't forward. Those jumps are followed too, so that the address
+found is always the code that actually implements the function.
+*/
+
+// A function to find in the export table of a module
+typedef struct
+{
+	// The name the function is exported as
+	const char* Name;
+
+	// Receives the address of the code that implements the function, after following any forwarder or import stub,
+	// or NULL if the module doesn't export it
+	PVOID Address;
+	// Receives the module that implements the function, which is another module if the export was forwarded
+	HMODULE Module;
+	// Receives if the export was forwarded to another module
+	bool Forwarded;
+	// Receives if the exported function was a stub that jumps to its implementation through an import
+	bool Stub;
+
+	// The forwarder string of the export, such as "KERNELBASE.CreateFileW", while it's being followed
+	const char* Forwarder;
+
+} SR_Export;
+
+// Resolves the address of every function in a list, in a single walk over the export table of a module.
+//  exports: The functions to resolve. Their names must all be different.
+// Returns the number of functions that were resolved.
+size_t SR_ResolveExports(HMODULE module, SR_Export* exports, size_t count);
@@ -0,0 +1,221 @@
+#include "SR_Base.h"
+#include "HookStats.h"
+#include "Logging.h"
+#include "Epoch.h"
+
+#include <Windows.h>
+#include <malloc.h>
+#include <string.h>
+
+#define CACHE_LINE_SIZE 64
+
+bool SR_HookStatsEnabled = false;
+
+// Counters of a single hook in a single thread.
+// Aligned to a cache line so that the slots of different threads never share one.
+typedef __declspec(align(CACHE_LINE_SIZE)) struct
+{
+	uint64_t Calls;
+	uint64_t Redirected;
+	uint64_t Cycles;
+	uint32_t Latency[SR_HOOK_LATENCY_BUCKETS];
+
+} HookSlot;
+
+// Counters of every hook in a single thread
+typedef struct ThreadStats
+{
+	HookSlot Slots[SR_MAX_HOOKS];
+	struct ThreadStats* Next;
+
+} ThreadStats;
+
+// Every thread's counters, as a lock-free stack that is only pushed to until the statistics are freed
+static ThreadStats* volatile AllThreads = NULL;
+
+// Incremented every time the statistics are freed, so that threads know their counters are gone
+static volatile LONG Generation = 0;
+
+// The counters of the current thread, only valid if CurrentGeneration is Generation
+static __declspec(thread) ThreadStats* CurrentThread = NULL;
+static __declspec(thread) LONG CurrentGeneration = -1;
+
+static const wchar_t* HookNames[SR_MAX_HOOKS];
+static volatile LONG HookCount = 0;
+
+// Cycle and performance counters when recording started, used to convert cycles to time
+static uint64_t StartCycles = 0;
+static LARGE_INTEGER StartTime = { 0 };
+
+SR_HookId SR_RegisterHookStats(const wchar_t* name)
+{
+	LONG id = InterlockedIncrement(&HookCount) - 1;
+	if (id >= SR_MAX_HOOKS)
+	{
+		SR_WARN("Too many hooks, statistics won't be recorded for %ls", name);
+		return -1;
+	}
+
+	HookNames[id] = name;
+	return id;
+}
+
+void SR_EnableHookStats(bool enabled)
+{
+	if (enabled && !SR_HookStatsEnabled)
+	{
+		QueryPerformanceCounter(&StartTime);
+		StartCycles = __rdtsc();
+	}
+
+	SR_HookStatsEnabled = enabled;
+}
+
+// Gets the counters of the current thread, creating them if this thread didn't record anything yet.
+// Returns NULL if the counters couldn't be allocated.
+static ThreadStats* GetThreadStats()
+{
+	if (CurrentThread != NULL && CurrentGeneration == Generation) return CurrentThread;
+
+	ThreadStats* stats = _aligned_malloc(sizeof(ThreadStats), CACHE_LINE_SIZE);
+	if (stats == NULL) return NULL;
+
+	memset(stats, 0, sizeof(ThreadStats));
+
+	ThreadStats* head;
+	do
+	{
+		head = AllThreads;
+		stats->Next = head;
+	} while (InterlockedCompareExchangePointer((PVOID volatile*)&AllThreads, stats, head) != head);
+
+	CurrentThread = stats;
+	CurrentGeneration = Generation;
+
+	return stats;
+}
+
+// Finds the latency bucket of a number of cycles, which is the position of its highest set bit plus one
+static unsigned int GetBucket(uint64_t cycles)
+{
+	unsigned long index;
+	unsigned int bucket;
+
+	// _BitScanReverse64 isn't available in 32-bit builds
+	if ((cycles >> 32) != 0 && _BitScanReverse(&index, (unsigned long)(cycles >> 32)))
+		bucket = index + 33;
+	else if (_BitScanReverse(&index, (unsigned long)cycles))
+		bucket = index + 1;
+	else
+		bucket = 0;
+
+	return bucket < SR_HOOK_LATENCY_BUCKETS ? bucket : SR_HOOK_LATENCY_BUCKETS - 1;
+}
+
+void SR_RecordHookCall(SR_HookId hook, uint64_t start, bool redirected)
+{
+	uint64_t cycles = __rdtsc() - start;
+	if (hook < 0) return;
+
+	ThreadStats* stats = GetThreadStats();
+	if (stats == NULL) return;
+
+	// Only this thread writes to its slots, so there's no need for atomic operations
+	HookSlot* slot = &stats->Slots[hook];
+	slot->Calls++;
+	slot->Cycles += cycles;
+	slot->Latency[GetBucket(cycles)]++;
+
+	if (redirected) slot->Redirected++;
+}
+
+// Finds the upper bound, in cycles, of the bucket that contains a percentile of a histogram
+static uint64_t GetPercentile(const uint64_t* latency, uint64_t calls, unsigned int percentile)
+{
+	uint64_t target = (calls * percentile + 99) / 100;
+	uint64_t seen = 0;
+
+	for (unsigned int i = 0; i < SR_HOOK_LATENCY_BUCKETS; i++)
+	{
+		seen += latency[i];
+		if (seen >= target) return (uint64_t)1 << i;
+	}
+
+	return (uint64_t)1 << (SR_HOOK_LATENCY_BUCKETS - 1);
+}
+
+void SR_LogHookStats()
+{
+	if (AllThreads == NULL)
+	{
+		if (SR_HookStatsEnabled) SR_INFO("No hook statistics were recorded");
+		return;
+	}
+
+	LARGE_INTEGER now;
+	LARGE_INTEGER frequency;
+	QueryPerformanceCounter(&now);
+	QueryPerformanceFrequency(&frequency);
+
+	double elapsedNs = (double)(now.QuadPart - StartTime.QuadPart) * 1e9 / (double)frequency.QuadPart;
+	double cyclesPerNs = elapsedNs > 0 ? (double)(__rdtsc() - StartCycles) / elapsedNs : 1;
+
+	SR_INFO("Hook statistics (latency is the time spent matching paths, percentiles are upper bounds)");
+	SR_INFO("%-32ls %12ls %12ls %12ls %12ls %12ls", L"Hook", L"Calls", L"Redirected", L"Mean (ns)", L"p50 (ns)", L"p99 (ns)");
+
+	LONG hookCount = min(HookCount, SR_MAX_HOOKS);
+	for (LONG hook = 0; hook < hookCount; hook++)
+	{
+		uint64_t calls = 0;
+		uint64_t redirected = 0;
+		uint64_t cycles = 0;
+		uint64_t latency[SR_HOOK_LATENCY_BUCKETS] = { 0 };
+
+		for (const ThreadStats* stats = AllThreads; stats != NULL; stats = stats->Next)
+		{
+			const HookSlot* slot = &stats->Slots[hook];
+			calls += slot->Calls;
+			redirected += slot->Redirected;
+			cycles += slot->Cycles;
+
+			for (unsigned int i = 0; i < SR_HOOK_LATENCY_BUCKETS; i++)
+				latency[i] += slot->Latency[i];
+		}
+
+		if (calls == 0) continue;
+
+		SR_INFO(
+			"%-32ls %12llu %12llu %12.0f %12.0f %12.0f",
+			HookNames[hook],
+			calls,
+			redirected,
+			(double)cycles / (double)calls / cyclesPerNs,
+			(double)GetPercentile(latency, calls, 50) / cyclesPerNs,
+			(double)GetPercentile(latency, calls, 99) / cyclesPerNs
+		);
+	}
+}
+
+void SR_FreeHookStats(bool processExiting)
+{
+	SR_HookStatsEnabled = false;
+
+	ThreadStats* current = InterlockedExchangePointer((PVOID volatile*)&AllThreads, NULL);
+
+	// Threads that check the generation from now on will allocate new counters instead of using the ones freed below
+	InterlockedIncrement(&Generation);
+
+	// A call that was already inside a hook when it was detached may still be writing to its thread's counters.
+	// Threads that were killed when the process started exiting may never leave their epoch, and can't write anymore.
+	if (!processExiting) SR_SynchronizeEpoch();
+
+	while (current != NULL)
+	{
+		ThreadStats* next = current->Next;
+		_aligned_free(current);
+		current = next;
+	}
+
+	// Hooks will be registered again if the redirections are created again
+	InterlockedExchange(&HookCount, 0);
+}
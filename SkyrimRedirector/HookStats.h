@@ -0,0 +1,52 @@
+#pragma once
+#include <wchar.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <intrin.h>
+
+/*
+Hook statistics
+
+Counts how many times every hook ran, how many of those calls were redirected and how long matching their paths took,
+as a histogram with one bucket per power of two of CPU cycles.
+
+Every thread writes to its own block of counters, with one cache-line-aligned slot per hook, so recording a call
+needs no locks or atomic operations and threads never share cache lines. The blocks are only summed when the
+statistics are logged, after every hook is detached.
+*/
+
+// Maximum number of hooks that can be registered
+#define SR_MAX_HOOKS 64
+
+// Number of buckets in the latency histogram. Bucket N counts calls that took [2^(N-1), 2^N) cycles.
+#define SR_HOOK_LATENCY_BUCKETS 32
+
+// Identifies a registered hook
+typedef int SR_HookId;
+
+// If statistics are being recorded.
+// Read directly by the hooks so that disabled statistics cost a single predictable branch.
+extern bool SR_HookStatsEnabled;
+
+// Registers a hook, returning the ID used to record its calls.
+//  name: The name of the hook, which must outlive the statistics
+SR_HookId SR_RegisterHookStats(const wchar_t* name);
+
+// Turns recording statistics on or off
+void SR_EnableHookStats(bool enabled);
+
+// Gets the timestamp to pass to SR_RecordHookCall when a hook starts matching its paths
+static __forceinline uint64_t SR_HookStatsNow() { return __rdtsc(); }
+
+// Records a single call to a hook. Must only be called while statistics are enabled, from inside an epoch (see Epoch.h).
+//  hook: The hook that was called
+//  start: The value of SR_HookStatsNow when the hook started matching its paths
+//  redirected: If the hook redirected its path
+void SR_RecordHookCall(SR_HookId hook, uint64_t start, bool redirected);
+
+// Writes a table with the statistics of every hook that was called to the log
+void SR_LogHookStats();
+
+// Frees the statistics of every thread, once no hook can still be recording a call.
+//  processExiting: If the process is exiting, in which case every other thread is already gone and isn't waited for
+void SR_FreeHookStats(bool processExiting);
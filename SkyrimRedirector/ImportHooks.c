@@ -0,0 +1,133 @@
+#include "SR_Base.h"
+#include "ImportHooks.h"
+#include "Logging.h"
+#include "CaseFold.h"
+
+#include <stdbool.h>
+#include <Windows.h>
+#include "..\Detours\detours.h"
+
+// State of a walk over the game's imports
+typedef struct
+{
+	SR_Redirection* Redirections;
+
+	// If the functions being enumerated are imported from kernel32
+	bool FromKernel32;
+
+	// Number of hooks installed so far
+	size_t Attached;
+
+} ImportWalk;
+
+// Checks if an imported DLL is kernel32, either directly or through one of the API sets it implements
+static bool IsKernel32File(const char* file)
+{
+	if (SR_FoldedEqualsA(file, "KERNEL32.DLL")) return true;
+
+	const char* apiSet = "API-MS-WIN-";
+	for (size_t i = 0; apiSet[i] != '\0'; i++)
+	{
+		if (SR_FoldCharA(file[i]) != apiSet[i]) return false;
+	}
+
+	return true;
+}
+
+// Checks if the name of a redirection, in wide characters, is the same as an imported function name
+static bool IsImportName(const wchar_t* name, const char* import)
+{
+	for (; *name != L'\0' && *import != '\0'; name++, import++)
+	{
+		if (*name != (unsigned char)*import) return false;
+	}
+
+	return *name == L'\0' && *import == '\0';
+}
+
+// Replaces the value of an import slot. The import table is read-only, so it's made writable while it's changed.
+//  expected: The value the slot must have to be replaced, or NULL to replace any value
+// Returns the previous value of the slot, or NULL if it couldn't be changed.
+static PVOID SwapImportSlot(PVOID* slot, PVOID value, PVOID expected)
+{
+	DWORD protection;
+	if (!VirtualProtect(slot, sizeof(PVOID), PAGE_READWRITE, &protection)) return NULL;
+
+	PVOID previous = expected == NULL
+		? InterlockedExchangePointer(slot, value)
+		: InterlockedCompareExchangePointer(slot, value, expected);
+
+	VirtualProtect(slot, sizeof(PVOID), protection, &protection);
+	return previous;
+}
+
+static BOOL CALLBACK OnImportFile(PVOID context, HMODULE module, LPCSTR file)
+{
+	(void)module;
+
+	ImportWalk* walk = context;
+	walk->FromKernel32 = file != NULL && IsKernel32File(file);
+
+	return TRUE;
+}
+
+static BOOL CALLBACK OnImportFunction(PVOID context, DWORD ordinal, LPCSTR name, PVOID* slot)
+{
+	(void)ordinal;
+
+	ImportWalk* walk = context;
+	if (!walk->FromKernel32 || name == NULL || slot == NULL) return TRUE;
+
+	for (SR_Redirection* current = walk->Redirections; current != NULL; current = current->Next)
+	{
+		// A function imported twice, e.g. from kernel32 and an API set, is only hooked at its first import
+		if (current->Mode != SR_HOOK_IMPORT || current->ImportSlot != NULL || !IsImportName(current->Name, name))
+			continue;
+
+		PVOID original = SwapImportSlot(slot, current->Redirected, NULL);
+		if (original == NULL)
+		{
+			SR_ERROR("Unable to write the game's import of %ls (error %lu)", current->Name, GetLastError());
+			return TRUE;
+		}
+
+		*current->Original = original;
+		current->ImportSlot = slot;
+		walk->Attached++;
+
+		SR_TRACE("Attached %ls to the game's imports", current->Name);
+		return TRUE;
+	}
+
+	return TRUE;
+}
+
+size_t SR_AttachImportHooks(SR_Redirection* redirections)
+{
+	bool anyImport = false;
+	for (SR_Redirection* current = redirections; current != NULL; current = current->Next)
+		anyImport |= current->Mode == SR_HOOK_IMPORT;
+
+	if (!anyImport) return 0;
+
+	ImportWalk walk = { redirections, false, 0 };
+	if (!DetourEnumerateImportsEx(GetModuleHandleW(NULL), &walk, OnImportFile, OnImportFunction))
+		SR_ERROR("Unable to read the game's imports (error %lu)", GetLastError());
+
+	return walk.Attached;
+}
+
+void SR_DetachImportHooks(SR_Redirection* redirections)
+{
+	for (SR_Redirection* current = redirections; current != NULL; current = current->Next)
+	{
+		if (current->ImportSlot == NULL) continue;
+
+		// Something else may have hooked the import after us, in which case it's left pointing at that
+		if (SwapImportSlot(current->ImportSlot, *current->Original, current->Redirected) != current->Redirected)
+			SR_WARN("The game's import of %ls was changed by something else, leaving it as it is", current->Name);
+
+		current->ImportSlot = NULL;
+		SR_TRACE("Detached %ls from the game's imports", current->Name);
+	}
+}
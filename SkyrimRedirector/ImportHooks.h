@@ -0,0 +1,26 @@
+#pragma once
+#include "Redirections.h"
+
+/*
+Import hooks
+
+Installs hooks by rewriting the game executable's import address table instead of the first instructions of the
+hooked functions. The game calls every kernel32 function through its import slot, so pointing the slot at the hook
+sends those calls straight to it: there's no jump into a trampoline on every call, and nothing has to be disassembled,
+relocated or allocated near the function when attaching. Each slot is a single pointer, written atomically, so no
+thread has to be suspended either.
+
+Only the calls the game executable makes through its imports go through these hooks. Calls from other modules, like
+SKSE and other plugins, or through addresses found with GetProcAddress, still reach the original function directly.
+
+The imports are found with DetourEnumerateImportsEx, in a single walk over the executable's import table.
+*/
+
+// Installs every redirection whose Mode is SR_HOOK_IMPORT in the game executable's imports.
+// The original function of each hook is set to what its import pointed to, and ImportSlot is set to the import.
+// Redirections the game doesn't import are left without an ImportSlot, and must be attached inline instead.
+// Returns the number of hooks installed.
+size_t SR_AttachImportHooks(SR_Redirection* redirections);
+
+// Points the imports of every redirection with an ImportSlot back to their original functions
+void SR_DetachImportHooks(SR_Redirection* redirections);
@@ -0,0 +1,886 @@
+#include "SR_Base.h"
+#include "IniCache.h"
+#include "IniFile.h"
+#include "Logging.h"
+#include "WindowsUtils.h"
+#include "Redirections.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Largest file that is read into memory. Calls for bigger files are left to Windows.
+#define MAX_FILE_SIZE (16 * 1024 * 1024)
+
+// Size, in characters, of the stack buffers the arguments of the ANSI functions are converted into.
+// Calls with longer arguments are left to Windows.
+#define ARGUMENT_BUFFER_SIZE 256
+
+// Size, in characters, of the stack buffer the ANSI functions read into before converting the result.
+// Only calls with bigger buffers need to allocate memory.
+#define RESULT_BUFFER_SIZE 1024
+
+// Time, in milliseconds, without any write after which changes are written to the file.
+// The game writes every setting with a separate call, so this makes each save write the file once.
+#define FLUSH_DELAY 1000
+
+// Appended to the path of a file to get the temporary file its changes are written to
+#define TEMPORARY_SUFFIX L".tmp"
+
+struct SR_IniCache
+{
+	// Path of the file, as passed to SR_GetIniCache
+	wchar_t* Path;
+	// Canonical path of the file, used to share the cache between every path that refers to it
+	wchar_t* CanonicalPath;
+
+	// Taken shared while reading Ini, and exclusively to replace it
+	SRWLOCK Lock;
+	// The in-memory copy of the file, or NULL if it wasn't read yet
+	SR_IniFile* Ini;
+	// The encoding the file was read in
+	SR_IniEncoding Encoding;
+	// If calls for the file must always be left to Windows
+	volatile bool Disabled;
+
+	// If Ini has changes that weren't written to the file yet. Only set while holding Lock exclusively.
+	volatile LONG Dirty;
+	// Number of changes that weren't written to the file yet, only used for logging
+	volatile LONG PendingWrites;
+
+	struct SR_IniCache* Next;
+};
+
+// Every cache. New caches are only added at the head, by the thread that creates or reloads the redirections, so it
+// can be walked from any thread without locks. Caches are only removed when the redirections are freed.
+static SR_IniCache* volatile Caches = NULL;
+
+// Writes changes to the files after FLUSH_DELAY, created at the first write
+static PTP_TIMER FlushTimer = NULL;
+// Set once the changes were written for the last time, so that no other write is scheduled
+static volatile bool FlushStopped = false;
+// Held while writing any file, so that an older copy can never be written over a newer one
+static SRWLOCK FlushLock = SRWLOCK_INIT;
+
+SR_IniCache* SR_GetIniCache(const wchar_t* path)
+{
+	wchar_t* canonical = SR_CanonicizePathW(path);
+
+	for (SR_IniCache* cache = Caches; cache != NULL; cache = cache->Next)
+	{
+		if (wcscmp(cache->CanonicalPath, canonical) == 0)
+		{
+			free(canonical);
+			return cache;
+		}
+	}
+
+	SR_IniCache* cache = calloc(1, sizeof(SR_IniCache));
+	cache->Path = _wcsdup(path);
+	cache->CanonicalPath = canonical;
+	InitializeSRWLock(&cache->Lock);
+
+	// The cache is complete before it's published, in case the flush timer is walking the list
+	cache->Next = Caches;
+	InterlockedExchangePointer((PVOID volatile*)&Caches, cache);
+
+	return cache;
+}
+
+// Decodes and parses the contents of a file the same way Windows does:
+// UTF-16 if it starts with a byte order mark, UTF-8 if it starts with the UTF-8 one, and the ANSI codepage otherwise.
+// Returns NULL if the file couldn't be decoded.
+static SR_IniFile* DecodeIni(const unsigned char* bytes, DWORD count, SR_IniEncoding* encoding)
+{
+	*encoding = SR_INI_ENCODING_ANSI;
+
+	if (count >= 2 && bytes[0] == 0xFF && bytes[1] == 0xFE)
+	{
+		*encoding = SR_INI_ENCODING_UTF16LE;
+		return SR_ParseIni((const wchar_t*)(bytes + 2), (count - 2) / sizeof(wchar_t));
+	}
+
+	if (count >= 2 && bytes[0] == 0xFE && bytes[1] == 0xFF)
+	{
+		*encoding = SR_INI_ENCODING_UTF16BE;
+
+		size_t len = (count - 2) / sizeof(wchar_t);
+		wchar_t* text = malloc(max(len, 1) * sizeof(wchar_t));
+		if (text == NULL) return NULL;
+
+		for (size_t i = 0; i < len; i++)
+			text[i] = (wchar_t)((bytes[2 + i * 2] << 8) | bytes[3 + i * 2]);
+
+		SR_IniFile* ini = SR_ParseIni(text, len);
+		free(text);
+		return ini;
+	}
+
+	UINT codepage = CP_ACP;
+	if (count >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF)
+	{
+		codepage = CP_UTF8;
+		*encoding = SR_INI_ENCODING_UTF8;
+		bytes += 3;
+		count -= 3;
+	}
+
+	if (count == 0) return SR_ParseIni(L"", 0);
+
+	int len = MultiByteToWideChar(codepage, 0, (LPCCH)bytes, count, NULL, 0);
+	if (len == 0) return NULL;
+
+	wchar_t* text = malloc(len * sizeof(wchar_t));
+	if (text == NULL) return NULL;
+
+	MultiByteToWideChar(codepage, 0, (LPCCH)bytes, count, text, len);
+
+	SR_IniFile* ini = SR_ParseIni(text, len);
+	free(text);
+	return ini;
+}
+
+// Reads a whole file into memory.
+// A file that doesn't exist is read as an empty file, the same way Windows does.
+// Returns NULL if the file couldn't be read.
+//  encoding: Receives the encoding of the file. Files that don't exist use the ANSI codepage, like Windows creates them.
+static SR_IniFile* ReadIni(const wchar_t* path, SR_IniEncoding* encoding)
+{
+	*encoding = SR_INI_ENCODING_ANSI;
+
+	HANDLE file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		DWORD error = GetLastError();
+		if (error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND) return SR_ParseIni(L"", 0);
+
+		SR_DEBUG("Unable to read '%ls' into memory (error %lu)", path, error);
+		return NULL;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart > MAX_FILE_SIZE)
+	{
+		CloseHandle(file);
+		return NULL;
+	}
+
+	DWORD count = (DWORD)size.QuadPart;
+	unsigned char* bytes = malloc(max(count, 1));
+	if (bytes == NULL)
+	{
+		CloseHandle(file);
+		return NULL;
+	}
+
+	DWORD read = 0;
+	BOOL succeeded = ReadFile(file, bytes, count, &read, NULL);
+	CloseHandle(file);
+
+	SR_IniFile* ini = succeeded ? DecodeIni(bytes, read, encoding) : NULL;
+	free(bytes);
+
+	return ini;
+}
+
+// Reads a file into memory if it wasn't read yet. Must be called while holding the lock exclusively.
+static void LoadIni(SR_IniCache* cache)
+{
+	if (cache->Ini != NULL || cache->Disabled) return;
+
+	SR_EnterRedirector();
+	cache->Ini = ReadIni(cache->Path, &cache->Encoding);
+	SR_LeaveRedirector();
+
+	if (cache->Ini != NULL) SR_DEBUG("Read '%ls' into memory", cache->Path);
+}
+
+// Encodes text in the same encoding the file was read in, with the same byte order mark.
+// Returns NULL if the text couldn't be encoded. Otherwise, the returned buffer must be freed.
+static unsigned char* EncodeIni(const wchar_t* text, size_t len, SR_IniEncoding encoding, DWORD* count)
+{
+	if (encoding == SR_INI_ENCODING_UTF16LE || encoding == SR_INI_ENCODING_UTF16BE)
+	{
+		*count = (DWORD)((len + 1) * sizeof(wchar_t));
+		unsigned char* bytes = malloc(*count);
+		if (bytes == NULL) return NULL;
+
+		bytes[0] = 0xFF;
+		bytes[1] = 0xFE;
+		memcpy(bytes + 2, text, len * sizeof(wchar_t));
+
+		if (encoding == SR_INI_ENCODING_UTF16BE)
+		{
+			for (DWORD i = 0; i < *count; i += 2)
+			{
+				unsigned char low = bytes[i];
+				bytes[i] = bytes[i + 1];
+				bytes[i + 1] = low;
+			}
+		}
+
+		return bytes;
+	}
+
+	UINT codepage = encoding == SR_INI_ENCODING_UTF8 ? CP_UTF8 : CP_ACP;
+	DWORD prefix = encoding == SR_INI_ENCODING_UTF8 ? 3 : 0;
+
+	int encodedLen = len > 0 ? WideCharToMultiByte(codepage, 0, text, (int)len, NULL, 0, NULL, NULL) : 0;
+	if (len > 0 && encodedLen == 0) return NULL;
+
+	*count = prefix + encodedLen;
+	unsigned char* bytes = malloc(max(*count, 1));
+	if (bytes == NULL) return NULL;
+
+	if (encoding == SR_INI_ENCODING_UTF8)
+	{
+		bytes[0] = 0xEF;
+		bytes[1] = 0xBB;
+		bytes[2] = 0xBF;
+	}
+
+	if (len > 0) WideCharToMultiByte(codepage, 0, text, (int)len, (LPSTR)(bytes + prefix), encodedLen, NULL, NULL);
+	return bytes;
+}
+
+// Replaces the contents of a file without ever leaving it half-written.
+// The contents are written to a temporary file next to it, which then replaces the file in a single step.
+// ReplaceFile keeps the attributes and the security of the file, and fails if the file is read-only, like Windows does.
+static bool ReplaceContents(const wchar_t* path, const unsigned char* bytes, DWORD count)
+{
+	size_t pathLen = wcslen(path);
+	size_t suffixLen = wcslen(TEMPORARY_SUFFIX);
+
+	wchar_t* temporary = malloc((pathLen + suffixLen + 1) * sizeof(wchar_t));
+	if (temporary == NULL) return false;
+
+	wmemcpy(temporary, path, pathLen);
+	wmemcpy(temporary + pathLen, TEMPORARY_SUFFIX, suffixLen + 1);
+
+	bool succeeded = false;
+	HANDLE file = CreateFileW(temporary, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file != INVALID_HANDLE_VALUE)
+	{
+		DWORD written = 0;
+		succeeded = WriteFile(file, bytes, count, &written, NULL) && written == count && FlushFileBuffers(file);
+		CloseHandle(file);
+
+		if (succeeded)
+		{
+			succeeded = ReplaceFileW(path, temporary, NULL, REPLACEFILE_IGNORE_MERGE_ERRORS | REPLACEFILE_IGNORE_ACL_ERRORS, NULL, NULL);
+
+			// There's nothing to keep if the file doesn't exist yet
+			if (!succeeded && GetLastError() == ERROR_FILE_NOT_FOUND)
+				succeeded = MoveFileExW(temporary, path, MOVEFILE_WRITE_THROUGH);
+		}
+
+		if (!succeeded)
+		{
+			DWORD error = GetLastError();
+			DeleteFileW(temporary);
+			SetLastError(error);
+		}
+	}
+
+	free(temporary);
+	return succeeded;
+}
+
+SR_IniFile* SR_ReadIniFile(const wchar_t* path, SR_IniEncoding* encoding)
+{
+	SR_EnterRedirector();
+	SR_IniFile* ini = ReadIni(path, encoding);
+	SR_LeaveRedirector();
+
+	return ini;
+}
+
+bool SR_WriteIniFile(const wchar_t* path, const SR_IniFile* ini, SR_IniEncoding encoding)
+{
+	size_t len;
+	wchar_t* text = SR_FormatIni(ini, &len);
+
+	DWORD count;
+	unsigned char* bytes = EncodeIni(text, len, encoding, &count);
+	free(text);
+
+	SR_EnterRedirector();
+	bool succeeded = bytes != NULL && ReplaceContents(path, bytes, count);
+	SR_LeaveRedirector();
+
+	free(bytes);
+
+	return succeeded;
+}
+
+// Writes the changes of the in-memory copy of a file to the file, if there are any.
+//  wait: If the locks can be waited for. Only false while the process is exiting, when the threads that held them may
+//        have been terminated and would never release them.
+static void FlushCache(SR_IniCache* cache, bool wait)
+{
+	// The timer clears Dirty before it writes the file, so callers that wait take FlushLock even for a file without
+	// changes, to make sure a write in progress is done before they use the file
+	if (cache->Dirty == 0 && !wait) return;
+
+	if (wait) AcquireSRWLockExclusive(&FlushLock);
+	else if (!TryAcquireSRWLockExclusive(&FlushLock)) return;
+
+	if (wait) AcquireSRWLockShared(&cache->Lock);
+	else if (!TryAcquireSRWLockShared(&cache->Lock))
+	{
+		ReleaseSRWLockExclusive(&FlushLock);
+		return;
+	}
+
+	// Take a copy of the text and write it without holding the file's lock, so that calls can still be answered
+	wchar_t* text = NULL;
+	size_t len = 0;
+	LONG writes = 0;
+	if (InterlockedExchange(&cache->Dirty, 0) != 0 && cache->Ini != NULL)
+	{
+		text = SR_FormatIni(cache->Ini, &len);
+		writes = InterlockedExchange(&cache->PendingWrites, 0);
+	}
+
+	SR_IniEncoding encoding = cache->Encoding;
+	ReleaseSRWLockShared(&cache->Lock);
+
+	if (text != NULL)
+	{
+		DWORD count;
+		unsigned char* bytes = EncodeIni(text, len, encoding, &count);
+		free(text);
+
+		SR_EnterRedirector();
+		bool written = bytes != NULL && ReplaceContents(cache->Path, bytes, count);
+		SR_LeaveRedirector();
+
+		if (written)
+		{
+			SR_DEBUG("Wrote %ld changes to '%ls'", writes, cache->Path);
+		}
+		else
+		{
+			SR_ERROR("Unable to write %ld changes to '%ls' (error %lu), trying again at the next change", writes, cache->Path, GetLastError());
+			InterlockedExchangeAdd(&cache->PendingWrites, writes);
+			InterlockedExchange(&cache->Dirty, 1);
+		}
+
+		free(bytes);
+	}
+
+	ReleaseSRWLockExclusive(&FlushLock);
+}
+
+// Writes the changes of every file, called by FlushTimer
+static VOID CALLBACK FlushTimerCallback(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_TIMER timer)
+{
+	(void)instance;
+	(void)context;
+	(void)timer;
+
+	for (SR_IniCache* cache = Caches; cache != NULL; cache = cache->Next)
+		FlushCache(cache, true);
+}
+
+// Writes the changes to the files once FLUSH_DELAY passes without any other change
+static void ScheduleFlush()
+{
+	if (FlushStopped) return;
+
+	PTP_TIMER timer = FlushTimer;
+	if (timer == NULL)
+	{
+		timer = CreateThreadpoolTimer(FlushTimerCallback, NULL, NULL);
+		if (timer == NULL)
+		{
+			SR_ERROR("Unable to create the timer that writes .ini files, changes will only be written when the plugin is unloaded");
+			return;
+		}
+
+		PTP_TIMER existing = InterlockedCompareExchangePointer((PVOID volatile*)&FlushTimer, timer, NULL);
+		if (existing != NULL)
+		{
+			CloseThreadpoolTimer(timer);
+			timer = existing;
+		}
+	}
+
+	// A negative due time is relative, in 100 nanosecond units. Setting it again pushes back the pending flush.
+	ULARGE_INTEGER due;
+	due.QuadPart = (ULONGLONG)(-(LONGLONG)FLUSH_DELAY * 10000);
+
+	FILETIME dueTime;
+	dueTime.dwLowDateTime = due.LowPart;
+	dueTime.dwHighDateTime = due.HighPart;
+
+	SetThreadpoolTimer(timer, &dueTime, 0, 0);
+}
+
+// Gets the in-memory copy of a file, reading the file if needed, and locks it for reading.
+// Returns NULL if calls for the file must be left to Windows, in which case nothing is locked.
+// Otherwise, ReleaseIni must be called when done.
+static const SR_IniFile* AcquireIni(SR_IniCache* cache)
+{
+	if (cache->Disabled) return NULL;
+
+	AcquireSRWLockShared(&cache->Lock);
+	if (cache->Ini != NULL) return cache->Ini;
+	ReleaseSRWLockShared(&cache->Lock);
+
+	// Read the file while holding the lock exclusively, so that only one thread reads it
+	AcquireSRWLockExclusive(&cache->Lock);
+	LoadIni(cache);
+	ReleaseSRWLockExclusive(&cache->Lock);
+
+	// SRW locks can't be downgraded, so take it again. If the copy was discarded in the meantime, leave the call to Windows.
+	AcquireSRWLockShared(&cache->Lock);
+	if (cache->Ini != NULL) return cache->Ini;
+	ReleaseSRWLockShared(&cache->Lock);
+
+	return NULL;
+}
+
+// Unlocks the in-memory copy of a file returned by AcquireIni
+static void ReleaseIni(SR_IniCache* cache)
+{
+	ReleaseSRWLockShared(&cache->Lock);
+}
+
+// Checks if a file exists and is read-only
+static bool IsReadOnly(const wchar_t* path)
+{
+	SR_EnterRedirector();
+	DWORD attributes = GetFileAttributesW(path);
+	SR_LeaveRedirector();
+
+	return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_READONLY) != 0;
+}
+
+// Gets the in-memory copy of a file, reading the file if needed, and locks it for writing.
+// Returns NULL if calls for the file must be left to Windows, in which case nothing is locked.
+// Otherwise, ReleaseWrittenIni must be called when done.
+static SR_IniFile* AcquireIniForWriting(SR_IniCache* cache)
+{
+	if (cache->Disabled) return NULL;
+
+	// Windows fails to write a read-only file, which a change made in memory would only report once it's written
+	if (IsReadOnly(cache->Path)) return NULL;
+
+	AcquireSRWLockExclusive(&cache->Lock);
+	LoadIni(cache);
+	if (cache->Ini != NULL) return cache->Ini;
+	ReleaseSRWLockExclusive(&cache->Lock);
+
+	return NULL;
+}
+
+// Unlocks the in-memory copy of a file returned by AcquireIniForWriting, scheduling a flush if it was changed
+static void ReleaseWrittenIni(SR_IniCache* cache, bool changed)
+{
+	if (changed)
+	{
+		InterlockedIncrement(&cache->PendingWrites);
+		InterlockedExchange(&cache->Dirty, 1);
+	}
+
+	ReleaseSRWLockExclusive(&cache->Lock);
+
+	if (changed) ScheduleFlush();
+}
+
+void SR_FlushIniCache(SR_IniCache* cache)
+{
+	FlushCache(cache, true);
+}
+
+void SR_FlushIniCaches(bool processExiting)
+{
+	FlushStopped = true;
+
+	PTP_TIMER timer = InterlockedExchangePointer((PVOID volatile*)&FlushTimer, NULL);
+	if (timer != NULL)
+	{
+		SetThreadpoolTimer(timer, NULL, 0, 0);
+
+		// When the process is exiting, the threadpool threads were already terminated, so there's nothing to wait for
+		if (!processExiting)
+		{
+			WaitForThreadpoolTimerCallbacks(timer, TRUE);
+			CloseThreadpoolTimer(timer);
+		}
+	}
+
+	for (SR_IniCache* cache = Caches; cache != NULL; cache = cache->Next)
+		FlushCache(cache, !processExiting);
+}
+
+void SR_InvalidateIniCache(SR_IniCache* cache)
+{
+	AcquireSRWLockExclusive(&cache->Lock);
+	SR_FreeIni(cache->Ini);
+	cache->Ini = NULL;
+	cache->Dirty = 0;
+	cache->PendingWrites = 0;
+	ReleaseSRWLockExclusive(&cache->Lock);
+}
+
+void SR_DiscardIniCache(SR_IniCache* cache)
+{
+	// A write in progress would otherwise put the file back after it's deleted
+	AcquireSRWLockExclusive(&FlushLock);
+	SR_InvalidateIniCache(cache);
+	ReleaseSRWLockExclusive(&FlushLock);
+}
+
+void SR_DisableIniCache(SR_IniCache* cache)
+{
+	if (cache->Disabled) return;
+
+	// Changes that weren't written yet must be in the file before it's written directly
+	AcquireSRWLockExclusive(&cache->Lock);
+	cache->Disabled = true;
+	ReleaseSRWLockExclusive(&cache->Lock);
+
+	FlushCache(cache, true);
+
+	AcquireSRWLockExclusive(&cache->Lock);
+	SR_FreeIni(cache->Ini);
+	cache->Ini = NULL;
+	ReleaseSRWLockExclusive(&cache->Lock);
+
+	SR_INFO("'%ls' was opened to be written directly, it won't be kept in memory anymore", cache->Path);
+}
+
+void SR_FreeIniCaches()
+{
+	while (Caches != NULL)
+	{
+		SR_IniCache* next = Caches->Next;
+
+		SR_FreeIni(Caches->Ini);
+		free(Caches->Path);
+		free(Caches->CanonicalPath);
+		free(Caches);
+
+		Caches = next;
+	}
+}
+
+// Converts an argument of an ANSI function into a stack buffer of ARGUMENT_BUFFER_SIZE characters.
+// NULL arguments stay NULL. Returns false if the argument doesn't fit in the buffer.
+static bool WidenArgument(const char* argument, wchar_t* buffer, const wchar_t** widened)
+{
+	if (argument == NULL)
+	{
+		*widened = NULL;
+		return true;
+	}
+
+	*widened = buffer;
+	return MultiByteToWideChar(CP_ACP, 0, argument, -1, buffer, ARGUMENT_BUFFER_SIZE) != 0;
+}
+
+// Gets a buffer for the wide result of an ANSI function, using `stackBuffer` if the result fits in it.
+// If the returned pointer is not `stackBuffer`, it must be freed.
+static wchar_t* GetResultBuffer(wchar_t* stackBuffer, DWORD size)
+{
+	if (size <= RESULT_BUFFER_SIZE) return stackBuffer;
+	return malloc(size * sizeof(wchar_t));
+}
+
+// Converts a single string read from memory to the ANSI codepage, the same way the ANSI functions do.
+//  size: The size of `buffer`, which can't be 0
+// Returns the length of the converted string.
+static DWORD NarrowString(const wchar_t* wide, size_t wideLen, char* buffer, DWORD size)
+{
+	int len = 0;
+	if (wideLen > 0 && size > 1)
+	{
+		len = WideCharToMultiByte(CP_ACP, 0, wide, (int)wideLen, buffer, size - 1, NULL, NULL);
+
+		// The string grew past the buffer, e.g. because of double-byte characters, so keep as much of it as fits
+		if (len == 0) len = size - 1;
+	}
+
+	buffer[len] = '\0';
+	return len;
+}
+
+// Converts a list of null-terminated strings read from memory to the ANSI codepage, the same way the ANSI functions do.
+//  size: The size of `buffer`, which can't be 0
+// Returns the length of the converted list, not counting its final null terminator.
+static DWORD NarrowList(const wchar_t* wide, size_t wideLen, char* buffer, DWORD size)
+{
+	// Convert the null terminator of the last string too
+	int len = WideCharToMultiByte(CP_ACP, 0, wide, (int)wideLen + 1, buffer, size, NULL, NULL);
+	if (len > 0)
+	{
+		// Lists that were truncated only have the last string's null terminator up to here
+		if ((DWORD)len < size) buffer[len] = '\0';
+		return len - 1;
+	}
+
+	// The list grew past the buffer, so truncate it the same way as the wide functions
+	if (size < 2)
+	{
+		buffer[0] = '\0';
+		return 0;
+	}
+
+	buffer[size - 2] = '\0';
+	buffer[size - 1] = '\0';
+	return size - 2;
+}
+
+bool SR_CachedGetPrivateProfileStringA(SR_IniCache* cache, LPCSTR lpAppName, LPCSTR lpKeyName, LPCSTR lpDefault, LPSTR lpReturnedString, DWORD nSize, DWORD* result)
+{
+	if (lpReturnedString == NULL || nSize == 0) return false;
+
+	wchar_t appBuffer[ARGUMENT_BUFFER_SIZE], keyBuffer[ARGUMENT_BUFFER_SIZE], defaultBuffer[ARGUMENT_BUFFER_SIZE];
+	const wchar_t* app;
+	const wchar_t* key;
+	const wchar_t* def;
+	if (!WidenArgument(lpAppName, appBuffer, &app) || !WidenArgument(lpKeyName, keyBuffer, &key) || !WidenArgument(lpDefault, defaultBuffer, &def))
+		return false;
+
+	wchar_t stackBuffer[RESULT_BUFFER_SIZE];
+	wchar_t* wide = GetResultBuffer(stackBuffer, nSize);
+	if (wide == NULL) return false;
+
+	const SR_IniFile* ini = AcquireIni(cache);
+	if (ini != NULL)
+	{
+		size_t wideLen = SR_GetIniString(ini, app, key, def, wide, nSize);
+		ReleaseIni(cache);
+
+		// Without a section or a key, the result is a list of names
+		if (app == NULL || key == NULL)
+			*result = NarrowList(wide, wideLen, lpReturnedString, nSize);
+		else
+			*result = NarrowString(wide, wideLen, lpReturnedString, nSize);
+	}
+
+	if (wide != stackBuffer) free(wide);
+	return ini != NULL;
+}
+
+bool SR_CachedGetPrivateProfileStringW(SR_IniCache* cache, LPCWSTR lpAppName, LPCWSTR lpKeyName, LPCWSTR lpDefault, LPWSTR lpReturnedString, DWORD nSize, DWORD* result)
+{
+	if (lpReturnedString == NULL || nSize == 0) return false;
+
+	const SR_IniFile* ini = AcquireIni(cache);
+	if (ini == NULL) return false;
+
+	*result = (DWORD)SR_GetIniString(ini, lpAppName, lpKeyName, lpDefault, lpReturnedString, nSize);
+
+	ReleaseIni(cache);
+	return true;
+}
+
+bool SR_CachedGetPrivateProfileIntA(SR_IniCache* cache, LPCSTR lpAppName, LPCSTR lpKeyName, INT nDefault, UINT* result)
+{
+	wchar_t appBuffer[ARGUMENT_BUFFER_SIZE], keyBuffer[ARGUMENT_BUFFER_SIZE];
+	const wchar_t* app;
+	const wchar_t* key;
+	if (!WidenArgument(lpAppName, appBuffer, &app) || !WidenArgument(lpKeyName, keyBuffer, &key))
+		return false;
+
+	return SR_CachedGetPrivateProfileIntW(cache, app, key, nDefault, result);
+}
+
+bool SR_CachedGetPrivateProfileIntW(SR_IniCache* cache, LPCWSTR lpAppName, LPCWSTR lpKeyName, INT nDefault, UINT* result)
+{
+	const SR_IniFile* ini = AcquireIni(cache);
+	if (ini == NULL) return false;
+
+	*result = SR_GetIniInt(ini, lpAppName, lpKeyName, nDefault);
+
+	ReleaseIni(cache);
+	return true;
+}
+
+bool SR_CachedGetPrivateProfileSectionA(SR_IniCache* cache, LPCSTR lpAppName, LPSTR lpReturnedString, DWORD nSize, DWORD* result)
+{
+	if (lpAppName == NULL || lpReturnedString == NULL || nSize == 0) return false;
+
+	wchar_t appBuffer[ARGUMENT_BUFFER_SIZE];
+	const wchar_t* app;
+	if (!WidenArgument(lpAppName, appBuffer, &app)) return false;
+
+	wchar_t stackBuffer[RESULT_BUFFER_SIZE];
+	wchar_t* wide = GetResultBuffer(stackBuffer, nSize);
+	if (wide == NULL) return false;
+
+	const SR_IniFile* ini = AcquireIni(cache);
+	if (ini != NULL)
+	{
+		size_t wideLen = SR_GetIniSection(ini, app, wide, nSize);
+		ReleaseIni(cache);
+
+		*result = NarrowList(wide, wideLen, lpReturnedString, nSize);
+	}
+
+	if (wide != stackBuffer) free(wide);
+	return ini != NULL;
+}
+
+bool SR_CachedGetPrivateProfileSectionW(SR_IniCache* cache, LPCWSTR lpAppName, LPWSTR lpReturnedString, DWORD nSize, DWORD* result)
+{
+	if (lpAppName == NULL || lpReturnedString == NULL || nSize == 0) return false;
+
+	const SR_IniFile* ini = AcquireIni(cache);
+	if (ini == NULL) return false;
+
+	*result = (DWORD)SR_GetIniSection(ini, lpAppName, lpReturnedString, nSize);
+
+	ReleaseIni(cache);
+	return true;
+}
+
+bool SR_CachedGetPrivateProfileSectionNamesA(SR_IniCache* cache, LPSTR lpszReturnBuffer, DWORD nSize, DWORD* result)
+{
+	if (lpszReturnBuffer == NULL || nSize == 0) return false;
+
+	wchar_t stackBuffer[RESULT_BUFFER_SIZE];
+	wchar_t* wide = GetResultBuffer(stackBuffer, nSize);
+	if (wide == NULL) return false;
+
+	const SR_IniFile* ini = AcquireIni(cache);
+	if (ini != NULL)
+	{
+		size_t wideLen = SR_GetIniSectionNames(ini, wide, nSize);
+		ReleaseIni(cache);
+
+		*result = NarrowList(wide, wideLen, lpszReturnBuffer, nSize);
+	}
+
+	if (wide != stackBuffer) free(wide);
+	return ini != NULL;
+}
+
+bool SR_CachedGetPrivateProfileSectionNamesW(SR_IniCache* cache, LPWSTR lpszReturnBuffer, DWORD nSize, DWORD* result)
+{
+	if (lpszReturnBuffer == NULL || nSize == 0) return false;
+
+	const SR_IniFile* ini = AcquireIni(cache);
+	if (ini == NULL) return false;
+
+	*result = (DWORD)SR_GetIniSectionNames(ini, lpszReturnBuffer, nSize);
+
+	ReleaseIni(cache);
+	return true;
+}
+
+bool SR_CachedGetPrivateProfileStructA(SR_IniCache* cache, LPCSTR lpszSection, LPCSTR lpszKey, LPVOID lpStruct, UINT uSizeStruct, BOOL* result)
+{
+	wchar_t sectionBuffer[ARGUMENT_BUFFER_SIZE], keyBuffer[ARGUMENT_BUFFER_SIZE];
+	const wchar_t* section;
+	const wchar_t* key;
+	if (!WidenArgument(lpszSection, sectionBuffer, &section) || !WidenArgument(lpszKey, keyBuffer, &key))
+		return false;
+
+	return SR_CachedGetPrivateProfileStructW(cache, section, key, lpStruct, uSizeStruct, result);
+}
+
+bool SR_CachedGetPrivateProfileStructW(SR_IniCache* cache, LPCWSTR lpszSection, LPCWSTR lpszKey, LPVOID lpStruct, UINT uSizeStruct, BOOL* result)
+{
+	if (lpszSection == NULL || lpszKey == NULL || lpStruct == NULL) return false;
+
+	const SR_IniFile* ini = AcquireIni(cache);
+	if (ini == NULL) return false;
+
+	*result = SR_GetIniStruct(ini, lpszSection, lpszKey, lpStruct, uSizeStruct);
+
+	ReleaseIni(cache);
+	return true;
+}
+
+bool SR_CachedWritePrivateProfileStringA(SR_IniCache* cache, LPCSTR lpAppName, LPCSTR lpKeyName, LPCSTR lpString, BOOL* result)
+{
+	wchar_t appBuffer[ARGUMENT_BUFFER_SIZE], keyBuffer[ARGUMENT_BUFFER_SIZE], stringBuffer[ARGUMENT_BUFFER_SIZE];
+	const wchar_t* app;
+	const wchar_t* key;
+	const wchar_t* string;
+	if (!WidenArgument(lpAppName, appBuffer, &app) || !WidenArgument(lpKeyName, keyBuffer, &key) || !WidenArgument(lpString, stringBuffer, &string))
+		return false;
+
+	return SR_CachedWritePrivateProfileStringW(cache, app, key, string, result);
+}
+
+bool SR_CachedWritePrivateProfileStringW(SR_IniCache* cache, LPCWSTR lpAppName, LPCWSTR lpKeyName, LPCWSTR lpString, BOOL* result)
+{
+	// Without a section, the call only asks Windows to write its own cached files
+	if (lpAppName == NULL) return false;
+
+	SR_IniFile* ini = AcquireIniForWriting(cache);
+	if (ini == NULL) return false;
+
+	ReleaseWrittenIni(cache, SR_SetIniString(ini, lpAppName, lpKeyName, lpString));
+
+	*result = TRUE;
+	return true;
+}
+
+bool SR_CachedWritePrivateProfileSectionA(SR_IniCache* cache, LPCSTR lpAppName, LPCSTR lpString, BOOL* result)
+{
+	wchar_t appBuffer[ARGUMENT_BUFFER_SIZE];
+	const wchar_t* app;
+	if (!WidenArgument(lpAppName, appBuffer, &app)) return false;
+
+	if (lpString == NULL) return SR_CachedWritePrivateProfileSectionW(cache, app, NULL, result);
+
+	// Convert the whole list, up to and including the empty string that ends it
+	const char* end = lpString;
+	while (*end != '\0') end += strlen(end) + 1;
+
+	int count = (int)(end - lpString) + 1;
+	int len = MultiByteToWideChar(CP_ACP, 0, lpString, count, NULL, 0);
+	if (len == 0) return false;
+
+	wchar_t* list = malloc(len * sizeof(wchar_t));
+	if (list == NULL) return false;
+
+	MultiByteToWideChar(CP_ACP, 0, lpString, count, list, len);
+
+	bool answered = SR_CachedWritePrivateProfileSectionW(cache, app, list, result);
+	free(list);
+
+	return answered;
+}
+
+bool SR_CachedWritePrivateProfileSectionW(SR_IniCache* cache, LPCWSTR lpAppName, LPCWSTR lpString, BOOL* result)
+{
+	if (lpAppName == NULL) return false;
+
+	SR_IniFile* ini = AcquireIniForWriting(cache);
+	if (ini == NULL) return false;
+
+	ReleaseWrittenIni(cache, SR_SetIniSection(ini, lpAppName, lpString));
+
+	*result = TRUE;
+	return true;
+}
+
+bool SR_CachedWritePrivateProfileStructA(SR_IniCache* cache, LPCSTR lpszSection, LPCSTR lpszKey, LPVOID lpStruct, UINT uSizeStruct, BOOL* result)
+{
+	wchar_t sectionBuffer[ARGUMENT_BUFFER_SIZE], keyBuffer[ARGUMENT_BUFFER_SIZE];
+	const wchar_t* section;
+	const wchar_t* key;
+	if (!WidenArgument(lpszSection, sectionBuffer, &section) || !WidenArgument(lpszKey, keyBuffer, &key))
+		return false;
+
+	return SR_CachedWritePrivateProfileStructW(cache, section, key, lpStruct, uSizeStruct, result);
+}
+
+bool SR_CachedWritePrivateProfileStructW(SR_IniCache* cache, LPCWSTR lpszSection, LPCWSTR lpszKey, LPVOID lpStruct, UINT uSizeStruct, BOOL* result)
+{
+	if (lpszSection == NULL || (lpszKey != NULL && lpStruct == NULL)) return false;
+
+	SR_IniFile* ini = AcquireIniForWriting(cache);
+	if (ini == NULL) return false;
+
+	ReleaseWrittenIni(cache, SR_SetIniStruct(ini, lpszSection, lpszKey, lpStruct, uSizeStruct));
+
+	*result = TRUE;
+	return true;
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include "IniFile.h"
+#include <Windows.h>
+#include <stdbool.h>
+
+/*
+INI cache
+
+Keeps an in-memory copy of every .ini file that is a redirection target, so that the GetPrivateProfile* hooks can
+answer from memory instead of letting Windows open, read and parse the whole file at every call.
+The game reads hundreds of settings at startup, each of which would otherwise read the file again.
+
+A file is only read the first time it's needed. Its copy is discarded whenever something could have changed the
+file (moving or deleting it), and read again at the next call. If a file is opened to be written directly, it's
+impossible to know when the writes end, so that file is never cached again.
+
+The WritePrivateProfile* hooks change the in-memory copy instead of the file, so that calls made afterwards already
+see the change. When the game saves its settings, it writes each one with a separate call, and Windows would write
+the whole file every time. Instead, the changes are written once no other change is made for a second, and when the
+plugin is unloaded. The new contents are written to a temporary file that then replaces the file, so that a crash
+never leaves it half-written.
+
+Every function that answers a call returns false if the call couldn't be answered from memory, in which case it
+must be forwarded to Windows.
+*/
+
+typedef struct SR_IniCache SR_IniCache;
+
+// Encodings a file can be read in, so that it's written back in the same one
+typedef enum
+{
+	SR_INI_ENCODING_ANSI,
+	SR_INI_ENCODING_UTF8,
+	SR_INI_ENCODING_UTF16LE,
+	SR_INI_ENCODING_UTF16BE
+
+} SR_IniEncoding;
+
+// Reads and parses a whole .ini file with a single read, decoding it the same way Windows does.
+// A file that doesn't exist is read as an empty file. Returns NULL if the file couldn't be read.
+// The returned file must be freed with SR_FreeIni.
+//  encoding: Receives the encoding of the file, to write it back in
+SR_IniFile* SR_ReadIniFile(const wchar_t* path, SR_IniEncoding* encoding);
+
+// Writes a whole .ini file in a single step, through a temporary file, so that it's never left half-written.
+// Returns false if the file couldn't be written, in which case GetLastError tells why.
+bool SR_WriteIniFile(const wchar_t* path, const SR_IniFile* ini, SR_IniEncoding encoding);
+
+// Gets the cache of an .ini file, creating it if it doesn't exist yet.
+// Every path that refers to the same file gets the same cache.
+SR_IniCache* SR_GetIniCache(const wchar_t* path);
+
+// Discards the in-memory copy of a file, so that it's read again at the next call
+void SR_InvalidateIniCache(SR_IniCache* cache);
+
+// Discards the in-memory copy of a file along with the changes that weren't written yet, once any write in progress
+// is done, so that they're never written to a file that's about to be deleted
+void SR_DiscardIniCache(SR_IniCache* cache);
+
+// Stops answering calls for a file from memory, writing any change that wasn't written yet
+void SR_DisableIniCache(SR_IniCache* cache);
+
+// Writes the changes of a file that weren't written yet, if there are any, and waits for any write in progress
+void SR_FlushIniCache(SR_IniCache* cache);
+
+// Writes the changes of every file that weren't written yet, and stops writing them in the background.
+//  processExiting: If the whole process is exiting, in which case the other threads were already terminated
+void SR_FlushIniCaches(bool processExiting);
+
+// Frees every cache. No hook can be running when this is called.
+void SR_FreeIniCaches();
+
+// Answers GetPrivateProfileStringA from memory, storing its return value in `result`
+bool SR_CachedGetPrivateProfileStringA(SR_IniCache* cache, LPCSTR lpAppName, LPCSTR lpKeyName, LPCSTR lpDefault, LPSTR lpReturnedString, DWORD nSize, DWORD* result);
+
+// Answers GetPrivateProfileStringW from memory, storing its return value in `result`
+bool SR_CachedGetPrivateProfileStringW(SR_IniCache* cache, LPCWSTR lpAppName, LPCWSTR lpKeyName, LPCWSTR lpDefault, LPWSTR lpReturnedString, DWORD nSize, DWORD* result);
+
+// Answers GetPrivateProfileIntA from memory, storing its return value in `result`
+bool SR_CachedGetPrivateProfileIntA(SR_IniCache* cache, LPCSTR lpAppName, LPCSTR lpKeyName, INT nDefault, UINT* result);
+
+// Answers GetPrivateProfileIntW from memory, storing its return value in `result`
+bool SR_CachedGetPrivateProfileIntW(SR_IniCache* cache, LPCWSTR lpAppName, LPCWSTR lpKeyName, INT nDefault, UINT* result);
+
+// Answers GetPrivateProfileSectionA from memory, storing its return value in `result`
+bool SR_CachedGetPrivateProfileSectionA(SR_IniCache* cache, LPCSTR lpAppName, LPSTR lpReturnedString, DWORD nSize, DWORD* result);
+
+// Answers GetPrivateProfileSectionW from memory, storing its return value in `result`
+bool SR_CachedGetPrivateProfileSectionW(SR_IniCache* cache, LPCWSTR lpAppName, LPWSTR lpReturnedString, DWORD nSize, DWORD* result);
+
+// Answers GetPrivateProfileSectionNamesA from memory, storing its return value in `result`
+bool SR_CachedGetPrivateProfileSectionNamesA(SR_IniCache* cache, LPSTR lpszReturnBuffer, DWORD nSize, DWORD* result);
+
+// Answers GetPrivateProfileSectionNamesW from memory, storing its return value in `result`
+bool SR_CachedGetPrivateProfileSectionNamesW(SR_IniCache* cache, LPWSTR lpszReturnBuffer, DWORD nSize, DWORD* result);
+
+// Answers GetPrivateProfileStructA from memory, storing its return value in `result`
+bool SR_CachedGetPrivateProfileStructA(SR_IniCache* cache, LPCSTR lpszSection, LPCSTR lpszKey, LPVOID lpStruct, UINT uSizeStruct, BOOL* result);
+
+// Answers GetPrivateProfileStructW from memory, storing its return value in `result`
+bool SR_CachedGetPrivateProfileStructW(SR_IniCache* cache, LPCWSTR lpszSection, LPCWSTR lpszKey, LPVOID lpStruct, UINT uSizeStruct, BOOL* result);
+
+// Changes the in-memory copy like WritePrivateProfileStringA, storing its return value in `result`
+bool SR_CachedWritePrivateProfileStringA(SR_IniCache* cache, LPCSTR lpAppName, LPCSTR lpKeyName, LPCSTR lpString, BOOL* result);
+
+// Changes the in-memory copy like WritePrivateProfileStringW, storing its return value in `result`
+bool SR_CachedWritePrivateProfileStringW(SR_IniCache* cache, LPCWSTR lpAppName, LPCWSTR lpKeyName, LPCWSTR lpString, BOOL* result);
+
+// Changes the in-memory copy like WritePrivateProfileSectionA, storing its return value in `result`
+bool SR_CachedWritePrivateProfileSectionA(SR_IniCache* cache, LPCSTR lpAppName, LPCSTR lpString, BOOL* result);
+
+// Changes the in-memory copy like WritePrivateProfileSectionW, storing its return value in `result`
+bool SR_CachedWritePrivateProfileSectionW(SR_IniCache* cache, LPCWSTR lpAppName, LPCWSTR lpString, BOOL* result);
+
+// Changes the in-memory copy like WritePrivateProfileStructA, storing its return value in `result`
+bool SR_CachedWritePrivateProfileStructA(SR_IniCache* cache, LPCSTR lpszSection, LPCSTR lpszKey, LPVOID lpStruct, UINT uSizeStruct, BOOL* result);
+
+// Changes the in-memory copy like WritePrivateProfileStructW, storing its return value in `result`
+bool SR_CachedWritePrivateProfileStructW(SR_IniCache* cache, LPCWSTR lpszSection, LPCWSTR lpszKey, LPVOID lpStruct, UINT uSizeStruct, BOOL* result);
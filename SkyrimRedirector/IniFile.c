@@ -0,0 +1,902 @@
+#include "SR_Base.h"
+#include "IniFile.h"
+#include "CaseFold.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// Transforms an ASCII character to uppercase, leaving any other character unchanged.
+// Names are folded with SR_FoldCharW instead, as Windows ignores the case of every letter in them.
+#define FOLD(c) (((c) >= 'a' && (c) <= 'z') ? (c) - ('a' - 'A') : (c))
+
+// Value returned when a section or key doesn't exist
+#define NOT_FOUND UINT32_MAX
+
+// Smallest number of slots in a hash index
+#define MIN_INDEX_SIZE 16
+
+// Size of the buffer values are read into before being converted to integers, the same one Windows uses
+#define INT_BUFFER_SIZE 30
+
+// The name of a section or key, which is always the first member of both so that the hash index can read it
+typedef struct
+{
+	wchar_t* Text;
+	size_t Len;
+
+} Name;
+
+typedef struct
+{
+	Name Name;
+	// NULL if the line has no '=', e.g. comments and blank lines
+	wchar_t* Value;
+	size_t ValueLen;
+
+	// The line as it was read, written back unchanged so that saving only changes the lines that were written to.
+	// NULL for lines that were added or changed.
+	wchar_t* Line;
+	size_t LineLen;
+
+} Key;
+
+// Open-addressing hash table from names to their positions in an array.
+// Each slot stores the position plus one, so that 0 means an empty slot.
+typedef struct
+{
+	uint32_t* Slots;
+	uint32_t Size;
+	uint32_t Count;
+
+} HashIndex;
+
+typedef struct
+{
+	Name Name;
+
+	// The header line as it was read, or "[name]" for sections that were added.
+	// NULL for the section with no name.
+	wchar_t* Line;
+	size_t LineLen;
+
+	// Every line of the section, in the same order as the file
+	Key* Keys;
+	uint32_t KeyCount;
+	uint32_t KeyCapacity;
+
+	HashIndex Index;
+
+} Section;
+
+struct SR_IniFile
+{
+	// Every section, in the same order as the file.
+	// The first one has no name and holds the lines that come before any section header.
+	Section* Sections;
+	uint32_t SectionCount;
+	uint32_t SectionCapacity;
+
+	HashIndex Index;
+};
+
+// Checks if a character is whitespace. Windows also ignores the old end of file character, Ctrl+Z.
+static bool IsSpace(wchar_t c)
+{
+	return c == L' ' || (c >= L'\t' && c <= L'\r') || c == 0x1A;
+}
+
+// Hashes a name ignoring case, with FNV-1a
+static uint32_t Hash(const wchar_t* name, size_t len)
+{
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < len; i++)
+	{
+		hash ^= (uint32_t)SR_FoldCharW(name[i]);
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+// Checks if a name is equal to a string, ignoring case
+static bool NameEquals(const Name* name, const wchar_t* other, size_t len)
+{
+	if (name->Len != len) return false;
+
+	for (size_t i = 0; i < len; i++)
+	{
+		if (SR_FoldCharW(name->Text[i]) != SR_FoldCharW(other[i])) return false;
+	}
+
+	return true;
+}
+
+// Gets the name of an item in an array of sections or keys
+#define ITEM_NAME(items, stride, position) ((const Name*)((const char*)(items) + (size_t)(position) * (stride)))
+
+// Finds the position of the item with a name in an array of sections or keys.
+// Returns NOT_FOUND if there is no such item.
+static uint32_t FindInIndex(const HashIndex* index, const void* items, size_t stride, const wchar_t* name, size_t len)
+{
+	if (index->Size == 0) return NOT_FOUND;
+
+	uint32_t mask = index->Size - 1;
+	for (uint32_t slot = Hash(name, len) & mask; index->Slots[slot] != 0; slot = (slot + 1) & mask)
+	{
+		uint32_t position = index->Slots[slot] - 1;
+		if (NameEquals(ITEM_NAME(items, stride, position), name, len)) return position;
+	}
+
+	return NOT_FOUND;
+}
+
+// Adds an item to an index, unless an item with the same name is already there
+static void AddToIndex(HashIndex* index, const void* items, size_t stride, uint32_t position)
+{
+	const Name* name = ITEM_NAME(items, stride, position);
+	if (FindInIndex(index, items, stride, name->Text, name->Len) != NOT_FOUND) return;
+
+	// Keep the index at most half full
+	if ((index->Count + 1) * 2 > index->Size)
+	{
+		HashIndex grown;
+		grown.Size = index->Size == 0 ? MIN_INDEX_SIZE : index->Size * 2;
+		grown.Count = index->Count;
+		grown.Slots = calloc(grown.Size, sizeof(uint32_t));
+
+		for (uint32_t i = 0; i < index->Size; i++)
+		{
+			if (index->Slots[i] == 0) continue;
+
+			const Name* existing = ITEM_NAME(items, stride, index->Slots[i] - 1);
+			uint32_t slot = Hash(existing->Text, existing->Len) & (grown.Size - 1);
+			while (grown.Slots[slot] != 0) slot = (slot + 1) & (grown.Size - 1);
+
+			grown.Slots[slot] = index->Slots[i];
+		}
+
+		free(index->Slots);
+		*index = grown;
+	}
+
+	uint32_t slot = Hash(name->Text, name->Len) & (index->Size - 1);
+	while (index->Slots[slot] != 0) slot = (slot + 1) & (index->Size - 1);
+
+	index->Slots[slot] = position + 1;
+	index->Count++;
+}
+
+// Copies a string into a new null-terminated heap buffer
+static wchar_t* Duplicate(const wchar_t* text, size_t len)
+{
+	wchar_t* copy = malloc((len + 1) * sizeof(wchar_t));
+	wmemcpy(copy, text, len);
+	copy[len] = L'\0';
+
+	return copy;
+}
+
+// Adds every item of an array of sections or keys to an empty index, skipping the ones without a name if needed
+static void BuildIndex(HashIndex* index, const void* items, size_t stride, uint32_t count, bool skipUnnamed)
+{
+	if (index->Slots != NULL) memset(index->Slots, 0, index->Size * sizeof(uint32_t));
+	index->Count = 0;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (skipUnnamed && ITEM_NAME(items, stride, i)->Len == 0) continue;
+		AddToIndex(index, items, stride, i);
+	}
+}
+
+// Adds a section to the end of a file, returning it
+//  line: The header line of the section, or NULL for the section with no name
+static Section* AddSection(SR_IniFile* ini, const wchar_t* name, size_t len, const wchar_t* line, size_t lineLen)
+{
+	if (ini->SectionCount == ini->SectionCapacity)
+	{
+		ini->SectionCapacity = ini->SectionCapacity == 0 ? 8 : ini->SectionCapacity * 2;
+		ini->Sections = realloc(ini->Sections, ini->SectionCapacity * sizeof(Section));
+	}
+
+	Section* section = &ini->Sections[ini->SectionCount];
+	memset(section, 0, sizeof(Section));
+	section->Name.Text = Duplicate(name, len);
+	section->Name.Len = len;
+	section->Line = line != NULL ? Duplicate(line, lineLen) : NULL;
+	section->LineLen = lineLen;
+
+	// Sections without a name can never be read
+	if (len > 0) AddToIndex(&ini->Index, ini->Sections, sizeof(Section), ini->SectionCount);
+
+	ini->SectionCount++;
+	return section;
+}
+
+// Inserts a line into a section
+//  position: Where to insert the line, up to the number of keys in the section
+//  value: The value of the key, or NULL if the line has no '='
+//  line: The line as it was read, or NULL for new lines
+static void InsertKey(Section* section, uint32_t position, const wchar_t* name, size_t nameLen, const wchar_t* value, size_t valueLen, const wchar_t* line, size_t lineLen)
+{
+	if (section->KeyCount == section->KeyCapacity)
+	{
+		section->KeyCapacity = section->KeyCapacity == 0 ? 8 : section->KeyCapacity * 2;
+		section->Keys = realloc(section->Keys, section->KeyCapacity * sizeof(Key));
+	}
+
+	memmove(&section->Keys[position + 1], &section->Keys[position], (section->KeyCount - position) * sizeof(Key));
+
+	Key* key = &section->Keys[position];
+	key->Name.Text = Duplicate(name, nameLen);
+	key->Name.Len = nameLen;
+	key->Value = value != NULL ? Duplicate(value, valueLen) : NULL;
+	key->ValueLen = valueLen;
+	key->Line = line != NULL ? Duplicate(line, lineLen) : NULL;
+	key->LineLen = lineLen;
+
+	section->KeyCount++;
+
+	// Keys at the end are the common case, and don't move any other key
+	if (position == section->KeyCount - 1)
+		AddToIndex(&section->Index, section->Keys, sizeof(Key), position);
+	else
+		BuildIndex(&section->Index, section->Keys, sizeof(Key), section->KeyCount, false);
+}
+
+// Frees the strings of a line
+static void FreeKey(Key* key)
+{
+	free(key->Name.Text);
+	free(key->Value);
+	free(key->Line);
+}
+
+SR_IniFile* SR_ParseIni(const wchar_t* text, size_t len)
+{
+	SR_IniFile* ini = calloc(1, sizeof(SR_IniFile));
+	Section* section = AddSection(ini, L"", 0, NULL, 0);
+
+	const wchar_t* end = text + len;
+	const wchar_t* next = text;
+
+	while (next < end)
+	{
+		// Lines end at "\r\n", "\n" or a lone "\r"
+		const wchar_t* start = next;
+		const wchar_t* lineEnd = start;
+		while (lineEnd < end && *lineEnd != L'\n' && *lineEnd != L'\r') lineEnd++;
+
+		next = lineEnd;
+		if (next < end && *next == L'\r') next++;
+		if (next < end && *next == L'\n') next++;
+
+		const wchar_t* line = start;
+		size_t lineLen = lineEnd - start;
+
+		while (start < lineEnd && IsSpace(*start)) start++;
+		while (lineEnd > start && IsSpace(lineEnd[-1])) lineEnd--;
+
+		if (start < lineEnd && *start == L'[')
+		{
+			// Anything after the last ']' is ignored. Lines without one are read as keys.
+			const wchar_t* close = lineEnd - 1;
+			while (close > start && *close != L']') close--;
+
+			if (close > start)
+			{
+				section = AddSection(ini, start + 1, close - start - 1, line, lineLen);
+				continue;
+			}
+		}
+
+		const wchar_t* nameEnd = lineEnd;
+		const wchar_t* value = NULL;
+
+		const wchar_t* equals = wmemchr(start, L'=', lineEnd - start);
+		if (equals != NULL)
+		{
+			nameEnd = equals;
+			while (nameEnd > start && IsSpace(nameEnd[-1])) nameEnd--;
+
+			value = equals + 1;
+			while (value < lineEnd && IsSpace(*value)) value++;
+		}
+
+		// Windows ignores lines with no name that come right after another one.
+		// Blank lines are kept anyway, as they're never read and keeping them preserves the layout of the file.
+		size_t nameLen = nameEnd - start;
+		bool afterUnnamed = section->KeyCount > 0 && section->Keys[section->KeyCount - 1].Name.Len == 0;
+		if (nameLen == 0 && value != NULL && afterUnnamed) continue;
+
+		InsertKey(section, section->KeyCount, start, nameLen, value, value != NULL ? (size_t)(lineEnd - value) : 0, line, lineLen);
+	}
+
+	return ini;
+}
+
+// Finds a section by its exact name. Returns NULL if it doesn't exist.
+static const Section* FindSection(const SR_IniFile* ini, const wchar_t* name, size_t len)
+{
+	uint32_t position = FindInIndex(&ini->Index, ini->Sections, sizeof(Section), name, len);
+	return position != NOT_FOUND ? &ini->Sections[position] : NULL;
+}
+
+// Removes the leading and trailing whitespace of a name passed to a query, returning its start
+static const wchar_t* TrimName(const wchar_t* name, size_t* len)
+{
+	while (IsSpace(*name)) name++;
+
+	*len = wcslen(name);
+	while (*len > 0 && IsSpace(name[*len - 1])) (*len)--;
+
+	return name;
+}
+
+// Finds a key by its section and name, ignoring any whitespace around them. Returns NULL if it doesn't exist.
+// Only the first section with the name is searched, even if there's another one with the key.
+static const Key* FindKey(const SR_IniFile* ini, const wchar_t* sectionName, const wchar_t* keyName)
+{
+	size_t sectionLen, keyLen;
+	sectionName = TrimName(sectionName, &sectionLen);
+	keyName = TrimName(keyName, &keyLen);
+
+	const Section* section = FindSection(ini, sectionName, sectionLen);
+	if (section == NULL) return NULL;
+
+	uint32_t position = FindInIndex(&section->Index, section->Keys, sizeof(Key), keyName, keyLen);
+	return position != NOT_FOUND ? &section->Keys[position] : NULL;
+}
+
+// Copies a value into a buffer, truncating it if needed, and returns the length of the copy.
+//  size: The size of `buffer`, in characters. Must not be 0.
+//  stripQuotes: If the quotes around the value should be removed
+static size_t CopyEntry(wchar_t* buffer, size_t size, const wchar_t* value, size_t len, bool stripQuotes)
+{
+	bool quoted = false;
+	if (stripQuotes && len > 1 && (value[0] == L'"' || value[0] == L'\'') && value[len - 1] == value[0])
+	{
+		quoted = true;
+		value++;
+		len--;
+	}
+
+	size_t copied = len < size - 1 ? len : size - 1;
+	wmemcpy(buffer, value, copied);
+	buffer[copied] = L'\0';
+
+	// Windows only removes the closing quote if the buffer is at least as long as the value without its opening quote,
+	// and then removes the last character it copied, which isn't the quote if the value was truncated
+	if (quoted && size >= len && copied > 0)
+	{
+		copied--;
+		buffer[copied] = L'\0';
+	}
+
+	return copied;
+}
+
+// Lists the lines of a section, the same way as GetPrivateProfileSectionW
+//  withValues: If the values are listed as "key=value". If false, only the names of keys with a value are listed.
+static size_t ListSection(const SR_IniFile* ini, const wchar_t* name, wchar_t* buffer, size_t size, bool withValues)
+{
+	if (buffer == NULL || size == 0) return 0;
+	if (size == 1)
+	{
+		buffer[0] = L'\0';
+		return 0;
+	}
+
+	// Unlike single values, whitespace around the section name is not ignored
+	const Section* section = FindSection(ini, name, wcslen(name));
+	if (section == NULL)
+	{
+		buffer[0] = buffer[1] = L'\0';
+		return 0;
+	}
+
+	wchar_t* current = buffer;
+	size_t remaining = size;
+
+	for (uint32_t i = 0; i < section->KeyCount; i++)
+	{
+		const Key* key = &section->Keys[i];
+
+		if (remaining <= 2) break;
+
+		// Skip blank lines, comments, and lines without '=' when only listing names
+		if (key->Name.Len == 0 && key->Value == NULL) continue;
+		if (key->Name.Len > 0 && key->Name.Text[0] == L';') continue;
+		if (!withValues && key->Value == NULL) continue;
+
+		size_t len = CopyEntry(current, remaining - 1, key->Name.Text, key->Name.Len, false);
+		current += len + 1;
+		remaining -= len + 1;
+
+		if (remaining < 2) break;
+
+		if (withValues && key->Value != NULL)
+		{
+			current[-1] = L'=';
+
+			len = CopyEntry(current, remaining - 1, key->Value, key->ValueLen, false);
+			current += len + 1;
+			remaining -= len + 1;
+		}
+	}
+
+	*current = L'\0';
+
+	// If the list doesn't fit, the last string is truncated and followed by two null terminators
+	if (remaining <= 1)
+	{
+		current[-1] = L'\0';
+		return size - 2;
+	}
+
+	return size - remaining;
+}
+
+size_t SR_GetIniSectionNames(const SR_IniFile* ini, wchar_t* buffer, size_t size)
+{
+	if (buffer == NULL || size == 0) return 0;
+	if (size == 1)
+	{
+		buffer[0] = L'\0';
+		return 0;
+	}
+
+	wchar_t* current = buffer;
+	size_t remaining = size - 1;
+
+	for (uint32_t i = 0; i < ini->SectionCount; i++)
+	{
+		const Name* name = &ini->Sections[i].Name;
+		if (name->Len == 0) continue;
+
+		// Windows truncates the list even if the name fits exactly
+		size_t needed = name->Len + 1;
+		if (needed >= remaining)
+		{
+			wmemcpy(current, name->Text, remaining - 1);
+			current += remaining - 1;
+			*current++ = L'\0';
+			*current = L'\0';
+
+			return size - 2;
+		}
+
+		wmemcpy(current, name->Text, needed);
+		current += needed;
+		remaining -= needed;
+	}
+
+	*current = L'\0';
+	return current - buffer;
+}
+
+size_t SR_GetIniString(const SR_IniFile* ini, const wchar_t* section, const wchar_t* key, const wchar_t* def, wchar_t* buffer, size_t size)
+{
+	if (section == NULL) return SR_GetIniSectionNames(ini, buffer, size);
+	if (buffer == NULL || size == 0) return 0;
+
+	// Trailing spaces are removed from the default, but a default made only of spaces keeps one of them
+	if (def == NULL) def = L"";
+	size_t defLen = wcslen(def);
+	while (defLen > 1 && def[defLen - 1] == L' ') defLen--;
+
+	if (key != NULL)
+	{
+		const Key* found = FindKey(ini, section, key);
+		if (found != NULL && found->Value != NULL)
+			return CopyEntry(buffer, size, found->Value, found->ValueLen, true);
+
+		return CopyEntry(buffer, size, def, defLen, true);
+	}
+
+	size_t len = ListSection(ini, section, buffer, size, false);
+	if (buffer[0] == L'\0') len = CopyEntry(buffer, size, def, defLen, true);
+
+	return len;
+}
+
+// Parses an integer the same way as RtlUnicodeStringToInteger with base 0, which GetPrivateProfileInt uses
+static unsigned int ParseInt(const wchar_t* text)
+{
+	while (*text != L'\0' && *text <= L' ') text++;
+
+	bool negative = false;
+	if (*text == L'+')
+	{
+		text++;
+	}
+	else if (*text == L'-')
+	{
+		negative = true;
+		text++;
+	}
+
+	unsigned int base = 10;
+	if (text[0] == L'0')
+	{
+		if (text[1] == L'x') base = 16;
+		else if (text[1] == L'o') base = 8;
+		else if (text[1] == L'b') base = 2;
+
+		if (base != 10) text += 2;
+	}
+
+	uint32_t result = 0;
+	for (; *text != L'\0'; text++)
+	{
+		unsigned int digit;
+		if (*text >= L'0' && *text <= L'9') digit = *text - L'0';
+		else if (*text >= L'A' && *text <= L'Z') digit = *text - L'A' + 10;
+		else if (*text >= L'a' && *text <= L'z') digit = *text - L'a' + 10;
+		else break;
+
+		if (digit >= base) break;
+		result = result * base + digit;
+	}
+
+	return negative ? 0u - result : result;
+}
+
+unsigned int SR_GetIniInt(const SR_IniFile* ini, const wchar_t* section, const wchar_t* key, int def)
+{
+	wchar_t buffer[INT_BUFFER_SIZE];
+
+	// Missing and empty values both return the default
+	if (SR_GetIniString(ini, section, key, L"", buffer, INT_BUFFER_SIZE) == 0) return (unsigned int)def;
+
+	return ParseInt(buffer);
+}
+
+size_t SR_GetIniSection(const SR_IniFile* ini, const wchar_t* section, wchar_t* buffer, size_t size)
+{
+	if (section == NULL) return 0;
+	return ListSection(ini, section, buffer, size, true);
+}
+
+// Gets the value of a hexadecimal digit. The digit must be valid.
+static uint8_t HexDigit(wchar_t c)
+{
+	c = FOLD(c);
+	return (uint8_t)(c > L'9' ? c - L'A' + 10 : c - L'0');
+}
+
+bool SR_GetIniStruct(const SR_IniFile* ini, const wchar_t* section, const wchar_t* key, void* data, size_t size)
+{
+	if (section == NULL || key == NULL) return false;
+
+	const Key* found = FindKey(ini, section, key);
+	if (found == NULL || found->Value == NULL) return false;
+
+	// Two digits per byte, plus two for the checksum
+	const wchar_t* value = found->Value;
+	size_t len = found->ValueLen;
+	if (len < 2 || (len - 2) / 2 != size) return false;
+
+	for (size_t i = 0; i < len; i++)
+	{
+		wchar_t c = FOLD(value[i]);
+		if (!((c >= L'0' && c <= L'9') || (c >= L'A' && c <= L'F'))) return false;
+	}
+
+	// Like Windows, the data is written to the buffer even if the checksum doesn't match
+	uint8_t* output = data;
+	uint8_t checksum = 0;
+	uint8_t byte = 0;
+	bool highNibble = true;
+
+	const wchar_t* dataEnd = value + len - 2;
+	const wchar_t* current = value;
+	for (; current < dataEnd; current++)
+	{
+		if (highNibble)
+		{
+			byte = (uint8_t)(HexDigit(*current) << 4);
+		}
+		else
+		{
+			byte += HexDigit(*current);
+			*output++ = byte;
+			checksum += byte;
+		}
+
+		highNibble = !highNibble;
+	}
+
+	uint8_t expected = (uint8_t)((HexDigit(current[0]) << 4) + HexDigit(current[1]));
+	return expected == checksum;
+}
+
+// Removes every named section with a name, ignoring case but not whitespace. Returns false if there was none.
+static bool DeleteSections(SR_IniFile* ini, const wchar_t* name)
+{
+	size_t len = wcslen(name);
+	uint32_t kept = 1;
+
+	for (uint32_t i = 1; i < ini->SectionCount; i++)
+	{
+		Section* section = &ini->Sections[i];
+		if (!NameEquals(&section->Name, name, len))
+		{
+			ini->Sections[kept++] = *section;
+			continue;
+		}
+
+		for (uint32_t j = 0; j < section->KeyCount; j++)
+			FreeKey(&section->Keys[j]);
+
+		free(section->Keys);
+		free(section->Index.Slots);
+		free(section->Name.Text);
+		free(section->Line);
+	}
+
+	if (kept == ini->SectionCount) return false;
+
+	ini->SectionCount = kept;
+	BuildIndex(&ini->Index, ini->Sections, sizeof(Section), ini->SectionCount, true);
+	return true;
+}
+
+// Removes a line from a section
+static void RemoveKey(Section* section, uint32_t position)
+{
+	FreeKey(&section->Keys[position]);
+
+	section->KeyCount--;
+	memmove(&section->Keys[position], &section->Keys[position + 1], (section->KeyCount - position) * sizeof(Key));
+
+	BuildIndex(&section->Index, section->Keys, sizeof(Key), section->KeyCount, false);
+}
+
+// Finds the first section with a name, ignoring case and whitespace, adding it to the end of the file if there's none
+static Section* FindOrAddSection(SR_IniFile* ini, const wchar_t* name)
+{
+	size_t len;
+	name = TrimName(name, &len);
+
+	uint32_t position = FindInIndex(&ini->Index, ini->Sections, sizeof(Section), name, len);
+	if (position != NOT_FOUND) return &ini->Sections[position];
+
+	wchar_t* header = malloc((len + 2) * sizeof(wchar_t));
+	header[0] = L'[';
+	wmemcpy(header + 1, name, len);
+	header[len + 1] = L']';
+
+	Section* section = AddSection(ini, name, len, header, len + 2);
+	free(header);
+
+	return section;
+}
+
+// Adds a key to a section, before the blank lines at its end so that they keep separating it from the next section
+static void AppendKey(Section* section, const wchar_t* name, size_t nameLen, const wchar_t* value, size_t valueLen)
+{
+	uint32_t position = section->KeyCount;
+	while (position > 0 && section->Keys[position - 1].Name.Len == 0 && section->Keys[position - 1].Value == NULL) position--;
+
+	InsertKey(section, position, name, nameLen, value, valueLen, NULL, 0);
+}
+
+// Checks if a stored value reads back the same as a new one.
+// Quoted values are read without their quotes, so writing the same value without them doesn't change anything.
+static bool ValueEquals(const wchar_t* stored, size_t storedLen, const wchar_t* value, size_t len)
+{
+	if (storedLen == len && wmemcmp(stored, value, len) == 0) return true;
+
+	bool quoted = storedLen > 1 && (stored[0] == L'"' || stored[0] == L'\'') && stored[storedLen - 1] == stored[0];
+	return quoted && storedLen - 2 == len && wmemcmp(stored + 1, value, len) == 0;
+}
+
+bool SR_SetIniString(SR_IniFile* ini, const wchar_t* section, const wchar_t* key, const wchar_t* value)
+{
+	if (section == NULL) return false;
+	if (key == NULL) return DeleteSections(ini, section);
+
+	if (value == NULL)
+	{
+		// Only the first key with the name is removed, searching every section with the name
+		size_t keyLen = wcslen(key);
+		size_t sectionLen = wcslen(section);
+
+		for (uint32_t i = 1; i < ini->SectionCount; i++)
+		{
+			Section* current = &ini->Sections[i];
+			if (!NameEquals(&current->Name, section, sectionLen)) continue;
+
+			for (uint32_t j = 0; j < current->KeyCount; j++)
+			{
+				if (!NameEquals(&current->Keys[j].Name, key, keyLen)) continue;
+
+				RemoveKey(current, j);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// Values are stored the same way they'll be read back from the file
+	size_t valueLen;
+	value = TrimName(value, &valueLen);
+
+	size_t keyLen;
+	key = TrimName(key, &keyLen);
+
+	Section* found = FindOrAddSection(ini, section);
+	uint32_t position = FindInIndex(&found->Index, found->Keys, sizeof(Key), key, keyLen);
+	if (position == NOT_FOUND)
+	{
+		AppendKey(found, key, keyLen, value, valueLen);
+		return true;
+	}
+
+	Key* existing = &found->Keys[position];
+	if (existing->Value != NULL && ValueEquals(existing->Value, existing->ValueLen, value, valueLen)) return false;
+
+	free(existing->Value);
+	free(existing->Line);
+	existing->Value = Duplicate(value, valueLen);
+	existing->ValueLen = valueLen;
+	existing->Line = NULL;
+
+	return true;
+}
+
+bool SR_SetIniSection(SR_IniFile* ini, const wchar_t* section, const wchar_t* list)
+{
+	if (section == NULL) return false;
+	if (list == NULL) return DeleteSections(ini, section);
+
+	// Every section with the name is emptied, but the lines are only added to the first one
+	size_t sectionLen = wcslen(section);
+	for (uint32_t i = 1; i < ini->SectionCount; i++)
+	{
+		Section* current = &ini->Sections[i];
+		if (!NameEquals(&current->Name, section, sectionLen)) continue;
+
+		for (uint32_t j = 0; j < current->KeyCount; j++)
+			FreeKey(&current->Keys[j]);
+
+		current->KeyCount = 0;
+		BuildIndex(&current->Index, current->Keys, sizeof(Key), 0, false);
+	}
+
+	Section* found = FindOrAddSection(ini, section);
+
+	// Lines without '=' are ignored, and names that appear more than once are all kept
+	for (const wchar_t* line = list; *line != L'\0'; line += wcslen(line) + 1)
+	{
+		const wchar_t* equals = wcschr(line, L'=');
+		if (equals == NULL) continue;
+
+		const wchar_t* name = line;
+		const wchar_t* nameEnd = equals;
+		while (name < nameEnd && IsSpace(*name)) name++;
+		while (nameEnd > name && IsSpace(nameEnd[-1])) nameEnd--;
+
+		size_t valueLen;
+		const wchar_t* value = TrimName(equals + 1, &valueLen);
+
+		InsertKey(found, found->KeyCount, name, nameEnd - name, value, valueLen, NULL, 0);
+	}
+
+	return true;
+}
+
+bool SR_SetIniStruct(SR_IniFile* ini, const wchar_t* section, const wchar_t* key, const void* data, size_t size)
+{
+	if (key == NULL) return SR_SetIniString(ini, section, NULL, NULL);
+
+	static const wchar_t Digits[] = L"0123456789ABCDEF";
+
+	// Two digits per byte, plus two for the checksum and the null terminator
+	wchar_t* value = malloc((size * 2 + 3) * sizeof(wchar_t));
+	wchar_t* current = value;
+
+	const uint8_t* input = data;
+	uint8_t checksum = 0;
+	for (size_t i = 0; i < size; i++)
+	{
+		*current++ = Digits[input[i] >> 4];
+		*current++ = Digits[input[i] & 0xF];
+		checksum += input[i];
+	}
+
+	*current++ = Digits[checksum >> 4];
+	*current++ = Digits[checksum & 0xF];
+	*current = L'\0';
+
+	bool changed = SR_SetIniString(ini, section, key, value);
+	free(value);
+
+	return changed;
+}
+
+// Writes a line and its line break, or only counts its length if the buffer is NULL
+//  value: The text written after an '=', or NULL if the line has no '='
+static size_t FormatLine(wchar_t* buffer, const wchar_t* text, size_t len, const wchar_t* value, size_t valueLen)
+{
+	size_t total = len + (value != NULL ? 1 + valueLen : 0) + 2;
+	if (buffer == NULL) return total;
+
+	wmemcpy(buffer, text, len);
+	buffer += len;
+
+	if (value != NULL)
+	{
+		*buffer++ = L'=';
+		wmemcpy(buffer, value, valueLen);
+		buffer += valueLen;
+	}
+
+	*buffer++ = L'\r';
+	*buffer = L'\n';
+
+	return total;
+}
+
+// Writes a file as text, or only counts its length if the buffer is NULL
+static size_t FormatFile(const SR_IniFile* ini, wchar_t* buffer)
+{
+	size_t len = 0;
+
+	for (uint32_t i = 0; i < ini->SectionCount; i++)
+	{
+		const Section* section = &ini->Sections[i];
+		if (section->Line != NULL)
+			len += FormatLine(buffer != NULL ? buffer + len : NULL, section->Line, section->LineLen, NULL, 0);
+
+		// Lines that were never changed are written exactly as they were read
+		for (uint32_t j = 0; j < section->KeyCount; j++)
+		{
+			const Key* key = &section->Keys[j];
+			wchar_t* current = buffer != NULL ? buffer + len : NULL;
+
+			if (key->Line != NULL)
+				len += FormatLine(current, key->Line, key->LineLen, NULL, 0);
+			else
+				len += FormatLine(current, key->Name.Text, key->Name.Len, key->Value, key->ValueLen);
+		}
+	}
+
+	return len;
+}
+
+wchar_t* SR_FormatIni(const SR_IniFile* ini, size_t* len)
+{
+	*len = FormatFile(ini, NULL);
+
+	wchar_t* text = malloc((*len + 1) * sizeof(wchar_t));
+	FormatFile(ini, text);
+	text[*len] = L'\0';
+
+	return text;
+}
+
+void SR_FreeIni(SR_IniFile* ini)
+{
+	if (ini == NULL) return;
+
+	for (uint32_t i = 0; i < ini->SectionCount; i++)
+	{
+		Section* section = &ini->Sections[i];
+
+		for (uint32_t j = 0; j < section->KeyCount; j++)
+			FreeKey(&section->Keys[j]);
+
+		free(section->Keys);
+		free(section->Index.Slots);
+		free(section->Name.Text);
+		free(section->Line);
+	}
+
+	free(ini->Sections);
+	free(ini->Index.Slots);
+	free(ini);
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <wchar.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+In-memory INI file
+
+An INI file parsed once into sections and keys, with a hash index over the names of both, so that reading a value
+costs two hash lookups instead of opening, reading and parsing the whole file like GetPrivateProfileString does.
+
+Every line of the file is kept, including comments and blank lines, in the same order as the file.
+The queries return exactly what the matching GetPrivateProfile* function returns for the same file, including
+how results are truncated when they don't fit in the buffer:
+  * Leading and trailing whitespace is removed from lines, names and values
+  * Values surrounded by matching single or double quotes have them removed
+  * Section and key names are compared ignoring case. Only ASCII letters are folded.
+  * If a section or key appears more than once, only the first one is used
+
+Changes are made the same way as the matching WritePrivateProfile* function. When the file is written back, every
+line that wasn't changed is written exactly as it was read, so comments and formatting are kept.
+
+This file doesn't depend on Windows, so it can be tested and benchmarked on any platform.
+*/
+
+typedef struct SR_IniFile SR_IniFile;
+
+// Parses the text of an INI file, without any byte order mark.
+// The returned file must be freed with SR_FreeIni.
+//  text: The text of the file, which doesn't need to be null-terminated
+//  len: The length of `text`, in characters
+SR_IniFile* SR_ParseIni(const wchar_t* text, size_t len);
+
+// Reads a value, a list of keys or a list of sections, the same way as GetPrivateProfileStringW.
+//  section: The section to read. If NULL, every section name is listed instead.
+//  key: The key to read. If NULL, every key name in the section is listed instead.
+//  def: The value returned if the key doesn't exist, or NULL for an empty string
+//  buffer: The buffer that receives the value or list
+//  size: The size of `buffer`, in characters
+// Returns the number of characters stored in the buffer, not counting the final null terminator.
+size_t SR_GetIniString(const SR_IniFile* ini, const wchar_t* section, const wchar_t* key, const wchar_t* def, wchar_t* buffer, size_t size);
+
+// Reads an integer value, the same way as GetPrivateProfileIntW.
+// Hexadecimal, octal and binary values are supported with the 0x, 0o and 0b prefixes.
+// Anything after the digits is ignored, e.g. "1.5000" is read as 1.
+unsigned int SR_GetIniInt(const SR_IniFile* ini, const wchar_t* section, const wchar_t* key, int def);
+
+// Lists every "key=value" line of a section, the same way as GetPrivateProfileSectionW.
+// Returns the number of characters stored in the buffer, not counting the final null terminator.
+size_t SR_GetIniSection(const SR_IniFile* ini, const wchar_t* section, wchar_t* buffer, size_t size);
+
+// Lists every section name, the same way as GetPrivateProfileSectionNamesW.
+// Returns the number of characters stored in the buffer, not counting the final null terminator.
+size_t SR_GetIniSectionNames(const SR_IniFile* ini, wchar_t* buffer, size_t size);
+
+// Reads a value written by WritePrivateProfileStructW, the same way as GetPrivateProfileStructW.
+// The value is the data in hexadecimal followed by a one-byte checksum.
+// Returns false if the key doesn't exist, if its value isn't `size` bytes long or if the checksum doesn't match.
+bool SR_GetIniStruct(const SR_IniFile* ini, const wchar_t* section, const wchar_t* key, void* data, size_t size);
+
+// Changes, adds or removes a value, the same way as WritePrivateProfileStringW.
+//  key: The key to change. If NULL, every section with the name is removed.
+//  value: The new value of the key. If NULL, the key is removed.
+// Returns true if the file was changed. Writing the value a key already reads as, e.g. without its quotes, doesn't.
+bool SR_SetIniString(SR_IniFile* ini, const wchar_t* section, const wchar_t* key, const wchar_t* value);
+
+// Replaces every line of a section, the same way as WritePrivateProfileSectionW.
+//  list: A list of "key=value" strings, each null-terminated, that ends with an empty string.
+//        If NULL, every section with the name is removed.
+// Returns true if the file may have changed.
+bool SR_SetIniSection(SR_IniFile* ini, const wchar_t* section, const wchar_t* list);
+
+// Writes data as a value, the same way as WritePrivateProfileStructW.
+// If `key` is NULL, every section with the name is removed.
+// Returns true if the file was changed.
+bool SR_SetIniStruct(SR_IniFile* ini, const wchar_t* section, const wchar_t* key, const void* data, size_t size);
+
+// Writes a file back as text, with "\r\n" line breaks.
+// The returned text is null-terminated and must be freed with free.
+//  len: Receives the length of the text, in characters
+wchar_t* SR_FormatIni(const SR_IniFile* ini, size_t* len);
+
+// Frees an INI file
+void SR_FreeIni(SR_IniFile* ini);
@@ -1,38 +1,364 @@
 #include "SR_Base.h"
 #include "Logging.h"
 #include "Config.h"
-#include "StringUtils.h"
 #include "PlatformDefinitions.h"
+#include "TraceFormat.h"
+#include "Redirections.h"
 
 #include <Windows.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
 #include <wchar.h>
 
-#define SR_LOG_HEADER_SIZE 32
+/*
+Messages are formatted by the thread that logs them straight into a slot of a fixed-size ring buffer, and written
+to the file in the background. Logging a message never allocates memory, takes a lock or calls into the kernel,
+which matters at the TRACE level, where every hooked call logs.
+
+The ring is a bounded multi-producer queue: each slot has a sequence number that tells whether it's free for the
+producer at a position or ready for the consumer at a position, so threads only race on the position counter.
+If the ring is full, the message is dropped and counted instead of making the thread wait, and the number of dropped
+messages is written to the log the next time it's written.
+
+Only one thread drains the ring at a time: a threadpool timer started by the first message after the last drain,
+and SR_StopLogging, which drains whatever is left before closing the file.
+
+In binary mode, messages aren't formatted at all: the thread that logs a message only stores the ID of its format and
+copies its arguments into the slot, and the drain writes them to the file as a trace (see TraceFormat.h). Formats are
+identified by their address, since every message is a string literal, and the arguments each one takes are only
+parsed the first time it's logged. Messages with formats that can't be stored as arguments are formatted as usual.
+*/
+
+// Number of slots in the ring. Must be a power of two.
+#define RING_SIZE 256
+
+// Size, in characters, of the text of a message. Longer messages are truncated.
+#define MESSAGE_SIZE 1024
+
+// Time, in milliseconds, between the first message logged and the ring being written to the file
+#define DRAIN_DELAY 50
+
+// Size, in bytes, of the buffer messages are converted into before being written to the file
+#define BATCH_SIZE (64 * 1024)
+
+// Size, in characters, of the buffer the "yyyy-MM-dd HH:mm:ss.SSS [LEVEL] " header of a line is formatted into
+#define SR_LOG_HEADER_SIZE 40
+
+// Number of formats that can be stored in a trace by ID, as a power of two. Other formats are logged as text.
+#define FORMAT_TABLE_BITS 9
+#define FORMAT_TABLE_SIZE (1 << FORMAT_TABLE_BITS)
+
+// Format ID of entries that hold formatted text instead of arguments
+#define TEXT_FORMAT UINT32_MAX
+
+typedef struct
+{
+	// Equal to the position of the producer that can write this slot, or to that position plus one once it's written
+	volatile LONG Sequence;
+
+	uint8_t Level;
+	FILETIME Time;
+	DWORD ThreadId;
+
+	// Index of the format in Formats, or TEXT_FORMAT if the message was formatted into Text
+	uint32_t Format;
+	// Number of characters in Text or bytes in Data
+	size_t Len;
+
+	union
+	{
+		wchar_t Text[MESSAGE_SIZE];
+		// The arguments of the message, in the trace format
+		unsigned char Data[MESSAGE_SIZE * sizeof(wchar_t)];
+	};
+
+} Entry;
+
+// A format stored in a trace, and the kinds of the arguments it takes
+typedef struct
+{
+	// The address of the format, set by the first thread that logs it
+	PVOID volatile Format;
+	// 0 while the format is being parsed, 1 once Arguments can be used, -1 if it can't be stored in a trace
+	volatile LONG State;
+
+	uint8_t ArgumentCount;
+	uint8_t Arguments[SR_TRACE_MAX_ARGUMENTS];
+
+} FormatInfo;
+
+volatile uint8_t SR_LogLevel = SR_LOG_LEVEL_OFF;
 
 static HANDLE LogFile = INVALID_HANDLE_VALUE;
+// If messages are written as a binary trace
+static bool Binary = false;
+
+static Entry Ring[RING_SIZE];
+// Position the next message will be written to
+static volatile LONG WritePosition = 0;
+// Position of the next message to be written to the file. Only used while holding DrainLock.
+static LONG ReadPosition = 0;
+// Number of messages dropped because the ring was full, since it was last written to the file
+static volatile LONG Dropped = 0;
+
+static PTP_TIMER DrainTimer = NULL;
+// If DrainTimer was started and didn't start draining yet
+static volatile LONG DrainScheduled = 0;
+// Held while draining, so that there's only ever one consumer
+static SRWLOCK DrainLock = SRWLOCK_INIT;
+
+// UTF-8 lines waiting to be written to the file. Only used while holding DrainLock.
+static char Batch[BATCH_SIZE];
+static size_t BatchLen = 0;
+
+// Open addressing hash table of the formats logged in binary mode, keyed by their address.
+// Formats are never removed, since they're all string literals that live as long as the plugin.
+static FormatInfo Formats[FORMAT_TABLE_SIZE];
+// If each format was written to the trace since it was opened. Only used while holding DrainLock.
+static bool FormatWritten[FORMAT_TABLE_SIZE];
+
+// Gets how far ahead a position is of another, handling the positions wrapping around
+static LONG Distance(LONG position, LONG other)
+{
+	return (LONG)((ULONG)position - (ULONG)other);
+}
+
+static const wchar_t* NameOf(int level)
+{
+	switch (level)
+	{
+	case SR_LOG_LEVEL_TRACE: return L"TRACE";
+	case SR_LOG_LEVEL_DEBUG: return L"DEBUG";
+	case SR_LOG_LEVEL_INFO: return L"INFO";
+	case SR_LOG_LEVEL_WARN: return L"WARN";
+	case SR_LOG_LEVEL_ERROR: return L"ERROR";
+	default: return L"????";
+	}
+}
+
+// Writes every line in Batch to the file
+static void WriteBatch()
+{
+	if (BatchLen == 0) return;
+
+	DWORD bytesWritten;
+	WriteFile(LogFile, Batch, (DWORD)BatchLen, &bytesWritten, NULL);
+	BatchLen = 0;
+}
+
+// Adds a line to Batch, writing Batch to the file first if the line doesn't fit
+static void AddLine(uint8_t level, const FILETIME* time, const wchar_t* message, size_t len)
+{
+	FILETIME localTime;
+	SYSTEMTIME date;
+	FileTimeToLocalFileTime(time, &localTime);
+	FileTimeToSystemTime(&localTime, &date);
 
-static wchar_t* VFormat(const wchar_t* format, va_list args)
+	// yyyy-MM-dd HH:mm:ss.SSS [LEVEL]
+	wchar_t line[SR_LOG_HEADER_SIZE + MESSAGE_SIZE + 2];
+	int headerLen = swprintf_s(line, SR_LOG_HEADER_SIZE, L"%04u-%02u-%02u %02u:%02u:%02u.%03u [%-5s] ", date.wYear, date.wMonth, date.wDay, date.wHour, date.wMinute, date.wSecond, date.wMilliseconds, NameOf(level));
+	if (headerLen < 0) headerLen = 0;
+
+	wmemcpy(line + headerLen, message, len);
+	size_t lineLen = headerLen + len;
+	line[lineLen++] = L'\r';
+	line[lineLen++] = L'\n';
+
+	// Every UTF-16 character takes at most three UTF-8 bytes
+	if (BatchLen + lineLen * 3 > BATCH_SIZE) WriteBatch();
+
+	BatchLen += WideCharToMultiByte(CP_UTF8, 0, line, (int)lineLen, Batch + BatchLen, (int)(BATCH_SIZE - BatchLen), NULL, NULL);
+}
+
+// Makes room for a record of a trace in Batch, writing Batch to the file first if the record doesn't fit
+static unsigned char* AddRecord(uint8_t type, size_t size)
 {
-	int needed = _vscwprintf(format, args);
+	if (BatchLen + 1 + size > BATCH_SIZE) WriteBatch();
 
-	size_t bufferLen = (size_t)needed + 1;
-	wchar_t* buffer = calloc(bufferLen, sizeof(wchar_t));
-	vswprintf_s(buffer, bufferLen, format, args);
+	unsigned char* record = (unsigned char*)Batch + BatchLen;
+	BatchLen += 1 + size;
 
-	return buffer;
+	record[0] = type;
+	return record + 1;
 }
 
-static wchar_t* Format(const wchar_t* format, ...)
+// Stores a field of a record, advancing past it
+static void PutField(unsigned char** record, const void* value, size_t size)
 {
-	va_list args;
-	va_start(args, format);
-	wchar_t* result = VFormat(format, args);
-	va_end(args);
+	memcpy(*record, value, size);
+	*record += size;
+}
+
+// Adds a message that was already formatted to Batch, as a line or as a trace record
+static void AddText(uint8_t level, const FILETIME* time, DWORD threadId, const wchar_t* message, size_t len)
+{
+	if (!Binary)
+	{
+		AddLine(level, time, message, len);
+		return;
+	}
+
+	unsigned char* record = AddRecord(SR_TRACE_RECORD_TEXT, 1 + 8 + 4 + 4 + len * sizeof(wchar_t));
+	uint32_t storedLen = (uint32_t)len;
+
+	PutField(&record, &level, 1);
+	PutField(&record, time, 8);
+	PutField(&record, &threadId, 4);
+	PutField(&record, &storedLen, 4);
+	PutField(&record, message, len * sizeof(wchar_t));
+}
+
+// Adds a message to Batch, along with its format if it wasn't written to the trace yet
+static void AddEntry(const Entry* entry)
+{
+	if (entry->Format == TEXT_FORMAT)
+	{
+		AddText(entry->Level, &entry->Time, entry->ThreadId, entry->Text, entry->Len);
+		return;
+	}
+
+	if (!FormatWritten[entry->Format])
+	{
+		const wchar_t* format = Formats[entry->Format].Format;
+		uint32_t formatLen = (uint32_t)wcslen(format);
+
+		unsigned char* formatRecord = AddRecord(SR_TRACE_RECORD_FORMAT, 4 + 4 + formatLen * sizeof(wchar_t));
+		PutField(&formatRecord, &entry->Format, 4);
+		PutField(&formatRecord, &formatLen, 4);
+		PutField(&formatRecord, format, formatLen * sizeof(wchar_t));
+
+		FormatWritten[entry->Format] = true;
+	}
+
+	unsigned char* record = AddRecord(SR_TRACE_RECORD_MESSAGE, 4 + 1 + 8 + 4 + 4 + entry->Len);
+	uint32_t size = (uint32_t)entry->Len;
+
+	PutField(&record, &entry->Format, 4);
+	PutField(&record, &entry->Level, 1);
+	PutField(&record, &entry->Time, 8);
+	PutField(&record, &entry->ThreadId, 4);
+	PutField(&record, &size, 4);
+	PutField(&record, entry->Data, entry->Len);
+}
 
-	return result;
+// Adds the record that starts a trace to Batch. The IDs of the formats written after it are relative to it.
+static void AddStartRecord()
+{
+	FILETIME now, localNow;
+	GetSystemTimeAsFileTime(&now);
+	FileTimeToLocalFileTime(&now, &localNow);
+
+	ULARGE_INTEGER utc, local;
+	utc.LowPart = now.dwLowDateTime;
+	utc.HighPart = now.dwHighDateTime;
+	local.LowPart = localNow.dwLowDateTime;
+	local.HighPart = localNow.dwHighDateTime;
+
+	uint32_t magic = SR_TRACE_MAGIC;
+	uint32_t version = SR_TRACE_VERSION;
+	int64_t offset = (int64_t)(local.QuadPart - utc.QuadPart);
+
+	unsigned char* record = AddRecord(SR_TRACE_RECORD_START, 4 + 4 + 8);
+	PutField(&record, &magic, 4);
+	PutField(&record, &version, 4);
+	PutField(&record, &offset, 8);
+
+	memset(FormatWritten, 0, sizeof(FormatWritten));
+}
+
+// Writes every message in the ring to the file, up to the first one that's still being written.
+// Must be called while holding DrainLock.
+static void Drain()
+{
+	for (;;)
+	{
+		Entry* entry = &Ring[ReadPosition & (RING_SIZE - 1)];
+		if (Distance(entry->Sequence, ReadPosition + 1) < 0) break;
+
+		AddEntry(entry);
+
+		// Free the slot for the producer that will be at this position in the next lap around the ring
+		InterlockedExchange(&entry->Sequence, ReadPosition + RING_SIZE);
+		ReadPosition++;
+	}
+
+	LONG dropped = InterlockedExchange(&Dropped, 0);
+	if (dropped > 0)
+	{
+		wchar_t message[64];
+		int len = swprintf_s(message, 64, L"%ld messages were dropped because the log buffer was full", dropped);
+
+		FILETIME time;
+		GetSystemTimeAsFileTime(&time);
+		AddText(SR_LOG_LEVEL_WARN, &time, GetCurrentThreadId(), message, len > 0 ? len : 0);
+	}
+
+	WriteBatch();
+}
+
+static VOID CALLBACK DrainTimerCallback(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_TIMER timer)
+{
+	(void)instance;
+	(void)context;
+	(void)timer;
+
+	// Messages logged from now on start the timer again, even if this drain also writes them
+	InterlockedExchange(&DrainScheduled, 0);
+
+	AcquireSRWLockExclusive(&DrainLock);
+	Drain();
+	ReleaseSRWLockExclusive(&DrainLock);
+}
+
+// Starts the timer that drains the ring, unless it's already started
+static void ScheduleDrain()
+{
+	if (DrainTimer == NULL || InterlockedExchange(&DrainScheduled, 1) != 0) return;
+
+	// A negative due time is relative, in 100 nanosecond units
+	ULARGE_INTEGER due;
+	due.QuadPart = (ULONGLONG)(-(LONGLONG)DRAIN_DELAY * 10000);
+
+	FILETIME dueTime;
+	dueTime.dwLowDateTime = due.LowPart;
+	dueTime.dwHighDateTime = due.HighPart;
+
+	SetThreadpoolTimer(DrainTimer, &dueTime, 0, 0);
+}
+
+// Finds the ID of a format in a trace, parsing the arguments it takes the first time it's logged.
+// Returns -1 if the format can't be stored in a trace or there's no room left for it.
+static LONG FindFormat(const wchar_t* format)
+{
+	// Fibonacci hashing of the address, so that nearby literals don't share a slot
+	size_t start = (size_t)(((uint64_t)(uintptr_t)format * 0x9E3779B97F4A7C15ull) >> (64 - FORMAT_TABLE_BITS));
+
+	for (size_t i = 0; i < FORMAT_TABLE_SIZE; i++)
+	{
+		size_t index = (start + i) & (FORMAT_TABLE_SIZE - 1);
+		FormatInfo* info = &Formats[index];
+
+		PVOID current = info->Format;
+		if (current == NULL)
+		{
+			current = InterlockedCompareExchangePointer(&info->Format, (PVOID)format, NULL);
+			if (current == NULL)
+			{
+				size_t count = SR_GetTraceArguments(format, info->Arguments);
+				info->ArgumentCount = (uint8_t)count;
+
+				InterlockedExchange(&info->State, count == SIZE_MAX ? -1 : 1);
+				return count == SIZE_MAX ? -1 : (LONG)index;
+			}
+		}
+
+		// Another thread that is still parsing the format is not waited for, the message is just formatted instead
+		if (current == format) return info->State == 1 ? (LONG)index : -1;
+	}
+
+	return -1;
 }
 
 void SR_StartLogging()
@@ -50,8 +376,28 @@ void SR_StartLogging()
 		if (config->Logging.Append)
 			creationDisposition = OPEN_ALWAYS;
 
+		for (LONG i = 0; i < RING_SIZE; i++)
+			Ring[i].Sequence = i;
+
+		WritePosition = 0;
+		ReadPosition = 0;
+		Dropped = 0;
+		DrainScheduled = 0;
+		Binary = config->Logging.Binary;
+
+		// Traces are kept apart from text logs, so that appending never mixes them
+		wchar_t* file = config->Logging.File;
+		if (Binary)
+		{
+			size_t fileSize = wcslen(config->Logging.File) + 5;
+			file = malloc(fileSize * sizeof(wchar_t));
+			swprintf_s(file, fileSize, L"%ls.bin", config->Logging.File);
+		}
+
+		// The log may be opened again while the hooks are attached, and its file must never be redirected
+		SR_EnterRedirector();
 		LogFile = CreateFileW(
-			config->Logging.File,
+			file,
 			FILE_APPEND_DATA,
 			FILE_SHARE_DELETE | FILE_SHARE_READ | FILE_SHARE_WRITE,
 			NULL,
@@ -59,60 +405,147 @@ void SR_StartLogging()
 			FILE_ATTRIBUTE_NORMAL,
 			NULL
 		);
+		SR_LeaveRedirector();
+
+		if (Binary) free(file);
+
+		if (LogFile != INVALID_HANDLE_VALUE)
+		{
+			if (Binary)
+			{
+				AddStartRecord();
+				WriteBatch();
+			}
+
+			DrainTimer = CreateThreadpoolTimer(DrainTimerCallback, NULL, NULL);
+			SR_LogLevel = config->Logging.Level;
+		}
 	}
 
 	SR_INFO("Skyrim Redirector by Davipb started. github.com/Davipb/SkyrimRedirector");
 	SR_INFO("Platform: %ls", SR_PLATFORM_IDENTIFIER_W);
+
+	// Without the timer, the ring is only drained when logging stops, so everything after the first messages is dropped
+	if (LogFile != INVALID_HANDLE_VALUE && DrainTimer == NULL)
+		SR_WARN("Unable to create the timer that writes the log, only the first %d messages will be written", RING_SIZE);
 }
 
-void SR_StopLogging()
+void SR_StopLogging(bool processExiting)
 {
 	if (LogFile == INVALID_HANDLE_VALUE) return;
 
 	SR_INFO("Skyrim Redirector stopped.");
+	SR_LogLevel = SR_LOG_LEVEL_OFF;
+
+	PTP_TIMER timer = DrainTimer;
+	DrainTimer = NULL;
+
+	// When the process is exiting, the threadpool threads were already terminated, so there's nothing to wait for
+	if (timer != NULL && !processExiting)
+	{
+		SetThreadpoolTimer(timer, NULL, 0, 0);
+		WaitForThreadpoolTimerCallbacks(timer, TRUE);
+		CloseThreadpoolTimer(timer);
+	}
+
+	// A threadpool thread terminated while draining never releases the lock, but then it can't be draining either
+	bool locked = TryAcquireSRWLockExclusive(&DrainLock);
+	if (!locked && !processExiting)
+	{
+		AcquireSRWLockExclusive(&DrainLock);
+		locked = true;
+	}
+
+	Drain();
+	if (locked) ReleaseSRWLockExclusive(&DrainLock);
+
 	CloseHandle(LogFile);
 	LogFile = INVALID_HANDLE_VALUE;
 }
 
-static const wchar_t* NameOf(int level)
+// Claims the slot at the current position of the ring, unless the consumer didn't free it yet.
+// Returns NULL if the message has to be dropped.
+static Entry* ReserveEntry(LONG* position)
 {
-	switch (level)
+	LONG current = WritePosition;
+	for (;;)
 	{
-	case SR_LOG_LEVEL_TRACE: return L"TRACE";
-	case SR_LOG_LEVEL_DEBUG: return L"DEBUG";
-	case SR_LOG_LEVEL_INFO: return L"INFO";
-	case SR_LOG_LEVEL_WARN: return L"WARN";
-	case SR_LOG_LEVEL_ERROR: return L"ERROR";
-	default: return L"????";
+		Entry* entry = &Ring[current & (RING_SIZE - 1)];
+		LONG distance = Distance(entry->Sequence, current);
+
+		if (distance < 0)
+		{
+			InterlockedIncrement(&Dropped);
+			ScheduleDrain();
+			return NULL;
+		}
+
+		if (distance == 0)
+		{
+			LONG previous = InterlockedCompareExchange(&WritePosition, current + 1, current);
+			if (previous == current)
+			{
+				*position = current;
+				return entry;
+			}
+
+			current = previous;
+		}
+		else
+		{
+			// Another thread claimed this slot first
+			current = WritePosition;
+		}
 	}
 }
 
+// Publishes a message, then makes sure a drain will see it
+static void PublishEntry(Entry* entry, LONG position)
+{
+	InterlockedExchange(&entry->Sequence, position + 1);
+	ScheduleDrain();
+}
+
 void SR_Log(uint8_t level, const wchar_t* message, ...)
 {
-	if (level < SR_GetUserConfig()->Logging.Level || LogFile == INVALID_HANDLE_VALUE) return;
+	// The macros already checked the level, but the log may have been closed since
+	if (level < SR_LogLevel || LogFile == INVALID_HANDLE_VALUE) return;
 
-	SYSTEMTIME time;
-	GetLocalTime(&time);
+	LONG position;
+	Entry* entry = ReserveEntry(&position);
+	if (entry == NULL) return;
 
-	// yyyy-MM-dd HH:mm:ss.SSS [LEVEL] 
-	wchar_t* buffer = Format(L"%04u-%02u-%02u %02u:%02u:%02u.%03u [%-5s] ", time.wYear, time.wMonth, time.wDay, time.wHour, time.wMinute, time.wSecond, time.wMilliseconds, NameOf(level));
+	entry->Level = (uint8_t)level;
+	entry->ThreadId = GetCurrentThreadId();
+	GetSystemTimeAsFileTime(&entry->Time);
 
 	va_list args;
 	va_start(args, message);
-	wchar_t* fmtMessage = VFormat(message, args);
-	va_end(args);
 
-	// Date + Message + "\r\n" + '\0'
-	size_t totalLen = wcslen(buffer) + wcslen(fmtMessage) + 3;
-	buffer = realloc(buffer, totalLen * sizeof(wchar_t));
-	wcscat_s(buffer, totalLen, fmtMessage);
-	free(fmtMessage);
-	wcscat_s(buffer, totalLen, L"\r\n");
+	LONG format = Binary ? FindFormat(message) : -1;
+	if (format >= 0)
+	{
+		const FormatInfo* info = &Formats[format];
 
-	char* result = SR_Utf16ToUtf8(buffer);
-	free(buffer);
+		entry->Format = (uint32_t)format;
+		entry->Len = SR_EncodeTraceArguments(info->Arguments, info->ArgumentCount, args, entry->Data, sizeof(entry->Data));
+	}
+	else
+	{
+		int len = _vsnwprintf_s(entry->Text, MESSAGE_SIZE, _TRUNCATE, message, args);
 
-	DWORD bytesWritten;
-	WriteFile(LogFile, result, (DWORD)strlen(result), &bytesWritten, NULL);
-	free(result);
+		// Mark truncated messages so that they aren't mistaken for complete ones
+		if (len < 0)
+		{
+			len = MESSAGE_SIZE - 1;
+			wmemcpy(entry->Text + len - 3, L"...", 3);
+		}
+
+		entry->Format = TEXT_FORMAT;
+		entry->Len = (size_t)len;
+	}
+
+	va_end(args);
+
+	PublishEntry(entry, position);
 }
@@ -1,9 +1,13 @@
 #pragma once
 #include <wchar.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 void SR_StartLogging();
-void SR_StopLogging();
+
+// Writes every message that wasn't written yet and closes the log.
+//  processExiting: If the whole process is exiting, in which case the other threads were already terminated
+void SR_StopLogging(bool processExiting);
 void SR_Log(uint8_t level, const wchar_t* message, ...);
 
 enum
@@ -16,8 +20,44 @@ enum
 	SR_LOG_LEVEL_OFF
 };
 
-#define SR_TRACE(message, ...) SR_Log(SR_LOG_LEVEL_TRACE, L##message, __VA_ARGS__)
-#define SR_DEBUG(message, ...) SR_Log(SR_LOG_LEVEL_DEBUG, L##message, __VA_ARGS__)
-#define SR_INFO(message, ...) SR_Log(SR_LOG_LEVEL_INFO, L##message, __VA_ARGS__)
-#define SR_WARN(message, ...) SR_Log(SR_LOG_LEVEL_WARN, L##message, __VA_ARGS__)
-#define SR_ERROR(message, ...) SR_Log(SR_LOG_LEVEL_ERROR, L##message, __VA_ARGS__)
+// The lowest level of the messages that are compiled in, as a number: 0 for TRACE up to 5 for OFF.
+// Messages below it are removed at compile time, along with their arguments, whatever the configured level.
+#ifndef SR_LOG_FLOOR
+#define SR_LOG_FLOOR 0
+#endif
+
+// The configured log level, or SR_LOG_LEVEL_OFF while the log isn't open.
+// Checked before a message's arguments are evaluated, so that a disabled message costs a single comparison.
+extern volatile uint8_t SR_LogLevel;
+
+#define SR_LOG_AT(level, message, ...) ((level) >= SR_LogLevel ? SR_Log((level), L##message, __VA_ARGS__) : (void)0)
+
+#if SR_LOG_FLOOR <= 0
+#define SR_TRACE(message, ...) SR_LOG_AT(SR_LOG_LEVEL_TRACE, message, __VA_ARGS__)
+#else
+#define SR_TRACE(message, ...) ((void)0)
+#endif
+
+#if SR_LOG_FLOOR <= 1
+#define SR_DEBUG(message, ...) SR_LOG_AT(SR_LOG_LEVEL_DEBUG, message, __VA_ARGS__)
+#else
+#define SR_DEBUG(message, ...) ((void)0)
+#endif
+
+#if SR_LOG_FLOOR <= 2
+#define SR_INFO(message, ...) SR_LOG_AT(SR_LOG_LEVEL_INFO, message, __VA_ARGS__)
+#else
+#define SR_INFO(message, ...) ((void)0)
+#endif
+
+#if SR_LOG_FLOOR <= 3
+#define SR_WARN(message, ...) SR_LOG_AT(SR_LOG_LEVEL_WARN, message, __VA_ARGS__)
+#else
+#define SR_WARN(message, ...) ((void)0)
+#endif
+
+#if SR_LOG_FLOOR <= 4
+#define SR_ERROR(message, ...) SR_LOG_AT(SR_LOG_LEVEL_ERROR, message, __VA_ARGS__)
+#else
+#define SR_ERROR(message, ...) ((void)0)
+#endif
@@ -3,6 +3,9 @@
 #include "Logging.h"
 #include "Redirector.h"
 #include "Config.h"
+#include "Redirections.h"
+#include "Paths.h"
+#include "Epoch.h"
 #include <Windows.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -40,23 +43,50 @@ __declspec(dllexport) bool SKSEPlugin_Load(const SKSEInterface* skse)
 {
 	(void)skse;
 
+	// The config, the log and the redirections all build their paths from the same few folders
+	SR_ResolvePaths();
+
 	SR_StartLogging();
 	SR_DEBUG("SKSE load request received");
 
 	SR_ValidateUserConfig();
-	return SR_AttachRedirector();
+	bool result = SR_AttachRedirector();
+
+	SR_LogPathTimings();
+	return result;
+}
+
+// Lets the test program check that path matching doesn't allocate memory
+__declspec(dllexport) long SR_Test_GetMatcherAllocationCount()
+{
+	return SR_GetMatcherAllocationCount();
+}
+
+// Lets the test program check that the redirector's own I/O never goes through the matcher
+__declspec(dllexport) long SR_Test_GetMatcherCallCount()
+{
+	return SR_GetThreadMatcherCallCount();
 }
 
 BOOL WINAPI DllMain(HINSTANCE hinst, DWORD dwReason, LPVOID reserved)
 {
 	(void)hinst;
-	(void)reserved;
+
+	if (dwReason == DLL_THREAD_DETACH)
+	{
+		SR_FreeThreadRedirectionBuffers();
+		SR_FreeThreadEpoch();
+		return TRUE;
+	}
 
 	if (dwReason == DLL_PROCESS_DETACH)
 	{
-		bool result = SR_DetachRedirector();
-		SR_StopLogging();
+		// `reserved` is only set when the whole process is exiting, instead of only this DLL being unloaded
+		bool result = SR_DetachRedirector(reserved != NULL);
+		SR_FreeThreadRedirectionBuffers();
+		SR_StopLogging(reserved != NULL);
 		SR_FreeUserConfig();
+		SR_FreePaths();
 
 		return result;
 	}
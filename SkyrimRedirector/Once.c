@@ -0,0 +1,33 @@
+#include "SR_Base.h"
+#include "Once.h"
+
+static BOOL CALLBACK CreateCallback(PINIT_ONCE initOnce, PVOID parameter, PVOID* context)
+{
+	(void)initOnce;
+
+	// A function pointer can't be passed as a PVOID without a warning, so it's passed by address instead
+	SR_OnceCreate create = *(SR_OnceCreate*)parameter;
+	*context = create();
+
+	return *context != NULL;
+}
+
+void* SR_CreateOnce(SR_Once* once, SR_OnceCreate create)
+{
+	void* value = NULL;
+	if (!InitOnceExecuteOnce(&once->Once, CreateCallback, &create, &value)) return NULL;
+
+	// Every thread that waited publishes the same value, which is harmless
+	WritePointerRelease(&once->Value, value);
+	return value;
+}
+
+void* SR_ResetOnce(SR_Once* once)
+{
+	void* value = once->Value;
+
+	once->Value = NULL;
+	InitOnceInitialize(&once->Once);
+
+	return value;
+}
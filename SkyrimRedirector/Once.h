@@ -0,0 +1,48 @@
+#pragma once
+#include <Windows.h>
+
+/*
+One-time initialization
+
+A value that's created the first time it's needed, by a single thread, even if several threads need it at once.
+Once it's been created, getting it is a single acquire load, without any locks or interlocked operations, so hooks
+called by many game threads at the same time never wait on each other, and never see a half-created value.
+
+Threads that need the value while it's being created wait for it inside InitOnceExecuteOnce instead of creating
+their own copy.
+*/
+
+typedef struct
+{
+	// The value, only set after it's been fully created
+	void* volatile Value;
+
+	INIT_ONCE Once;
+
+} SR_Once;
+
+#define SR_ONCE_INIT { NULL, INIT_ONCE_STATIC_INIT }
+
+// Creates a value. If it returns NULL, the value is created again the next time it's needed.
+typedef void* (*SR_OnceCreate)();
+
+// Creates the value if no other thread did it yet, waiting for the one that's creating it if there is one.
+// Returns the value, or NULL if it couldn't be created. Use SR_GetOnce instead, which only calls this when needed.
+void* SR_CreateOnce(SR_Once* once, SR_OnceCreate create);
+
+// Gets the value, or NULL if it wasn't created yet
+static __forceinline void* SR_PeekOnce(SR_Once* once)
+{
+	return ReadPointerAcquire(&once->Value);
+}
+
+// Gets the value, creating it first if needed
+static __forceinline void* SR_GetOnce(SR_Once* once, SR_OnceCreate create)
+{
+	void* value = SR_PeekOnce(once);
+	return value != NULL ? value : SR_CreateOnce(once, create);
+}
+
+// Takes the value out, so that it's created again the next time it's needed, and returns it so it can be freed.
+// No other thread can be using the value or creating it.
+void* SR_ResetOnce(SR_Once* once);
@@ -0,0 +1,317 @@
+#include "SR_Base.h"
+#include "PathScan.h"
+
+#include <stdint.h>
+
+// SSE2 is part of every x64 processor, and 32-bit builds use it when they target it; only AVX2 needs to be detected
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || (defined(__i386__) && defined(__SSE2__))
+#define PATH_SCAN_SIMD
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+// Lets a single function use AVX2 without letting the compiler use it anywhere else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+// The aligned blocks are read past the end of the path, which is safe but not something AddressSanitizer can know
+#define NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#else
+#define TARGET_AVX2
+#define NO_SANITIZE_ADDRESS
+#endif
+
+// wchar_t is 16 bits on Windows, but 32 bits on most other platforms
+#if WCHAR_MAX > 0xFFFF
+#define CMPEQ_128W _mm_cmpeq_epi32
+#define SET1_128W _mm_set1_epi32
+#define CMPEQ_256W _mm256_cmpeq_epi32
+#define SET1_256W _mm256_set1_epi32
+#else
+#define CMPEQ_128W _mm_cmpeq_epi16
+#define SET1_128W _mm_set1_epi16
+#define CMPEQ_256W _mm256_cmpeq_epi16
+#define SET1_256W _mm256_set1_epi16
+#endif
+
+#define SSE2_BLOCK_SIZE 16
+#define AVX2_BLOCK_SIZE 32
+
+// The instructions used to scan paths, or -1 until they're detected.
+// Detecting them always gives the same result, so threads that detect them at the same time all store the same value.
+static volatile int Level = -1;
+
+#ifdef PATH_SCAN_SIMD
+
+#ifdef _MSC_VER
+static unsigned int LowestBit(uint32_t mask)
+{
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return index;
+}
+
+static unsigned int HighestBit(uint32_t mask)
+{
+	unsigned long index;
+	_BitScanReverse(&index, mask);
+	return index;
+}
+#else
+static unsigned int LowestBit(uint32_t mask) { return (unsigned int)__builtin_ctz(mask); }
+static unsigned int HighestBit(uint32_t mask) { return 31 - (unsigned int)__builtin_clz(mask); }
+#endif
+
+// Checks if the processor and the operating system support AVX2
+static bool SupportsAvx2()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+
+	// The operating system must save the AVX registers when switching threads
+	__cpuid(info, 1);
+	bool hasAvx = (info[2] & (1 << 28)) != 0;
+	bool hasXsave = (info[2] & (1 << 27)) != 0;
+	if (!hasAvx || !hasXsave || (_xgetbv(0) & 6) != 6) return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+// Records the separators in a block, and the end of the path if it's in the block.
+//  block: The address of the block
+//  nulls: Bit N is set if byte N of the block is part of a null character inside the path, or after it
+//  separators: Bit N is set if byte N of the block is part of a separator inside the path, or after it
+//  separator: The address of the last separator found so far, which is updated with the ones in this block
+// Returns the address of the terminating null, or NULL if it isn't in this block.
+static const char* ScanBlock(const char* block, uint32_t nulls, uint32_t separators, const char** separator)
+{
+	if (nulls == 0)
+	{
+		if (separators != 0) *separator = block + HighestBit(separators);
+		return NULL;
+	}
+
+	// Anything after the terminating null is just whatever is in memory after the path
+	unsigned int end = LowestBit(nulls);
+	separators &= ((uint32_t)1 << end) - 1;
+
+	if (separators != 0) *separator = block + HighestBit(separators);
+	return block + end;
+}
+
+// Converts the addresses found by a scan into the index of the file name and the length of the path
+//  separator: The address of any byte of the last separator, or NULL if the path has none
+//  end: The address of the terminating null
+static size_t FinishScan(const char* start, const char* separator, const char* end, size_t charSize, size_t* len)
+{
+	*len = (size_t)(end - start) / charSize;
+	return separator == NULL ? 0 : (size_t)(separator - start) / charSize + 1;
+}
+
+#endif
+
+static size_t FindFileNameScalarW(const wchar_t* path, size_t* len)
+{
+	size_t fileName = 0;
+	size_t i = 0;
+
+	for (; path[i] != L'\0'; i++)
+	{
+		if (path[i] == L'\\' || path[i] == L'/') fileName = i + 1;
+	}
+
+	*len = i;
+	return fileName;
+}
+
+static size_t FindFileNameScalarA(const char* path, size_t* len)
+{
+	size_t fileName = 0;
+	size_t i = 0;
+
+	for (; path[i] != '\0'; i++)
+	{
+		if (path[i] == '\\' || path[i] == '/') fileName = i + 1;
+	}
+
+	*len = i;
+	return fileName;
+}
+
+#ifdef PATH_SCAN_SIMD
+
+NO_SANITIZE_ADDRESS
+static size_t FindFileNameSse2W(const wchar_t* path, size_t* len)
+{
+	const __m128i nul = _mm_setzero_si128();
+	const __m128i back = SET1_128W(L'\\');
+	const __m128i forward = SET1_128W(L'/');
+
+	const char* start = (const char*)path;
+	const char* block = (const char*)((uintptr_t)start & ~(uintptr_t)(SSE2_BLOCK_SIZE - 1));
+	const char* separator = NULL;
+
+	// The bytes of the first block that come before the path
+	uint32_t before = ((uint32_t)1 << (unsigned int)(start - block)) - 1;
+
+	while (true)
+	{
+		__m128i chars = _mm_load_si128((const __m128i*)block);
+		uint32_t nulls = (uint32_t)_mm_movemask_epi8(CMPEQ_128W(chars, nul)) & ~before;
+		uint32_t separators = (uint32_t)_mm_movemask_epi8(_mm_or_si128(CMPEQ_128W(chars, back), CMPEQ_128W(chars, forward))) & ~before;
+
+		const char* end = ScanBlock(block, nulls, separators, &separator);
+		if (end != NULL) return FinishScan(start, separator, end, sizeof(wchar_t), len);
+
+		block += SSE2_BLOCK_SIZE;
+		before = 0;
+	}
+}
+
+NO_SANITIZE_ADDRESS
+static size_t FindFileNameSse2A(const char* path, size_t* len)
+{
+	const __m128i nul = _mm_setzero_si128();
+	const __m128i back = _mm_set1_epi8('\\');
+	const __m128i forward = _mm_set1_epi8('/');
+
+	const char* block = (const char*)((uintptr_t)path & ~(uintptr_t)(SSE2_BLOCK_SIZE - 1));
+	const char* separator = NULL;
+
+	// The bytes of the first block that come before the path
+	uint32_t before = ((uint32_t)1 << (unsigned int)(path - block)) - 1;
+
+	while (true)
+	{
+		__m128i chars = _mm_load_si128((const __m128i*)block);
+		uint32_t nulls = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chars, nul)) & ~before;
+		uint32_t separators = (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chars, back), _mm_cmpeq_epi8(chars, forward))) & ~before;
+
+		const char* end = ScanBlock(block, nulls, separators, &separator);
+		if (end != NULL) return FinishScan(path, separator, end, sizeof(char), len);
+
+		block += SSE2_BLOCK_SIZE;
+		before = 0;
+	}
+}
+
+TARGET_AVX2 NO_SANITIZE_ADDRESS
+static size_t FindFileNameAvx2W(const wchar_t* path, size_t* len)
+{
+	const __m256i nul = _mm256_setzero_si256();
+	const __m256i back = SET1_256W(L'\\');
+	const __m256i forward = SET1_256W(L'/');
+
+	const char* start = (const char*)path;
+	const char* block = (const char*)((uintptr_t)start & ~(uintptr_t)(AVX2_BLOCK_SIZE - 1));
+	const char* separator = NULL;
+
+	// The bytes of the first block that come before the path
+	uint32_t before = ((uint32_t)1 << (unsigned int)(start - block)) - 1;
+
+	while (true)
+	{
+		__m256i chars = _mm256_load_si256((const __m256i*)block);
+		uint32_t nulls = (uint32_t)_mm256_movemask_epi8(CMPEQ_256W(chars, nul)) & ~before;
+		uint32_t separators = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(CMPEQ_256W(chars, back), CMPEQ_256W(chars, forward))) & ~before;
+
+		const char* end = ScanBlock(block, nulls, separators, &separator);
+		if (end != NULL) return FinishScan(start, separator, end, sizeof(wchar_t), len);
+
+		block += AVX2_BLOCK_SIZE;
+		before = 0;
+	}
+}
+
+TARGET_AVX2 NO_SANITIZE_ADDRESS
+static size_t FindFileNameAvx2A(const char* path, size_t* len)
+{
+	const __m256i nul = _mm256_setzero_si256();
+	const __m256i back = _mm256_set1_epi8('\\');
+	const __m256i forward = _mm256_set1_epi8('/');
+
+	const char* block = (const char*)((uintptr_t)path & ~(uintptr_t)(AVX2_BLOCK_SIZE - 1));
+	const char* separator = NULL;
+
+	// The bytes of the first block that come before the path
+	uint32_t before = ((uint32_t)1 << (unsigned int)(path - block)) - 1;
+
+	while (true)
+	{
+		__m256i chars = _mm256_load_si256((const __m256i*)block);
+		uint32_t nulls = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, nul)) & ~before;
+		uint32_t separators = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chars, back), _mm256_cmpeq_epi8(chars, forward))) & ~before;
+
+		const char* end = ScanBlock(block, nulls, separators, &separator);
+		if (end != NULL) return FinishScan(path, separator, end, sizeof(char), len);
+
+		block += AVX2_BLOCK_SIZE;
+		before = 0;
+	}
+}
+
+#endif
+
+// Gets the fastest instructions the processor supports
+static SR_PathScanLevel DetectLevel()
+{
+#ifdef PATH_SCAN_SIMD
+	return SupportsAvx2() ? SR_PATH_SCAN_AVX2 : SR_PATH_SCAN_SSE2;
+#else
+	return SR_PATH_SCAN_SCALAR;
+#endif
+}
+
+SR_PathScanLevel SR_GetPathScanLevel()
+{
+	int level = Level;
+	if (level < 0)
+	{
+		level = (int)DetectLevel();
+		Level = level;
+	}
+
+	return (SR_PathScanLevel)level;
+}
+
+bool SR_SetPathScanLevel(SR_PathScanLevel level)
+{
+	if (level > DetectLevel()) return false;
+
+	Level = (int)level;
+	return true;
+}
+
+size_t SR_FindFileNameW(const wchar_t* path, size_t* len)
+{
+#ifdef PATH_SCAN_SIMD
+	// The characters are only aligned to the blocks if the path is aligned to its character size
+	if (((uintptr_t)path & (sizeof(wchar_t) - 1)) == 0)
+	{
+		SR_PathScanLevel level = SR_GetPathScanLevel();
+		if (level == SR_PATH_SCAN_AVX2) return FindFileNameAvx2W(path, len);
+		if (level == SR_PATH_SCAN_SSE2) return FindFileNameSse2W(path, len);
+	}
+#endif
+
+	return FindFileNameScalarW(path, len);
+}
+
+size_t SR_FindFileNameA(const char* path, size_t* len)
+{
+#ifdef PATH_SCAN_SIMD
+	SR_PathScanLevel level = SR_GetPathScanLevel();
+	if (level == SR_PATH_SCAN_AVX2) return FindFileNameAvx2A(path, len);
+	if (level == SR_PATH_SCAN_SSE2) return FindFileNameSse2A(path, len);
+#endif
+
+	return FindFileNameScalarA(path, len);
+}
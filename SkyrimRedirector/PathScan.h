@@ -0,0 +1,45 @@
+#pragma once
+#include <wchar.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+Path scanning
+
+Finds where the file name of a path starts, along with the length of the whole path, in a single pass over it.
+Looking for the last '\' and then for the last '/' with wcsrchr reads the whole path twice, once for each kind of
+separator, and finding its length reads it a third time.
+
+The path is read one 32-byte (AVX2) or 16-byte (SSE2) block at a time, comparing every character in the block against
+both separators and the terminating null at once. The blocks are aligned, so the reads past the end of the path never
+cross into a page the path isn't in. Processors without SSE2, and paths that aren't aligned to their character size,
+are read one character at a time instead.
+
+This file doesn't depend on Windows, so it can be tested and benchmarked on any platform.
+*/
+
+// The instructions used to scan paths
+typedef enum
+{
+	SR_PATH_SCAN_SCALAR,
+	SR_PATH_SCAN_SSE2,
+	SR_PATH_SCAN_AVX2,
+
+} SR_PathScanLevel;
+
+// Gets the instructions used to scan paths, which are the fastest ones the processor supports
+SR_PathScanLevel SR_GetPathScanLevel();
+
+// Changes the instructions used to scan paths, so that they can be compared against each other.
+// Returns false, without changing them, if the processor doesn't support them.
+bool SR_SetPathScanLevel(SR_PathScanLevel level);
+
+// Finds the file name of a wide path, which is everything after its last '\' or '/', or the whole path if it has none.
+//  len: Receives the length of the whole path
+// Returns the index of the first character of the file name, which is `*len` if the path ends with a separator.
+size_t SR_FindFileNameW(const wchar_t* path, size_t* len);
+
+// Finds the file name of a narrow path, which is everything after its last '\' or '/', or the whole path if it has none.
+//  len: Receives the length of the whole path
+// Returns the index of the first character of the file name, which is `*len` if the path ends with a separator.
+size_t SR_FindFileNameA(const char* path, size_t* len);
@@ -0,0 +1,141 @@
+#include "SR_Base.h"
+#include "Paths.h"
+#include "Logging.h"
+#include "WindowsUtils.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <ShlObj.h>
+#include <Windows.h>
+
+// A resolved path, along with what it cost to resolve and how many times it was used
+typedef struct
+{
+	wchar_t* Path;
+
+	// Time it took to ask Windows for this path, in milliseconds
+	double Milliseconds;
+
+	// Number of times the path was used. Every use but the first would have asked Windows for it again.
+	volatile LONG Lookups;
+
+} ResolvedPath;
+
+static ResolvedPath ModuleDir = { 0 };
+static ResolvedPath Documents = { 0 };
+static ResolvedPath LocalAppData = { 0 };
+
+static bool Resolved = false;
+
+static double ElapsedMilliseconds(LARGE_INTEGER start)
+{
+	LARGE_INTEGER end, frequency;
+	QueryPerformanceCounter(&end);
+	QueryPerformanceFrequency(&frequency);
+
+	return (double)(end.QuadPart - start.QuadPart) * 1000.0 / (double)frequency.QuadPart;
+}
+
+// Gets the folder of the running executable.
+// The returned string is allocated dynamically and must be freed.
+static wchar_t* GetModuleDir()
+{
+	// Exponentially increase the buffer size until it fits the full module file name
+	DWORD moduleFilePathSize = 16;
+	wchar_t* moduleFilePath = NULL;
+	do
+	{
+		moduleFilePathSize *= 2;
+		moduleFilePath = realloc(moduleFilePath, moduleFilePathSize * sizeof(wchar_t));
+		GetModuleFileNameW(NULL, moduleFilePath, moduleFilePathSize);
+
+	} while (GetLastError() == ERROR_INSUFFICIENT_BUFFER);
+
+	// The folder is the module file path until its last path separator
+	wchar_t* separator = wcsrchr(moduleFilePath, L'\\');
+	if (separator != NULL) *separator = L'\0';
+
+	// Trim buffer to fit string exactly
+	size_t actualSize = wcslen(moduleFilePath) + 1;
+	return realloc(moduleFilePath, actualSize * sizeof(wchar_t));
+}
+
+static void ResolveModuleDir()
+{
+	LARGE_INTEGER start;
+	QueryPerformanceCounter(&start);
+
+	ModuleDir.Path = GetModuleDir();
+	ModuleDir.Milliseconds = ElapsedMilliseconds(start);
+}
+
+static void ResolveKnownFolder(ResolvedPath* resolved, const KNOWNFOLDERID* const rfid)
+{
+	LARGE_INTEGER start;
+	QueryPerformanceCounter(&start);
+
+	resolved->Path = SR_GetKnownFolder(rfid);
+	resolved->Milliseconds = ElapsedMilliseconds(start);
+}
+
+void SR_ResolvePaths()
+{
+	if (Resolved) return;
+
+	ResolveModuleDir();
+	ResolveKnownFolder(&Documents, &FOLDERID_Documents);
+	ResolveKnownFolder(&LocalAppData, &FOLDERID_LocalAppData);
+
+	Resolved = true;
+}
+
+// Counts a use of a path and returns it, resolving every path first if needed
+static const wchar_t* Lookup(ResolvedPath* resolved)
+{
+	SR_ResolvePaths();
+
+	InterlockedIncrement(&resolved->Lookups);
+	return resolved->Path;
+}
+
+const wchar_t* SR_GetModuleDir() { return Lookup(&ModuleDir); }
+const wchar_t* SR_GetDocumentsDir() { return Lookup(&Documents); }
+const wchar_t* SR_GetLocalAppDataDir() { return Lookup(&LocalAppData); }
+
+// Time saved by not resolving a path again every time it was used, in milliseconds
+static double SavedMilliseconds(const ResolvedPath* resolved)
+{
+	if (resolved->Lookups <= 1) return 0;
+	return resolved->Milliseconds * (resolved->Lookups - 1);
+}
+
+void SR_LogPathTimings()
+{
+	if (!Resolved) return;
+
+	double resolving = ModuleDir.Milliseconds + Documents.Milliseconds + LocalAppData.Milliseconds;
+	double saved = SavedMilliseconds(&ModuleDir) + SavedMilliseconds(&Documents) + SavedMilliseconds(&LocalAppData);
+	LONG lookups = ModuleDir.Lookups + Documents.Lookups + LocalAppData.Lookups;
+
+	SR_INFO("Resolved the startup paths in %.3f ms, and sharing them among %ld lookups saved about %.3f ms", resolving, lookups, saved);
+	SR_DEBUG("Module folder: '%ls' (%.3f ms, %ld lookups)", ModuleDir.Path, ModuleDir.Milliseconds, ModuleDir.Lookups);
+	SR_DEBUG("Documents: '%ls' (%.3f ms, %ld lookups)", Documents.Path, Documents.Milliseconds, Documents.Lookups);
+	SR_DEBUG("Local AppData: '%ls' (%.3f ms, %ld lookups)", LocalAppData.Path, LocalAppData.Milliseconds, LocalAppData.Lookups);
+}
+
+static void FreeResolvedPath(ResolvedPath* resolved)
+{
+	free(resolved->Path);
+	resolved->Path = NULL;
+	resolved->Milliseconds = 0;
+	resolved->Lookups = 0;
+}
+
+void SR_FreePaths()
+{
+	FreeResolvedPath(&ModuleDir);
+	FreeResolvedPath(&Documents);
+	FreeResolvedPath(&LocalAppData);
+
+	Resolved = false;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <wchar.h>
+
+/*
+Resolved paths
+
+The folders every other path of the plugin is built from: the folder of the running executable, the Documents folder
+and the Local AppData folder. Asking Windows for them is slow compared to everything else done while loading, and the
+config, the log and the redirections used to ask for each of them several times, so they're resolved together once,
+when the plugin is loaded, and shared from then on.
+
+Every returned path is absolute, has no trailing separator and stays valid until SR_FreePaths is called.
+*/
+
+// Resolves every path, if they weren't resolved yet
+void SR_ResolvePaths();
+
+// Gets the folder of the running executable
+const wchar_t* SR_GetModuleDir();
+
+// Gets the current user's Documents folder
+const wchar_t* SR_GetDocumentsDir();
+
+// Gets the current user's Local AppData folder
+const wchar_t* SR_GetLocalAppDataDir();
+
+// Writes how long resolving the paths took, and about how much time sharing them saved, to the log
+void SR_LogPathTimings();
+
+// Frees the resolved paths. They're resolved again the next time they're needed.
+void SR_FreePaths();
@@ -4,164 +4,460 @@
 #include "StringUtils.h"
 #include "Config.h"
 #include "WindowsUtils.h"
+#include "Paths.h"
+#include "RuleTrie.h"
+#include "HookStats.h"
+#include "IniCache.h"
+#include "Once.h"
+#include "Epoch.h"
+#include "ExportResolver.h"
 #include "PlatformDefinitions.h"
 
 #include <ShlObj.h>
 #include <stdbool.h>
-
-#define BASE_NAME_SKYRIM_INI_W        L"SKYRIM.INI"
-#define BASE_NAME_SKYRIM_PREFS_INI_W  L"SKYRIMPREFS.INI"
-#define BASE_NAME_SKYRIM_CUSTOM_INI_W L"SKYRIMCUSTOM.INI"
-#define BASE_NAME_PLUGINS_TXT_W       L"PLUGINS.TXT"
-
-#define BASE_NAME_SKYRIM_INI_A         "SKYRIM.INI"
-#define BASE_NAME_SKYRIM_PREFS_INI_A   "SKYRIMPREFS.INI"
-#define BASE_NAME_SKYRIM_CUSTOM_INI_A  "SKYRIMCUSTOM.INI"
-#define BASE_NAME_PLUGINS_TXT_A        "PLUGINS.TXT"
+#include <string.h>
 
 #define PATH_SKYRIM_INI_W            L"MY GAMES\\SKYRIM" SR_FOLDER_SUFFIX_W L"\\SKYRIM.INI"
 #define PATH_SKYRIM_PREFS_INI_W      L"MY GAMES\\SKYRIM" SR_FOLDER_SUFFIX_W L"\\SKYRIMPREFS.INI"
 #define PATH_SKYRIM_CUSTOM_INI_W     L"MY GAMES\\SKYRIM" SR_FOLDER_SUFFIX_W L"\\SKYRIMCUSTOM.INI"
 #define PATH_PLUGINS_TXT_W           L"\\SKYRIM" SR_FOLDER_SUFFIX_W L"\\PLUGINS.TXT"
 
-#define PATH_SKYRIM_INI_A             "MY GAMES\\SKYRIM" SR_FOLDER_SUFFIX_A "\\SKYRIM.INI"
-#define PATH_SKYRIM_PREFS_INI_A       "MY GAMES\\SKYRIM" SR_FOLDER_SUFFIX_A "\\SKYRIMPREFS.INI"
-#define PATH_SKYRIM_CUSTOM_INI_A      "MY GAMES\\SKYRIM" SR_FOLDER_SUFFIX_A "\\SKYRIMCUSTOM.INI"
-#define PATH_PLUGINS_TXT_A            "\\SKYRIM" SR_FOLDER_SUFFIX_A "\\PLUGINS.TXT"
-
 // +==================================================================+
 // |                         Redirect support                         |
 // +==================================================================+
 
+// A file or directory that paths can be redirected to
+typedef struct
+{
+	// Wide path of the file or directory. Points to a string owned by the config the rules were built from.
+	const wchar_t* PathW;
+
+	// Narrow path of the file or directory, converted to the Windows ANSI codepage.
+	// This allows functions to pass a pointer to the Windows API without allocating a new
+	// string at every ANSI call just to convert a Unicode string to ANSI.
+	char* PathA;
 
-// This variable contains a copy of every path stored in the user config, converted
-// to the windows ANSI codepage.
-// This allows functions to pass a pointer to the Windows API without allocating a new
-// string at every ANSI call just to convert a Unicode string to ANSI.
-static struct
+	// Length of the paths. For directories, it's the length to keep when rewriting a path inside them,
+	// which excludes any trailing separator.
+	size_t LenW;
+	size_t LenA;
+
+	// The in-memory copy of the file, if it's an .ini file. Shared by every rule with the same target.
+	SR_IniCache* Ini;
+
+} Target;
+
+// Everything the hooks match paths against.
+// A rule set is never changed after it's published, so the hooks can read it from any thread without locks.
+// Reloading the config builds a new one, and the old one is only freed once no hook can still be reading it.
+typedef struct
 {
-	char* Ini;
-	char* PrefsIni;
-	char* CustomIni;
-	char* Plugins;
+	// Every file that paths can be redirected to. The values stored in the rule tries are indices into this array.
+	Target* Targets;
+	size_t TargetCount;
+
+	// Every redirection rule, matched against wide paths
+	SR_RuleTrie* RulesW;
+	// Every redirection rule, converted to the Windows ANSI codepage and matched against narrow paths
+	SR_RuleTrie* RulesA;
+
+	// The config the paths of the targets point into, if it was reloaded. NULL for the UserConfig read at startup.
+	SR_UserConfig* Config;
 
-} UserConfigA;
+} RuleSet;
 
-// Narrow version of the canonicized path Skyrim will use to search for plugins.txt
-static char* SkyrimPluginsPathA = NULL;
-// Wide version of the canonicized path Skyrim will use to search for plugins.txt
-static wchar_t* SkyrimPluginsPathW = NULL;
+// The rules the hooks currently match paths against. Only read inside an epoch, see Epoch.h.
+static RuleSet* volatile CurrentRules = NULL;
 
+// Every WinAPI function that is redirected, created the first time it's needed
+static SR_Once Redirections = SR_ONCE_INIT;
 
-// Checks if the canonical version of a wide path ends with a specified wide string.
-static bool CanonicalEndsWithW(const wchar_t* path, const wchar_t* component)
+
+// Size, in characters, of the stack buffer used to canonicize paths while matching them.
+// Only paths whose canonical form doesn't fit in this buffer need to allocate memory.
+#define CANONICAL_BUFFER_SIZE (MAX_PATH * 2)
+
+// Number of heap allocations made while matching paths.
+// Matching and rewriting are allocation-free unless a path is longer than CANONICAL_BUFFER_SIZE, so this should stay at 0
+// during normal gameplay.
+static volatile LONG MatcherAllocations = 0;
+
+// Number of times the current thread entered the plugin's own I/O without leaving it yet.
+// While it's not 0, the hooks called by this thread forward their paths unchanged, so the plugin never matches its own
+// paths, and never re-enters a hook from inside one, e.g. when an .ini file is read into memory by GetPrivateProfile*.
+static __declspec(thread) unsigned int RedirectorDepth = 0;
+
+// Number of paths the current thread matched against the rules
+static __declspec(thread) long MatcherCalls = 0;
+
+// Hooks rewrite at most two paths per call, e.g. the source and the destination of MoveFile
+#define REWRITE_BUFFER_COUNT 2
+
+// A heap buffer where redirected paths that don't fit in a fixed rewrite buffer are stored
+typedef struct
+{
+	void* Data;
+	// Size of Data, in bytes
+	size_t Size;
+
+} RewriteBuffer;
+
+// Redirected paths must outlive TryRedirect, as they are passed on to the original API, while the rules they were
+// matched against can be replaced by a reload at any time.
+// Each thread cycles through its own fixed buffers, and only falls back to the heap for paths that don't fit in them.
+static __declspec(thread) wchar_t FixedRewriteBuffers[REWRITE_BUFFER_COUNT][CANONICAL_BUFFER_SIZE];
+static __declspec(thread) RewriteBuffer RewriteBuffers[REWRITE_BUFFER_COUNT];
+static __declspec(thread) unsigned int NextRewriteBuffer = 0;
+
+// Gets the next rewrite buffer of the current thread, making sure it has at least `size` bytes.
+// Returns NULL if the buffer couldn't be allocated.
+static void* GetRewriteBuffer(size_t size)
 {
-	wchar_t* canonical = SR_CanonicizePathW(path);
+	unsigned int index = NextRewriteBuffer;
+	NextRewriteBuffer = (NextRewriteBuffer + 1) % REWRITE_BUFFER_COUNT;
 
-	bool result = SR_EndsWithW(canonical, component);
+	if (size <= sizeof(FixedRewriteBuffers[index])) return FixedRewriteBuffers[index];
 
-	free(canonical);
-	return result;
+	RewriteBuffer* buffer = &RewriteBuffers[index];
+	if (buffer->Size < size)
+	{
+		// Path is too long for the fixed buffer, fall back to the heap
+		InterlockedIncrement(&MatcherAllocations);
+
+		// Round up to avoid reallocating for every slightly longer path
+		size_t newSize = max(size, CANONICAL_BUFFER_SIZE * 2 * sizeof(wchar_t));
+		void* newData = realloc(buffer->Data, newSize);
+		if (newData == NULL) return NULL;
+
+		buffer->Data = newData;
+		buffer->Size = newSize;
+	}
+
+	return buffer->Data;
 }
 
-// Checks if the canonical version of a narrow path ends with a specified narrow string.
-static bool CanonicalEndsWithA(const char* path, const char* component)
+// Canonicizes a wide path, storing it in `stackBuffer` if it fits or in a new heap buffer if it doesn't.
+// If the returned pointer is not `stackBuffer`, it must be freed.
+// Returns NULL if the path couldn't be canonicized.
+static wchar_t* CanonicizeW(const wchar_t* path, wchar_t* stackBuffer, size_t stackBufferSize, size_t* len)
 {
-	char* canonical = SR_CanonicizePathA(path);
+	*len = SR_CanonicizePathIntoW(path, stackBuffer, stackBufferSize);
+	if (*len == 0) return NULL;
+	if (*len < stackBufferSize) return stackBuffer;
 
-	bool result = SR_EndsWithA(canonical, component);
+	// Path is too long for the stack buffer, fall back to the heap
+	InterlockedIncrement(&MatcherAllocations);
 
-	free(canonical);
-	return result;
+	size_t heapBufferSize = *len;
+	wchar_t* heapBuffer = calloc(heapBufferSize, sizeof(wchar_t));
+	if (heapBuffer == NULL) return NULL;
+
+	*len = SR_CanonicizePathIntoW(path, heapBuffer, heapBufferSize);
+	if (*len == 0 || *len >= heapBufferSize)
+	{
+		free(heapBuffer);
+		return NULL;
+	}
+
+	return heapBuffer;
 }
 
-// Checks if the canonical version of a wide path is equal to a specified wide string
-static bool CanonicalEqualsW(const wchar_t* path, const wchar_t* other)
+// Canonicizes a narrow path, storing it in `stackBuffer` if it fits or in a new heap buffer if it doesn't.
+// If the returned pointer is not `stackBuffer`, it must be freed.
+// Returns NULL if the path couldn't be canonicized.
+static char* CanonicizeA(const char* path, char* stackBuffer, size_t stackBufferSize, size_t* len)
 {
-	wchar_t* canonical = SR_CanonicizePathW(path);
+	*len = SR_CanonicizePathIntoA(path, stackBuffer, stackBufferSize);
+	if (*len == 0) return NULL;
+	if (*len < stackBufferSize) return stackBuffer;
 
-	bool result = wcscmp(canonical, other) == 0;
+	// Path is too long for the stack buffer, fall back to the heap
+	InterlockedIncrement(&MatcherAllocations);
 
-	free(canonical);
-	return result;
+	size_t heapBufferSize = *len;
+	char* heapBuffer = calloc(heapBufferSize, sizeof(char));
+	if (heapBuffer == NULL) return NULL;
+
+	*len = SR_CanonicizePathIntoA(path, heapBuffer, heapBufferSize);
+	if (*len == 0 || *len >= heapBufferSize)
+	{
+		free(heapBuffer);
+		return NULL;
+	}
+
+	return heapBuffer;
 }
 
-// Checks if the canonical version of a narrow path is equal to a specified narrow string
-static bool CanonicalEqualsA(const char* path, const char* other)
+// Rewrites a wide path inside a redirected directory to the same path inside the target directory.
+//  input: The original path
+//  scratch: A buffer holding the canonical path, which will be overwritten
+//  scratchSize: The size of `scratch`, in characters
+//  canonicalLen: The length of the canonical path
+//  target: The target directory
+//  prefixLen: The length of the redirected directory in the canonical path
+// Returns the rewritten path, stored in a rewrite buffer, or NULL if the path couldn't be rewritten.
+static const wchar_t* RewriteW(const wchar_t* input, wchar_t* scratch, size_t scratchSize, size_t canonicalLen, const Target* target, size_t prefixLen)
 {
-	char* canonical = SR_CanonicizePathA(path);
+	// The canonical path is uppercase, so resolve it again keeping its case to not change the case of new files
+	size_t resolvedLen = SR_ResolvePathIntoW(input, scratch, scratchSize);
+	if (resolvedLen != canonicalLen) return NULL;
 
-	bool result = strcmp(canonical, other) == 0;
+	size_t restLen = resolvedLen - prefixLen;
+	size_t targetLen = target->LenW;
 
-	free(canonical);
-	return result;
+	wchar_t* rewritten = GetRewriteBuffer((targetLen + restLen + 1) * sizeof(wchar_t));
+	if (rewritten == NULL) return NULL;
+
+	wmemcpy(rewritten, target->PathW, targetLen);
+	wmemcpy(rewritten + targetLen, scratch + prefixLen, restLen);
+	rewritten[targetLen + restLen] = L'\0';
+
+	return rewritten;
 }
 
-// Tries to redirect a wide path. If the path can't be redirected, it is returned unchanged.
-// The returned string does not need to be freed.
-static const wchar_t* TryRedirectW(const wchar_t* input)
+// Rewrites a narrow path inside a redirected directory to the same path inside the target directory.
+//  input: The original path
+//  scratch: A buffer holding the canonical path, which will be overwritten
+//  scratchSize: The size of `scratch`, in characters
+//  canonicalLen: The length of the canonical path
+//  target: The target directory
+//  prefixLen: The length of the redirected directory in the canonical path
+// Returns the rewritten path, stored in a rewrite buffer, or NULL if the path couldn't be rewritten.
+static const char* RewriteA(const char* input, char* scratch, size_t scratchSize, size_t canonicalLen, const Target* target, size_t prefixLen)
 {
-	const wchar_t* fileName = SR_GetFileNameW(input);
+	// The canonical path is uppercase, so resolve it again keeping its case to not change the case of new files
+	size_t resolvedLen = SR_ResolvePathIntoA(input, scratch, scratchSize);
+	if (resolvedLen != canonicalLen) return NULL;
 
-	// Canonicizing a path is expensive
-	// Match the file name first to avoid canonicizing a path whenever possible
+	size_t restLen = resolvedLen - prefixLen;
+	size_t targetLen = target->LenA;
 
-	if (SR_AreCaseInsensitiveEqualW(fileName, BASE_NAME_SKYRIM_INI_W))
-	{
-		if (CanonicalEndsWithW(input, PATH_SKYRIM_INI_W))
-			return SR_GetUserConfig()->Redirection.Ini;
-	}
-	else if (SR_AreCaseInsensitiveEqualW(fileName, BASE_NAME_SKYRIM_PREFS_INI_W))
-	{
-		if (CanonicalEndsWithW(input, PATH_SKYRIM_PREFS_INI_W))
-			return SR_GetUserConfig()->Redirection.PrefsIni;
-	}
-	else if (SR_AreCaseInsensitiveEqualW(fileName, BASE_NAME_SKYRIM_CUSTOM_INI_W))
+	char* rewritten = GetRewriteBuffer((targetLen + restLen + 1) * sizeof(char));
+	if (rewritten == NULL) return NULL;
+
+	memcpy(rewritten, target->PathA, targetLen);
+	memcpy(rewritten + targetLen, scratch + prefixLen, restLen);
+	rewritten[targetLen + restLen] = '\0';
+
+	return rewritten;
+}
+
+// Copies the path of a file target into a rewrite buffer, as the target is freed if the config is reloaded.
+// Returns NULL if the path couldn't be copied.
+static const wchar_t* CopyTargetW(const Target* target)
+{
+	wchar_t* copy = GetRewriteBuffer((target->LenW + 1) * sizeof(wchar_t));
+	if (copy == NULL) return NULL;
+
+	wmemcpy(copy, target->PathW, target->LenW + 1);
+	return copy;
+}
+
+// Matches a wide path against a rule set. If the path can't be redirected, it is returned unchanged.
+// The returned string never points into the rule set, and is valid until the thread's next two redirections.
+//  ini: Receives the cache of the .ini file the path was redirected to, or NULL if it wasn't redirected to one
+static const wchar_t* MatchPathW(const RuleSet* rules, const wchar_t* input, SR_IniCache** ini)
+{
+	if (rules == NULL) return input;
+
+	// Canonicizing a path is expensive
+	// Match the file name first to avoid canonicizing a path whenever possible,
+	// unless a whole directory is redirected, since then any file name can match
+	bool hasDirectories = SR_RuleTrieHasPrefixes(rules->RulesW);
+	if (!hasDirectories && !SR_RuleTrieCouldMatchW(rules->RulesW, input))
+		return input;
+
+	wchar_t buffer[CANONICAL_BUFFER_SIZE];
+	size_t canonicalLen;
+	wchar_t* canonical = CanonicizeW(input, buffer, CANONICAL_BUFFER_SIZE, &canonicalLen);
+	if (canonical == NULL) return input;
+
+	const wchar_t* result = input;
+
+	// Redirections of single files are more specific, so they take precedence over directories
+	size_t target = SR_MatchRuleTrieW(rules->RulesW, canonical, canonicalLen);
+	if (target != SR_NO_RULE)
 	{
-		if (CanonicalEndsWithW(input, PATH_SKYRIM_CUSTOM_INI_A))
-			return SR_GetUserConfig()->Redirection.CustomIni;
+		const wchar_t* copied = CopyTargetW(&rules->Targets[target]);
+		if (copied != NULL)
+		{
+			result = copied;
+			*ini = rules->Targets[target].Ini;
+		}
 	}
-	else if (SR_AreCaseInsensitiveEqualW(fileName, BASE_NAME_PLUGINS_TXT_W))
+	else if (hasDirectories)
 	{
-		if (CanonicalEqualsW(input, SkyrimPluginsPathW))
-			return SR_GetUserConfig()->Redirection.Plugins;
+		size_t prefixLen;
+		target = SR_MatchRuleTriePrefixW(rules->RulesW, canonical, canonicalLen, &prefixLen);
+
+		if (target != SR_NO_RULE)
+		{
+			size_t canonicalSize = canonical == buffer ? CANONICAL_BUFFER_SIZE : canonicalLen + 1;
+			const wchar_t* rewritten = RewriteW(input, canonical, canonicalSize, canonicalLen, &rules->Targets[target], prefixLen);
+			if (rewritten != NULL) result = rewritten;
+		}
 	}
 
-	return input;
+	if (canonical != buffer) free(canonical);
+
+	return result;
 }
 
-// Tries to redirect a narrow path. If the path can't be redirected, it is returned unchanged.
-// The returned string does not need to be freed.
-static const char* TryRedirectA(const char* input)
+// Copies the path of a file target into a rewrite buffer, as the target is freed if the config is reloaded.
+// Returns NULL if the path couldn't be copied.
+static const char* CopyTargetA(const Target* target)
 {
-	const char* fileName = SR_GetFileNameA(input);
+	char* copy = GetRewriteBuffer((target->LenA + 1) * sizeof(char));
+	if (copy == NULL) return NULL;
 
-	// Canonicizing a path is expensive
-	// Match the file name first to avoid canonicizing a path whenever possible
+	memcpy(copy, target->PathA, target->LenA + 1);
+	return copy;
+}
+
+// Matches a narrow path against a rule set. If the path can't be redirected, it is returned unchanged.
+// The returned string never points into the rule set, and is valid until the thread's next two redirections.
+//  ini: Receives the cache of the .ini file the path was redirected to, or NULL if it wasn't redirected to one
+static const char* MatchPathA(const RuleSet* rules, const char* input, SR_IniCache** ini)
+{
+	if (rules == NULL) return input;
 
-	if (SR_AreCaseInsensitiveEqualA(fileName, BASE_NAME_SKYRIM_INI_A))
+	// Canonicizing a path is expensive
+	// Match the file name first to avoid canonicizing a path whenever possible,
+	// unless a whole directory is redirected, since then any file name can match
+	bool hasDirectories = SR_RuleTrieHasPrefixes(rules->RulesA);
+	if (!hasDirectories && !SR_RuleTrieCouldMatchA(rules->RulesA, input))
+		return input;
+
+	char buffer[CANONICAL_BUFFER_SIZE];
+	size_t canonicalLen;
+	char* canonical = CanonicizeA(input, buffer, CANONICAL_BUFFER_SIZE, &canonicalLen);
+	if (canonical == NULL) return input;
+
+	const char* result = input;
+
+	// Redirections of single files are more specific, so they take precedence over directories
+	size_t target = SR_MatchRuleTrieA(rules->RulesA, canonical, canonicalLen);
+	if (target != SR_NO_RULE)
 	{
-		if (CanonicalEndsWithA(input, PATH_SKYRIM_INI_A))
-			return UserConfigA.Ini;
+		const char* copied = CopyTargetA(&rules->Targets[target]);
+		if (copied != NULL)
+		{
+			result = copied;
+			*ini = rules->Targets[target].Ini;
+		}
 	}
-	else if (SR_AreCaseInsensitiveEqualA(fileName, BASE_NAME_SKYRIM_PREFS_INI_A))
+	else if (hasDirectories)
 	{
-		if (CanonicalEndsWithA(input, PATH_SKYRIM_PREFS_INI_A))
-			return UserConfigA.PrefsIni;
+		size_t prefixLen;
+		target = SR_MatchRuleTriePrefixA(rules->RulesA, canonical, canonicalLen, &prefixLen);
+
+		if (target != SR_NO_RULE)
+		{
+			size_t canonicalSize = canonical == buffer ? CANONICAL_BUFFER_SIZE : canonicalLen + 1;
+			const char* rewritten = RewriteA(input, canonical, canonicalSize, canonicalLen, &rules->Targets[target], prefixLen);
+			if (rewritten != NULL) result = rewritten;
+		}
 	}
-	else if (SR_AreCaseInsensitiveEqualA(fileName, BASE_NAME_SKYRIM_CUSTOM_INI_A))
+
+	if (canonical != buffer) free(canonical);
+
+	return result;
+}
+
+// Redirects a wide path if it matches any rule. If the path can't be redirected, it is returned unchanged.
+// The returned string does not need to be freed, and is valid until the thread's next two redirections.
+//  ini: Receives the cache of the .ini file the path was redirected to, or NULL if it wasn't redirected to one
+//  hook: The hook whose statistics the call is recorded in, if they are enabled
+static const wchar_t* RedirectPathW(SR_HookId hook, const wchar_t* input, SR_IniCache** ini)
+{
+	*ini = NULL;
+	MatcherCalls++;
+
+	bool recordStats = SR_HookStatsEnabled;
+	uint64_t start = recordStats ? SR_HookStatsNow() : 0;
+
+	// The rules can be replaced by a reload at any time, so they're only read inside an epoch
+	if (!SR_EnterEpoch()) return input;
+	const wchar_t* result = MatchPathW(CurrentRules, input, ini);
+
+	// The statistics are only freed once no thread is inside an epoch, so the call is recorded before leaving it
+	if (recordStats) SR_RecordHookCall(hook, start, result != input);
+	SR_LeaveEpoch();
+
+	return result;
+}
+
+// Tries to redirect a wide path, recording the call in the statistics of a hook if they are enabled.
+// If the path can't be redirected, it is returned unchanged.
+// The returned string does not need to be freed, and is valid until the thread's next two redirections.
+//  ini: Receives the cache of the .ini file the path was redirected to, or NULL if it wasn't redirected to one
+static const wchar_t* TryRedirectIniW(SR_HookId hook, const wchar_t* input, SR_IniCache** ini)
+{
+	if (RedirectorDepth != 0)
 	{
-		if (CanonicalEndsWithA(input, PATH_SKYRIM_CUSTOM_INI_A))
-			return UserConfigA.CustomIni;
+		*ini = NULL;
+		return input;
 	}
-	else if (SR_AreCaseInsensitiveEqualA(fileName, BASE_NAME_PLUGINS_TXT_A))
+
+	return RedirectPathW(hook, input, ini);
+}
+
+// Tries to redirect a wide path, recording the call in the statistics of a hook if they are enabled.
+// If the path can't be redirected, it is returned unchanged.
+// The returned string does not need to be freed, and is valid until the thread's next two redirections.
+static const wchar_t* TryRedirectW(SR_HookId hook, const wchar_t* input)
+{
+	SR_IniCache* ini;
+	return TryRedirectIniW(hook, input, &ini);
+}
+
+// Redirects a narrow path if it matches any rule. If the path can't be redirected, it is returned unchanged.
+// The returned string does not need to be freed, and is valid until the thread's next two redirections.
+//  ini: Receives the cache of the .ini file the path was redirected to, or NULL if it wasn't redirected to one
+//  hook: The hook whose statistics the call is recorded in, if they are enabled
+static const char* RedirectPathA(SR_HookId hook, const char* input, SR_IniCache** ini)
+{
+	*ini = NULL;
+	MatcherCalls++;
+
+	bool recordStats = SR_HookStatsEnabled;
+	uint64_t start = recordStats ? SR_HookStatsNow() : 0;
+
+	// The rules can be replaced by a reload at any time, so they're only read inside an epoch
+	if (!SR_EnterEpoch()) return input;
+	const char* result = MatchPathA(CurrentRules, input, ini);
+
+	// The statistics are only freed once no thread is inside an epoch, so the call is recorded before leaving it
+	if (recordStats) SR_RecordHookCall(hook, start, result != input);
+	SR_LeaveEpoch();
+
+	return result;
+}
+
+// Tries to redirect a narrow path, recording the call in the statistics of a hook if they are enabled.
+// If the path can't be redirected, it is returned unchanged.
+// The returned string does not need to be freed, and is valid until the thread's next two redirections.
+//  ini: Receives the cache of the .ini file the path was redirected to, or NULL if it wasn't redirected to one
+static const char* TryRedirectIniA(SR_HookId hook, const char* input, SR_IniCache** ini)
+{
+	if (RedirectorDepth != 0)
 	{
-		if (CanonicalEqualsA(input, SkyrimPluginsPathA))
-			return UserConfigA.Plugins;
+		*ini = NULL;
+		return input;
 	}
 
-	return input;
+	return RedirectPathA(hook, input, ini);
 }
+
+// Tries to redirect a narrow path, recording the call in the statistics of a hook if they are enabled.
+// If the path can't be redirected, it is returned unchanged.
+// The returned string does not need to be freed, and is valid until the thread's next two redirections.
+static const char* TryRedirectA(SR_HookId hook, const char* input)
+{
+	SR_IniCache* ini;
+	return TryRedirectIniA(hook, input, &ini);
+}
+
 /*
 +==================================================================+
 |                        Redirect functions                        |
@@ -173,7 +469,7 @@ static const char* TryRedirectA(const char* input)
 
 /*
 The following macro is be used as: REDIRECT(WinAPI function name, WinAPI return value, WinAPI arguments)
-It creates three definitions:
+It creates four definitions:
 
   1. A typedef for a function pointer of the specified API, called (name)_t
 
@@ -181,273 +477,621 @@ It creates three definitions:
 	 This variable should store the original WinAPI being redirected, and can
 	 be used to call the original API from inside the redirect.
 
-  3. A function signature identical to the API being redirected, called
+  3. A static variable with the ID of the redirect in the hook statistics,
+	 called SR_Hook_(name), which must be passed to TryRedirect.
+	 Redirects that take two paths record one call per path.
+
+  4. A function signature identical to the API being redirected, called
 	 SR_Redirect_(name)
 */
 
 
+/*
+Kernelbase implements the narrow functions by converting their paths and calling the wide functions, which are hooked
+as well, since the hooks are placed on kernelbase. The narrow redirects call their original function inside
+SR_EnterRedirector, so that the wide redirect passes the path it's given through, instead of matching the already
+redirected path a second time.
+*/
+
+// Checks if CreateFile was called to write to a file
+static bool IsWriteAccess(DWORD desiredAccess, DWORD creationDisposition)
+{
+	const DWORD writeAccess = GENERIC_WRITE | GENERIC_ALL | FILE_WRITE_DATA | FILE_APPEND_DATA;
+	return (desiredAccess & writeAccess) != 0 || creationDisposition == CREATE_ALWAYS || creationDisposition == TRUNCATE_EXISTING;
+}
+
 #define REDIRECT(name, ret, ...) typedef ret(WINAPI *##name##_t)(__VA_ARGS__); \
 	static name##_t SR_Original_##name; \
+	static SR_HookId SR_Hook_##name = -1; \
 	ret WINAPI SR_Redirect_##name(__VA_ARGS__)
 
 REDIRECT(CreateFileA, HANDLE, LPCSTR lpFileName, DWORD dwDesiredAccess, DWORD dwShareMode, LPSECURITY_ATTRIBUTES lpSecurityAttributes, DWORD dwCreationDisposition, DWORD dwFlagsAndAttributes, HANDLE hTemplateFile)
 {
-	lpFileName = TryRedirectA(lpFileName);
-	return SR_Original_CreateFileA(lpFileName, dwDesiredAccess, dwShareMode, lpSecurityAttributes, dwCreationDisposition, dwFlagsAndAttributes, hTemplateFile);
+	SR_IniCache* ini;
+	lpFileName = TryRedirectIniA(SR_Hook_CreateFileA, lpFileName, &ini);
+	if (ini != NULL && IsWriteAccess(dwDesiredAccess, dwCreationDisposition)) SR_DisableIniCache(ini);
+	else if (ini != NULL) SR_FlushIniCache(ini);
+
+	SR_EnterRedirector();
+	HANDLE result = SR_Original_CreateFileA(lpFileName, dwDesiredAccess, dwShareMode, lpSecurityAttributes, dwCreationDisposition, dwFlagsAndAttributes, hTemplateFile);
+	SR_LeaveRedirector();
+
+	return result;
 }
 
 REDIRECT(CreateFileW, HANDLE, LPCWSTR lpFileName, DWORD dwDesiredAccess, DWORD dwShareMode, LPSECURITY_ATTRIBUTES lpSecurityAttributes, DWORD dwCreationDisposition, DWORD dwFlagsAndAttributes, HANDLE hTemplateFile)
 {
-	lpFileName = TryRedirectW(lpFileName);
+	SR_IniCache* ini;
+	lpFileName = TryRedirectIniW(SR_Hook_CreateFileW, lpFileName, &ini);
+	if (ini != NULL && IsWriteAccess(dwDesiredAccess, dwCreationDisposition)) SR_DisableIniCache(ini);
+	else if (ini != NULL) SR_FlushIniCache(ini);
+
 	return SR_Original_CreateFileW(lpFileName, dwDesiredAccess, dwShareMode, lpSecurityAttributes, dwCreationDisposition, dwFlagsAndAttributes, hTemplateFile);
 }
 
 REDIRECT(OpenFile, HFILE, LPCSTR lpFileName, LPOFSTRUCT lpReOpenBuff, UINT uStyle)
 {
-	lpFileName = TryRedirectA(lpFileName);
-	return SR_Original_OpenFile(lpFileName, lpReOpenBuff, uStyle);
+	SR_IniCache* ini;
+	lpFileName = TryRedirectIniA(SR_Hook_OpenFile, lpFileName, &ini);
+	if (ini != NULL && (uStyle & (OF_WRITE | OF_READWRITE | OF_CREATE)) != 0) SR_DisableIniCache(ini);
+	else if (ini != NULL) SR_FlushIniCache(ini);
+
+	SR_EnterRedirector();
+	HFILE result = SR_Original_OpenFile(lpFileName, lpReOpenBuff, uStyle);
+	SR_LeaveRedirector();
+
+	return result;
 }
 
 REDIRECT(GetPrivateProfileStringA, DWORD, LPCSTR lpAppName, LPCSTR lpKeyName, LPCSTR lpDefault, LPSTR lpReturnedString, DWORD nSize, LPCSTR lpFileName)
 {
-	lpFileName = TryRedirectA(lpFileName);
-	return SR_Original_GetPrivateProfileStringA(lpAppName, lpKeyName, lpDefault, lpReturnedString, nSize, lpFileName);
+	SR_IniCache* ini;
+	lpFileName = TryRedirectIniA(SR_Hook_GetPrivateProfileStringA, lpFileName, &ini);
+
+	DWORD result;
+	if (ini != NULL && SR_CachedGetPrivateProfileStringA(ini, lpAppName, lpKeyName, lpDefault, lpReturnedString, nSize, &result)) return result;
+
+	SR_EnterRedirector();
+	result = SR_Original_GetPrivateProfileStringA(lpAppName, lpKeyName, lpDefault, lpReturnedString, nSize, lpFileName);
+	SR_LeaveRedirector();
+
+	return result;
 }
 
 REDIRECT(GetPrivateProfileStringW, DWORD, LPCWSTR lpAppName, LPCWSTR lpKeyName, LPCWSTR lpDefault, LPWSTR lpReturnedString, DWORD nSize, LPCWSTR lpFileName)
 {
-	lpFileName = TryRedirectW(lpFileName);
+	SR_IniCache* ini;
+	lpFileName = TryRedirectIniW(SR_Hook_GetPrivateProfileStringW, lpFileName, &ini);
+
+	DWORD result;
+	if (ini != NULL && SR_CachedGetPrivateProfileStringW(ini, lpAppName, lpKeyName, lpDefault, lpReturnedString, nSize, &result)) return result;
+
 	return SR_Original_GetPrivateProfileStringW(lpAppName, lpKeyName, lpDefault, lpReturnedString, nSize, lpFileName);
 }
 
 REDIRECT(GetPrivateProfileIntA, UINT, LPCSTR lpAppName, LPCSTR lpKeyName, INT nDefault, LPCSTR lpFileName)
 {
-	lpFileName = TryRedirectA(lpFileName);
-	return SR_Original_GetPrivateProfileIntA(lpAppName, lpKeyName, nDefault, lpFileName);
+	SR_IniCache* ini;
+	lpFileName = TryRedirectIniA(SR_Hook_GetPrivateProfileIntA, lpFileName, &ini);
+
+	UINT result;
+	if (ini != NULL && SR_CachedGetPrivateProfileIntA(ini, lpAppName, lpKeyName, nDefault, &result)) return result;
+
+	SR_EnterRedirector();
+	result = SR_Original_GetPrivateProfileIntA(lpAppName, lpKeyName, nDefault, lpFileName);
+	SR_LeaveRedirector();
+
+	return result;
 }
 
 REDIRECT(GetPrivateProfileIntW, UINT, LPCWSTR lpAppName, LPCWSTR lpKeyName, INT nDefault, LPCWSTR lpFileName)
 {
-	lpFileName = TryRedirectW(lpFileName);
+	SR_IniCache* ini;
+	lpFileName = TryRedirectIniW(SR_Hook_GetPrivateProfileIntW, lpFileName, &ini);
+
+	UINT result;
+	if (ini != NULL && SR_CachedGetPrivateProfileIntW(ini, lpAppName, lpKeyName, nDefault, &result)) return result;
+
 	return SR_Original_GetPrivateProfileIntW(lpAppName, lpKeyName, nDefault, lpFileName);
 }
 
 REDIRECT(GetPrivateProfileSectionA, DWORD, LPCSTR lpAppName, LPSTR  lpReturnedString, DWORD  nSize, LPCSTR lpFileName)
 {
-	lpFileName = TryRedirectA(lpFileName);
-	return SR_Original_GetPrivateProfileSectionA(lpAppName, lpReturnedString, nSize, lpFileName);
+	SR_IniCache* ini;
+	lpFileName = TryRedirectIniA(SR_Hook_GetPrivateProfileSectionA, lpFileName, &ini);
+
+	DWORD result;
+	if (ini != NULL && SR_CachedGetPrivateProfileSectionA(ini, lpAppName, lpReturnedString, nSize, &result)) return result;
+
+	SR_EnterRedirector();
+	result = SR_Original_GetPrivateProfileSectionA(lpAppName, lpReturnedString, nSize, lpFileName);
+	SR_LeaveRedirector();
+
+	return result;
 }
 
 REDIRECT(GetPrivateProfileSectionW, DWORD, LPCWSTR lpAppName, LPWSTR lpReturnedString, DWORD nSize, LPCWSTR lpFileName)
 {
-	lpFileName = TryRedirectW(lpFileName);
+	SR_IniCache* ini;
+	lpFileName = TryRedirectIniW(SR_Hook_GetPrivateProfileSectionW, lpFileName, &ini);
+
+	DWORD result;
+	if (ini != NULL && SR_CachedGetPrivateProfileSectionW(ini, lpAppName, lpReturnedString, nSize, &result)) return result;
+
 	return SR_Original_GetPrivateProfileSectionW(lpAppName, lpReturnedString, nSize, lpFileName);
 }
 
 REDIRECT(GetPrivateProfileStructA, BOOL, LPCSTR lpszSection, LPCSTR lpszKey, LPVOID lpStruct, UINT   uSizeStruct, LPCSTR szFile)
 {
-	szFile = TryRedirectA(szFile);
-	return SR_Original_GetPrivateProfileStructA(lpszSection, lpszKey, lpStruct, uSizeStruct, szFile);
+	SR_IniCache* ini;
+	szFile = TryRedirectIniA(SR_Hook_GetPrivateProfileStructA, szFile, &ini);
+
+	BOOL result;
+	if (ini != NULL && SR_CachedGetPrivateProfileStructA(ini, lpszSection, lpszKey, lpStruct, uSizeStruct, &result)) return result;
+
+	SR_EnterRedirector();
+	result = SR_Original_GetPrivateProfileStructA(lpszSection, lpszKey, lpStruct, uSizeStruct, szFile);
+	SR_LeaveRedirector();
+
+	return result;
 }
 
 REDIRECT(GetPrivateProfileStructW, BOOL, LPCWSTR lpszSection, LPCWSTR lpszKey, LPVOID lpStruct, UINT uSizeStruct, LPCWSTR szFile)
 {
-	szFile = TryRedirectW(szFile);
+	SR_IniCache* ini;
+	szFile = TryRedirectIniW(SR_Hook_GetPrivateProfileStructW, szFile, &ini);
+
+	BOOL result;
+	if (ini != NULL && SR_CachedGetPrivateProfileStructW(ini, lpszSection, lpszKey, lpStruct, uSizeStruct, &result)) return result;
+
 	return SR_Original_GetPrivateProfileStructW(lpszSection, lpszKey, lpStruct, uSizeStruct, szFile);
 }
 
 REDIRECT(GetPrivateProfileSectionNamesA, DWORD, LPSTR  lpszReturnBuffer, DWORD  nSize, LPCSTR lpFileName)
 {
-	lpFileName = TryRedirectA(lpFileName);
-	return SR_Original_GetPrivateProfileSectionNamesA(lpszReturnBuffer, nSize, lpFileName);
+	SR_IniCache* ini;
+	lpFileName = TryRedirectIniA(SR_Hook_GetPrivateProfileSectionNamesA, lpFileName, &ini);
+
+	DWORD result;
+	if (ini != NULL && SR_CachedGetPrivateProfileSectionNamesA(ini, lpszReturnBuffer, nSize, &result)) return result;
+
+	SR_EnterRedirector();
+	result = SR_Original_GetPrivateProfileSectionNamesA(lpszReturnBuffer, nSize, lpFileName);
+	SR_LeaveRedirector();
+
+	return result;
 }
 
 REDIRECT(GetPrivateProfileSectionNamesW, DWORD, LPWSTR  lpszReturnBuffer, DWORD   nSize, LPCWSTR lpFileName)
 {
-	lpFileName = TryRedirectW(lpFileName);
+	SR_IniCache* ini;
+	lpFileName = TryRedirectIniW(SR_Hook_GetPrivateProfileSectionNamesW, lpFileName, &ini);
+
+	DWORD result;
+	if (ini != NULL && SR_CachedGetPrivateProfileSectionNamesW(ini, lpszReturnBuffer, nSize, &result)) return result;
+
 	return SR_Original_GetPrivateProfileSectionNamesW(lpszReturnBuffer, nSize, lpFileName);
 }
 
 REDIRECT(WritePrivateProfileSectionA, BOOL, LPCSTR lpAppName, LPCSTR lpString, LPCSTR lpFileName)
 {
-	lpFileName = TryRedirectA(lpFileName);
-	return SR_Original_WritePrivateProfileSectionA(lpAppName, lpString, lpFileName);
+	SR_IniCache* ini;
+	lpFileName = TryRedirectIniA(SR_Hook_WritePrivateProfileSectionA, lpFileName, &ini);
+
+	BOOL result;
+	if (ini != NULL && SR_CachedWritePrivateProfileSectionA(ini, lpAppName, lpString, &result)) return result;
+
+	if (ini != NULL) SR_FlushIniCache(ini);
+	SR_EnterRedirector();
+	result = SR_Original_WritePrivateProfileSectionA(lpAppName, lpString, lpFileName);
+	SR_LeaveRedirector();
+	if (ini != NULL) SR_InvalidateIniCache(ini);
+
+	return result;
 }
 
 REDIRECT(WritePrivateProfileSectionW, BOOL, LPCWSTR lpAppName, LPCWSTR lpString, LPCWSTR lpFileName)
 {
-	lpFileName = TryRedirectW(lpFileName);
-	return SR_Original_WritePrivateProfileSectionW(lpAppName, lpString, lpFileName);
+	SR_IniCache* ini;
+	lpFileName = TryRedirectIniW(SR_Hook_WritePrivateProfileSectionW, lpFileName, &ini);
+
+	BOOL result;
+	if (ini != NULL && SR_CachedWritePrivateProfileSectionW(ini, lpAppName, lpString, &result)) return result;
+
+	if (ini != NULL) SR_FlushIniCache(ini);
+	result = SR_Original_WritePrivateProfileSectionW(lpAppName, lpString, lpFileName);
+	if (ini != NULL) SR_InvalidateIniCache(ini);
+
+	return result;
 }
 
 REDIRECT(WritePrivateProfileStringA, BOOL, LPCSTR lpAppName, LPCSTR lpKeyName, LPCSTR lpString, LPCSTR lpFileName)
 {
-	lpFileName = TryRedirectA(lpFileName);
-	return SR_Original_WritePrivateProfileStringA(lpAppName, lpKeyName, lpString, lpFileName);
+	SR_IniCache* ini;
+	lpFileName = TryRedirectIniA(SR_Hook_WritePrivateProfileStringA, lpFileName, &ini);
+
+	BOOL result;
+	if (ini != NULL && SR_CachedWritePrivateProfileStringA(ini, lpAppName, lpKeyName, lpString, &result)) return result;
+
+	if (ini != NULL) SR_FlushIniCache(ini);
+	SR_EnterRedirector();
+	result = SR_Original_WritePrivateProfileStringA(lpAppName, lpKeyName, lpString, lpFileName);
+	SR_LeaveRedirector();
+	if (ini != NULL) SR_InvalidateIniCache(ini);
+
+	return result;
 }
 
 REDIRECT(WritePrivateProfileStringW, BOOL, LPCWSTR lpAppName, LPCWSTR lpKeyName, LPCWSTR lpString, LPCWSTR lpFileName)
 {
-	lpFileName = TryRedirectW(lpFileName);
-	return SR_Original_WritePrivateProfileStringW(lpAppName, lpKeyName, lpString, lpFileName);
+	SR_IniCache* ini;
+	lpFileName = TryRedirectIniW(SR_Hook_WritePrivateProfileStringW, lpFileName, &ini);
+
+	BOOL result;
+	if (ini != NULL && SR_CachedWritePrivateProfileStringW(ini, lpAppName, lpKeyName, lpString, &result)) return result;
+
+	if (ini != NULL) SR_FlushIniCache(ini);
+	result = SR_Original_WritePrivateProfileStringW(lpAppName, lpKeyName, lpString, lpFileName);
+	if (ini != NULL) SR_InvalidateIniCache(ini);
+
+	return result;
 }
 
 REDIRECT(WritePrivateProfileStructA, BOOL, LPCSTR lpszSection, LPCSTR lpszKey, LPVOID lpStruct, UINT   uSizeStruct, LPCSTR szFile)
 {
-	szFile = TryRedirectA(szFile);
-	return SR_Original_WritePrivateProfileStructA(lpszSection, lpszKey, lpStruct, uSizeStruct, szFile);
+	SR_IniCache* ini;
+	szFile = TryRedirectIniA(SR_Hook_WritePrivateProfileStructA, szFile, &ini);
+
+	BOOL result;
+	if (ini != NULL && SR_CachedWritePrivateProfileStructA(ini, lpszSection, lpszKey, lpStruct, uSizeStruct, &result)) return result;
+
+	if (ini != NULL) SR_FlushIniCache(ini);
+	SR_EnterRedirector();
+	result = SR_Original_WritePrivateProfileStructA(lpszSection, lpszKey, lpStruct, uSizeStruct, szFile);
+	SR_LeaveRedirector();
+	if (ini != NULL) SR_InvalidateIniCache(ini);
+
+	return result;
 }
 
 REDIRECT(WritePrivateProfileStructW, BOOL, LPCWSTR lpszSection, LPCWSTR lpszKey, LPVOID  lpStruct, UINT    uSizeStruct, LPCWSTR szFile)
 {
-	szFile = TryRedirectW(szFile);
-	return SR_Original_WritePrivateProfileStructW(lpszSection, lpszKey, lpStruct, uSizeStruct, szFile);
+	SR_IniCache* ini;
+	szFile = TryRedirectIniW(SR_Hook_WritePrivateProfileStructW, szFile, &ini);
+
+	BOOL result;
+	if (ini != NULL && SR_CachedWritePrivateProfileStructW(ini, lpszSection, lpszKey, lpStruct, uSizeStruct, &result)) return result;
+
+	if (ini != NULL) SR_FlushIniCache(ini);
+	result = SR_Original_WritePrivateProfileStructW(lpszSection, lpszKey, lpStruct, uSizeStruct, szFile);
+	if (ini != NULL) SR_InvalidateIniCache(ini);
+
+	return result;
 }
 
 REDIRECT(GetFileAttributesA, DWORD, LPCSTR lpFileName)
 {
-	lpFileName = TryRedirectA(lpFileName);
-	return SR_Original_GetFileAttributesA(lpFileName);
+	lpFileName = TryRedirectA(SR_Hook_GetFileAttributesA, lpFileName);
+
+	SR_EnterRedirector();
+	DWORD result = SR_Original_GetFileAttributesA(lpFileName);
+	SR_LeaveRedirector();
+
+	return result;
 }
 
 REDIRECT(GetFileAttributesW, DWORD, LPCWSTR lpFileName)
 {
-	lpFileName = TryRedirectW(lpFileName);
+	lpFileName = TryRedirectW(SR_Hook_GetFileAttributesW, lpFileName);
 	return SR_Original_GetFileAttributesW(lpFileName);
 }
 
 REDIRECT(GetFileAttributesExA, BOOL, LPCSTR lpFileName, GET_FILEEX_INFO_LEVELS fInfoLevelId, LPVOID lpFileInformation)
 {
-	lpFileName = TryRedirectA(lpFileName);
-	return SR_Original_GetFileAttributesExA(lpFileName, fInfoLevelId, lpFileInformation);
+	lpFileName = TryRedirectA(SR_Hook_GetFileAttributesExA, lpFileName);
+
+	SR_EnterRedirector();
+	BOOL result = SR_Original_GetFileAttributesExA(lpFileName, fInfoLevelId, lpFileInformation);
+	SR_LeaveRedirector();
+
+	return result;
 }
 
 REDIRECT(GetFileAttributesExW, BOOL, LPCWSTR lpFileName, GET_FILEEX_INFO_LEVELS fInfoLevelId, LPVOID lpFileInformation)
 {
-	lpFileName = TryRedirectW(lpFileName);
+	lpFileName = TryRedirectW(SR_Hook_GetFileAttributesExW, lpFileName);
 	return SR_Original_GetFileAttributesExW(lpFileName, fInfoLevelId, lpFileInformation);
 }
 
 REDIRECT(SetFileAttributesA, BOOL, LPCSTR lpFileName, DWORD dwFileAttributes)
 {
-	lpFileName = TryRedirectA(lpFileName);
-	return SR_Original_SetFileAttributesA(lpFileName, dwFileAttributes);
+	SR_IniCache* ini;
+	lpFileName = TryRedirectIniA(SR_Hook_SetFileAttributesA, lpFileName, &ini);
+
+	// Changes that weren't written yet can't be written anymore once the file is made read-only
+	if (ini != NULL) SR_FlushIniCache(ini);
+
+	SR_EnterRedirector();
+	BOOL result = SR_Original_SetFileAttributesA(lpFileName, dwFileAttributes);
+	SR_LeaveRedirector();
+	if (ini != NULL) SR_InvalidateIniCache(ini);
+
+	return result;
 }
 
 REDIRECT(SetFileAttributesW, BOOL, LPCWSTR lpFileName, DWORD dwFileAttributes)
 {
-	lpFileName = TryRedirectW(lpFileName);
-	return SR_Original_SetFileAttributesW(lpFileName, dwFileAttributes);
+	SR_IniCache* ini;
+	lpFileName = TryRedirectIniW(SR_Hook_SetFileAttributesW, lpFileName, &ini);
+
+	// Changes that weren't written yet can't be written anymore once the file is made read-only
+	if (ini != NULL) SR_FlushIniCache(ini);
+
+	BOOL result = SR_Original_SetFileAttributesW(lpFileName, dwFileAttributes);
+	if (ini != NULL) SR_InvalidateIniCache(ini);
+
+	return result;
 }
 
 REDIRECT(CopyFileA, BOOL, LPCSTR lpExistingFileName, LPCSTR lpNewFileName, BOOL bFailIfExists)
 {
-	lpExistingFileName = TryRedirectA(lpExistingFileName);
-	lpExistingFileName = TryRedirectA(lpNewFileName);
-	return SR_Original_CopyFileA(lpExistingFileName, lpNewFileName, bFailIfExists);
+	SR_IniCache* existingIni;
+	SR_IniCache* newIni;
+	lpExistingFileName = TryRedirectIniA(SR_Hook_CopyFileA, lpExistingFileName, &existingIni);
+	lpNewFileName = TryRedirectIniA(SR_Hook_CopyFileA, lpNewFileName, &newIni);
+
+	// The copy must see every change to the source, and a change written later must not overwrite the copy
+	if (existingIni != NULL) SR_FlushIniCache(existingIni);
+	if (newIni != NULL) SR_FlushIniCache(newIni);
+
+	SR_EnterRedirector();
+	BOOL result = SR_Original_CopyFileA(lpExistingFileName, lpNewFileName, bFailIfExists);
+	SR_LeaveRedirector();
+	if (newIni != NULL) SR_InvalidateIniCache(newIni);
+
+	return result;
 }
 
 REDIRECT(CopyFileW, BOOL, LPCWSTR lpExistingFileName, LPCWSTR lpNewFileName, BOOL bFailIfExists)
 {
-	lpExistingFileName = TryRedirectW(lpExistingFileName);
-	lpExistingFileName = TryRedirectW(lpNewFileName);
-	return SR_Original_CopyFileW(lpExistingFileName, lpNewFileName, bFailIfExists);
+	SR_IniCache* existingIni;
+	SR_IniCache* newIni;
+	lpExistingFileName = TryRedirectIniW(SR_Hook_CopyFileW, lpExistingFileName, &existingIni);
+	lpNewFileName = TryRedirectIniW(SR_Hook_CopyFileW, lpNewFileName, &newIni);
+
+	// The copy must see every change to the source, and a change written later must not overwrite the copy
+	if (existingIni != NULL) SR_FlushIniCache(existingIni);
+	if (newIni != NULL) SR_FlushIniCache(newIni);
+
+	BOOL result = SR_Original_CopyFileW(lpExistingFileName, lpNewFileName, bFailIfExists);
+	if (newIni != NULL) SR_InvalidateIniCache(newIni);
+
+	return result;
 }
 
 REDIRECT(CopyFileExA, BOOL, LPCSTR lpExistingFileName, LPCSTR lpNewFileName, LPPROGRESS_ROUTINE lpProgressRoutine, LPVOID lpData, LPBOOL pbCancel, DWORD dwCopyFlags)
 {
-	lpExistingFileName = TryRedirectA(lpExistingFileName);
-	lpExistingFileName = TryRedirectA(lpNewFileName);
-	return SR_Original_CopyFileExA(lpExistingFileName, lpNewFileName, lpProgressRoutine, lpData, pbCancel, dwCopyFlags);
+	SR_IniCache* existingIni;
+	SR_IniCache* newIni;
+	lpExistingFileName = TryRedirectIniA(SR_Hook_CopyFileExA, lpExistingFileName, &existingIni);
+	lpNewFileName = TryRedirectIniA(SR_Hook_CopyFileExA, lpNewFileName, &newIni);
+
+	// The copy must see every change to the source, and a change written later must not overwrite the copy
+	if (existingIni != NULL) SR_FlushIniCache(existingIni);
+	if (newIni != NULL) SR_FlushIniCache(newIni);
+
+	SR_EnterRedirector();
+	BOOL result = SR_Original_CopyFileExA(lpExistingFileName, lpNewFileName, lpProgressRoutine, lpData, pbCancel, dwCopyFlags);
+	SR_LeaveRedirector();
+	if (newIni != NULL) SR_InvalidateIniCache(newIni);
+
+	return result;
 }
 
 REDIRECT(CopyFileExW, BOOL, LPCWSTR lpExistingFileName, LPCWSTR lpNewFileName, LPPROGRESS_ROUTINE lpProgressRoutine, LPVOID lpData, LPBOOL pbCancel, DWORD dwCopyFlags)
 {
-	lpExistingFileName = TryRedirectW(lpExistingFileName);
-	lpExistingFileName = TryRedirectW(lpNewFileName);
-	return SR_Original_CopyFileExW(lpExistingFileName, lpNewFileName, lpProgressRoutine, lpData, pbCancel, dwCopyFlags);
+	SR_IniCache* existingIni;
+	SR_IniCache* newIni;
+	lpExistingFileName = TryRedirectIniW(SR_Hook_CopyFileExW, lpExistingFileName, &existingIni);
+	lpNewFileName = TryRedirectIniW(SR_Hook_CopyFileExW, lpNewFileName, &newIni);
+
+	// The copy must see every change to the source, and a change written later must not overwrite the copy
+	if (existingIni != NULL) SR_FlushIniCache(existingIni);
+	if (newIni != NULL) SR_FlushIniCache(newIni);
+
+	BOOL result = SR_Original_CopyFileExW(lpExistingFileName, lpNewFileName, lpProgressRoutine, lpData, pbCancel, dwCopyFlags);
+	if (newIni != NULL) SR_InvalidateIniCache(newIni);
+
+	return result;
 }
 
 REDIRECT(CreateHardLinkA, BOOL, LPCSTR lpFileName, LPCSTR lpExistingFileName, LPSECURITY_ATTRIBUTES lpSecurityAttributes)
 {
-	lpFileName = TryRedirectA(lpFileName);
-	lpExistingFileName = TryRedirectA(lpExistingFileName);
-	return SR_Original_CreateHardLinkA(lpFileName, lpExistingFileName, lpSecurityAttributes);
+	SR_IniCache* ini;
+	SR_IniCache* existingIni;
+	lpFileName = TryRedirectIniA(SR_Hook_CreateHardLinkA, lpFileName, &ini);
+	lpExistingFileName = TryRedirectIniA(SR_Hook_CreateHardLinkA, lpExistingFileName, &existingIni);
+
+	// The link must see every change to the existing file, and a change written later must not replace the link
+	if (existingIni != NULL) SR_FlushIniCache(existingIni);
+	if (ini != NULL) SR_FlushIniCache(ini);
+
+	SR_EnterRedirector();
+	BOOL result = SR_Original_CreateHardLinkA(lpFileName, lpExistingFileName, lpSecurityAttributes);
+	SR_LeaveRedirector();
+	if (ini != NULL) SR_InvalidateIniCache(ini);
+
+	return result;
 }
 
 REDIRECT(CreateHardLinkW, BOOL, LPCWSTR lpFileName, LPCWSTR lpExistingFileName, LPSECURITY_ATTRIBUTES lpSecurityAttributes)
 {
-	lpFileName = TryRedirectW(lpFileName);
-	lpExistingFileName = TryRedirectW(lpExistingFileName);
-	return SR_Original_CreateHardLinkW(lpFileName, lpExistingFileName, lpSecurityAttributes);
+	SR_IniCache* ini;
+	SR_IniCache* existingIni;
+	lpFileName = TryRedirectIniW(SR_Hook_CreateHardLinkW, lpFileName, &ini);
+	lpExistingFileName = TryRedirectIniW(SR_Hook_CreateHardLinkW, lpExistingFileName, &existingIni);
+
+	// The link must see every change to the existing file, and a change written later must not replace the link
+	if (existingIni != NULL) SR_FlushIniCache(existingIni);
+	if (ini != NULL) SR_FlushIniCache(ini);
+
+	BOOL result = SR_Original_CreateHardLinkW(lpFileName, lpExistingFileName, lpSecurityAttributes);
+	if (ini != NULL) SR_InvalidateIniCache(ini);
+
+	return result;
 }
 
 REDIRECT(CreateSymbolicLinkA, BOOLEAN, LPCSTR lpSymlinkFileName, LPCSTR lpTargetFileName, DWORD dwFlags)
 {
-	lpSymlinkFileName = TryRedirectA(lpSymlinkFileName);
-	lpTargetFileName = TryRedirectA(lpTargetFileName);
-	return SR_Original_CreateSymbolicLinkA(lpSymlinkFileName, lpTargetFileName, dwFlags);
+	lpSymlinkFileName = TryRedirectA(SR_Hook_CreateSymbolicLinkA, lpSymlinkFileName);
+	lpTargetFileName = TryRedirectA(SR_Hook_CreateSymbolicLinkA, lpTargetFileName);
+
+	SR_EnterRedirector();
+	BOOLEAN result = SR_Original_CreateSymbolicLinkA(lpSymlinkFileName, lpTargetFileName, dwFlags);
+	SR_LeaveRedirector();
+
+	return result;
 }
 
 REDIRECT(CreateSymbolicLinkW, BOOLEAN, LPCWSTR lpSymlinkFileName, LPCWSTR lpTargetFileName, DWORD dwFlags)
 {
-	lpSymlinkFileName = TryRedirectW(lpSymlinkFileName);
-	lpTargetFileName = TryRedirectW(lpTargetFileName);
+	lpSymlinkFileName = TryRedirectW(SR_Hook_CreateSymbolicLinkW, lpSymlinkFileName);
+	lpTargetFileName = TryRedirectW(SR_Hook_CreateSymbolicLinkW, lpTargetFileName);
 	return SR_Original_CreateSymbolicLinkW(lpSymlinkFileName, lpTargetFileName, dwFlags);
 }
 
 REDIRECT(DeleteFileA, BOOL, LPCSTR lpFileName)
 {
-	lpFileName = TryRedirectA(lpFileName);
-	return SR_Original_DeleteFileA(lpFileName);
+	SR_IniCache* ini;
+	lpFileName = TryRedirectIniA(SR_Hook_DeleteFileA, lpFileName, &ini);
+	if (ini != NULL) SR_DiscardIniCache(ini);
+
+	SR_EnterRedirector();
+	BOOL result = SR_Original_DeleteFileA(lpFileName);
+	SR_LeaveRedirector();
+	if (ini != NULL) SR_InvalidateIniCache(ini);
+
+	return result;
 }
 
 REDIRECT(DeleteFileW, BOOL, LPCWSTR lpFileName)
 {
-	lpFileName = TryRedirectW(lpFileName);
-	return SR_Original_DeleteFileW(lpFileName);
+	SR_IniCache* ini;
+	lpFileName = TryRedirectIniW(SR_Hook_DeleteFileW, lpFileName, &ini);
+	if (ini != NULL) SR_DiscardIniCache(ini);
+
+	BOOL result = SR_Original_DeleteFileW(lpFileName);
+	if (ini != NULL) SR_InvalidateIniCache(ini);
+
+	return result;
 }
 
 REDIRECT(MoveFileA, BOOL, LPCSTR lpExistingFileName, LPCSTR lpNewFileName)
 {
-	lpExistingFileName = TryRedirectA(lpExistingFileName);
-	lpNewFileName = TryRedirectA(lpNewFileName);
-	return SR_Original_MoveFileA(lpExistingFileName, lpNewFileName);
+	SR_IniCache* existingIni;
+	SR_IniCache* newIni;
+	lpExistingFileName = TryRedirectIniA(SR_Hook_MoveFileA, lpExistingFileName, &existingIni);
+	lpNewFileName = TryRedirectIniA(SR_Hook_MoveFileA, lpNewFileName, &newIni);
+
+	if (existingIni != NULL) SR_FlushIniCache(existingIni);
+	if (newIni != NULL) SR_FlushIniCache(newIni);
+
+	SR_EnterRedirector();
+	BOOL result = SR_Original_MoveFileA(lpExistingFileName, lpNewFileName);
+	SR_LeaveRedirector();
+	if (existingIni != NULL) SR_InvalidateIniCache(existingIni);
+	if (newIni != NULL) SR_InvalidateIniCache(newIni);
+
+	return result;
 }
 
 REDIRECT(MoveFileW, BOOL, LPCWSTR lpExistingFileName, LPCWSTR lpNewFileName)
 {
-	lpExistingFileName = TryRedirectW(lpExistingFileName);
-	lpNewFileName = TryRedirectW(lpNewFileName);
-	return SR_Original_MoveFileW(lpExistingFileName, lpNewFileName);
+	SR_IniCache* existingIni;
+	SR_IniCache* newIni;
+	lpExistingFileName = TryRedirectIniW(SR_Hook_MoveFileW, lpExistingFileName, &existingIni);
+	lpNewFileName = TryRedirectIniW(SR_Hook_MoveFileW, lpNewFileName, &newIni);
+
+	if (existingIni != NULL) SR_FlushIniCache(existingIni);
+	if (newIni != NULL) SR_FlushIniCache(newIni);
+
+	BOOL result = SR_Original_MoveFileW(lpExistingFileName, lpNewFileName);
+	if (existingIni != NULL) SR_InvalidateIniCache(existingIni);
+	if (newIni != NULL) SR_InvalidateIniCache(newIni);
+
+	return result;
 }
 
 REDIRECT(MoveFileExA, BOOL, LPCSTR lpExistingFileName, LPCSTR lpNewFileName, DWORD dwFlags)
 {
-	lpExistingFileName = TryRedirectA(lpExistingFileName);
-	lpNewFileName = TryRedirectA(lpNewFileName);
-	return SR_Original_MoveFileExA(lpExistingFileName, lpNewFileName, dwFlags);
+	SR_IniCache* existingIni;
+	SR_IniCache* newIni;
+	lpExistingFileName = TryRedirectIniA(SR_Hook_MoveFileExA, lpExistingFileName, &existingIni);
+	lpNewFileName = TryRedirectIniA(SR_Hook_MoveFileExA, lpNewFileName, &newIni);
+
+	if (existingIni != NULL) SR_FlushIniCache(existingIni);
+	if (newIni != NULL) SR_FlushIniCache(newIni);
+
+	SR_EnterRedirector();
+	BOOL result = SR_Original_MoveFileExA(lpExistingFileName, lpNewFileName, dwFlags);
+	SR_LeaveRedirector();
+	if (existingIni != NULL) SR_InvalidateIniCache(existingIni);
+	if (newIni != NULL) SR_InvalidateIniCache(newIni);
+
+	return result;
 }
 
 REDIRECT(MoveFileExW, BOOL, LPCWSTR lpExistingFileName, LPCWSTR lpNewFileName, DWORD dwFlags)
 {
-	lpExistingFileName = TryRedirectW(lpExistingFileName);
-	lpNewFileName = TryRedirectW(lpNewFileName);
-	return SR_Original_MoveFileExW(lpExistingFileName, lpNewFileName, dwFlags);
+	SR_IniCache* existingIni;
+	SR_IniCache* newIni;
+	lpExistingFileName = TryRedirectIniW(SR_Hook_MoveFileExW, lpExistingFileName, &existingIni);
+	lpNewFileName = TryRedirectIniW(SR_Hook_MoveFileExW, lpNewFileName, &newIni);
+
+	if (existingIni != NULL) SR_FlushIniCache(existingIni);
+	if (newIni != NULL) SR_FlushIniCache(newIni);
+
+	BOOL result = SR_Original_MoveFileExW(lpExistingFileName, lpNewFileName, dwFlags);
+	if (existingIni != NULL) SR_InvalidateIniCache(existingIni);
+	if (newIni != NULL) SR_InvalidateIniCache(newIni);
+
+	return result;
 }
 
 REDIRECT(MoveFileWithProgressA, BOOL, LPCSTR lpExistingFileName, LPCSTR lpNewFileName, LPPROGRESS_ROUTINE lpProgressRoutine, LPVOID lpData, DWORD dwFlags)
 {
-	lpExistingFileName = TryRedirectA(lpExistingFileName);
-	lpNewFileName = TryRedirectA(lpNewFileName);
-	return SR_Original_MoveFileWithProgressA(lpExistingFileName, lpNewFileName, lpProgressRoutine, lpData, dwFlags);
+	SR_IniCache* existingIni;
+	SR_IniCache* newIni;
+	lpExistingFileName = TryRedirectIniA(SR_Hook_MoveFileWithProgressA, lpExistingFileName, &existingIni);
+	lpNewFileName = TryRedirectIniA(SR_Hook_MoveFileWithProgressA, lpNewFileName, &newIni);
+
+	if (existingIni != NULL) SR_FlushIniCache(existingIni);
+	if (newIni != NULL) SR_FlushIniCache(newIni);
+
+	SR_EnterRedirector();
+	BOOL result = SR_Original_MoveFileWithProgressA(lpExistingFileName, lpNewFileName, lpProgressRoutine, lpData, dwFlags);
+	SR_LeaveRedirector();
+	if (existingIni != NULL) SR_InvalidateIniCache(existingIni);
+	if (newIni != NULL) SR_InvalidateIniCache(newIni);
+
+	return result;
 }
 
 REDIRECT(MoveFileWithProgressW, BOOL, LPCWSTR lpExistingFileName, LPCWSTR lpNewFileName, LPPROGRESS_ROUTINE lpProgressRoutine, LPVOID lpData, DWORD dwFlags)
 {
-	lpExistingFileName = TryRedirectW(lpExistingFileName);
-	lpNewFileName = TryRedirectW(lpNewFileName);
-	return SR_Original_MoveFileWithProgressW(lpExistingFileName, lpNewFileName, lpProgressRoutine, lpData, dwFlags);
+	SR_IniCache* existingIni;
+	SR_IniCache* newIni;
+	lpExistingFileName = TryRedirectIniW(SR_Hook_MoveFileWithProgressW, lpExistingFileName, &existingIni);
+	lpNewFileName = TryRedirectIniW(SR_Hook_MoveFileWithProgressW, lpNewFileName, &newIni);
+
+	if (existingIni != NULL) SR_FlushIniCache(existingIni);
+	if (newIni != NULL) SR_FlushIniCache(newIni);
+
+	BOOL result = SR_Original_MoveFileWithProgressW(lpExistingFileName, lpNewFileName, lpProgressRoutine, lpData, dwFlags);
+	if (existingIni != NULL) SR_InvalidateIniCache(existingIni);
+	if (newIni != NULL) SR_InvalidateIniCache(newIni);
+
+	return result;
 }
 
 #undef REDIRECT
@@ -456,62 +1100,236 @@ REDIRECT(MoveFileWithProgressW, BOOL, LPCWSTR lpExistingFileName, LPCWSTR lpNewF
 // |                      End Redirect functions                      |
 // +==================================================================+
 
-static void CreatePaths()
+// Canonicizes an absolute path for the narrow rule trie.
+// Narrow paths only have their ASCII letters uppercased, so the pattern can't be converted from the wide canonical
+// path, whose other letters are uppercased too.
+static char* CanonicizePatternA(const wchar_t* path)
 {
-	const SR_UserConfig* config = SR_GetUserConfig();
+	char* pathA = SR_Utf16ToCodepage(path);
+	char* pattern = SR_CanonicizePathA(pathA);
+	free(pathA);
 
-	UserConfigA.Ini = SR_Utf16ToCodepage(config->Redirection.Ini);
-	UserConfigA.PrefsIni = SR_Utf16ToCodepage(config->Redirection.PrefsIni);
-	UserConfigA.CustomIni = SR_Utf16ToCodepage(config->Redirection.CustomIni);
-	UserConfigA.Plugins = SR_Utf16ToCodepage(config->Redirection.Plugins);
+	return pattern;
+}
+
+// Adds a redirection rule to both the wide and narrow rule tries, storing its target in the first free slot of Targets
+//  source: The file being redirected. Absolute paths are matched exactly, relative paths are matched as suffixes.
+//  target: The file it's redirected to. Must outlive the redirections.
+static void AddRule(RuleSet* rules, const wchar_t* source, const wchar_t* target)
+{
+	SR_RuleKind kind = SR_RULE_SUFFIX;
+	wchar_t* pattern = NULL;
+	char* patternA = NULL;
+
+	if (!SR_NeedsCurrentDirW(source))
+	{
+		// Absolute paths must be canonicized the same way the paths they are matched against are
+		kind = SR_RULE_EXACT;
+		pattern = SR_CanonicizePathW(source);
+		patternA = CanonicizePatternA(source);
+	}
+	else
+	{
+		pattern = _wcsdup(source);
+		patternA = SR_Utf16ToCodepage(source);
+	}
+
+	Target* current = &rules->Targets[rules->TargetCount];
+	current->PathW = target;
+	current->PathA = SR_Utf16ToCodepage(target);
+	current->LenW = wcslen(current->PathW);
+	current->LenA = strlen(current->PathA);
+
+	// The GetPrivateProfile* hooks answer from memory for every redirected .ini file
+	const wchar_t* extension = wcsrchr(target, L'.');
+	if (extension != NULL && SR_AreCaseInsensitiveEqualW(extension, L".ini"))
+		current->Ini = SR_GetIniCache(target);
 
-	wchar_t* appData = SR_GetKnownFolder(&FOLDERID_LocalAppData);
-	wchar_t* uncanonicizedPath = SR_Concat(2, appData, PATH_PLUGINS_TXT_W);
-	SkyrimPluginsPathW = SR_CanonicizePathW(uncanonicizedPath);
-	free(uncanonicizedPath);
+	SR_AddRuleW(rules->RulesW, pattern, kind, rules->TargetCount);
+	SR_AddRuleA(rules->RulesA, patternA, kind, rules->TargetCount);
 
-	SkyrimPluginsPathA = SR_Utf16ToCodepage(SkyrimPluginsPathW);
+	SR_DEBUG("Redirecting %ls '%ls' to '%ls'", kind == SR_RULE_EXACT ? L"file" : L"any path ending with", pattern, target);
 
-	free(appData);
+	rules->TargetCount++;
+
+	free(pattern);
+	free(patternA);
 }
 
-static SR_Redirection* Redirections = NULL;
+// Adds a directory redirection rule to both the wide and narrow rule tries, storing its target in the first free slot of Targets
+//  source: The directory being redirected. Relative paths are relative to the Documents folder.
+//  target: The directory it's redirected to. Must outlive the redirections.
+static void AddDirectoryRule(RuleSet* rules, const wchar_t* source, const wchar_t* target)
+{
+	wchar_t* pattern = NULL;
+	char* patternA = NULL;
+
+	if (SR_NeedsCurrentDirW(source))
+	{
+		wchar_t* absolute = SR_Concat(3, SR_GetDocumentsDir(), L"\\", source);
+		pattern = SR_CanonicizePathW(absolute);
+		patternA = CanonicizePatternA(absolute);
+		free(absolute);
+	}
+	else
+	{
+		pattern = SR_CanonicizePathW(source);
+		patternA = CanonicizePatternA(source);
+	}
+
+	Target* current = &rules->Targets[rules->TargetCount];
+	current->PathW = target;
+	current->PathA = SR_Utf16ToCodepage(target);
+
+	// Rewritten paths keep the separator that comes after the directory, so remove the target's own
+	current->LenW = wcslen(current->PathW);
+	while (current->LenW > 0 && (current->PathW[current->LenW - 1] == L'\\' || current->PathW[current->LenW - 1] == L'/'))
+		current->LenW--;
+
+	current->LenA = strlen(current->PathA);
+	while (current->LenA > 0 && (current->PathA[current->LenA - 1] == '\\' || current->PathA[current->LenA - 1] == '/'))
+		current->LenA--;
+
+	SR_AddRuleW(rules->RulesW, pattern, SR_RULE_PREFIX, rules->TargetCount);
+	SR_AddRuleA(rules->RulesA, patternA, SR_RULE_PREFIX, rules->TargetCount);
+
+	SR_DEBUG("Redirecting every path inside '%ls' to '%ls'", pattern, target);
+
+	rules->TargetCount++;
+
+	free(pattern);
+	free(patternA);
+}
+
+// Compiles the built-in and user-defined redirections of a config into a new rule set
+//  config: The config to read the redirections from. Must outlive the rule set.
+static RuleSet* CreateRules(const SR_UserConfig* config)
+{
+	RuleSet* rules = calloc(1, sizeof(RuleSet));
+
+	// Built-in redirections + user-defined rules
+	rules->Targets = calloc(4 + config->Redirection.RuleCount + config->Redirection.DirectoryRuleCount, sizeof(Target));
+	rules->TargetCount = 0;
+
+	rules->RulesW = SR_CreateRuleTrie();
+	rules->RulesA = SR_CreateRuleTrie();
+
+	AddRule(rules, PATH_SKYRIM_INI_W, config->Redirection.Ini);
+	AddRule(rules, PATH_SKYRIM_PREFS_INI_W, config->Redirection.PrefsIni);
+	AddRule(rules, PATH_SKYRIM_CUSTOM_INI_W, config->Redirection.CustomIni);
+
+	// plugins.txt is only redirected from its exact path, or Mod Organizer's own plugins.txt would be redirected too
+	wchar_t* skyrimPlugins = SR_Concat(2, SR_GetLocalAppDataDir(), PATH_PLUGINS_TXT_W);
+	AddRule(rules, skyrimPlugins, config->Redirection.Plugins);
+	free(skyrimPlugins);
+
+	for (size_t i = 0; i < config->Redirection.RuleCount; i++)
+		AddRule(rules, config->Redirection.Rules[i].Source, config->Redirection.Rules[i].Target);
+
+	for (size_t i = 0; i < config->Redirection.DirectoryRuleCount; i++)
+		AddDirectoryRule(rules, config->Redirection.DirectoryRules[i].Source, config->Redirection.DirectoryRules[i].Target);
+
+	return rules;
+}
+
+// Frees a rule set, along with its config if it was reloaded. No hook can still be reading it.
+static void FreeRules(RuleSet* rules)
+{
+	SR_FreeRuleTrie(rules->RulesW);
+	SR_FreeRuleTrie(rules->RulesA);
+
+	for (size_t i = 0; i < rules->TargetCount; i++)
+		free(rules->Targets[i].PathA);
+
+	free(rules->Targets);
+
+	// The .ini caches are shared by every rule set, and only freed with the redirections
+	SR_FreeConfig(rules->Config);
+	free(rules);
+}
 
 // Adds a WinAPI function redirection to the list of redirections.
-static void AddRedirection(PVOID* original, PVOID redirected, const wchar_t* name)
+// The original function is only found later, along with every other one, by ResolveRedirections.
+static void AddRedirection(SR_Redirection** redirections, PVOID* original, PVOID redirected, const wchar_t* name, const char* exportName)
 {
 	SR_Redirection* current = calloc(1, sizeof(SR_Redirection));
-	current->Next = Redirections;
+	current->Next = *redirections;
 
 	current->Original = original;
 	current->Redirected = redirected;
 	current->Name = name;
+	current->ExportName = exportName;
 
-	Redirections = current;
+	*redirections = current;
+}
+
+// Finds the original function of every redirection in kernel32, in a single walk over its exports.
+// Functions kernel32 only forwards or jumps to are found in the module that implements them, usually kernelbase, so
+// that they're hooked there: calls to them don't go through kernel32 first, and calls made straight to kernelbase,
+// which don't go through kernel32 at all, are redirected too.
+static void ResolveRedirections(SR_Redirection* redirections)
+{
+	LARGE_INTEGER start, end, frequency;
+	QueryPerformanceCounter(&start);
+
+	size_t count = 0;
+	for (SR_Redirection* current = redirections; current != NULL; current = current->Next)
+		count++;
+
+	SR_Export* exports = calloc(count, sizeof(SR_Export));
+
+	size_t i = 0;
+	for (SR_Redirection* current = redirections; current != NULL; current = current->Next)
+		exports[i++].Name = current->ExportName;
+
+	HMODULE kernel32 = GetModuleHandleW(L"kernel32");
+	size_t resolved = SR_ResolveExports(kernel32, exports, count);
+
+	size_t forwarded = 0, stubs = 0;
+	i = 0;
+	for (SR_Redirection* current = redirections; current != NULL; current = current->Next, i++)
+	{
+		*current->Original = exports[i].Address;
+		if (exports[i].Module != kernel32 && exports[i].Forwarded) forwarded++;
+		if (exports[i].Module != kernel32 && exports[i].Stub && !exports[i].Forwarded) stubs++;
+
+		if (exports[i].Address == NULL) SR_ERROR("Unable to find %ls in kernel32", current->Name);
+	}
+
+	free(exports);
+
+	QueryPerformanceCounter(&end);
+	QueryPerformanceFrequency(&frequency);
+	double milliseconds = (double)(end.QuadPart - start.QuadPart) * 1000.0 / (double)frequency.QuadPart;
+
+	SR_INFO("Resolved %zu of %zu hooked functions in %.3f ms, %zu of them forwarded and %zu of them stubs out of kernel32",
+		resolved, count, milliseconds, forwarded, stubs);
 }
 
 /*
 The following macro is to be used as: ADD_REDIRECT(name);
 It does two things:
 
-  1. Set SR_Original_(name) to the address of (name) in Kernel32
+  1. Call AddRedirection with SR_Original_(name) as the original pointer and
+	 SR_Redirect_(name) as the redirect pointer. SR_Original_(name) is set to
+	 the address of (name) in Kernel32 once every redirection is added.
 
-  2. Call AddRedirection with SR_Original_(name) as the original pointer and
-	 SR_Redirect_(name) as the redirect pointer.
+  2. Register SR_Hook_(name) in the hook statistics
 
 A convenience macro, ADD_REDIRECTAW, is supplied for redirecting both the A (ANSI)
 and W (Wide/Unicode) versions of a function.
 
 */
-#define ADD_REDIRECT(name) SR_Original_##name = (name##_t)GetProcAddress(kernel32, #name); AddRedirection(&(PVOID)SR_Original_##name, (PVOID)SR_Redirect_##name, L#name)
+#define ADD_REDIRECT(name) AddRedirection(&redirections, &(PVOID)SR_Original_##name, (PVOID)SR_Redirect_##name, L#name, #name); SR_Hook_##name = SR_RegisterHookStats(L#name)
 #define ADD_REDIRECTAW(name) ADD_REDIRECT(name##A); ADD_REDIRECT(name##W)
 
-static void CreateRedirections()
+// Creates the redirections, along with the rules they match paths against. Called once, through Redirections.
+static void* CreateRedirections()
 {
-	SR_FreeRedirections();
-	CreatePaths();
+	// The hooks are only attached after this, so they can never see the rules before they're published
+	InterlockedExchangePointer((PVOID volatile*)&CurrentRules, CreateRules(SR_GetUserConfig()));
 
-	HMODULE kernel32 = GetModuleHandleW(L"kernel32");
+	SR_Redirection* redirections = NULL;
 
 	ADD_REDIRECTAW(CreateFile);
 	ADD_REDIRECTAW(DeleteFile);
@@ -538,6 +1356,10 @@ static void CreateRedirections()
 	ADD_REDIRECTAW(GetFileAttributes);
 	ADD_REDIRECTAW(GetFileAttributesEx);
 	ADD_REDIRECTAW(SetFileAttributes);
+
+	ResolveRedirections(redirections);
+
+	return redirections;
 }
 
 #undef ADD_REDIRECTAW
@@ -545,40 +1367,76 @@ static void CreateRedirections()
 
 SR_Redirection* SR_GetRedirections()
 {
-	if (Redirections == NULL) CreateRedirections();
-	return Redirections;
+	return SR_GetOnce(&Redirections, CreateRedirections);
 }
 
-static void FreePaths()
+void SR_ReloadRedirections()
 {
-	free(UserConfigA.Ini);
-	UserConfigA.Ini = NULL;
+	SR_UserConfig* config = SR_ReadChangedUserConfig();
+	if (config == NULL) return;
+
+	LARGE_INTEGER start, end, frequency;
+	QueryPerformanceCounter(&start);
 
-	free(UserConfigA.PrefsIni);
-	UserConfigA.PrefsIni = NULL;
+	RuleSet* rules = CreateRules(config);
+	rules->Config = config;
 
-	free(UserConfigA.CustomIni);
-	UserConfigA.CustomIni = NULL;
+	RuleSet* previous = InterlockedExchangePointer((PVOID volatile*)&CurrentRules, rules);
 
-	free(UserConfigA.Plugins);
-	UserConfigA.Plugins = NULL;
+	// Hooks that started matching before the swap may still be reading the previous rules
+	SR_SynchronizeEpoch();
+	if (previous != NULL) FreeRules(previous);
 
-	free(SkyrimPluginsPathW);
-	SkyrimPluginsPathW = NULL;
+	QueryPerformanceCounter(&end);
+	QueryPerformanceFrequency(&frequency);
+	double milliseconds = (double)(end.QuadPart - start.QuadPart) * 1000.0 / (double)frequency.QuadPart;
 
-	free(SkyrimPluginsPathA);
-	SkyrimPluginsPathA = NULL;
+	SR_INFO("Reloaded the config with %zu redirections in %.3f ms", rules->TargetCount, milliseconds);
+}
+
+void SR_FreeThreadRedirectionBuffers()
+{
+	for (size_t i = 0; i < REWRITE_BUFFER_COUNT; i++)
+	{
+		free(RewriteBuffers[i].Data);
+		RewriteBuffers[i].Data = NULL;
+		RewriteBuffers[i].Size = 0;
+	}
+}
 
+void SR_EnterRedirector()
+{
+	RedirectorDepth++;
+}
+
+void SR_LeaveRedirector()
+{
+	RedirectorDepth--;
+}
+
+long SR_GetThreadMatcherCallCount()
+{
+	return MatcherCalls;
+}
+
+long SR_GetMatcherAllocationCount()
+{
+	return MatcherAllocations;
 }
 
 void SR_FreeRedirections()
 {
-	while (Redirections != NULL)
+	SR_Redirection* redirections = SR_ResetOnce(&Redirections);
+	while (redirections != NULL)
 	{
-		SR_Redirection* previous = Redirections;
-		Redirections = Redirections->Next;
+		SR_Redirection* previous = redirections;
+		redirections = redirections->Next;
 		free(previous);
 	}
 
-	FreePaths();
+	RuleSet* rules = InterlockedExchangePointer((PVOID volatile*)&CurrentRules, NULL);
+	if (rules != NULL) FreeRules(rules);
+
+	SR_FreeIniCaches();
+	SR_FreeEpochs();
 }
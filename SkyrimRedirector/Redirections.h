@@ -1,15 +1,46 @@
 #pragma once
+#include "Config.h"
 #include <Windows.h>
 
 typedef struct SR_Redirection
 {
 	const wchar_t* Name;
+	// The name kernel32 exports the function as
+	const char* ExportName;
 	PVOID* Original;
 	PVOID Redirected;
 
+	// How the hook is installed, read from the config when the redirections are attached
+	SR_HookMode Mode;
+	// The game's import of the function, if the hook is installed there instead of inline
+	PVOID* ImportSlot;
+
 	struct SR_Redirection* Next;
 
 } SR_Redirection;
 
 SR_Redirection* SR_GetRedirections();
 void SR_FreeRedirections();
+
+// Reads the config file again, and if it changed, replaces the rules the hooks match paths against with its rules.
+// The hooks keep running while the rules are replaced. Only one thread can call this at a time.
+void SR_ReloadRedirections();
+
+// Frees the buffers the current thread used to rewrite paths inside redirected directories.
+// Must be called when a thread exits.
+void SR_FreeThreadRedirectionBuffers();
+
+// Gets how many heap allocations were made while matching paths against the redirection rules.
+long SR_GetMatcherAllocationCount();
+
+// Marks the current thread as doing the plugin's own I/O, such as reading the config or writing the log, or as calling
+// the original of a narrow hook, which calls the hooked wide function with a path that was already redirected.
+// Until SR_LeaveRedirector is called, every hook called by this thread forwards straight to the original function,
+// without matching, logging or counting its paths. Calls can be nested.
+void SR_EnterRedirector();
+
+// Undoes a call to SR_EnterRedirector
+void SR_LeaveRedirector();
+
+// Gets how many paths the current thread matched against the redirection rules.
+long SR_GetThreadMatcherCallCount();
@@ -1,6 +1,12 @@
 #include "SR_Base.h"
 #include "Redirector.h"
 #include "Redirections.h"
+#include "ImportHooks.h"
+#include "HookStats.h"
+#include "IniCache.h"
+#include "ConfigWatcher.h"
+#include "Config.h"
+#include "ConfigParser.h"
 #include "Logging.h"
 
 #include <stdbool.h>
@@ -22,31 +28,58 @@ bool SR_AttachRedirector()
 
 	SR_DEBUG("Attaching all redirections");
 
+	SR_EnableHookStats(SR_GetUserConfig()->Logging.HookStatistics);
+	if (SR_HookStatsEnabled) SR_INFO("Hook statistics enabled, they will be logged when the plugin is unloaded");
+
+	SR_Redirection* redirections = SR_GetRedirections();
+	for (SR_Redirection* current = redirections; current != NULL; current = current->Next)
+		current->Mode = SR_GetHookMode(SR_GetUserConfig(), current->Name);
+
+	// Import hooks don't need a transaction, and any hook the game doesn't import falls back to an inline one
+	size_t importCount = SR_AttachImportHooks(redirections);
+	size_t inlineCount = 0;
+
 	DetourTransactionBegin();
 	DetourUpdateThread(GetCurrentThread());
 
-	SR_Redirection* current = SR_GetRedirections();
-	while (current != NULL)
+	for (SR_Redirection* current = redirections; current != NULL; current = current->Next)
 	{
+		if (current->ImportSlot != NULL) continue;
+
+		if (current->Mode == SR_HOOK_IMPORT)
+			SR_WARN("The game doesn't import %ls, attaching it inline instead", current->Name);
+
 		DetourAttach(current->Original, current->Redirected);
 		SR_TRACE("Attached %ls", current->Name);
-		current = current->Next;
+		inlineCount++;
 	}
 
 	if (DetourTransactionCommit() != NO_ERROR)
 	{
 		SR_TRACE("Unable to commit transaction");
+		SR_DetachImportHooks(redirections);
 		SR_ERROR("Unable to attach redirections, plugin failed to load");
 		return false;
 	}
 
 	SR_TRACE("Transaction commited");
-	SR_INFO("Redirections attached successfully, plugin loaded");
+
+	// Each inline hook used to make its page writable, restore it and flush it on its own
+	DETOUR_COMMIT_STATISTICS commit;
+	if (DetourGetCommitStatistics(&commit))
+	{
+		SR_DEBUG("Patched %lu functions on %lu pages with %lu protection changes and %lu cache flushes, instead of %lu and %lu",
+			commit.cOperations, commit.cPages, commit.cProtectCalls, commit.cFlushCalls, commit.cOperations * 2, commit.cOperations);
+	}
+
+	SR_INFO("Redirections attached successfully (%zu inline, %zu in the game's imports), plugin loaded", inlineCount, importCount);
+
+	SR_StartConfigWatcher();
 
 	return true;
 }
 
-bool SR_DetachRedirector()
+bool SR_DetachRedirector(bool processExiting)
 {
 	if (!Attached)
 	{
@@ -56,27 +89,41 @@ bool SR_DetachRedirector()
 
 	Attached = false;
 
+	// A reload can't be allowed to replace the rules while they're being freed
+	SR_StopConfigWatcher(processExiting);
+
 	SR_TRACE("Detaching all redirections");
 
+	SR_Redirection* redirections = SR_GetRedirections();
+
 	DetourTransactionBegin();
 	DetourUpdateThread(GetCurrentThread());
 
-	SR_Redirection* current = SR_GetRedirections();
-	while (current != NULL)
+	for (SR_Redirection* current = redirections; current != NULL; current = current->Next)
 	{
+		if (current->ImportSlot != NULL) continue;
+
 		DetourDetach(current->Original, current->Redirected);
 		SR_TRACE("Detached %ls", current->Name);
-		current = current->Next;
 	}
 
-	SR_FreeRedirections();
+	LONG error = DetourTransactionCommit();
+	SR_DetachImportHooks(redirections);
 
-	if (DetourTransactionCommit() != NO_ERROR)
+	// Changes to .ini files would be lost if they weren't written now, even if the hooks couldn't be detached
+	SR_FlushIniCaches(processExiting);
+
+	if (error != NO_ERROR)
 	{
 		SR_ERROR("Unable to detach redirections, plugin failed to unload");
 		return false;
 	}
 
+	// Only free the redirections once no hook can be running anymore, as they use the redirection rules
+	SR_LogHookStats();
+	SR_FreeHookStats(processExiting);
+	SR_FreeRedirections();
+
 	SR_INFO("Redirections detached successfully, plugin unloaded");
 	return true;
 }
@@ -2,4 +2,6 @@
 #include <Windows.h>
 
 _Bool SR_AttachRedirector();
-_Bool SR_DetachRedirector();
+// Detaches every hook, saving any change to .ini files that wasn't written yet.
+//  processExiting: If the whole process is exiting, in which case every other thread was already terminated
+_Bool SR_DetachRedirector(_Bool processExiting);
@@ -0,0 +1,690 @@
+#include "SR_Base.h"
+#include "RuleTrie.h"
+#include "PathScan.h"
+#include "CaseFold.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// Uppercases a character into the unsigned code unit stored in the trie.
+// This is the same folding canonical paths use.
+#define FOLD_W(c) ((unsigned int)SR_FoldCharW(c))
+#define FOLD_A(c) ((unsigned int)(unsigned char)SR_FoldCharA(c))
+
+// Index of the root node, which represents the end of every path
+#define ROOT 0
+// Index of the root of the SR_RULE_PREFIX patterns, which represents the start of every path
+#define PREFIX_ROOT 1
+
+// Index used when a node doesn't exist
+#define NO_NODE UINT32_MAX
+
+// Starting value of the hash of an extension, which is also the hash of an empty one
+#define EXTENSION_HASH_SEED 2166136261u
+
+typedef struct
+{
+	// The character being matched, as an unsigned code unit
+	unsigned int Char;
+	// The node that matches the character
+	uint32_t Child;
+
+} Edge;
+
+typedef struct
+{
+	// Edges to the next characters, sorted by character.
+	// The edges go backwards from ROOT and forwards from PREFIX_ROOT.
+	Edge* Edges;
+	uint32_t EdgeCount;
+
+	// Value of the SR_RULE_SUFFIX pattern that ends at this node, or SR_NO_RULE
+	size_t SuffixValue;
+	// Value of the SR_RULE_EXACT pattern that ends at this node, or SR_NO_RULE
+	size_t ExactValue;
+	// Value of the SR_RULE_PREFIX pattern that ends at this node, or SR_NO_RULE
+	size_t PrefixValue;
+
+	// Characters of the chain of single-edge nodes that starts at this node, in walking order.
+	// Most patterns share long runs of characters with no branches (e.g. "C:\USERS\"), so comparing the whole chain
+	// at once is much faster than visiting every node in it.
+	// Only nodes with a single edge have a run, which stops at the first node with a value or more than one edge.
+	unsigned int* Run;
+	uint32_t RunLen;
+	// The node reached after the whole run
+	uint32_t RunEnd;
+
+} Node;
+
+// What the file names of the SR_RULE_SUFFIX and SR_RULE_EXACT patterns look like.
+// A path can only match a pattern if its file name is the same as the pattern's, so a path whose file name has a
+// length, last character or extension that no pattern's file name has can be rejected without walking the trie.
+// Every check only looks at the end of the path, and can have false positives but never false negatives.
+typedef struct
+{
+	// Bit N is set if a file name has N characters. Every length from 63 on shares the last bit.
+	uint64_t Lengths;
+	// Length of the longest file name
+	size_t MaxLength;
+
+	// Bit N is set if a file name ends with a character whose folded value is N modulo 256
+	uint64_t LastChars[4];
+
+	// Bit N is set if a file name has an extension whose hash is N modulo 64.
+	// The extension is everything after the last '.', or the whole file name if it has none.
+	uint64_t Extensions;
+
+} Filter;
+
+struct SR_RuleTrie
+{
+	Node* Nodes;
+	uint32_t NodeCount;
+	uint32_t NodeCapacity;
+
+	Filter Filter;
+};
+
+// Finds the child of a node that matches a character.
+// Returns NO_NODE if there is no such child.
+static uint32_t FindChild(const SR_RuleTrie* trie, uint32_t node, unsigned int c)
+{
+	const Edge* edges = trie->Nodes[node].Edges;
+	uint32_t low = 0;
+	uint32_t high = trie->Nodes[node].EdgeCount;
+
+	while (low < high)
+	{
+		uint32_t middle = low + (high - low) / 2;
+
+		if (edges[middle].Char == c) return edges[middle].Child;
+		if (edges[middle].Char < c)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	return NO_NODE;
+}
+
+// Creates a new node with no edges and no values, returning its index
+static uint32_t CreateNode(SR_RuleTrie* trie)
+{
+	if (trie->NodeCount == trie->NodeCapacity)
+	{
+		trie->NodeCapacity *= 2;
+		trie->Nodes = realloc(trie->Nodes, trie->NodeCapacity * sizeof(Node));
+	}
+
+	Node* node = &trie->Nodes[trie->NodeCount];
+	node->Edges = NULL;
+	node->EdgeCount = 0;
+	node->SuffixValue = SR_NO_RULE;
+	node->ExactValue = SR_NO_RULE;
+	node->PrefixValue = SR_NO_RULE;
+	node->Run = NULL;
+	node->RunLen = 0;
+	node->RunEnd = trie->NodeCount;
+
+	return trie->NodeCount++;
+}
+
+// Finds the child of a node that matches a character, creating it if it doesn't exist yet
+static uint32_t FindOrCreateChild(SR_RuleTrie* trie, uint32_t node, unsigned int c)
+{
+	uint32_t child = FindChild(trie, node, c);
+	if (child != NO_NODE) return child;
+
+	child = CreateNode(trie);
+
+	// CreateNode may have moved the nodes, so only get the parent after it
+	Node* parent = &trie->Nodes[node];
+	parent->Edges = realloc(parent->Edges, (parent->EdgeCount + 1) * sizeof(Edge));
+
+	// Keep the edges sorted
+	uint32_t position = parent->EdgeCount;
+	while (position > 0 && parent->Edges[position - 1].Char > c)
+	{
+		parent->Edges[position] = parent->Edges[position - 1];
+		position--;
+	}
+
+	parent->Edges[position].Char = c;
+	parent->Edges[position].Child = child;
+	parent->EdgeCount++;
+
+	return child;
+}
+
+// Checks if any pattern ends at a node
+static bool HasValue(const Node* node)
+{
+	return node->SuffixValue != SR_NO_RULE || node->ExactValue != SR_NO_RULE || node->PrefixValue != SR_NO_RULE;
+}
+
+// Recalculates the run that starts at a node
+static void UpdateRun(SR_RuleTrie* trie, uint32_t node)
+{
+	uint32_t len = 0;
+	uint32_t end = node;
+
+	while (trie->Nodes[end].EdgeCount == 1)
+	{
+		end = trie->Nodes[end].Edges[0].Child;
+		len++;
+
+		if (HasValue(&trie->Nodes[end])) break;
+	}
+
+	Node* current = &trie->Nodes[node];
+	free(current->Run);
+	current->Run = len == 0 ? NULL : calloc(len, sizeof(unsigned int));
+	current->RunLen = len;
+	current->RunEnd = end;
+
+	uint32_t next = node;
+	for (uint32_t i = 0; i < len; i++)
+	{
+		current->Run[i] = trie->Nodes[next].Edges[0].Char;
+		next = trie->Nodes[next].Edges[0].Child;
+	}
+}
+
+// Sets the value of the pattern that ends at a node
+static void SetValue(SR_RuleTrie* trie, uint32_t node, SR_RuleKind kind, size_t value)
+{
+	if (kind == SR_RULE_EXACT)
+		trie->Nodes[node].ExactValue = value;
+	else if (kind == SR_RULE_PREFIX)
+		trie->Nodes[node].PrefixValue = value;
+	else
+		trie->Nodes[node].SuffixValue = value;
+}
+
+// Adds a pattern to a trie.
+//  root: The node to start from, ROOT or PREFIX_ROOT
+//  keys: The characters of the pattern, already normalized and in walking order
+//  len: The number of characters in `keys`
+static void AddKeys(SR_RuleTrie* trie, uint32_t root, const unsigned int* keys, size_t len, SR_RuleKind kind, size_t value)
+{
+	// Every node in the pattern's path, since only their runs can change
+	uint32_t* path = calloc(len + 1, sizeof(uint32_t));
+
+	path[0] = root;
+	for (size_t i = 0; i < len; i++)
+		path[i + 1] = FindOrCreateChild(trie, path[i], keys[i]);
+
+	SetValue(trie, path[len], kind, value);
+
+	for (size_t i = 0; i <= len; i++)
+		UpdateRun(trie, path[i]);
+
+	free(path);
+}
+
+// Adds the next character to the hash of an extension, which is built from its last character to its first
+static uint32_t HashExtensionChar(uint32_t hash, unsigned int c)
+{
+	return (hash ^ c) * 16777619u;
+}
+
+// Gets the bit of a file name length in Filter.Lengths
+static uint64_t LengthBit(size_t len)
+{
+	return (uint64_t)1 << (len < 63 ? len : 63);
+}
+
+// Checks if a folded character is the last character of any file name in a filter
+static bool HasLastChar(const Filter* filter, unsigned int c)
+{
+	return (filter->LastChars[(c & 0xFF) >> 6] >> (c & 63)) & 1;
+}
+
+// Adds the file name of a pattern to the filter.
+//  keys: The characters of the pattern, already normalized and reversed
+//  len: The number of characters in `keys`
+static void AddToFilter(SR_RuleTrie* trie, const unsigned int* keys, size_t len)
+{
+	Filter* filter = &trie->Filter;
+
+	size_t nameLen = 0;
+	while (nameLen < len && keys[nameLen] != '\\')
+		nameLen++;
+
+	filter->Lengths |= LengthBit(nameLen);
+	if (nameLen > filter->MaxLength) filter->MaxLength = nameLen;
+
+	if (nameLen > 0)
+		filter->LastChars[(keys[0] & 0xFF) >> 6] |= (uint64_t)1 << (keys[0] & 63);
+
+	uint32_t hash = EXTENSION_HASH_SEED;
+	for (size_t i = 0; i < nameLen && keys[i] != '.'; i++)
+		hash = HashExtensionChar(hash, keys[i]);
+
+	filter->Extensions |= (uint64_t)1 << (hash & 63);
+}
+
+// Transforms a wide pattern character into the character stored in the trie
+static unsigned int NormalizePatternCharW(wchar_t c)
+{
+	if (c == L'/') return '\\';
+	return FOLD_W(c);
+}
+
+// Transforms a narrow pattern character into the character stored in the trie
+static unsigned int NormalizePatternCharA(char c)
+{
+	if (c == '/') return '\\';
+	return FOLD_A(c);
+}
+
+SR_RuleTrie* SR_CreateRuleTrie()
+{
+	SR_RuleTrie* trie = calloc(1, sizeof(SR_RuleTrie));
+
+	trie->NodeCapacity = 16;
+	trie->Nodes = calloc(trie->NodeCapacity, sizeof(Node));
+	CreateNode(trie); // ROOT
+	CreateNode(trie); // PREFIX_ROOT
+
+	return trie;
+}
+
+void SR_AddRuleW(SR_RuleTrie* trie, const wchar_t* pattern, SR_RuleKind kind, size_t value)
+{
+	size_t len = wcslen(pattern);
+
+	// Suffix patterns always start right after a separator, so any leading separators are redundant
+	if (kind == SR_RULE_SUFFIX)
+	{
+		while (len > 0 && (*pattern == L'\\' || *pattern == L'/'))
+		{
+			pattern++;
+			len--;
+		}
+	}
+
+	// Directories match with or without a trailing separator, so it's redundant too
+	if (kind == SR_RULE_PREFIX)
+	{
+		while (len > 0 && (pattern[len - 1] == L'\\' || pattern[len - 1] == L'/'))
+			len--;
+	}
+
+	// Prefix patterns are walked forwards, every other pattern is walked backwards
+	unsigned int* keys = calloc(len + 1, sizeof(unsigned int));
+	for (size_t i = 0; i < len; i++)
+		keys[i] = NormalizePatternCharW(pattern[kind == SR_RULE_PREFIX ? i : len - 1 - i]);
+
+	if (kind != SR_RULE_PREFIX) AddToFilter(trie, keys, len);
+	AddKeys(trie, kind == SR_RULE_PREFIX ? PREFIX_ROOT : ROOT, keys, len, kind, value);
+	free(keys);
+}
+
+void SR_AddRuleA(SR_RuleTrie* trie, const char* pattern, SR_RuleKind kind, size_t value)
+{
+	size_t len = strlen(pattern);
+
+	// Suffix patterns always start right after a separator, so any leading separators are redundant
+	if (kind == SR_RULE_SUFFIX)
+	{
+		while (len > 0 && (*pattern == '\\' || *pattern == '/'))
+		{
+			pattern++;
+			len--;
+		}
+	}
+
+	// Directories match with or without a trailing separator, so it's redundant too
+	if (kind == SR_RULE_PREFIX)
+	{
+		while (len > 0 && (pattern[len - 1] == '\\' || pattern[len - 1] == '/'))
+			len--;
+	}
+
+	// Prefix patterns are walked forwards, every other pattern is walked backwards
+	unsigned int* keys = calloc(len + 1, sizeof(unsigned int));
+	for (size_t i = 0; i < len; i++)
+		keys[i] = NormalizePatternCharA(pattern[kind == SR_RULE_PREFIX ? i : len - 1 - i]);
+
+	if (kind != SR_RULE_PREFIX) AddToFilter(trie, keys, len);
+	AddKeys(trie, kind == SR_RULE_PREFIX ? PREFIX_ROOT : ROOT, keys, len, kind, value);
+	free(keys);
+}
+
+// Checks if a node reached after walking a whole file name could lead to a match,
+// that is, if a pattern ends there or continues with a separator
+static bool IsFileNameNode(const SR_RuleTrie* trie, uint32_t node)
+{
+	const Node* current = &trie->Nodes[node];
+
+	return current->SuffixValue != SR_NO_RULE
+		|| current->ExactValue != SR_NO_RULE
+		|| FindChild(trie, node, '\\') != NO_NODE;
+}
+
+bool SR_RuleTrieHasFileNameW(const SR_RuleTrie* trie, const wchar_t* fileName)
+{
+	uint32_t node = ROOT;
+	size_t i = wcslen(fileName);
+
+	while (i > 0)
+	{
+		const Node* current = &trie->Nodes[node];
+
+		if (current->RunLen == 0)
+		{
+			node = FindChild(trie, node, FOLD_W(fileName[i - 1]));
+			if (node == NO_NODE) return false;
+
+			i--;
+			continue;
+		}
+
+		size_t count = current->RunLen < i ? current->RunLen : i;
+		for (size_t j = 0; j < count; j++)
+			if (current->Run[j] != FOLD_W(fileName[i - 1 - j])) return false;
+
+		// The file name ends in the middle of the run, so the run must continue with a separator
+		if (count < current->RunLen) return current->Run[count] == '\\';
+
+		node = current->RunEnd;
+		i -= count;
+	}
+
+	return IsFileNameNode(trie, node);
+}
+
+bool SR_RuleTrieHasFileNameA(const SR_RuleTrie* trie, const char* fileName)
+{
+	uint32_t node = ROOT;
+	size_t i = strlen(fileName);
+
+	while (i > 0)
+	{
+		const Node* current = &trie->Nodes[node];
+
+		if (current->RunLen == 0)
+		{
+			node = FindChild(trie, node, FOLD_A(fileName[i - 1]));
+			if (node == NO_NODE) return false;
+
+			i--;
+			continue;
+		}
+
+		size_t count = current->RunLen < i ? current->RunLen : i;
+		for (size_t j = 0; j < count; j++)
+			if (current->Run[j] != FOLD_A(fileName[i - 1 - j])) return false;
+
+		// The file name ends in the middle of the run, so the run must continue with a separator
+		if (count < current->RunLen) return current->Run[count] == '\\';
+
+		node = current->RunEnd;
+		i -= count;
+	}
+
+	return IsFileNameNode(trie, node);
+}
+
+bool SR_RuleTrieCouldMatchW(const SR_RuleTrie* trie, const wchar_t* path)
+{
+	const Filter* filter = &trie->Filter;
+
+	size_t len;
+	size_t fileName = SR_FindFileNameW(path, &len);
+	size_t nameLen = len - fileName;
+
+	if (nameLen > filter->MaxLength || (filter->Lengths & LengthBit(nameLen)) == 0) return false;
+	if (nameLen > 0 && !HasLastChar(filter, FOLD_W(path[len - 1]))) return false;
+
+	uint32_t hash = EXTENSION_HASH_SEED;
+	for (size_t i = len; i > fileName; i--)
+	{
+		unsigned int c = FOLD_W(path[i - 1]);
+		if (c == '.') break;
+
+		hash = HashExtensionChar(hash, c);
+	}
+
+	if (((filter->Extensions >> (hash & 63)) & 1) == 0) return false;
+
+	return SR_RuleTrieHasFileNameW(trie, path + fileName);
+}
+
+bool SR_RuleTrieCouldMatchA(const SR_RuleTrie* trie, const char* path)
+{
+	const Filter* filter = &trie->Filter;
+
+	size_t len;
+	size_t fileName = SR_FindFileNameA(path, &len);
+	size_t nameLen = len - fileName;
+
+	if (nameLen > filter->MaxLength || (filter->Lengths & LengthBit(nameLen)) == 0) return false;
+	if (nameLen > 0 && !HasLastChar(filter, FOLD_A(path[len - 1]))) return false;
+
+	uint32_t hash = EXTENSION_HASH_SEED;
+	for (size_t i = len; i > fileName; i--)
+	{
+		unsigned int c = FOLD_A(path[i - 1]);
+		if (c == '.') break;
+
+		hash = HashExtensionChar(hash, c);
+	}
+
+	if (((filter->Extensions >> (hash & 63)) & 1) == 0) return false;
+
+	return SR_RuleTrieHasFileNameA(trie, path + fileName);
+}
+
+// Walks backwards from a node over a wide path, ending right before `path[end]`.
+// Returns the node reached and sets `consumed` to the number of characters walked over, or returns NO_NODE.
+static uint32_t StepBackwardW(const SR_RuleTrie* trie, uint32_t node, const wchar_t* path, size_t end, size_t* consumed)
+{
+	const Node* current = &trie->Nodes[node];
+
+	if (current->RunLen == 0)
+	{
+		*consumed = 1;
+		return FindChild(trie, node, (unsigned int)path[end - 1]);
+	}
+
+	if (current->RunLen > end) return NO_NODE;
+
+	for (uint32_t i = 0; i < current->RunLen; i++)
+		if (current->Run[i] != (unsigned int)path[end - 1 - i]) return NO_NODE;
+
+	*consumed = current->RunLen;
+	return current->RunEnd;
+}
+
+// Walks backwards from a node over a narrow path, ending right before `path[end]`.
+// Returns the node reached and sets `consumed` to the number of characters walked over, or returns NO_NODE.
+static uint32_t StepBackwardA(const SR_RuleTrie* trie, uint32_t node, const char* path, size_t end, size_t* consumed)
+{
+	const Node* current = &trie->Nodes[node];
+
+	if (current->RunLen == 0)
+	{
+		*consumed = 1;
+		return FindChild(trie, node, (unsigned int)(unsigned char)path[end - 1]);
+	}
+
+	if (current->RunLen > end) return NO_NODE;
+
+	for (uint32_t i = 0; i < current->RunLen; i++)
+		if (current->Run[i] != (unsigned int)(unsigned char)path[end - 1 - i]) return NO_NODE;
+
+	*consumed = current->RunLen;
+	return current->RunEnd;
+}
+
+// Walks forwards from a node over a wide path, starting at `path[start]`.
+// Returns the node reached and sets `consumed` to the number of characters walked over, or returns NO_NODE.
+static uint32_t StepForwardW(const SR_RuleTrie* trie, uint32_t node, const wchar_t* path, size_t start, size_t len, size_t* consumed)
+{
+	const Node* current = &trie->Nodes[node];
+
+	if (current->RunLen == 0)
+	{
+		*consumed = 1;
+		return FindChild(trie, node, (unsigned int)path[start]);
+	}
+
+	if (current->RunLen > len - start) return NO_NODE;
+
+	for (uint32_t i = 0; i < current->RunLen; i++)
+		if (current->Run[i] != (unsigned int)path[start + i]) return NO_NODE;
+
+	*consumed = current->RunLen;
+	return current->RunEnd;
+}
+
+// Walks forwards from a node over a narrow path, starting at `path[start]`.
+// Returns the node reached and sets `consumed` to the number of characters walked over, or returns NO_NODE.
+static uint32_t StepForwardA(const SR_RuleTrie* trie, uint32_t node, const char* path, size_t start, size_t len, size_t* consumed)
+{
+	const Node* current = &trie->Nodes[node];
+
+	if (current->RunLen == 0)
+	{
+		*consumed = 1;
+		return FindChild(trie, node, (unsigned int)(unsigned char)path[start]);
+	}
+
+	if (current->RunLen > len - start) return NO_NODE;
+
+	for (uint32_t i = 0; i < current->RunLen; i++)
+		if (current->Run[i] != (unsigned int)(unsigned char)path[start + i]) return NO_NODE;
+
+	*consumed = current->RunLen;
+	return current->RunEnd;
+}
+
+size_t SR_MatchRuleTrieW(const SR_RuleTrie* trie, const wchar_t* path, size_t len)
+{
+	size_t result = SR_NO_RULE;
+	uint32_t node = ROOT;
+	size_t i = len;
+
+	// Every match found while walking backwards is longer than the previous one, so the last match wins
+	while (i > 0)
+	{
+		size_t consumed;
+		node = StepBackwardW(trie, node, path, i, &consumed);
+		if (node == NO_NODE) break;
+
+		i -= consumed;
+		const Node* current = &trie->Nodes[node];
+
+		// path[i] is the first character of the match
+		if (current->SuffixValue != SR_NO_RULE && (i == 0 || path[i - 1] == L'\\'))
+			result = current->SuffixValue;
+
+		if (current->ExactValue != SR_NO_RULE && i == 0)
+			result = current->ExactValue;
+	}
+
+	return result;
+}
+
+size_t SR_MatchRuleTrieA(const SR_RuleTrie* trie, const char* path, size_t len)
+{
+	size_t result = SR_NO_RULE;
+	uint32_t node = ROOT;
+	size_t i = len;
+
+	// Every match found while walking backwards is longer than the previous one, so the last match wins
+	while (i > 0)
+	{
+		size_t consumed;
+		node = StepBackwardA(trie, node, path, i, &consumed);
+		if (node == NO_NODE) break;
+
+		i -= consumed;
+		const Node* current = &trie->Nodes[node];
+
+		// path[i] is the first character of the match
+		if (current->SuffixValue != SR_NO_RULE && (i == 0 || path[i - 1] == '\\'))
+			result = current->SuffixValue;
+
+		if (current->ExactValue != SR_NO_RULE && i == 0)
+			result = current->ExactValue;
+	}
+
+	return result;
+}
+
+bool SR_RuleTrieHasPrefixes(const SR_RuleTrie* trie)
+{
+	return trie->Nodes[PREFIX_ROOT].EdgeCount > 0;
+}
+
+size_t SR_MatchRuleTriePrefixW(const SR_RuleTrie* trie, const wchar_t* path, size_t len, size_t* prefixLen)
+{
+	size_t result = SR_NO_RULE;
+	uint32_t node = PREFIX_ROOT;
+	size_t i = 0;
+
+	// Every match found while walking forwards is longer than the previous one, so the last match wins
+	while (i < len)
+	{
+		size_t consumed;
+		node = StepForwardW(trie, node, path, i, len, &consumed);
+		if (node == NO_NODE) break;
+
+		i += consumed;
+
+		// path[i - 1] is the last character of the match, which must end a segment
+		size_t value = trie->Nodes[node].PrefixValue;
+		if (value != SR_NO_RULE && (i == len || path[i] == L'\\'))
+		{
+			result = value;
+			*prefixLen = i;
+		}
+	}
+
+	return result;
+}
+
+size_t SR_MatchRuleTriePrefixA(const SR_RuleTrie* trie, const char* path, size_t len, size_t* prefixLen)
+{
+	size_t result = SR_NO_RULE;
+	uint32_t node = PREFIX_ROOT;
+	size_t i = 0;
+
+	// Every match found while walking forwards is longer than the previous one, so the last match wins
+	while (i < len)
+	{
+		size_t consumed;
+		node = StepForwardA(trie, node, path, i, len, &consumed);
+		if (node == NO_NODE) break;
+
+		i += consumed;
+
+		// path[i - 1] is the last character of the match, which must end a segment
+		size_t value = trie->Nodes[node].PrefixValue;
+		if (value != SR_NO_RULE && (i == len || path[i] == '\\'))
+		{
+			result = value;
+			*prefixLen = i;
+		}
+	}
+
+	return result;
+}
+
+void SR_FreeRuleTrie(SR_RuleTrie* trie)
+{
+	if (trie == NULL) return;
+
+	for (uint32_t i = 0; i < trie->NodeCount; i++)
+	{
+		free(trie->Nodes[i].Edges);
+		free(trie->Nodes[i].Run);
+	}
+
+	free(trie->Nodes);
+	free(trie);
+}
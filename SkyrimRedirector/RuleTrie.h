@@ -0,0 +1,110 @@
+#pragma once
+#include <wchar.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+Reverse path trie
+
+Stores any number of path patterns reversed and case-folded, so that every pattern a path ends with can be found
+in a single backward walk over the path. Directory patterns are stored forwards in a separate branch, so that the
+directory a path is in can be found in a single forward walk. The cost of a lookup depends only on the length of
+the path, never on the number of patterns.
+
+This file doesn't depend on Windows, so it can be tested and benchmarked on any platform.
+*/
+
+typedef struct SR_RuleTrie SR_RuleTrie;
+
+// Value returned when no rule matches
+#define SR_NO_RULE ((size_t)-1)
+
+// How a rule pattern is matched against a path
+typedef enum
+{
+	// The pattern is a relative path that matches the end of any path, as long as it starts right after a separator.
+	// e.g. "My Games\Skyrim\Skyrim.ini" matches "C:\Users\Player\Documents\My Games\Skyrim\Skyrim.ini"
+	SR_RULE_SUFFIX,
+
+	// The pattern is an absolute path that only matches itself.
+	SR_RULE_EXACT,
+
+	// The pattern is an absolute directory that matches itself and every path inside it.
+	// These patterns are only matched by SR_MatchRuleTriePrefixW/A.
+	// e.g. "C:\Saves" matches "C:\Saves" and "C:\Saves\Save1.ess", but not "C:\Saves2"
+	SR_RULE_PREFIX,
+
+} SR_RuleKind;
+
+// Creates an empty trie.
+// The returned trie must be freed with SR_FreeRuleTrie.
+SR_RuleTrie* SR_CreateRuleTrie();
+
+// Adds a wide pattern to a trie.
+// If the same pattern is added twice with the same kind, the last value is kept.
+//  pattern: The path to match. It is case-folded and its '/' separators are converted to '\'.
+//  kind: How the pattern is matched
+//  value: The value returned when the pattern matches
+void SR_AddRuleW(SR_RuleTrie* trie, const wchar_t* pattern, SR_RuleKind kind, size_t value);
+
+// Adds a narrow pattern to a trie.
+// If the same pattern is added twice with the same kind, the last value is kept.
+//  pattern: The path to match. It is case-folded and its '/' separators are converted to '\'.
+//  kind: How the pattern is matched
+//  value: The value returned when the pattern matches
+void SR_AddRuleA(SR_RuleTrie* trie, const char* pattern, SR_RuleKind kind, size_t value);
+
+// Checks if any pattern could match a path with a specified wide file name, ignoring case.
+// This doesn't need a canonical path, and is used to reject most paths before canonicizing them.
+bool SR_RuleTrieHasFileNameW(const SR_RuleTrie* trie, const wchar_t* fileName);
+
+// Checks if any pattern could match a path with a specified narrow file name, ignoring case.
+// This doesn't need a canonical path, and is used to reject most paths before canonicizing them.
+bool SR_RuleTrieHasFileNameA(const SR_RuleTrie* trie, const char* fileName);
+
+// Checks if any pattern could match a wide path, from its file name, ignoring case.
+// The file name is found with SR_FindFileNameW, and most paths are rejected from its length, last character and
+// extension alone. The file name of the remaining paths is checked with SR_RuleTrieHasFileNameW.
+// This doesn't need a canonical path, and is used to reject most paths before canonicizing them.
+bool SR_RuleTrieCouldMatchW(const SR_RuleTrie* trie, const wchar_t* path);
+
+// Checks if any pattern could match a narrow path, from its file name, ignoring case.
+// The file name is found with SR_FindFileNameA, and most paths are rejected from its length, last character and
+// extension alone. The file name of the remaining paths is checked with SR_RuleTrieHasFileNameA.
+// This doesn't need a canonical path, and is used to reject most paths before canonicizing them.
+bool SR_RuleTrieCouldMatchA(const SR_RuleTrie* trie, const char* path);
+
+// Finds the longest pattern that matches a canonical wide path.
+//  path: The canonical path, in uppercase and using only '\' as separator
+//  len: The length of `path`
+// Returns the value of the matched pattern, or SR_NO_RULE if no pattern matches.
+size_t SR_MatchRuleTrieW(const SR_RuleTrie* trie, const wchar_t* path, size_t len);
+
+// Finds the longest pattern that matches a canonical narrow path.
+//  path: The canonical path, in uppercase and using only '\' as separator
+//  len: The length of `path`
+// Returns the value of the matched pattern, or SR_NO_RULE if no pattern matches.
+size_t SR_MatchRuleTrieA(const SR_RuleTrie* trie, const char* path, size_t len);
+
+// Checks if a trie has any SR_RULE_PREFIX pattern.
+// Paths with any file name can match those, so the file name can't be used to reject paths if this is true.
+bool SR_RuleTrieHasPrefixes(const SR_RuleTrie* trie);
+
+// Finds the longest SR_RULE_PREFIX pattern that matches a canonical wide path.
+//  path: The canonical path, in uppercase and using only '\' as separator
+//  len: The length of `path`
+//  prefixLen: Where the length of the matched directory in `path` will be stored.
+//             The rest of the path is either empty or starts with a separator.
+// Returns the value of the matched pattern, or SR_NO_RULE if no pattern matches.
+size_t SR_MatchRuleTriePrefixW(const SR_RuleTrie* trie, const wchar_t* path, size_t len, size_t* prefixLen);
+
+// Finds the longest SR_RULE_PREFIX pattern that matches a canonical narrow path.
+//  path: The canonical path, in uppercase and using only '\' as separator
+//  len: The length of `path`
+//  prefixLen: Where the length of the matched directory in `path` will be stored.
+//             The rest of the path is either empty or starts with a separator.
+// Returns the value of the matched pattern, or SR_NO_RULE if no pattern matches.
+size_t SR_MatchRuleTriePrefixA(const SR_RuleTrie* trie, const char* path, size_t len, size_t* prefixLen);
+
+// Frees all resources used by a trie
+void SR_FreeRuleTrie(SR_RuleTrie* trie);
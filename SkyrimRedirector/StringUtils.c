@@ -1,20 +1,11 @@
 #include "SR_Base.h"
 #include "StringUtils.h"
 #include "Logging.h"
+#include "PathScan.h"
+#include "CaseFold.h"
 #include <stdlib.h>
-#include <locale.h>
 #include <Windows.h>
 
-static _locale_t InvariantLocale = NULL;
-
-_locale_t SR_GetInvariantLocale()
-{
-	if (InvariantLocale == NULL)
-		InvariantLocale = _create_locale(LC_ALL, "C");
-
-	return InvariantLocale;
-}
-
 static char* Utf16ToCodepage(const wchar_t* utf16, UINT codePage)
 {
 	int needed = WideCharToMultiByte(CP_UTF8, 0, utf16, -1, NULL, 0, NULL, NULL);
@@ -29,30 +20,14 @@ char* SR_Utf16ToCodepage(const wchar_t* utf16) { return Utf16ToCodepage(utf16, C
 
 const wchar_t* SR_GetFileNameW(const wchar_t* path)
 {
-	wchar_t* lastBack = wcsrchr(path, L'\\');
-	wchar_t* lastForward = wcsrchr(path, L'/');
-
-	if (lastBack != NULL && lastForward != NULL)
-		return max(lastBack, lastForward) + 1;
-
-	if (lastBack != NULL) return lastBack + 1;
-	if (lastForward != NULL) return lastForward + 1;
-
-	return path;
+	size_t len;
+	return path + SR_FindFileNameW(path, &len);
 }
 
 const char* SR_GetFileNameA(const char* path)
 {
-	char* lastBack = strrchr(path, '\\');
-	char* lastForward = strrchr(path, '/');
-
-	if (lastBack != NULL && lastForward != NULL)
-		return max(lastBack, lastForward) + 1;
-
-	if (lastBack != NULL) return lastBack + 1;
-	if (lastForward != NULL) return lastForward + 1;
-
-	return path;
+	size_t len;
+	return path + SR_FindFileNameA(path, &len);
 }
 
 const wchar_t* SR_ToUpperW(const wchar_t* input)
@@ -61,7 +36,7 @@ const wchar_t* SR_ToUpperW(const wchar_t* input)
 	wchar_t* inputUpper = calloc(inputSize, sizeof(wchar_t));
 
 	wcscpy_s(inputUpper, inputSize, input);
-	_wcsupr_s_l(inputUpper, inputSize, SR_GetInvariantLocale());
+	SR_FoldW(inputUpper, inputSize - 1);
 
 	return inputUpper;
 }
@@ -72,19 +47,19 @@ const char* SR_ToUpperA(const char* input)
 	char* inputUpper = calloc(inputSize, sizeof(char));
 
 	strcpy_s(inputUpper, inputSize, input);
-	_strupr_s_l(inputUpper, inputSize, SR_GetInvariantLocale());
+	SR_FoldA(inputUpper, inputSize - 1);
 
 	return inputUpper;
 }
 
 bool SR_AreCaseInsensitiveEqualW(const wchar_t* first, const wchar_t* second)
 {
-	return _wcsicmp_l(first, second, SR_GetInvariantLocale()) == 0;
+	return SR_FoldedEqualsW(first, second);
 }
 
 bool SR_AreCaseInsensitiveEqualA(const char* first, const char* second)
 {
-	return _stricmp_l(first, second, SR_GetInvariantLocale()) == 0;
+	return SR_FoldedEqualsA(first, second);
 }
 
 wchar_t* SR_Concat(size_t count, ...)
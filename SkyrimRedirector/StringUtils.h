@@ -2,9 +2,6 @@
 #include <wchar.h>
 #include <stdbool.h>
 
-// Gets a locale that can be used to perform invariant string operations.
-_locale_t SR_GetInvariantLocale();
-
 // Transforms a UTF16 string to a UTF8 string.
 // The new string is allocated dynamically must be freed
 char* SR_Utf16ToUtf8(const wchar_t* utf16);
@@ -21,18 +18,18 @@ const wchar_t* SR_GetFileNameW(const wchar_t* path);
 // The returned string points to the same buffer as `path`, and doesn't need to be freed.
 const char* SR_GetFileNameA(const char* path);
 
-// Transforms a wide string to all-upercase, using an invariant locale.
+// Transforms a wide string to all-upercase, the same way NTFS does.
 // The returned string is allocated dynamically and must be freed
 const wchar_t* SR_ToUpperW(const wchar_t* input);
 
-// Transforms a narrow string to all-upercase, using an invariant locale.
+// Transforms the ASCII letters of a narrow string to uppercase.
 // The returned string is allocated dynamically and must be freed
 const char* SR_ToUpperA(const char* input);
 
-// Checks if two wide strings are equal, ignoring case and using an invariant locale.
+// Checks if two wide strings are equal, ignoring case the same way NTFS does.
 bool SR_AreCaseInsensitiveEqualW(const wchar_t* first, const wchar_t* second);
 
-// Checks if two narrow strings are equal, ignoring case and using an invariant locale.
+// Checks if two narrow strings are equal, ignoring the case of ASCII letters.
 bool SR_AreCaseInsensitiveEqualA(const char* first, const char* second);
 
 // Concatenates multiple strings. All arguments must be of type const wchar_t*.
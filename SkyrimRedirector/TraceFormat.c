@@ -0,0 +1,563 @@
+#include "SR_Base.h"
+#include "TraceFormat.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// A conversion specification of a printf format, e.g. "%-12.3ls"
+typedef struct
+{
+	// The flags, e.g. "-0"
+	const wchar_t* Flags;
+	size_t FlagsLen;
+
+	// The width and precision as written in the format, or -1 if there is none.
+	// If they're '*', they're read from the arguments instead.
+	int Width;
+	int Precision;
+	bool WidthArgument;
+	bool PrecisionArgument;
+
+	// The length modifier, e.g. 'h' for "h", 'H' for "hh", 'l' for "l", 'L' for "ll" and "I64"
+	wchar_t Length;
+	// The conversion character, e.g. 'd'
+	wchar_t Conversion;
+	// The kind of the argument, or 0 if it takes none
+	uint8_t Kind;
+
+	// The first character after the specification
+	const wchar_t* End;
+
+} Specification;
+
+// Reads a number from a format, advancing past it
+static int ParseNumber(const wchar_t** format)
+{
+	int number = 0;
+	for (; **format >= L'0' && **format <= L'9'; (*format)++)
+		number = number * 10 + (**format - L'0');
+
+	return number;
+}
+
+// Gets the kind of an integer argument from its length modifier
+static uint8_t IntegerKind(wchar_t length, bool isUnsigned)
+{
+	switch (length)
+	{
+	case L'l': return isUnsigned ? SR_TRACE_UNSIGNED_LONG : SR_TRACE_LONG;
+	case L'L': return SR_TRACE_LONG_LONG;
+	case L'z': return SR_TRACE_SIZE;
+	default: return isUnsigned ? SR_TRACE_UNSIGNED_INT : SR_TRACE_INT;
+	}
+}
+
+// Parses the conversion specification that starts at a '%'.
+// Returns false if it can't be stored in a trace, e.g. "%n".
+static bool ParseSpecification(const wchar_t* format, Specification* spec)
+{
+	memset(spec, 0, sizeof(Specification));
+	format++;
+
+	spec->Flags = format;
+	while (*format != L'\0' && wcschr(L"-+ #0", *format) != NULL) format++;
+	spec->FlagsLen = format - spec->Flags;
+
+	spec->Width = -1;
+	if (*format == L'*')
+	{
+		spec->WidthArgument = true;
+		format++;
+	}
+	else if (*format >= L'0' && *format <= L'9')
+	{
+		spec->Width = ParseNumber(&format);
+	}
+
+	spec->Precision = -1;
+	if (*format == L'.')
+	{
+		format++;
+		if (*format == L'*')
+		{
+			spec->PrecisionArgument = true;
+			format++;
+		}
+		else
+		{
+			spec->Precision = ParseNumber(&format);
+		}
+	}
+
+	// Sizes that are the same as int on every platform are read as int
+	if (format[0] == L'h' && format[1] == L'h') { spec->Length = L'H'; format += 2; }
+	else if (format[0] == L'l' && format[1] == L'l') { spec->Length = L'L'; format += 2; }
+	else if (format[0] == L'I' && format[1] == L'6' && format[2] == L'4') { spec->Length = L'L'; format += 3; }
+	else if (format[0] == L'I' && format[1] == L'3' && format[2] == L'2') { format += 3; }
+	else if (*format == L'j') { spec->Length = L'L'; format++; }
+	else if (*format == L'z' || *format == L't' || *format == L'I') { spec->Length = L'z'; format++; }
+	else if (*format == L'h' || *format == L'l' || *format == L'w' || *format == L'L') { spec->Length = *format; format++; }
+
+	spec->Conversion = *format;
+	if (*format != L'\0') format++;
+	spec->End = format;
+
+	switch (spec->Conversion)
+	{
+	case L'%':
+		return true;
+
+	case L'd': case L'i':
+		spec->Kind = IntegerKind(spec->Length, false);
+		return true;
+
+	case L'u': case L'o': case L'x': case L'X':
+		spec->Kind = IntegerKind(spec->Length, true);
+		return true;
+
+	case L'c': case L'C':
+		spec->Kind = SR_TRACE_INT;
+		return true;
+
+	case L'e': case L'E': case L'f': case L'F': case L'g': case L'G': case L'a': case L'A':
+		spec->Kind = SR_TRACE_DOUBLE;
+		return true;
+
+	case L'p':
+		spec->Kind = SR_TRACE_POINTER;
+		return true;
+
+	case L's': case L'S':
+		// Without a length, the wide functions read %s as a wide string on Windows, and %S as the other kind
+		if (spec->Length == L'l' || spec->Length == L'w')
+			spec->Kind = SR_TRACE_WIDE_STRING;
+		else if (spec->Length == L'h')
+			spec->Kind = SR_TRACE_NARROW_STRING;
+#ifdef _WIN32
+		else
+			spec->Kind = spec->Conversion == L's' ? SR_TRACE_WIDE_STRING : SR_TRACE_NARROW_STRING;
+#else
+		else
+			spec->Kind = spec->Conversion == L's' ? SR_TRACE_NARROW_STRING : SR_TRACE_WIDE_STRING;
+#endif
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+size_t SR_GetTraceArguments(const wchar_t* format, uint8_t* kinds)
+{
+	size_t count = 0;
+
+	while ((format = wcschr(format, L'%')) != NULL)
+	{
+		Specification spec;
+		if (!ParseSpecification(format, &spec)) return SIZE_MAX;
+
+		size_t needed = (spec.WidthArgument ? 1 : 0) + (spec.PrecisionArgument ? 1 : 0) + (spec.Kind != 0 ? 1 : 0);
+		if (count + needed > SR_TRACE_MAX_ARGUMENTS) return SIZE_MAX;
+
+		if (spec.WidthArgument) kinds[count++] = SR_TRACE_INT;
+		if (spec.PrecisionArgument) kinds[count++] = SR_TRACE_INT;
+		if (spec.Kind != 0) kinds[count++] = spec.Kind;
+
+		format = spec.End;
+	}
+
+	return count;
+}
+
+// Stores a string argument, truncating it to fit.
+//  unitSize: The size of each character in the trace, 1 or 2
+static size_t EncodeString(const void* text, size_t len, size_t unitSize, unsigned char* buffer, size_t size)
+{
+	size_t fits = size > 4 ? (size - 4) / unitSize : 0;
+	if (len > fits) len = fits;
+
+	uint32_t storedLen = (uint32_t)len;
+	memcpy(buffer, &storedLen, 4);
+	memcpy(buffer + 4, text, len * unitSize);
+
+	return 4 + len * unitSize;
+}
+
+// Stores a wide string argument as UTF-16, truncating it to fit
+static size_t EncodeWideString(const wchar_t* text, unsigned char* buffer, size_t size)
+{
+	if (text == NULL) text = L"(null)";
+
+#if WCHAR_MAX <= 0xFFFF
+	return EncodeString(text, wcslen(text), sizeof(uint16_t), buffer, size);
+#else
+	// Wide strings are UTF-32 on other platforms. Almost every character fits in one unit, so convert them all
+	// assuming so, and only start over if one didn't.
+	size_t fits = size > 4 ? (size - 4) / sizeof(uint16_t) : 0;
+	size_t textLen = wcslen(text);
+	size_t len = textLen < fits ? textLen : fits;
+
+	uint32_t outside = 0;
+	for (size_t i = 0; i < len; i++)
+	{
+		uint16_t unit = (uint16_t)text[i];
+		outside |= (uint32_t)text[i] >> 16;
+		memcpy(buffer + 4 + i * sizeof(uint16_t), &unit, sizeof(uint16_t));
+	}
+
+	if (outside != 0)
+	{
+		len = 0;
+		for (; *text != L'\0'; text++)
+		{
+			uint32_t c = (uint32_t)*text;
+			uint16_t units[2] = { (uint16_t)c, 0 };
+			size_t count = 1;
+			if (c > 0xFFFF)
+			{
+				units[0] = (uint16_t)(0xD800 + ((c - 0x10000) >> 10));
+				units[1] = (uint16_t)(0xDC00 + ((c - 0x10000) & 0x3FF));
+				count = 2;
+			}
+
+			if (len + count > fits) break;
+
+			memcpy(buffer + 4 + len * sizeof(uint16_t), units, count * sizeof(uint16_t));
+			len += count;
+		}
+	}
+
+	uint32_t storedLen = (uint32_t)len;
+	memcpy(buffer, &storedLen, 4);
+	return 4 + len * sizeof(uint16_t);
+#endif
+}
+
+size_t SR_EncodeTraceArguments(const uint8_t* kinds, size_t count, va_list args, unsigned char* buffer, size_t size)
+{
+	size_t len = 0;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		// Every argument takes at least its kind and 8 bytes
+		if (size - len < 9) break;
+
+		uint8_t kind = kinds[i];
+		buffer[len++] = kind;
+
+		int64_t value = 0;
+		switch (kind)
+		{
+		case SR_TRACE_INT: value = va_arg(args, int); break;
+		case SR_TRACE_UNSIGNED_INT: value = va_arg(args, unsigned int); break;
+		case SR_TRACE_LONG: value = va_arg(args, long); break;
+		case SR_TRACE_UNSIGNED_LONG: value = (int64_t)va_arg(args, unsigned long); break;
+		case SR_TRACE_LONG_LONG: value = va_arg(args, long long); break;
+		case SR_TRACE_SIZE: value = (int64_t)va_arg(args, size_t); break;
+		case SR_TRACE_POINTER: value = (int64_t)(uintptr_t)va_arg(args, void*); break;
+
+		case SR_TRACE_DOUBLE:
+		{
+			double number = va_arg(args, double);
+			memcpy(buffer + len, &number, 8);
+			len += 8;
+			continue;
+		}
+
+		case SR_TRACE_WIDE_STRING:
+			len += EncodeWideString(va_arg(args, const wchar_t*), buffer + len, size - len);
+			continue;
+
+		case SR_TRACE_NARROW_STRING:
+		{
+			const char* text = va_arg(args, const char*);
+			if (text == NULL) text = "(null)";
+
+			len += EncodeString(text, strlen(text), 1, buffer + len, size - len);
+			continue;
+		}
+		}
+
+		memcpy(buffer + len, &value, 8);
+		len += 8;
+	}
+
+	return len;
+}
+
+// Text being formatted into a buffer, which is truncated if it grows past it
+typedef struct
+{
+	char* Buffer;
+	size_t Size;
+	size_t Len;
+
+} Output;
+
+static void Append(Output* output, const char* text, size_t len)
+{
+	size_t fits = output->Size - 1 - output->Len;
+	if (len > fits) len = fits;
+
+	memcpy(output->Buffer + output->Len, text, len);
+	output->Len += len;
+}
+
+// Appends a Unicode character as UTF-8
+static void AppendCodePoint(Output* output, uint32_t c)
+{
+	char bytes[4];
+	size_t len;
+
+	if (c < 0x80) { bytes[0] = (char)c; len = 1; }
+	else if (c < 0x800) { bytes[0] = (char)(0xC0 | (c >> 6)); bytes[1] = (char)(0x80 | (c & 0x3F)); len = 2; }
+	else if (c < 0x10000)
+	{
+		bytes[0] = (char)(0xE0 | (c >> 12));
+		bytes[1] = (char)(0x80 | ((c >> 6) & 0x3F));
+		bytes[2] = (char)(0x80 | (c & 0x3F));
+		len = 3;
+	}
+	else
+	{
+		bytes[0] = (char)(0xF0 | (c >> 18));
+		bytes[1] = (char)(0x80 | ((c >> 12) & 0x3F));
+		bytes[2] = (char)(0x80 | ((c >> 6) & 0x3F));
+		bytes[3] = (char)(0x80 | (c & 0x3F));
+		len = 4;
+	}
+
+	Append(output, bytes, len);
+}
+
+// Appends UTF-16 text as UTF-8. Unpaired surrogates are replaced with U+FFFD.
+static void AppendUtf16(Output* output, const uint16_t* text, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+	{
+		uint32_t c = text[i];
+		if (c >= 0xD800 && c <= 0xDBFF && i + 1 < len && text[i + 1] >= 0xDC00 && text[i + 1] <= 0xDFFF)
+		{
+			c = 0x10000 + ((c - 0xD800) << 10) + (text[i + 1] - 0xDC00);
+			i++;
+		}
+		else if (c >= 0xD800 && c <= 0xDFFF)
+		{
+			c = 0xFFFD;
+		}
+
+		AppendCodePoint(output, c);
+	}
+}
+
+// Appends the literal text of a format as UTF-8
+static void AppendWide(Output* output, const wchar_t* text, size_t len)
+{
+#if WCHAR_MAX <= 0xFFFF
+	AppendUtf16(output, (const uint16_t*)text, len);
+#else
+	for (size_t i = 0; i < len; i++)
+		AppendCodePoint(output, (uint32_t)text[i]);
+#endif
+}
+
+size_t SR_TraceUtf16ToUtf8(const uint16_t* text, size_t len, char* buffer, size_t size)
+{
+	// Output always keeps space for a null terminator, which isn't needed here
+	Output output = { buffer, size + 1, 0 };
+	AppendUtf16(&output, text, len);
+
+	return output.Len;
+}
+
+// A stored argument read back from a trace
+typedef struct
+{
+	uint8_t Kind;
+	int64_t Value;
+	double Number;
+
+	// The characters of a string, which are 1 or 2 bytes long, and their number
+	const unsigned char* Text;
+	size_t TextLen;
+
+} Argument;
+
+// Reads the next stored argument, advancing past it. Returns false if there are no more valid arguments.
+static bool ReadArgument(const unsigned char* data, size_t len, size_t* offset, Argument* argument)
+{
+	memset(argument, 0, sizeof(Argument));
+	if (*offset >= len) return false;
+
+	argument->Kind = data[(*offset)++];
+	if (len - *offset < sizeof(uint64_t) && argument->Kind != SR_TRACE_WIDE_STRING && argument->Kind != SR_TRACE_NARROW_STRING) return false;
+
+	switch (argument->Kind)
+	{
+	case SR_TRACE_DOUBLE:
+		memcpy(&argument->Number, data + *offset, 8);
+		*offset += 8;
+		return true;
+
+	case SR_TRACE_WIDE_STRING:
+	case SR_TRACE_NARROW_STRING:
+	{
+		if (len - *offset < 4) return false;
+
+		uint32_t textLen;
+		memcpy(&textLen, data + *offset, 4);
+		*offset += 4;
+
+		size_t bytes = (size_t)textLen * (argument->Kind == SR_TRACE_WIDE_STRING ? 2 : 1);
+		if (len - *offset < bytes) return false;
+
+		argument->Text = data + *offset;
+		argument->TextLen = textLen;
+		*offset += bytes;
+		return true;
+	}
+
+	default:
+		memcpy(&argument->Value, data + *offset, 8);
+		*offset += 8;
+		return true;
+	}
+}
+
+// Appends a string argument, padded to its width and truncated to its precision
+static void AppendString(Output* output, const Specification* spec, int width, int precision, const Argument* argument)
+{
+	size_t len = argument->TextLen;
+	if (precision >= 0 && (size_t)precision < len) len = precision;
+
+	size_t padding = width > 0 && (size_t)width > len ? width - len : 0;
+	bool leftAligned = wmemchr(spec->Flags, L'-', spec->FlagsLen) != NULL;
+
+	if (!leftAligned)
+		for (size_t i = 0; i < padding; i++) Append(output, " ", 1);
+
+	if (argument->Kind == SR_TRACE_WIDE_STRING)
+	{
+		// The characters aren't aligned in the trace, so copy them before converting them
+		uint16_t units[256];
+		for (size_t start = 0; start < len; start += 256)
+		{
+			size_t count = len - start < 256 ? len - start : 256;
+			memcpy(units, argument->Text + start * 2, count * 2);
+			AppendUtf16(output, units, count);
+		}
+	}
+	else
+	{
+		Append(output, (const char*)argument->Text, len);
+	}
+
+	if (leftAligned)
+		for (size_t i = 0; i < padding; i++) Append(output, " ", 1);
+}
+
+// Appends a number argument by formatting it with the narrow printf, which formats numbers the same way
+static void AppendNumber(Output* output, const Specification* spec, int width, int precision, const Argument* argument)
+{
+	// '%', flags, width, precision, "ll", conversion and the null terminator
+	char format[64];
+	size_t len = 0;
+
+	format[len++] = '%';
+	for (size_t i = 0; i < spec->FlagsLen && i < 8; i++) format[len++] = (char)spec->Flags[i];
+	if (width >= 0) len += snprintf(format + len, sizeof(format) - len, "%d", width);
+	if (precision >= 0) len += snprintf(format + len, sizeof(format) - len, ".%d", precision);
+
+	char text[512];
+	if (argument->Kind == SR_TRACE_DOUBLE)
+	{
+		format[len++] = (char)spec->Conversion;
+		format[len] = '\0';
+		snprintf(text, sizeof(text), format, argument->Number);
+	}
+	else if (argument->Kind == SR_TRACE_POINTER)
+	{
+		// Pointers are printed as fixed-width uppercase hexadecimal, the same as Windows does for 64-bit pointers
+		snprintf(text, sizeof(text), "%016llX", (unsigned long long)argument->Value);
+	}
+	else
+	{
+		// Values read as int but printed as smaller types are truncated first
+		long long value = argument->Value;
+		bool isUnsigned = argument->Kind == SR_TRACE_UNSIGNED_INT || argument->Kind == SR_TRACE_UNSIGNED_LONG;
+		if (spec->Length == L'H') value = isUnsigned ? (long long)(unsigned char)value : (long long)(signed char)value;
+		if (spec->Length == L'h') value = isUnsigned ? (long long)(unsigned short)value : (long long)(short)value;
+
+		format[len++] = 'l';
+		format[len++] = 'l';
+		format[len++] = (char)spec->Conversion;
+		format[len] = '\0';
+		snprintf(text, sizeof(text), format, value);
+	}
+
+	Append(output, text, strlen(text));
+}
+
+size_t SR_FormatTrace(const wchar_t* format, const unsigned char* data, size_t len, char* buffer, size_t size)
+{
+	Output output = { buffer, size, 0 };
+	size_t offset = 0;
+
+	const wchar_t* percent;
+	while ((percent = wcschr(format, L'%')) != NULL)
+	{
+		AppendWide(&output, format, percent - format);
+
+		Specification spec;
+		if (!ParseSpecification(percent, &spec))
+		{
+			// Formats with these are never stored in a trace, so they can only come from a corrupted one
+			AppendWide(&output, percent, spec.End - percent);
+			format = spec.End;
+			continue;
+		}
+
+		format = spec.End;
+		if (spec.Kind == 0)
+		{
+			Append(&output, "%", 1);
+			continue;
+		}
+
+		Argument argument;
+		int width = spec.Width;
+		int precision = spec.Precision;
+
+		if (spec.WidthArgument)
+		{
+			if (!ReadArgument(data, len, &offset, &argument)) break;
+			width = (int)argument.Value;
+		}
+
+		if (spec.PrecisionArgument)
+		{
+			if (!ReadArgument(data, len, &offset, &argument)) break;
+			precision = (int)argument.Value;
+		}
+
+		if (!ReadArgument(data, len, &offset, &argument)) break;
+
+		if (argument.Kind == SR_TRACE_WIDE_STRING || argument.Kind == SR_TRACE_NARROW_STRING)
+		{
+			AppendString(&output, &spec, width, precision, &argument);
+		}
+		else if (spec.Conversion == L'c' || spec.Conversion == L'C')
+		{
+			AppendCodePoint(&output, (uint32_t)argument.Value & 0xFFFF);
+		}
+		else
+		{
+			AppendNumber(&output, &spec, width, precision, &argument);
+		}
+	}
+
+	if (percent == NULL) AppendWide(&output, format, wcslen(format));
+
+	buffer[output.Len] = '\0';
+	return output.Len;
+}
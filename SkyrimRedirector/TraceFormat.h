@@ -0,0 +1,77 @@
+#pragma once
+#include <wchar.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+Binary trace format
+
+In binary mode, the log doesn't format messages. Each message is stored as the ID of its format string, its level,
+time and thread, and the raw values of its arguments, so logging a message only copies its arguments.
+TraceDecoder turns a trace back into the same text the log would have had.
+
+A trace is a sequence of records, each starting with its one-byte type. Every number is little-endian.
+  * Start:   uint32 SR_TRACE_MAGIC, uint32 SR_TRACE_VERSION, int64 offset of the local time from UTC.
+             Written whenever the log is opened, so format IDs are only valid until the next start record.
+  * Format:  uint32 ID, uint32 length, UTF-16 format string. Written before the first message that uses it.
+  * Message: uint32 format ID, uint8 level, uint64 time, uint32 thread ID, uint32 size, arguments
+  * Text:    uint8 level, uint64 time, uint32 thread ID, uint32 length, UTF-16 message.
+             Used for messages whose format can't be stored as arguments.
+
+Times are FILETIMEs, in 100 nanosecond units since 1601, in UTC.
+Each argument is its one-byte kind followed by its value: integers, pointers and doubles take 8 bytes, and strings
+take their uint32 length followed by their UTF-16 or narrow characters.
+
+This file doesn't depend on Windows, so traces can be decoded on any platform.
+*/
+
+#define SR_TRACE_MAGIC 0x43525453u
+#define SR_TRACE_VERSION 1
+
+// Most arguments a format can have to be stored in a trace, counting '*' widths and precisions
+#define SR_TRACE_MAX_ARGUMENTS 16
+
+enum
+{
+	SR_TRACE_RECORD_START = 'S',
+	SR_TRACE_RECORD_FORMAT = 'F',
+	SR_TRACE_RECORD_MESSAGE = 'M',
+	SR_TRACE_RECORD_TEXT = 'T',
+};
+
+// How an argument is read from the argument list. The value is always stored as 8 bytes.
+enum
+{
+	SR_TRACE_INT = 1,
+	SR_TRACE_UNSIGNED_INT,
+	SR_TRACE_LONG,
+	SR_TRACE_UNSIGNED_LONG,
+	SR_TRACE_LONG_LONG,
+	SR_TRACE_SIZE,
+	SR_TRACE_POINTER,
+	SR_TRACE_DOUBLE,
+	SR_TRACE_WIDE_STRING,
+	SR_TRACE_NARROW_STRING,
+};
+
+// Finds the kind of every argument a wide printf format takes.
+//  kinds: Receives the kind of each argument, at most SR_TRACE_MAX_ARGUMENTS
+// Returns the number of arguments, or SIZE_MAX if the format can't be stored as arguments.
+size_t SR_GetTraceArguments(const wchar_t* format, uint8_t* kinds);
+
+// Stores the values of arguments in the trace format. Strings are truncated to fit in the buffer.
+//  kinds: The kinds returned by SR_GetTraceArguments for the format
+// Returns the number of bytes stored.
+size_t SR_EncodeTraceArguments(const uint8_t* kinds, size_t count, va_list args, unsigned char* buffer, size_t size);
+
+// Formats stored arguments the same way as the wide printf functions would have formatted them, as UTF-8.
+//  format: The null-terminated format the arguments were stored for
+//  size: The size of `buffer`, in bytes. Must not be 0.
+// Returns the length of the text stored in the buffer, not counting its null terminator.
+size_t SR_FormatTrace(const wchar_t* format, const unsigned char* data, size_t len, char* buffer, size_t size);
+
+// Converts UTF-16 text to UTF-8, truncating it if it doesn't fit in the buffer.
+// Returns the number of bytes stored, without any null terminator.
+size_t SR_TraceUtf16ToUtf8(const uint16_t* text, size_t len, char* buffer, size_t size);
@@ -1,8 +1,10 @@
 #include "SR_Base.h"
 #include "WindowsUtils.h"
-#include "StringUtils.h"
+#include "Canonicizer.h"
+#include "CaseFold.h"
 
 #include <string.h>
+#include <stdbool.h>
 #include <ShlObj.h>
 
 wchar_t* SR_GetKnownFolder(const KNOWNFOLDERID* const rfid)
@@ -26,7 +28,7 @@ wchar_t* SR_CanonicizePathW(const wchar_t* path)
 	GetFullPathNameW(path, canonicizedSize, canonicized, NULL);
 
 	// In-place uppercase path
-	_wcsupr_s_l(canonicized, canonicizedSize, SR_GetInvariantLocale());
+	SR_FoldW(canonicized, wcslen(canonicized));
 
 	return canonicized;
 }
@@ -39,7 +41,113 @@ char* SR_CanonicizePathA(const char* path)
 	GetFullPathNameA(path, canonicizedSize, canonicized, NULL);
 
 	// In-place uppercase path
-	_strupr_s_l(canonicized, canonicizedSize, SR_GetInvariantLocale());
+	SR_FoldA(canonicized, strlen(canonicized));
 
 	return canonicized;
 }
+
+// Size, in characters, of the buffer used to store the current directory when canonicizing relative paths
+#define CURRENT_DIR_BUFFER_SIZE (MAX_PATH * 2)
+
+// Checks if the ANSI code page can be handled by the user-mode canonicizer,
+// which needs '\' and '/' to never be part of a multi-byte character
+static bool IsAnsiCodePageCanonicizable()
+{
+	// 0 = Not checked yet, 1 = Canonicizable, 2 = Not canonicizable
+	// Checking twice from two threads is harmless, so there's no need to synchronize this
+	static volatile LONG state = 0;
+
+	if (state == 0)
+	{
+		CPINFO info;
+		bool canonicizable = GetACP() == CP_UTF8 || (GetCPInfo(CP_ACP, &info) && info.MaxCharSize == 1);
+		state = canonicizable ? 1 : 2;
+	}
+
+	return state == 1;
+}
+
+// Resolves a wide path into a caller-supplied buffer, uppercasing it if `fold` is set.
+// See SR_CanonicizePathIntoW for the return value.
+static size_t ResolvePathIntoW(const wchar_t* path, wchar_t* buffer, size_t bufferSize, bool fold)
+{
+	// Try the user-mode canonicizer first, which only needs to call into Windows for relative paths
+	wchar_t currentDirBuffer[CURRENT_DIR_BUFFER_SIZE];
+	const wchar_t* currentDir = NULL;
+
+	if (SR_NeedsCurrentDirW(path))
+	{
+		DWORD currentDirLen = GetCurrentDirectoryW(CURRENT_DIR_BUFFER_SIZE, currentDirBuffer);
+		if (currentDirLen != 0 && currentDirLen < CURRENT_DIR_BUFFER_SIZE)
+			currentDir = currentDirBuffer;
+	}
+
+	size_t canonicalLen = fold
+		? SR_CanonicizeIntoW(path, currentDir, buffer, bufferSize)
+		: SR_ResolveIntoW(path, currentDir, buffer, bufferSize);
+	if (canonicalLen != 0) return canonicalLen;
+
+	// GetFullPathName returns the required size (with the null terminator) if the buffer is too small,
+	// or the length of the path (without the null terminator) if it fit
+	const DWORD result = GetFullPathNameW(path, (DWORD)bufferSize, buffer, NULL);
+	if (result == 0 || result >= bufferSize || !fold) return result;
+
+	// In-place uppercase path
+	SR_FoldW(buffer, result);
+
+	return result;
+}
+
+size_t SR_CanonicizePathIntoW(const wchar_t* path, wchar_t* buffer, size_t bufferSize)
+{
+	return ResolvePathIntoW(path, buffer, bufferSize, true);
+}
+
+size_t SR_ResolvePathIntoW(const wchar_t* path, wchar_t* buffer, size_t bufferSize)
+{
+	return ResolvePathIntoW(path, buffer, bufferSize, false);
+}
+
+// Resolves a narrow path into a caller-supplied buffer, uppercasing it if `fold` is set.
+// See SR_CanonicizePathIntoA for the return value.
+static size_t ResolvePathIntoA(const char* path, char* buffer, size_t bufferSize, bool fold)
+{
+	// Try the user-mode canonicizer first, which only needs to call into Windows for relative paths
+	if (IsAnsiCodePageCanonicizable())
+	{
+		char currentDirBuffer[CURRENT_DIR_BUFFER_SIZE];
+		const char* currentDir = NULL;
+
+		if (SR_NeedsCurrentDirA(path))
+		{
+			DWORD currentDirLen = GetCurrentDirectoryA(CURRENT_DIR_BUFFER_SIZE, currentDirBuffer);
+			if (currentDirLen != 0 && currentDirLen < CURRENT_DIR_BUFFER_SIZE)
+				currentDir = currentDirBuffer;
+		}
+
+		size_t canonicalLen = fold
+			? SR_CanonicizeIntoA(path, currentDir, buffer, bufferSize)
+			: SR_ResolveIntoA(path, currentDir, buffer, bufferSize);
+		if (canonicalLen != 0) return canonicalLen;
+	}
+
+	// GetFullPathName returns the required size (with the null terminator) if the buffer is too small,
+	// or the length of the path (without the null terminator) if it fit
+	const DWORD result = GetFullPathNameA(path, (DWORD)bufferSize, buffer, NULL);
+	if (result == 0 || result >= bufferSize || !fold) return result;
+
+	// In-place uppercase path
+	SR_FoldA(buffer, result);
+
+	return result;
+}
+
+size_t SR_CanonicizePathIntoA(const char* path, char* buffer, size_t bufferSize)
+{
+	return ResolvePathIntoA(path, buffer, bufferSize, true);
+}
+
+size_t SR_ResolvePathIntoA(const char* path, char* buffer, size_t bufferSize)
+{
+	return ResolvePathIntoA(path, buffer, bufferSize, false);
+}
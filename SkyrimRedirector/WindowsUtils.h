@@ -12,3 +12,29 @@ wchar_t* SR_CanonicizePathW(const wchar_t* path);
 // Canonicizes a narrow path, transforming it into an absolute path with no '.' or '..' nodes and in all uppercase
 // The returned string is allocated dynamically and must be freed.
 char* SR_CanonicizePathA(const char* path);
+
+// Canonicizes a wide path into a caller-supplied buffer, without allocating any memory.
+// Paths are resolved in user mode whenever possible, and only fall back to GetFullPathName if they aren't supported
+// by the user-mode canonicizer.
+// If the buffer is big enough, returns the length of the canonical path.
+// If the buffer is too small, returns the size needed to store the canonical path and leaves the buffer unspecified.
+// Returns 0 if the path couldn't be canonicized.
+size_t SR_CanonicizePathIntoW(const wchar_t* path, wchar_t* buffer, size_t bufferSize);
+
+// Canonicizes a narrow path into a caller-supplied buffer, without allocating any memory.
+// Paths are resolved in user mode whenever possible, and only fall back to GetFullPathName if they aren't supported
+// by the user-mode canonicizer.
+// If the buffer is big enough, returns the length of the canonical path.
+// If the buffer is too small, returns the size needed to store the canonical path and leaves the buffer unspecified.
+// Returns 0 if the path couldn't be canonicized.
+size_t SR_CanonicizePathIntoA(const char* path, char* buffer, size_t bufferSize);
+
+// Resolves a wide path into a caller-supplied buffer, the same way as SR_CanonicizePathIntoW but keeping its case.
+// The result has the same length and separators as the canonical path.
+// See SR_CanonicizePathIntoW for the return value.
+size_t SR_ResolvePathIntoW(const wchar_t* path, wchar_t* buffer, size_t bufferSize);
+
+// Resolves a narrow path into a caller-supplied buffer, the same way as SR_CanonicizePathIntoA but keeping its case.
+// The result has the same length and separators as the canonical path.
+// See SR_CanonicizePathIntoA for the return value.
+size_t SR_ResolvePathIntoA(const char* path, char* buffer, size_t bufferSize);
@@ -1,13 +1,16 @@
 #include <Windows.h>
 #include <ShlObj.h>
 #include <stdio.h>
+#include <string.h>
 #include <stdbool.h>
 #include "..\SkyrimRedirector\PluginAPI.h"
 #include "..\SkyrimRedirector\PlatformDefinitions.h"
 
-#define NUMBER_OF_TESTS 9
+#define NUMBER_OF_TESTS 13
 
 typedef bool(*SKSEPlugin_Load_t)(const SKSEInterface*);
+typedef long(*SR_Test_GetMatcherAllocationCount_t)();
+typedef long(*SR_Test_GetMatcherCallCount_t)();
 
 #define FOREGROUND_GRAY FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE
 #define FOREGROUND_WHITE FOREGROUND_GRAY | FOREGROUND_INTENSITY
@@ -24,6 +27,18 @@ typedef bool(*SKSEPlugin_Load_t)(const SKSEInterface*);
 #define SKYRIM_PREFS_INI &FOLDERID_Documents, L"\\My Games\\Skyrim" SR_FOLDER_SUFFIX_W L"\\SkyrimPrefs.ini"
 #define SKYRIM_PLUGINS &FOLDERID_LocalAppData, L"\\Skyrim" SR_FOLDER_SUFFIX_W L"\\plugins.txt"
 
+// The redirector's config, relative to the current directory
+#define CONFIG_FILE L"Data\\SKSE\\Plugins\\SkyrimRedirector.ini"
+// Where the config is kept while the tests add their rules to it, to be put back once they're done
+#define CONFIG_BACKUP_FILE L"Data\\SKSE\\Plugins\\SkyrimRedirector.ini.testbackup"
+
+// Files copied by the CopyFile test, relative to the current directory. Each source is redirected to its target.
+#define COPY_FOLDER L"RedirectorCopyTest"
+#define COPY_SOURCE L"CopySource.txt"
+#define COPY_SOURCE_TARGET L"CopySourceTarget.txt"
+#define COPY_DESTINATION L"CopyDestination.txt"
+#define COPY_DESTINATION_TARGET L"CopyDestinationTarget.txt"
+
 #define TRY_READ_INI(shouldRedirect) TRY(TryRead(SKYRIM_INI, &OriginalInfo.Ini, shouldRedirect))
 #define TRY_READ_PREFS_INI(shouldRedirect) TRY(TryRead(SKYRIM_PREFS_INI, &OriginalInfo.PrefsIni, shouldRedirect))
 #define TRY_READ_PLUGINS(shouldRedirect) TRY(TryRead(SKYRIM_PLUGINS, &OriginalInfo.Plugins, shouldRedirect))
@@ -63,6 +78,9 @@ typedef bool(*SKSEPlugin_Load_t)(const SKSEInterface*);
 HANDLE StdOut;
 int TestsPassed = 0;
 
+// If the config existed before the tests, and was copied to CONFIG_BACKUP_FILE
+bool ConfigBackedUp = false;
+
 struct
 {
 	BY_HANDLE_FILE_INFORMATION Ini;
@@ -133,6 +151,23 @@ bool OpenExisting(const wchar_t* const file, HANDLE* result)
 	return true;
 }
 
+void PrintResult(bool passed)
+{
+	if (!passed)
+	{
+		SetConsoleTextAttribute(StdOut, FOREGROUND_BRIGHT_RED);
+		wprintf_s(L"    X Failed\n");
+	}
+	else
+	{
+		SetConsoleTextAttribute(StdOut, FOREGROUND_BRIGHT_GREEN);
+		wprintf_s(L"    Y Passed\n");
+		TestsPassed++;
+	}
+
+	SetConsoleTextAttribute(StdOut, FOREGROUND_NORMAL);
+}
+
 bool TryRead(const KNOWNFOLDERID* const refid, const wchar_t* const suffix, BY_HANDLE_FILE_INFORMATION* original, bool shouldRedirect)
 {
 	wchar_t* filePath;
@@ -159,25 +194,211 @@ bool TryRead(const KNOWNFOLDERID* const refid, const wchar_t* const suffix, BY_H
 	else
 		wprintf_s(L"    File was not redirected\n");
 
-	if (redirected != shouldRedirect)
-	{
-		SetConsoleTextAttribute(StdOut, FOREGROUND_BRIGHT_RED);
-		wprintf_s(L"    X Failed\n");
-	}
-	else
+	PrintResult(redirected == shouldRedirect);
+
+	CloseHandle(handle);
+
+	return true;
+}
+
+bool CheckMatcherAllocations(SR_Test_GetMatcherAllocationCount_t getAllocations)
+{
+	SetConsoleTextAttribute(StdOut, FOREGROUND_BRIGHT_BLUE);
+	wprintf_s(L"\nRedirected files have been read: Matching should not allocate memory\n");
+	SetConsoleTextAttribute(StdOut, FOREGROUND_NORMAL);
+
+	long allocations = getAllocations();
+	wprintf_s(L"    Heap allocations made while matching: %ld\n", allocations);
+
+	PrintResult(allocations == 0);
+	return true;
+}
+
+bool CheckInternalCalls(SR_Test_GetMatcherCallCount_t getMatcherCalls)
+{
+	SetConsoleTextAttribute(StdOut, FOREGROUND_BRIGHT_BLUE);
+	wprintf_s(L"\nRedirected .ini file is read into memory: Only the game's call should be matched\n");
+	SetConsoleTextAttribute(StdOut, FOREGROUND_NORMAL);
+
+	wchar_t* filePath;
+	TRY(GetKnownPath(SKYRIM_INI, &filePath));
+
+	// The first GetPrivateProfile* call reads the redirected file into memory, with the redirector's own CreateFile
+	long before = getMatcherCalls();
+	wchar_t value[256];
+	GetPrivateProfileStringW(L"General", L"sLanguage", L"", value, 256, filePath);
+	long calls = getMatcherCalls() - before;
+
+	free(filePath);
+	wprintf_s(L"    Paths matched: %ld\n", calls);
+
+	PrintResult(calls == 1);
+	return true;
+}
+
+bool CheckNarrowCalls(SR_Test_GetMatcherCallCount_t getMatcherCalls)
+{
+	SetConsoleTextAttribute(StdOut, FOREGROUND_BRIGHT_BLUE);
+	wprintf_s(L"\nNarrow function is called: Its path should only be matched once\n");
+	SetConsoleTextAttribute(StdOut, FOREGROUND_NORMAL);
+
+	wchar_t* filePath;
+	TRY(GetKnownPath(SKYRIM_INI, &filePath));
+
+	char narrowPath[MAX_PATH];
+	int converted = WideCharToMultiByte(CP_ACP, 0, filePath, -1, narrowPath, MAX_PATH, NULL, NULL);
+	free(filePath);
+	if (converted == 0) RETURN_ERROR("Unable to convert the path of Skyrim.ini to a narrow string");
+
+	// The narrow function calls the wide one, which is hooked too, with the path the narrow hook already redirected
+	long before = getMatcherCalls();
+	GetFileAttributesA(narrowPath);
+	long calls = getMatcherCalls() - before;
+
+	wprintf_s(L"    Paths matched: %ld\n", calls);
+	PrintResult(calls == 1);
+
+	return true;
+}
+
+// Gets the full path of a file in the folder of the CopyFile test
+bool GetCopyPath(const wchar_t* const name, wchar_t* result)
+{
+	wchar_t relative[MAX_PATH];
+	swprintf_s(relative, MAX_PATH, COPY_FOLDER L"\\%ls", name);
+
+	if (GetFullPathNameW(relative, MAX_PATH, result, NULL) == 0) RETURN_ERROR("Unable to get full path for %ls", relative);
+	return true;
+}
+
+bool WriteTextFile(const wchar_t* const file, const char* const text)
+{
+	HANDLE handle = CreateFileW(file, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (handle == INVALID_HANDLE_VALUE) RETURN_ERROR("Unable to create %ls", file);
+
+	DWORD written;
+	BOOL result = WriteFile(handle, text, (DWORD)strlen(text), &written, NULL);
+	CloseHandle(handle);
+
+	if (!result) RETURN_ERROR("Unable to write %ls", file);
+	return true;
+}
+
+// Checks if a file exists and has exactly the given text
+bool FileHasText(const wchar_t* const file, const char* const text)
+{
+	HANDLE handle = CreateFileW(file, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (handle == INVALID_HANDLE_VALUE) return false;
+
+	char contents[256];
+	DWORD read;
+	BOOL result = ReadFile(handle, contents, sizeof(contents) - 1, &read, NULL);
+	CloseHandle(handle);
+
+	if (!result) return false;
+	contents[read] = '\0';
+
+	return strcmp(contents, text) == 0;
+}
+
+// Adds a rule for each copied file to the config, before the redirector reads it, and prepares the files
+bool PrepareCopyTest()
+{
+	wchar_t config[MAX_PATH];
+	if (GetFullPathNameW(CONFIG_FILE, MAX_PATH, config, NULL) == 0)
+		RETURN_ERROR("Unable to get full path for the config");
+
+	CreateDirectoryW(COPY_FOLDER, NULL);
+
+	// The rules are only added to a config that can be put back as it was, whatever way the tests end
+	if (GetFileAttributesW(CONFIG_FILE) != INVALID_FILE_ATTRIBUTES)
 	{
-		SetConsoleTextAttribute(StdOut, FOREGROUND_BRIGHT_GREEN);
-		wprintf_s(L"    Y Passed\n");
-		TestsPassed++;
+		if (!CopyFileW(CONFIG_FILE, CONFIG_BACKUP_FILE, FALSE)) RETURN_ERROR("Unable to back up %ls", config);
+		ConfigBackedUp = true;
 	}
 
+	wchar_t source[MAX_PATH], sourceTarget[MAX_PATH], destination[MAX_PATH], destinationTarget[MAX_PATH];
+	TRY(GetCopyPath(COPY_SOURCE, source));
+	TRY(GetCopyPath(COPY_SOURCE_TARGET, sourceTarget));
+	TRY(GetCopyPath(COPY_DESTINATION, destination));
+	TRY(GetCopyPath(COPY_DESTINATION_TARGET, destinationTarget));
+
+	if (!WritePrivateProfileStringW(L"Redirection", COPY_SOURCE, sourceTarget, config) ||
+		!WritePrivateProfileStringW(L"Redirection", COPY_DESTINATION, destinationTarget, config))
+		RETURN_ERROR("Unable to add the CopyFile rules to %ls", config);
+
+	TRY(WriteTextFile(source, "Original source"));
+	TRY(WriteTextFile(sourceTarget, "Redirected source"));
+	DeleteFileW(destination);
+	DeleteFileW(destinationTarget);
+
+	return true;
+}
+
+// Copies a file matched by a rule to a file matched by another rule, while the redirector is loaded
+bool CopyRedirectedFile()
+{
+	wchar_t source[MAX_PATH], destination[MAX_PATH];
+	TRY(GetCopyPath(COPY_SOURCE, source));
+	TRY(GetCopyPath(COPY_DESTINATION, destination));
+
+	if (!CopyFileW(source, destination, FALSE)) RETURN_ERROR("Unable to copy %ls to %ls", source, destination);
+	return true;
+}
+
+// Checks where the copy went, once the redirector is unloaded
+bool CheckCopiedFile()
+{
+	SetConsoleTextAttribute(StdOut, FOREGROUND_BRIGHT_BLUE);
+	wprintf_s(L"\nFile has been copied: Both the source and the destination should redirect\n");
 	SetConsoleTextAttribute(StdOut, FOREGROUND_NORMAL);
 
-	CloseHandle(handle);
+	wchar_t source[MAX_PATH], sourceTarget[MAX_PATH], destination[MAX_PATH], destinationTarget[MAX_PATH];
+	TRY(GetCopyPath(COPY_SOURCE, source));
+	TRY(GetCopyPath(COPY_SOURCE_TARGET, sourceTarget));
+	TRY(GetCopyPath(COPY_DESTINATION, destination));
+	TRY(GetCopyPath(COPY_DESTINATION_TARGET, destinationTarget));
+
+	bool copiedToTarget = FileHasText(destinationTarget, "Redirected source");
+	bool copiedToDestination = GetFileAttributesW(destination) != INVALID_FILE_ATTRIBUTES;
+
+	wprintf_s(L"    Redirected source copied to the redirected destination: %ls\n", copiedToTarget ? L"yes" : L"no");
+	wprintf_s(L"    Destination written without redirection: %ls\n", copiedToDestination ? L"yes" : L"no");
+	PrintResult(copiedToTarget && !copiedToDestination);
 
 	return true;
 }
 
+// Puts the config back as it was before PrepareCopyTest, and removes the files of the test.
+// Called however the tests ended, even if one of them returned early.
+void CleanUpCopyTest()
+{
+	if (ConfigBackedUp)
+	{
+		MoveFileExW(CONFIG_BACKUP_FILE, CONFIG_FILE, MOVEFILE_REPLACE_EXISTING);
+		ConfigBackedUp = false;
+	}
+	else
+	{
+		// The config didn't exist, and was created by the redirector with the rules added to it
+		wchar_t config[MAX_PATH];
+		if (GetFullPathNameW(CONFIG_FILE, MAX_PATH, config, NULL) != 0)
+		{
+			WritePrivateProfileStringW(L"Redirection", COPY_SOURCE, NULL, config);
+			WritePrivateProfileStringW(L"Redirection", COPY_DESTINATION, NULL, config);
+		}
+	}
+
+	const wchar_t* names[] = { COPY_SOURCE, COPY_SOURCE_TARGET, COPY_DESTINATION, COPY_DESTINATION_TARGET };
+	for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+	{
+		wchar_t path[MAX_PATH];
+		if (GetCopyPath(names[i], path)) DeleteFileW(path);
+	}
+
+	RemoveDirectoryW(COPY_FOLDER);
+}
+
 bool MoveRedirector()
 {
 	DWORD dllAttributes = GetFileAttributesW(L"SkyrimRedirector.dll");
@@ -198,6 +419,7 @@ bool MoveRedirector()
 bool ExecuteTests()
 {
 	TRY(MoveRedirector());
+	TRY(PrepareCopyTest());
 
 	HMODULE redirector = LoadLibraryW(L"Data\\SKSE\\Plugins\\SkyrimRedirector");
 	if (redirector == NULL) RETURN_ERROR("Unable find the redirector. Is it in Data\\SKSE\\Plugins?");
@@ -205,15 +427,26 @@ bool ExecuteTests()
 	SKSEPlugin_Load_t load = (SKSEPlugin_Load_t)GetProcAddress(redirector, "SKSEPlugin_Load");
 	if (load == NULL) RETURN_ERROR("Unable to find SKSEPlugin_Load in the redirector");
 
+	SR_Test_GetMatcherAllocationCount_t getAllocations = (SR_Test_GetMatcherAllocationCount_t)GetProcAddress(redirector, "SR_Test_GetMatcherAllocationCount");
+	if (getAllocations == NULL) RETURN_ERROR("Unable to find SR_Test_GetMatcherAllocationCount in the redirector");
+
+	SR_Test_GetMatcherCallCount_t getMatcherCalls = (SR_Test_GetMatcherCallCount_t)GetProcAddress(redirector, "SR_Test_GetMatcherCallCount");
+	if (getMatcherCalls == NULL) RETURN_ERROR("Unable to find SR_Test_GetMatcherCallCount in the redirector");
+
 	PERFORM_TEST(L"Redirector has been attached but not loaded yet", false);
 
 	if (!load(NULL)) RETURN_ERROR("The redirector failed to load");
 
 	PERFORM_TEST(L"Redirector has been loaded", true);
+	TRY(CheckMatcherAllocations(getAllocations));
+	TRY(CheckInternalCalls(getMatcherCalls));
+	TRY(CheckNarrowCalls(getMatcherCalls));
+	TRY(CopyRedirectedFile());
 
 	if (!FreeLibrary(redirector)) RETURN_ERROR("The redirector failed to unload");
 
 	PERFORM_TEST(L"Redirector has been detached", false);
+	TRY(CheckCopiedFile());
 
 	if (TestsPassed == NUMBER_OF_TESTS)
 		SetConsoleTextAttribute(StdOut, FOREGROUND_BRIGHT_GREEN);
@@ -261,8 +494,11 @@ bool Execute()
 		RETURN_ERROR("Unable to load console handle");
 
 	TRY(LoadOriginals());
-	TRY(ExecuteTests());
-	return true;
+
+	bool result = ExecuteTests();
+	CleanUpCopyTest();
+
+	return result;
 }
 
 void main()
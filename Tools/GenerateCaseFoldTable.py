@@ -0,0 +1,87 @@
+"""
+Generates SkyrimRedirector/CaseFoldTable.c, the table SR_FoldCharW uses to uppercase wide characters.
+
+Run it from the repository root:
+
+    python Tools/GenerateCaseFoldTable.py
+
+The table follows the uppercase table NTFS uses to compare file names: every character of the Basic Multilingual Plane
+is mapped to its simple uppercase form, as long as that's a single character of the same plane. Characters whose
+uppercase form is ASCII are left unchanged unless they're ASCII themselves, so that e.g. the dotless i never matches
+an 'I' and ASCII text can be folded without looking at the table.
+
+The mappings come from the Unicode database of the Python running the script. Unicode never changes the case of an
+existing character, so newer versions only add mappings for characters that were added since.
+"""
+
+import os
+import unicodedata
+
+# Number of characters in each block of the table
+BLOCK_SIZE = 64
+# Number of characters in the Basic Multilingual Plane
+PLANE_SIZE = 0x10000
+
+OUTPUT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "SkyrimRedirector", "CaseFoldTable.c")
+
+
+def upper(c):
+	"""Gets the character a character is uppercased to, which is itself if it isn't uppercased"""
+	# Surrogates are never uppercased, as they're only halves of characters
+	if 0xD800 <= c <= 0xDFFF:
+		return c
+
+	mapped = chr(c).upper()
+	if len(mapped) != 1 or ord(mapped) >= PLANE_SIZE:
+		return c
+
+	if c >= 0x80 and ord(mapped) < 0x80:
+		return c
+
+	return ord(mapped)
+
+
+def main():
+	# Every block stores the difference between each of its characters and their uppercase form,
+	# and blocks with the same differences are only stored once
+	blocks = []
+	block_indices = {}
+	index = []
+
+	for start in range(0, PLANE_SIZE, BLOCK_SIZE):
+		deltas = tuple((upper(c) - c) & 0xFFFF for c in range(start, start + BLOCK_SIZE))
+		if deltas not in block_indices:
+			block_indices[deltas] = len(blocks)
+			blocks.append(deltas)
+
+		index.append(block_indices[deltas])
+
+	assert len(blocks) <= 256
+
+	lines = []
+	lines.append("// Generated by Tools/GenerateCaseFoldTable.py from Unicode %s, don't edit it by hand." % unicodedata.unidata_version)
+	lines.append("")
+	lines.append("#include \"SR_Base.h\"")
+	lines.append("#include \"CaseFold.h\"")
+	lines.append("")
+	lines.append("const uint8_t SR_CaseFoldIndex[SR_CASE_FOLD_BLOCK_COUNT] =")
+	lines.append("{")
+	for row in range(0, len(index), 16):
+		lines.append("\t" + " ".join("%d," % i for i in index[row:row + 16]))
+	lines.append("};")
+	lines.append("")
+	lines.append("const uint16_t SR_CaseFoldDeltas[][SR_CASE_FOLD_BLOCK_SIZE] =")
+	lines.append("{")
+	for block in blocks:
+		lines.append("\t{")
+		for row in range(0, BLOCK_SIZE, 16):
+			lines.append("\t\t" + " ".join("0x%04X," % d for d in block[row:row + 16]))
+		lines.append("\t},")
+	lines.append("};")
+
+	with open(OUTPUT, "w", newline="\n") as output:
+		output.write("\n".join(lines) + "\n")
+
+
+if __name__ == "__main__":
+	main()
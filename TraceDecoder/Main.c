@@ -0,0 +1,214 @@
+#include "../SkyrimRedirector/TraceFormat.h"
+#include "../SkyrimRedirector/Logging.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Decodes a binary trace written by the plugin's binary log mode into the text the log would have had.
+//
+// The trace format doesn't depend on Windows, so this program can be built and run on any platform,
+// e.g. from the repository root:
+//
+//   cc -O2 -o decoder TraceDecoder/Main.c SkyrimRedirector/TraceFormat.c
+//   ./decoder SkyrimRedirector.log.bin > SkyrimRedirector.log
+//
+// Pass --threads before the file to also print the ID of the thread that logged each message.
+
+// Number of 100 nanosecond intervals in a day
+#define TICKS_PER_DAY (24LL * 60 * 60 * 10000000)
+
+// Days from 0000-03-01 to 1601-01-01, the start of FILETIMEs, in the proleptic Gregorian calendar
+#define FILETIME_EPOCH_DAYS 584694
+
+// Most format IDs a trace can use
+#define MAX_FORMATS 4096
+
+// Size of the buffer each message is formatted into
+#define LINE_SIZE 8192
+
+// A trace read into memory, and the position of the next record
+typedef struct
+{
+	const unsigned char* Data;
+	size_t Len;
+	size_t Offset;
+
+} Reader;
+
+static const char* LevelNames[] = { "TRACE", "DEBUG", "INFO", "WARN", "ERROR" };
+
+// Every format defined since the last start record, as null-terminated wide strings
+static wchar_t* Formats[MAX_FORMATS];
+
+static bool Read(Reader* reader, void* value, size_t size)
+{
+	if (reader->Len - reader->Offset < size) return false;
+
+	memcpy(value, reader->Data + reader->Offset, size);
+	reader->Offset += size;
+	return true;
+}
+
+static void FreeFormats()
+{
+	for (size_t i = 0; i < MAX_FORMATS; i++)
+	{
+		free(Formats[i]);
+		Formats[i] = NULL;
+	}
+}
+
+// Prints the "yyyy-MM-dd HH:mm:ss.SSS [LEVEL] " header of a line
+static void PrintHeader(FILE* output, uint64_t time, int64_t localOffset, uint8_t level, uint32_t thread, bool threads)
+{
+	int64_t ticks = (int64_t)time + localOffset;
+	int64_t days = ticks / TICKS_PER_DAY;
+	int64_t remainder = ticks % TICKS_PER_DAY;
+
+	// Converts days to a date, counting years from March so that leap days come last
+	int64_t shifted = days + FILETIME_EPOCH_DAYS;
+	int64_t era = shifted / 146097;
+	int64_t dayOfEra = shifted - era * 146097;
+	int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+	int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+	int64_t monthIndex = (5 * dayOfYear + 2) / 153;
+	int64_t day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+	int64_t month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+	int64_t year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+
+	int64_t milliseconds = remainder / 10000;
+
+	fprintf(
+		output, "%04d-%02d-%02d %02d:%02d:%02d.%03d [%-5s] ",
+		(int)year, (int)month, (int)day,
+		(int)(milliseconds / 3600000), (int)(milliseconds / 60000 % 60), (int)(milliseconds / 1000 % 60), (int)(milliseconds % 1000),
+		level < sizeof(LevelNames) / sizeof(LevelNames[0]) ? LevelNames[level] : "????"
+	);
+
+	if (threads) fprintf(output, "[%5u] ", thread);
+}
+
+// Reads a UTF-16 string of `len` characters from the trace
+static bool ReadUtf16(Reader* reader, uint32_t len, uint16_t** text)
+{
+	if ((reader->Len - reader->Offset) / 2 < len) return false;
+
+	*text = malloc(((size_t)len + 1) * sizeof(uint16_t));
+	memcpy(*text, reader->Data + reader->Offset, (size_t)len * 2);
+	reader->Offset += (size_t)len * 2;
+
+	return true;
+}
+
+// Decodes every record of a trace. Returns false if the trace is corrupted.
+static bool Decode(Reader* reader, FILE* output, bool threads)
+{
+	static char line[LINE_SIZE];
+	int64_t localOffset = 0;
+
+	while (reader->Offset < reader->Len)
+	{
+		uint8_t type = reader->Data[reader->Offset++];
+
+		if (type == SR_TRACE_RECORD_START)
+		{
+			uint32_t magic, version;
+			if (!Read(reader, &magic, 4) || !Read(reader, &version, 4) || !Read(reader, &localOffset, 8)) return false;
+			if (magic != SR_TRACE_MAGIC || version != SR_TRACE_VERSION) return false;
+
+			// Every time the log is opened, the IDs start over
+			FreeFormats();
+		}
+		else if (type == SR_TRACE_RECORD_FORMAT)
+		{
+			uint32_t id, len;
+			uint16_t* text;
+			if (!Read(reader, &id, 4) || !Read(reader, &len, 4) || id >= MAX_FORMATS || !ReadUtf16(reader, len, &text)) return false;
+
+			// wchar_t isn't UTF-16 on every platform, but formats are plain ASCII
+			free(Formats[id]);
+			Formats[id] = malloc(((size_t)len + 1) * sizeof(wchar_t));
+			for (uint32_t i = 0; i < len; i++) Formats[id][i] = (wchar_t)text[i];
+			Formats[id][len] = L'\0';
+
+			free(text);
+		}
+		else if (type == SR_TRACE_RECORD_MESSAGE)
+		{
+			uint32_t id, thread, size;
+			uint8_t level;
+			uint64_t time;
+			if (!Read(reader, &id, 4) || !Read(reader, &level, 1) || !Read(reader, &time, 8) || !Read(reader, &thread, 4) || !Read(reader, &size, 4)) return false;
+			if (id >= MAX_FORMATS || Formats[id] == NULL || reader->Len - reader->Offset < size) return false;
+
+			size_t len = SR_FormatTrace(Formats[id], reader->Data + reader->Offset, size, line, LINE_SIZE);
+			reader->Offset += size;
+
+			PrintHeader(output, time, localOffset, level, thread, threads);
+			fwrite(line, 1, len, output);
+			fputs("\r\n", output);
+		}
+		else if (type == SR_TRACE_RECORD_TEXT)
+		{
+			uint32_t thread, len;
+			uint8_t level;
+			uint64_t time;
+			uint16_t* text;
+			if (!Read(reader, &level, 1) || !Read(reader, &time, 8) || !Read(reader, &thread, 4) || !Read(reader, &len, 4) || !ReadUtf16(reader, len, &text)) return false;
+
+			size_t converted = SR_TraceUtf16ToUtf8(text, len, line, LINE_SIZE);
+			free(text);
+
+			PrintHeader(output, time, localOffset, level, thread, threads);
+			fwrite(line, 1, converted, output);
+			fputs("\r\n", output);
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	bool threads = argc > 1 && strcmp(argv[1], "--threads") == 0;
+	if (argc != (threads ? 3 : 2))
+	{
+		fprintf(stderr, "Usage: %s [--threads] <trace file>\n", argv[0]);
+		return 2;
+	}
+
+	FILE* file = fopen(argv[threads ? 2 : 1], "rb");
+	if (file == NULL)
+	{
+		fprintf(stderr, "Unable to open '%s'\n", argv[threads ? 2 : 1]);
+		return 1;
+	}
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	unsigned char* data = malloc(size > 0 ? (size_t)size : 1);
+	size_t read = fread(data, 1, size > 0 ? (size_t)size : 0, file);
+	fclose(file);
+
+	Reader reader = { data, read, 0 };
+	bool decoded = Decode(&reader, stdout, threads);
+
+	FreeFormats();
+	free(data);
+
+	if (!decoded)
+	{
+		// A trace cut short by a crash is expected to end in the middle of a record
+		fprintf(stderr, "The trace is corrupted or truncated at byte %zu\n", reader.Offset);
+		return 1;
+	}
+
+	return 0;
+}